@@ -10,13 +10,14 @@
 //  See http://www.wtfpl.net/ for more details.
 //
 
+#include <algorithm>
 #include <array>
-#include <functional>
+#include <atomic>
+#include <cstring>
 #include <lol/engine/audio>
 #include <lol/msg>
 #include <memory>
-#include <mutex>
-#include <unordered_map>
+#include <thread>
 
 #if LOL_USE_KORE
 #   include <kinc/audio2/audio.h>
@@ -25,37 +26,211 @@
 namespace lol::audio
 {
 
-static std::shared_ptr<mixer<float>> g_mixer;
-static std::mutex g_mutex;
+// A bounded queue that any thread may push to or pop from without taking
+// a lock (Dmitry Vyukov’s algorithm). Cells are allocated once, and moving
+// a shared_ptr in or out of one neither allocates nor frees memory.
+template<typename T, size_t N>
+class command_queue
+{
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
 
-// FIXME: this could be removed by inserting this in g_mixer
-std::unordered_map<int, std::shared_ptr<stream<float>>> g_streams;
+public:
+    command_queue()
+    {
+        for (size_t i = 0; i < N; ++i)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
 
-void init()
+    bool try_push(T &&value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell &c = m_cells[pos & (N - 1)];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            if (seq == pos)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.value = std::move(value);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (seq < pos)
+                return false; // full
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_pop(T &value)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell &c = m_cells[pos & (N - 1)];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            if (seq == pos + 1)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(c.value);
+                    c.seq.store(pos + N, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (seq < pos + 1)
+                return false; // empty
+            else
+                pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::array<cell, N> m_cells;
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+};
+
+static size_t const channel_count = 2;
+static int const frequency = 48000;
+static size_t const max_streams = 256;
+static size_t const block_frames = 1024;
+
+// Adding a stream, or removing one if s is null
+struct command
+{
+    int id = -1;
+    std::shared_ptr<stream<float>> s;
+};
+
+static std::atomic<int> g_next_id = 0;
+static command_queue<command, 1024> g_commands;
+
+// Streams the callback let go of. They are released by the thread that
+// calls start_stream() or stop_stream(), so that the audio thread never
+// frees memory. The callback is the only producer, which lets it check
+// for room before taking a command.
+static command_queue<std::shared_ptr<stream<float>>, 1024> g_retired;
+static std::atomic<size_t> g_retired_count = 0;
+
+// Only ever touched by the thread rendering audio
+static struct
+{
+    std::array<int, max_streams> ids;
+    std::array<std::shared_ptr<stream<float>>, max_streams> streams;
+    size_t count = 0;
+    alignas(16) std::array<float, block_frames * channel_count> tmp;
+    alignas(16) std::array<float, block_frames * channel_count> out;
+}
+g_rt;
+
+static void retire(std::shared_ptr<stream<float>> &&s)
 {
-    g_mixer = std::make_shared<mixer<float>>(2, 48000);
+    // Count first, so that the count never falls below the queue size
+    g_retired_count.fetch_add(1, std::memory_order_relaxed);
+    g_retired.try_push(std::move(s));
+}
 
+static void apply_commands()
+{
+    // Every command retires at most one stream
+    command cmd;
+    while (g_retired_count.load(std::memory_order_relaxed) < 1024
+            && g_commands.try_pop(cmd))
+    {
+        if (cmd.s)
+        {
+            if (g_rt.count == max_streams)
+            {
+                retire(std::move(cmd.s));
+                continue;
+            }
+            g_rt.ids[g_rt.count] = cmd.id;
+            g_rt.streams[g_rt.count++] = std::move(cmd.s);
+        }
+        else
+        {
+            for (size_t i = 0; i < g_rt.count; ++i)
+            {
+                if (g_rt.ids[i] != cmd.id)
+                    continue;
+                // Order does not matter, so move the last stream here
+                retire(std::move(g_rt.streams[i]));
+                g_rt.ids[i] = g_rt.ids[--g_rt.count];
+                g_rt.streams[i] = std::move(g_rt.streams[g_rt.count]);
+                break;
+            }
+        }
+    }
+}
+
+// Release the streams that the callback is done with
+static void collect()
+{
+    std::shared_ptr<stream<float>> s;
+    while (g_retired.try_pop(s))
+    {
+        g_retired_count.fetch_sub(1, std::memory_order_relaxed);
+        s.reset();
+    }
+}
+
+void render(float *buf, size_t frames)
+{
+    apply_commands();
+
+    while (frames)
+    {
+        size_t todo = std::min(frames, block_frames);
+        size_t const samples = todo * channel_count;
+        std::fill_n(buf, samples, 0.f);
+
+        for (size_t i = 0; i < g_rt.count; ++i)
+        {
+            size_t count = g_rt.streams[i]->get(g_rt.tmp.data(), todo);
+            dsp::mix(buf, g_rt.tmp.data(), count * channel_count);
+        }
+
+        buf += samples;
+        frames -= todo;
+    }
+}
+
+void init()
+{
 #if LOL_USE_KORE
     kinc_a2_init();
     kinc_a2_set_callback([](kinc_a2_buffer_t* buffer, uint32_t samples, void* userdata)
     {
-        size_t channel_count;
-        std::vector<float> tmp;
-
+        for (size_t done = 0; done < samples; )
         {
-            std::unique_lock<std::mutex> lock(g_mutex);
+            size_t todo = std::min(size_t(samples) - done, block_frames);
+            render(g_rt.out.data(), todo);
+            dsp::softclip(g_rt.out.data(), todo * channel_count);
 
-            channel_count = g_mixer->channels();
-            tmp.resize(samples * channel_count);
-            g_mixer->get(tmp.data(), samples);
-        }
+            // Copy in at most two runs, split where the ring buffer wraps
+            for (size_t n = 0; n < todo; )
+            {
+                size_t pos = buffer->write_location;
+                size_t run = std::min(todo - n, size_t(buffer->data_size - pos));
+                float *dst[channel_count];
+                for (size_t ch = 0; ch < channel_count; ++ch)
+                    dst[ch] = buffer->channels[ch] + pos;
+                dsp::deinterleave(g_rt.out.data() + n * channel_count, channel_count, dst, run);
 
-        for (size_t n = 0; n < samples; ++n)
-        {
-            for (size_t ch = 0; ch < channel_count; ++ch)
-                buffer->channels[ch][buffer->write_location] = lol::audio::sample::softclip(tmp[n * channel_count + ch]);
+                buffer->write_location = uint32_t((pos + run) % buffer->data_size);
+                n += run;
+            }
 
-            buffer->write_location = (buffer->write_location + 1) % buffer->data_size;
+            done += todo;
         }
     }, nullptr);
 #endif
@@ -66,24 +241,44 @@ void shutdown()
 #if LOL_USE_KORE
     kinc_a2_set_callback(nullptr, nullptr);
 #endif
+
+    // Nothing is rendering any more, so we may touch the stream list
+    command cmd;
+    while (g_commands.try_pop(cmd))
+        ;
+    for (size_t i = 0; i < g_rt.count; ++i)
+        g_rt.streams[i].reset();
+    g_rt.count = 0;
+    collect();
 }
 
 template<>
 int start_stream(std::shared_ptr<stream<float>> s)
 {
-    static int idx = 0;
-    std::unique_lock<std::mutex> lock(g_mutex);
-    g_streams[idx] = s;
-    g_mixer->add(s);
-    return idx++;
+    s = dsp::make_output_adapter(s, channel_count, frequency);
+
+    int id = g_next_id++;
+    command cmd { id, s };
+    while (!g_commands.try_push(std::move(cmd)))
+    {
+        collect();
+        std::this_thread::yield();
+    }
+
+    collect();
+    return id;
 }
 
 void stop_stream(int id)
 {
-    std::unique_lock<std::mutex> lock(g_mutex);
-    auto s = g_streams[id];
-    g_streams.erase(id);
-    g_mixer->remove(s);
+    command cmd { id, nullptr };
+    while (!g_commands.try_push(std::move(cmd)))
+    {
+        collect();
+        std::this_thread::yield();
+    }
+
+    collect();
 }
 
 } // namespace lol::audio
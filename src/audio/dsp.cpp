@@ -0,0 +1,547 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine/audio>
+#include <algorithm> // std::min, std::fill_n
+#include <cmath>     // std::sin, std::sqrt
+#include <cstring>   // std::memmove
+#include <vector>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define LOL_DSP_SSE2 1
+#elif defined __ARM_NEON && defined __aarch64__
+#   include <arm_neon.h>
+#   define LOL_DSP_NEON 1
+#endif
+
+namespace lol::audio::dsp
+{
+
+// Streams are processed in blocks of this many frames
+static size_t const block_frames = 1024;
+
+//
+// Sample kernels
+//
+
+void convert(int16_t const *src, float *dst, size_t samples)
+{
+    float const scale = 1.f / 32768.f;
+    size_t n = 0;
+#if LOL_DSP_SSE2
+    __m128 const k = _mm_set1_ps(scale);
+    for (; n + 8 <= samples; n += 8)
+    {
+        __m128i x = _mm_loadu_si128((__m128i const *)(src + n));
+        // Sign-extend by putting each sample in the top half of a lane
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + n, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(dst + n + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+#elif LOL_DSP_NEON
+    for (; n + 8 <= samples; n += 8)
+    {
+        int16x8_t x = vld1q_s16(src + n);
+        vst1q_f32(dst + n, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+        vst1q_f32(dst + n + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), scale));
+    }
+#endif
+    for (; n < samples; ++n)
+        dst[n] = src[n] * scale;
+}
+
+void mix(float *dst, float const *src, size_t samples)
+{
+    size_t n = 0;
+#if LOL_DSP_SSE2
+    for (; n + 8 <= samples; n += 8)
+    {
+        _mm_storeu_ps(dst + n, _mm_add_ps(_mm_loadu_ps(dst + n), _mm_loadu_ps(src + n)));
+        _mm_storeu_ps(dst + n + 4, _mm_add_ps(_mm_loadu_ps(dst + n + 4), _mm_loadu_ps(src + n + 4)));
+    }
+#elif LOL_DSP_NEON
+    for (; n + 8 <= samples; n += 8)
+    {
+        vst1q_f32(dst + n, vaddq_f32(vld1q_f32(dst + n), vld1q_f32(src + n)));
+        vst1q_f32(dst + n + 4, vaddq_f32(vld1q_f32(dst + n + 4), vld1q_f32(src + n + 4)));
+    }
+#endif
+    for (; n < samples; ++n)
+        dst[n] += src[n];
+}
+
+void remix(float const *src, size_t src_channels,
+           float *dst, size_t dst_channels, size_t frames)
+{
+    size_t n = 0;
+
+    if (src_channels == dst_channels)
+    {
+        std::copy_n(src, frames * src_channels, dst);
+    }
+    else if (src_channels == 1 && dst_channels == 2)
+    {
+#if LOL_DSP_SSE2
+        for (; n + 4 <= frames; n += 4)
+        {
+            __m128 x = _mm_loadu_ps(src + n);
+            _mm_storeu_ps(dst + 2 * n, _mm_unpacklo_ps(x, x));
+            _mm_storeu_ps(dst + 2 * n + 4, _mm_unpackhi_ps(x, x));
+        }
+#elif LOL_DSP_NEON
+        for (; n + 4 <= frames; n += 4)
+        {
+            float32x4_t x = vld1q_f32(src + n);
+            float32x4x2_t y = { { x, x } };
+            vst2q_f32(dst + 2 * n, y);
+        }
+#endif
+        for (; n < frames; ++n)
+            dst[2 * n] = dst[2 * n + 1] = src[n];
+    }
+    else if (src_channels == 2 && dst_channels == 1)
+    {
+#if LOL_DSP_SSE2
+        __m128 const half = _mm_set1_ps(0.5f);
+        for (; n + 4 <= frames; n += 4)
+        {
+            __m128 a = _mm_loadu_ps(src + 2 * n), b = _mm_loadu_ps(src + 2 * n + 4);
+            __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(dst + n, _mm_mul_ps(_mm_add_ps(l, r), half));
+        }
+#elif LOL_DSP_NEON
+        for (; n + 4 <= frames; n += 4)
+        {
+            float32x4x2_t x = vld2q_f32(src + 2 * n);
+            vst1q_f32(dst + n, vmulq_n_f32(vaddq_f32(x.val[0], x.val[1]), 0.5f));
+        }
+#endif
+        for (; n < frames; ++n)
+            dst[n] = 0.5f * (src[2 * n] + src[2 * n + 1]);
+    }
+    else if (src_channels == 1)
+    {
+        for (; n < frames; ++n)
+            std::fill_n(dst + n * dst_channels, dst_channels, src[n]);
+    }
+    else if (dst_channels == 1)
+    {
+        float const k = 1.f / src_channels;
+        for (; n < frames; ++n)
+        {
+            float sum = 0.f;
+            for (size_t ch = 0; ch < src_channels; ++ch)
+                sum += src[n * src_channels + ch];
+            dst[n] = sum * k;
+        }
+    }
+    else
+    {
+        for (; n < frames; ++n)
+            for (size_t ch = 0; ch < dst_channels; ++ch)
+                dst[n * dst_channels + ch] = ch < src_channels ? src[n * src_channels + ch] : 0.f;
+    }
+}
+
+// Not vectorised by hand, so that the curve stays the one every sample
+// went through before; it is inlined and simple enough for the compiler.
+void softclip(float *buf, size_t samples)
+{
+    for (size_t n = 0; n < samples; ++n)
+        buf[n] = sample::softclip(buf[n]);
+}
+
+void deinterleave(float const *src, size_t channels, float *const *dst, size_t frames)
+{
+    size_t n = 0;
+
+    if (channels == 2)
+    {
+        float *l = dst[0], *r = dst[1];
+#if LOL_DSP_SSE2
+        for (; n + 4 <= frames; n += 4)
+        {
+            __m128 a = _mm_loadu_ps(src + 2 * n), b = _mm_loadu_ps(src + 2 * n + 4);
+            _mm_storeu_ps(l + n, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(r + n, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+#elif LOL_DSP_NEON
+        for (; n + 4 <= frames; n += 4)
+        {
+            float32x4x2_t x = vld2q_f32(src + 2 * n);
+            vst1q_f32(l + n, x.val[0]);
+            vst1q_f32(r + n, x.val[1]);
+        }
+#endif
+        for (; n < frames; ++n)
+        {
+            l[n] = src[2 * n];
+            r[n] = src[2 * n + 1];
+        }
+        return;
+    }
+
+    for (size_t ch = 0; ch < channels; ++ch)
+        for (n = 0; n < frames; ++n)
+            dst[ch][n] = src[n * channels + ch];
+}
+
+//
+// The resampler
+//
+// Output frames are computed from a window of `taps` input frames. The
+// filter for the fractional position between two input frames is linearly
+// interpolated between the two nearest of `phases` precomputed filters.
+//
+
+class resampler_impl
+{
+public:
+    static int const taps = 32;     // multiple of 4, for the SIMD dot product
+    static int const phases = 256;
+
+    resampler_impl(std::shared_ptr<stream<float>> src, int frequency)
+      : m_src(src),
+        m_channels(src->channels()),
+        m_in_freq(src->frequency()),
+        m_out_freq(frequency),
+        m_capacity(block_frames + taps),
+        m_history(m_capacity * m_channels),
+        m_input(block_frames * m_channels),
+        m_rows(m_channels)
+    {
+        // Kaiser-windowed sinc, cut off a bit below the lower Nyquist
+        // frequency to leave room for the transition band
+        double const cutoff = 0.95 * std::min(1.0, double(frequency) / m_in_freq);
+        double const beta = 8.0;
+        auto bessel_i0 = [](double x)
+        {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 32; ++k)
+            {
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+            }
+            return sum;
+        };
+
+        m_table.resize((phases + 1) * taps);
+        for (int p = 0; p <= phases; ++p)
+        {
+            float *h = &m_table[p * taps];
+            double sum = 0.0;
+            for (int k = 0; k < taps; ++k)
+            {
+                double x = k - (taps / 2 - 1) - double(p) / phases;
+                double w = x / (taps / 2);
+                double sinc = x == 0.0 ? 1.0 : std::sin(3.14159265358979 * cutoff * x)
+                                                 / (3.14159265358979 * cutoff * x);
+                double win = std::abs(w) >= 1.0 ? 0.0 : bessel_i0(beta * std::sqrt(1.0 - w * w)) / bessel_i0(beta);
+                h[k] = float(sinc * win);
+                sum += h[k];
+            }
+            // Unity gain at DC for every phase
+            for (int k = 0; k < taps; ++k)
+                h[k] = float(h[k] / sum);
+        }
+
+        reset(0);
+    }
+
+    void reset(size_t in_pos)
+    {
+        // Start with silence before the first frame, so that the first
+        // output frame is centred on it
+        std::fill(m_history.begin(), m_history.end(), 0.f);
+        m_count = taps / 2 - 1;
+        m_read = 0;
+        m_frac = 0;
+        m_abs = int64_t(in_pos) - m_count;
+        m_in_total = in_pos;
+        m_eof = false;
+    }
+
+    // Make room in the history and append input frames, or silence once
+    // the source is exhausted
+    void refill()
+    {
+        if (m_read)
+        {
+            for (size_t ch = 0; ch < m_channels; ++ch)
+            {
+                float *row = &m_history[ch * m_capacity];
+                std::memmove(row, row + m_read, (m_count - m_read) * sizeof(float));
+            }
+            m_abs += int64_t(m_read);
+            m_count -= m_read;
+            m_read = 0;
+        }
+
+        size_t const room = m_capacity - m_count;
+        for (size_t ch = 0; ch < m_channels; ++ch)
+            m_rows[ch] = &m_history[ch * m_capacity + m_count];
+
+        if (!m_eof)
+        {
+            size_t n = m_src->get(m_input.data(), std::min(room, block_frames));
+            if (n)
+            {
+                deinterleave(m_input.data(), m_channels, m_rows.data(), n);
+                m_count += n;
+                m_in_total += n;
+                return;
+            }
+            m_eof = true;
+        }
+
+        for (size_t ch = 0; ch < m_channels; ++ch)
+            std::fill_n(m_rows[ch], room, 0.f);
+        m_count += room;
+    }
+
+    static void lerp(float const *h0, float const *h1, float t, float *dst)
+    {
+#if LOL_DSP_SSE2
+        __m128 const k = _mm_set1_ps(t);
+        for (int i = 0; i < taps; i += 4)
+        {
+            __m128 a = _mm_loadu_ps(h0 + i), b = _mm_loadu_ps(h1 + i);
+            _mm_store_ps(dst + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), k)));
+        }
+#elif LOL_DSP_NEON
+        for (int i = 0; i < taps; i += 4)
+        {
+            float32x4_t a = vld1q_f32(h0 + i), b = vld1q_f32(h1 + i);
+            vst1q_f32(dst + i, vmlaq_n_f32(a, vsubq_f32(b, a), t));
+        }
+#else
+        for (int i = 0; i < taps; ++i)
+            dst[i] = h0[i] + (h1[i] - h0[i]) * t;
+#endif
+    }
+
+    static float dot(float const *x, float const *h)
+    {
+#if LOL_DSP_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < taps; k += 4)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+#elif LOL_DSP_NEON
+        float32x4_t sum = vdupq_n_f32(0.f);
+        for (int k = 0; k < taps; k += 4)
+            sum = vmlaq_f32(sum, vld1q_f32(x + k), vld1q_f32(h + k));
+        return vaddvq_f32(sum);
+#else
+        float sum = 0.f;
+        for (int k = 0; k < taps; ++k)
+            sum += x[k] * h[k];
+        return sum;
+#endif
+    }
+
+    size_t get(float *buf, size_t frames)
+    {
+        size_t done = 0;
+        while (done < frames)
+        {
+            // Stop after the output frame for the last input frame
+            if (m_eof && m_abs + int64_t(m_read + taps / 2 - 1) >= int64_t(m_in_total))
+                break;
+
+            if (m_count - m_read < size_t(taps))
+            {
+                refill();
+                continue;
+            }
+
+            // The position between two input frames picks two phases
+            float const phase = float(m_frac) * m_phase_scale;
+            size_t const p = std::min(size_t(phase), size_t(phases - 1));
+            float const t = phase - float(p);
+            float const *h0 = &m_table[p * taps];
+            float const *h1 = h0 + taps;
+            lerp(h0, h1, t, m_kernel);
+
+            for (size_t ch = 0; ch < m_channels; ++ch)
+                buf[done * m_channels + ch] = dot(&m_history[ch * m_capacity + m_read], m_kernel);
+
+            // Step by in/out input frames, exactly
+            m_frac += uint64_t(m_in_freq);
+            while (m_frac >= uint64_t(m_out_freq))
+            {
+                m_frac -= uint64_t(m_out_freq);
+                ++m_read;
+            }
+            ++done;
+        }
+
+        m_out_pos += done;
+        return done;
+    }
+
+    std::shared_ptr<stream<float>> m_src;
+    size_t m_channels;
+    int m_in_freq, m_out_freq;
+    uint64_t m_frac = 0;          // position between input frames, in 1/m_out_freq
+    float m_phase_scale = float(phases) / m_out_freq;
+
+    std::vector<float> m_table;
+    alignas(16) float m_kernel[taps];
+    size_t m_capacity;
+    std::vector<float> m_history; // one row of m_capacity frames per channel
+    std::vector<float> m_input;
+    std::vector<float *> m_rows;
+    size_t m_count = 0, m_read = 0;
+    int64_t m_abs = 0;             // input position of the first history frame
+    size_t m_in_total = 0, m_out_pos = 0;
+    bool m_eof = false;
+};
+
+resampler::resampler(std::shared_ptr<stream<float>> src, int frequency)
+  : stream<float>(src->channels(), frequency),
+    impl(std::make_unique<resampler_impl>(src, frequency))
+{
+}
+
+resampler::~resampler()
+{
+}
+
+size_t resampler::get(float *buf, size_t frames)
+{
+    return impl->get(buf, frames);
+}
+
+std::optional<size_t> resampler::size() const
+{
+    if (auto n = impl->m_src->size(); n)
+        return size_t((uint64_t(*n) * impl->m_out_freq + impl->m_in_freq - 1) / impl->m_in_freq);
+    return std::nullopt;
+}
+
+std::optional<size_t> resampler::pos() const
+{
+    return impl->m_out_pos;
+}
+
+bool resampler::seek(size_t pos)
+{
+    size_t in_pos = size_t(uint64_t(pos) * impl->m_in_freq / impl->m_out_freq);
+    if (!impl->m_src->seek(in_pos))
+        return false;
+    impl->reset(in_pos);
+    impl->m_frac = uint64_t(pos) * impl->m_in_freq % impl->m_out_freq;
+    impl->m_out_pos = pos;
+    return true;
+}
+
+//
+// Format adapters
+//
+
+// 16-bit samples to floats
+class converter : public stream<float>
+{
+public:
+    converter(std::shared_ptr<stream<int16_t>> src)
+      : stream<float>(src->channels(), src->frequency()),
+        m_src(src),
+        m_tmp(block_frames * src->channels())
+    {}
+
+    virtual size_t get(float *buf, size_t frames) override
+    {
+        size_t done = 0;
+        while (done < frames)
+        {
+            size_t todo = std::min(frames - done, block_frames);
+            size_t n = m_src->get(m_tmp.data(), todo);
+            convert(m_tmp.data(), buf + done * m_channels, n * m_channels);
+            done += n;
+            if (n < todo)
+                break;
+        }
+        return done;
+    }
+
+    virtual std::optional<size_t> size() const override { return m_src->size(); }
+    virtual std::optional<size_t> pos() const override { return m_src->pos(); }
+    virtual bool seek(size_t pos) override { return m_src->seek(pos); }
+
+private:
+    std::shared_ptr<stream<int16_t>> m_src;
+    std::vector<int16_t> m_tmp;
+};
+
+// Change the number of channels
+class remixer : public stream<float>
+{
+public:
+    remixer(std::shared_ptr<stream<float>> src, size_t channels)
+      : stream<float>(channels, src->frequency()),
+        m_src(src),
+        m_tmp(block_frames * src->channels())
+    {}
+
+    virtual size_t get(float *buf, size_t frames) override
+    {
+        size_t done = 0;
+        while (done < frames)
+        {
+            size_t todo = std::min(frames - done, block_frames);
+            size_t n = m_src->get(m_tmp.data(), todo);
+            remix(m_tmp.data(), m_src->channels(), buf + done * m_channels, m_channels, n);
+            done += n;
+            if (n < todo)
+                break;
+        }
+        return done;
+    }
+
+    virtual std::optional<size_t> size() const override { return m_src->size(); }
+    virtual std::optional<size_t> pos() const override { return m_src->pos(); }
+    virtual bool seek(size_t pos) override { return m_src->seek(pos); }
+
+private:
+    std::shared_ptr<stream<float>> m_src;
+    std::vector<float> m_tmp;
+};
+
+std::shared_ptr<stream<float>> make_output_adapter(std::shared_ptr<stream<int16_t>> s,
+                                                   size_t channels, int frequency)
+{
+    return make_output_adapter(std::make_shared<converter>(s), channels, frequency);
+}
+
+std::shared_ptr<stream<float>> make_output_adapter(std::shared_ptr<stream<float>> s,
+                                                   size_t channels, int frequency)
+{
+    // Resample whichever side has fewer channels
+    bool const upmix = s->channels() < channels;
+
+    if (upmix && s->frequency() != frequency)
+        s = std::make_shared<resampler>(s, frequency);
+    if (s->channels() != channels)
+        s = std::make_shared<remixer>(s, channels);
+    if (!upmix && s->frequency() != frequency)
+        s = std::make_shared<resampler>(s, frequency);
+
+    return s;
+}
+
+} // namespace lol::audio::dsp
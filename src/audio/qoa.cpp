@@ -11,44 +11,136 @@
 //
 
 #include <lol/engine/audio>
+#include <algorithm> // std::min, std::copy_n
+#include <fstream>   // std::ifstream
+#include <limits>    // std::numeric_limits
 #include <memory>
+#include <vector>
+
+#if !_WIN32
+#   include <fcntl.h>    // open
+#   include <sys/mman.h> // mmap
+#   include <sys/stat.h> // fstat
+#   include <unistd.h>   // close
+#endif
 
 #include "../3rdparty/qoa/qoa.h"
 
 namespace lol::audio
 {
 
+// Where the encoded data lives: a copy of a caller’s buffer, or a file
+// that is mapped in memory when the platform allows it.
+
+class qoa_source
+{
+public:
+    qoa_source(uint8_t const *data, size_t size)
+      : m_copy(data, data + size),
+        m_data(m_copy.data()),
+        m_size(size)
+    {}
+
+    qoa_source(std::string const &path)
+    {
+#if !_WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    m_map = p;
+                    m_data = static_cast<uint8_t const *>(p);
+                    m_size = size_t(st.st_size);
+                }
+            }
+            close(fd);
+            if (m_map)
+                return;
+        }
+#endif
+        std::ifstream f(path, std::ios::binary);
+        m_copy.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        m_data = m_copy.data();
+        m_size = m_copy.size();
+    }
+
+    ~qoa_source()
+    {
+#if !_WIN32
+        if (m_map)
+            munmap(m_map, m_size);
+#endif
+    }
+
+    uint8_t const *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    std::vector<uint8_t> m_copy;
+    void *m_map = nullptr;
+    uint8_t const *m_data = nullptr;
+    size_t m_size = 0;
+};
+
 // The QOA decoder (https://qoaformat.org/)
+//
+// Every QOA frame holds QOA_FRAME_LEN samples per channel, except the last
+// one, and starts with the decoder state, so frames can be decoded on their
+// own. All frames but the last have the same size, so finding the frame for
+// a given position is a multiplication. Only the current frame is kept.
 
 class qoa_decoder : public stream<int16_t>
 {
 public:
-    qoa_decoder(uint8_t const *data, size_t size)
+    qoa_decoder(std::shared_ptr<qoa_source> source)
       : stream<int16_t>(1, 0),
-        m_frame_count(0),
-        m_frame_pos(0)
+        m_source(source)
     {
-        qoa_desc qoa;
-        if (auto qoa_data = qoa_decode(data, (int)size, &qoa); qoa_data)
-        {
-            m_channels = qoa.channels;
-            m_frequency = qoa.samplerate;
-            // Should use QOA_FREE() instead of free() but it is private to the implementation.
-            m_qoa_data = std::shared_ptr<int16_t>(qoa_data, [](int16_t *p) { free(p); });
-            m_frame_count = qoa.samples;
-        }
+        m_header_size = decode_header(m_source->data(), m_source->size(), m_qoa);
+        if (!m_header_size || !m_qoa.channels || m_qoa.channels > QOA_MAX_CHANNELS
+             || !m_qoa.samplerate)
+            return;
+
+        m_channels = m_qoa.channels;
+        m_frequency = m_qoa.samplerate;
+        m_frame_size = qoa_max_frame_size(&m_qoa);
+        // A sample count of zero means a streamed file of unknown length,
+        // which is read until a frame fails to decode
+        m_frame_count = m_qoa.samples ? m_qoa.samples : std::numeric_limits<size_t>::max();
+        m_pcm.resize(QOA_FRAME_LEN * m_qoa.channels);
     }
 
     virtual size_t get(int16_t *buf, size_t frames) override
     {
-        size_t todo = std::min(frames, m_frame_count - m_frame_pos);
-        std::copy_n(m_qoa_data.get() + m_frame_pos * m_channels, todo * m_channels, buf);
-        m_frame_pos += todo;
-        return todo;
+        size_t done = 0;
+        while (done < frames && m_frame_pos < m_frame_count)
+        {
+            size_t const block = m_frame_pos / QOA_FRAME_LEN;
+            if (block != m_block && !decode(block))
+                break;
+
+            size_t const offset = m_frame_pos - block * QOA_FRAME_LEN;
+            if (offset >= m_block_len)
+                break; // truncated file
+
+            size_t todo = std::min(frames - done, m_block_len - offset);
+            std::copy_n(m_pcm.data() + offset * m_channels, todo * m_channels,
+                        buf + done * m_channels);
+            done += todo;
+            m_frame_pos += todo;
+        }
+        return done;
     }
 
     virtual std::optional<size_t> size() const override
     {
+        if (m_frame_count == std::numeric_limits<size_t>::max())
+            return std::nullopt;
         return m_frame_count;
     }
 
@@ -64,14 +156,60 @@ public:
     }
 
 protected:
-    std::shared_ptr<int16_t> m_qoa_data;
-    size_t m_frame_count;
-    size_t m_frame_pos;
+    // The file header only holds the sample count; the channel count and
+    // rate come from the first frame header. This is what qoa_decode_header()
+    // does, except that it refuses streamed files, whose sample count is 0.
+    static size_t decode_header(uint8_t const *data, size_t size, qoa_desc &qoa)
+    {
+        auto const read_u32 = [data](size_t i)
+        {
+            return uint32_t(data[i]) << 24 | uint32_t(data[i + 1]) << 16
+                 | uint32_t(data[i + 2]) << 8 | uint32_t(data[i + 3]);
+        };
+
+        if (size < QOA_MIN_FILESIZE || read_u32(0) != QOA_MAGIC)
+            return 0;
+
+        qoa.samples = read_u32(4);
+        qoa.channels = data[8];
+        qoa.samplerate = read_u32(8) & 0xffffff;
+        return 8;
+    }
+
+    bool decode(size_t block)
+    {
+        size_t const offset = m_header_size + block * m_frame_size;
+        if (offset >= m_source->size())
+            return false;
+
+        unsigned int len = 0;
+        if (!qoa_decode_frame(m_source->data() + offset, (unsigned int)(m_source->size() - offset),
+                              &m_qoa, m_pcm.data(), &len))
+            return false;
+
+        m_block = block;
+        m_block_len = len;
+        return true;
+    }
+
+    std::shared_ptr<qoa_source> m_source;
+    qoa_desc m_qoa {};
+    size_t m_header_size = 0, m_frame_size = 0;
+    size_t m_frame_count = 0, m_frame_pos = 0;
+
+    // The decoded frame
+    std::vector<int16_t> m_pcm;
+    size_t m_block = std::numeric_limits<size_t>::max(), m_block_len = 0;
 };
 
 std::shared_ptr<stream<int16_t>> make_qoa_decoder(uint8_t const *data, size_t size)
 {
-    return std::make_shared<qoa_decoder>(data, size);
+    return std::make_shared<qoa_decoder>(std::make_shared<qoa_source>(data, size));
+}
+
+std::shared_ptr<stream<int16_t>> make_qoa_decoder(std::string const &path)
+{
+    return std::make_shared<qoa_decoder>(std::make_shared<qoa_source>(path));
 }
 
 } // namespace lol::audio
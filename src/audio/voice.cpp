@@ -0,0 +1,430 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine/audio>
+#include <algorithm> // std::sort
+#include <atomic>
+#include <cmath>     // std::fmod
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace lol::audio
+{
+
+static size_t const channel_count = 2;
+static int const frequency = 48000;
+
+// What the mixer sees of a sound that has a voice. Everything that touches
+// the source happens here, on the audio thread, including the seek to the
+// position a virtual sound reached; the pool only reads the atomics.
+//
+// The mixer keeps calling get() until it sees the stop command, so stop()
+// freezes the position first: a block rendered after it is dropped, and
+// the sound resumes exactly where the last mixed block ended.
+class voice_stream : public stream<float>
+{
+public:
+    voice_stream(std::shared_ptr<stream<float>> src, size_t pos, bool loop, float gain)
+      : stream<float>(src->channels(), src->frequency()),
+        m_src(src),
+        m_loop(loop),
+        m_cursor(pos),
+        m_seek(pos > 0),
+        // Fade in when resuming in the middle of a sound
+        m_last_gain(pos > 0 ? 0.f : gain),
+        m_gain(gain),
+        m_state(pos)
+    {}
+
+    virtual size_t get(float *buf, size_t frames) override
+    {
+        uint64_t const state = m_state.load(std::memory_order_relaxed);
+        if (state & stopped)
+            return 0;
+
+        if (m_seek)
+        {
+            // Streams that cannot seek just resume where they stopped
+            if (!m_src->seek(m_cursor))
+                m_cursor = m_src->pos().value_or(0);
+            m_seek = false;
+        }
+
+        size_t done = 0;
+        bool finished = false;
+        for (bool rewound = false; done < frames; )
+        {
+            size_t n = m_src->get(buf + done * m_channels, frames - done);
+            done += n;
+            m_cursor += n;
+            if (done == frames)
+                break;
+
+            // The source ran out: start over if looping, unless it is empty
+            if (!m_loop || (rewound && !n) || !m_src->seek(0))
+            {
+                finished = true;
+                break;
+            }
+            rewound = true;
+            m_cursor = 0;
+        }
+
+        // Ramp the gain over the block so that volume changes do not click
+        float const gain = m_gain.load(std::memory_order_relaxed);
+        if (gain != 1.f || m_last_gain != 1.f)
+        {
+            float const step = (gain - m_last_gain) / float(frames);
+            for (size_t n = 0; n < done; ++n)
+            {
+                float g = m_last_gain + step * float(n + 1);
+                for (size_t ch = 0; ch < m_channels; ++ch)
+                    buf[n * m_channels + ch] *= g;
+            }
+        }
+        m_last_gain = gain;
+
+        // If the pool stopped us meanwhile, it already has the position of
+        // the previous block, so this one must not be heard
+        uint64_t expected = state;
+        if (!m_state.compare_exchange_strong(expected, m_cursor, std::memory_order_relaxed))
+            return 0;
+        if (finished)
+            m_done.store(true, std::memory_order_release);
+        return done;
+    }
+
+    void set_gain(float gain) { m_gain.store(gain, std::memory_order_relaxed); }
+    bool done() const { return m_done.load(std::memory_order_acquire); }
+
+    // Freeze the position and return it; the stream is silent from now on
+    size_t stop()
+    {
+        return size_t(m_state.fetch_or(stopped, std::memory_order_relaxed) & ~stopped);
+    }
+
+private:
+    std::shared_ptr<stream<float>> m_src;
+    bool const m_loop;
+
+    // Only used by the audio thread
+    size_t m_cursor;
+    bool m_seek;
+    float m_last_gain;
+
+    // Shared with the pool: the position, and whether the pool stopped us
+    static uint64_t const stopped = uint64_t(1) << 63;
+    std::atomic<float> m_gain;
+    std::atomic<uint64_t> m_state;
+    std::atomic<bool> m_done = false;
+};
+
+struct voice
+{
+    uint64_t id;
+    voice_params params;
+    std::shared_ptr<stream<float>> src; // in the mixer format
+    std::optional<size_t> size;
+
+    // Set while the sound has a voice
+    std::shared_ptr<voice_stream> mixed;
+    int mixer_id = -1;
+
+    // Position in frames, updated when the sound loses its voice
+    double pos = 0.0;
+};
+
+class voice_pool_impl
+{
+public:
+    voice_pool_impl(size_t voices)
+      : m_voices(voices)
+    {}
+
+    bool audible(voice const &v) const
+    {
+        return v.params.volume > 0.f && v.params.volume >= m_threshold;
+    }
+
+    // Higher priority wins, then higher volume, then the newest sound
+    static bool stronger(voice const &a, voice const &b)
+    {
+        if (a.params.priority != b.params.priority)
+            return a.params.priority > b.params.priority;
+        if (a.params.volume != b.params.volume)
+            return a.params.volume > b.params.volume;
+        return a.id > b.id;
+    }
+
+    void mix(voice &v)
+    {
+        v.mixed = std::make_shared<voice_stream>(v.src, size_t(v.pos), v.params.loop, v.params.volume);
+        v.mixer_id = start_stream(std::shared_ptr<stream<float>>(v.mixed));
+        ++m_stats.mixed;
+    }
+
+    void unmix(voice &v)
+    {
+        v.pos = double(v.mixed->stop());
+        stop_stream(v.mixer_id);
+        v.mixed.reset();
+        v.mixer_id = -1;
+        --m_stats.mixed;
+    }
+
+    void release(uint64_t id)
+    {
+        auto it = m_sounds.find(id);
+        if (it == m_sounds.end())
+            return;
+        if (it->second.mixed)
+            unmix(it->second);
+        m_sounds.erase(it);
+    }
+
+    voice *find(uint64_t id)
+    {
+        auto it = m_sounds.find(id);
+        return it != m_sounds.end() ? &it->second : nullptr;
+    }
+
+    // Make room in the category of v, or return false if v is the weakest
+    bool enforce_limit(voice const &v)
+    {
+        auto limit = m_limits.find(v.params.category);
+        if (limit == m_limits.end())
+            return true;
+
+        for (;;)
+        {
+            size_t count = 0;
+            voice *weakest = nullptr;
+            for (auto &[id, other] : m_sounds)
+            {
+                if (other.params.category != v.params.category)
+                    continue;
+                ++count;
+                if (!weakest || stronger(*weakest, other))
+                    weakest = &other;
+            }
+
+            if (count < limit->second)
+                return true;
+
+            if (!weakest || stronger(*weakest, v))
+            {
+                ++m_stats.dropped;
+                return false;
+            }
+            ++m_stats.evicted;
+            release(weakest->id);
+        }
+    }
+
+    uint64_t play(std::shared_ptr<stream<float>> s, voice_params const &params)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        voice v { ++m_next_id, params, dsp::make_output_adapter(s, channel_count, frequency) };
+        v.size = v.src->size();
+        if (!enforce_limit(v))
+            return 0;
+
+        voice &added = m_sounds.emplace(v.id, std::move(v)).first->second;
+        if (!audible(added))
+            return added.id;
+
+        if (m_stats.mixed < m_voices)
+        {
+            mix(added);
+            return added.id;
+        }
+
+        // All voices are taken; steal the weakest one if we can
+        voice *weakest = nullptr;
+        for (auto &[id, other] : m_sounds)
+            if (other.mixed && (!weakest || stronger(*weakest, other)))
+                weakest = &other;
+
+        if (weakest && stronger(added, *weakest))
+        {
+            unmix(*weakest);
+            ++m_stats.stolen;
+            mix(added);
+        }
+
+        return added.id;
+    }
+
+    void update(float seconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        double const frames = double(seconds) * frequency;
+
+        m_done.clear();
+        for (auto &[id, v] : m_sounds)
+        {
+            if (v.mixed)
+            {
+                if (v.mixed->done())
+                    m_done.push_back(id);
+                continue;
+            }
+
+            // Virtual sounds move on as if they were playing. Those of
+            // unknown length run until stopped or given a voice.
+            v.pos += frames;
+            if (!v.size)
+                continue;
+            if (v.params.loop && *v.size)
+                v.pos = std::fmod(v.pos, double(*v.size));
+            else if (v.pos >= double(*v.size))
+                m_done.push_back(id);
+        }
+        for (uint64_t id : m_done)
+            release(id);
+
+        // Rank the audible sounds; the first ones get the voices
+        m_rank.clear();
+        for (auto &[id, v] : m_sounds)
+            if (audible(v))
+                m_rank.push_back(&v);
+        std::sort(m_rank.begin(), m_rank.end(),
+                  [](voice const *a, voice const *b) { return stronger(*a, *b); });
+
+        size_t const mixed = std::min(m_rank.size(), m_voices);
+
+        // Free voices before handing them out again
+        for (auto &[id, v] : m_sounds)
+            if (v.mixed && !audible(v))
+                unmix(v);
+        for (size_t i = mixed; i < m_rank.size(); ++i)
+            if (m_rank[i]->mixed)
+            {
+                unmix(*m_rank[i]);
+                ++m_stats.stolen;
+            }
+        for (size_t i = 0; i < mixed; ++i)
+            if (!m_rank[i]->mixed)
+                mix(*m_rank[i]);
+    }
+
+    mutable std::mutex m_mutex;
+
+    size_t const m_voices;
+    float m_threshold = 0.f;
+    std::unordered_map<int, size_t> m_limits;
+
+    uint64_t m_next_id = 0;
+    std::unordered_map<uint64_t, voice> m_sounds;
+    voice_pool::stats m_stats;
+
+    // Kept around so that update() does not allocate
+    std::vector<uint64_t> m_done;
+    std::vector<voice *> m_rank;
+};
+
+voice_pool::voice_pool(size_t voices)
+  : impl(std::make_unique<voice_pool_impl>(voices))
+{
+}
+
+voice_pool::~voice_pool()
+{
+    stop_all();
+}
+
+void voice_pool::set_threshold(float volume)
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    impl->m_threshold = volume;
+}
+
+void voice_pool::set_category_limit(int category, size_t count)
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    impl->m_limits[category] = count;
+}
+
+uint64_t voice_pool::play(std::shared_ptr<stream<float>> s, voice_params const &params)
+{
+    return impl->play(s, params);
+}
+
+uint64_t voice_pool::play(std::shared_ptr<stream<int16_t>> s, voice_params const &params)
+{
+    return impl->play(dsp::make_output_adapter(s, channel_count, frequency), params);
+}
+
+void voice_pool::stop(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    impl->release(id);
+}
+
+void voice_pool::stop_all()
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    for (auto &[id, v] : impl->m_sounds)
+        if (v.mixed)
+            impl->unmix(v);
+    impl->m_sounds.clear();
+}
+
+void voice_pool::set_volume(uint64_t id, float volume)
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    if (voice *v = impl->find(id))
+    {
+        v->params.volume = volume;
+        if (v->mixed)
+            v->mixed->set_gain(volume);
+    }
+}
+
+void voice_pool::set_priority(uint64_t id, int priority)
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    if (voice *v = impl->find(id))
+        v->params.priority = priority;
+}
+
+bool voice_pool::is_playing(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    return impl->find(id) != nullptr;
+}
+
+bool voice_pool::is_virtual(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    voice *v = impl->find(id);
+    return v && !v->mixed;
+}
+
+void voice_pool::update(float seconds)
+{
+    impl->update(seconds);
+}
+
+voice_pool::stats voice_pool::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(impl->m_mutex);
+    voice_pool::stats ret = impl->m_stats;
+    ret.sounds = impl->m_sounds.size();
+    return ret;
+}
+
+} // namespace lol::audio
@@ -38,6 +38,8 @@ class AndroidImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<AndroidImageCodec>"; }
+    /* Saving is not implemented */
+    virtual uint32_t GetCapabilities() { return can_load; }
     virtual ResourceCodecData* Load(std::string const &path);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
     virtual bool Close();
@@ -27,6 +27,7 @@ class DummyImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<DummyImageCodec>"; }
+    virtual uint32_t GetCapabilities() { return can_load; }
     virtual ResourceCodecData* Load(std::string const &path);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
 };
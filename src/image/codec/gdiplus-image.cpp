@@ -40,6 +40,10 @@ class GdiPlusImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<GdiPlusImageCodec>"; }
+    virtual match Probe(ResourceProbe const &probe)
+    {
+        return probe.exists() ? match::maybe : match::no;
+    }
     virtual ResourceCodecData* Load(std::string const &path);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
 };
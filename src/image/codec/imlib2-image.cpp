@@ -38,6 +38,12 @@ class Imlib2ImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<Imlib2ImageCodec>"; }
+    /* Imlib2 only loads from a path, so all we can check is that the
+     * file is there; it saves to whatever the extension says. */
+    virtual match Probe(ResourceProbe const &probe)
+    {
+        return probe.exists() ? match::maybe : match::no;
+    }
     virtual ResourceCodecData* Load(std::string const &path);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
 };
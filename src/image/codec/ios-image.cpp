@@ -31,6 +31,8 @@ class IosImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<IosImageCodec>"; }
+    /* Saving is not implemented */
+    virtual uint32_t GetCapabilities() { return can_load; }
     virtual ResourceCodecData* Load(std::string const &path);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
 };
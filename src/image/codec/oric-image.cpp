@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -35,11 +35,17 @@ class OricImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<OricImageCodec>"; }
+    virtual uint32_t GetCapabilities() { return can_load | can_save | can_stream; }
+    virtual std::vector<std::string> GetExtensions() { return { "tap" }; }
+    virtual match Probe(ResourceProbe const &probe);
     virtual ResourceCodecData* Load(std::string const &path);
+    virtual ResourceCodecData* LoadProbe(ResourceProbe &probe);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
 
 private:
-    static std::string ReadScreen(std::string const &name);
+    static ResourceCodecData* Decode(std::string const &tape);
+    static size_t SkipSync(std::string const &data);
+    static std::string ReadScreen(std::string const &data);
     static void WriteScreen(old_image &old_image, std::vector<uint8_t> &result);
 };
 
@@ -49,7 +55,28 @@ DECLARE_IMAGE_CODEC(OricImageCodec, 100)
  * Public Image class
  */
 
+ResourceCodec::match OricImageCodec::Probe(ResourceProbe const &probe)
+{
+    auto const &header = probe.header();
+    return SkipSync(std::string(header.begin(), header.end())) ? match::yes : match::no;
+}
+
 ResourceCodecData* OricImageCodec::Load(std::string const &path)
+{
+    /* Same lookup as ResourceProbe, so that Load() and Probe() see
+     * the same file */
+    std::string data;
+    file::read(sys::get_data_path(path), data);
+    return Decode(data);
+}
+
+ResourceCodecData* OricImageCodec::LoadProbe(ResourceProbe &probe)
+{
+    auto const &data = probe.data();
+    return Decode(std::string(data.begin(), data.end()));
+}
+
+ResourceCodecData* OricImageCodec::Decode(std::string const &tape)
 {
     static u8vec4 const pal[8] =
     {
@@ -63,7 +90,7 @@ ResourceCodecData* OricImageCodec::Load(std::string const &path)
         u8vec4(0xff, 0xff, 0xff, 0xff),
     };
 
-    std::string screen = ReadScreen(path);
+    std::string screen = ReadScreen(tape);
     if (screen.length() == 0)
         return nullptr;
 
@@ -150,28 +177,32 @@ bool OricImageCodec::Save(std::string const &path, ResourceCodecData* data)
     return file::write(path, result);
 }
 
-std::string OricImageCodec::ReadScreen(std::string const &name)
+/* Return the offset of the tape header, or zero if there are no
+ * sync bytes */
+size_t OricImageCodec::SkipSync(std::string const &data)
 {
-    std::string data;
-    file::read(name, data);
-
-    /* Skip the sync bytes */
-    if (data[0] != 0x16)
-        return "";
-    int header = 1;
-    while (data[header] == 0x16)
+    if (data.empty() || data[0] != 0x16)
+        return 0;
+    size_t header = 1;
+    while (header < data.length() && data[header] == 0x16)
         ++header;
-    if (data[header] != 0x24)
+    if (header >= data.length() || data[header] != 0x24)
+        return 0;
+    return header + 1;
+}
+
+std::string OricImageCodec::ReadScreen(std::string const &data)
+{
+    size_t header = SkipSync(data);
+    if (header == 0)
         return "";
-    ++header;
 
     /* Skip the header, ignoring the last byte’s value */
-    if (!starts_with(data, std::string("\x00\xff\x80\x00\xbf\x3f\xa0\x00", 8)))
+    if (data.compare(header, 7, std::string("\x00\xff\x80\x00\xbf\x3f\xa0", 7)) != 0)
         return "";
 
     /* Skip the file name, including trailing nul char */
-    data = data.substr(header + 8);
-    size_t filename_end = data.find('\0');
+    size_t filename_end = data.find('\0', header + 8);
     if (filename_end == std::string::npos)
         return "";
 
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -38,14 +38,39 @@ class SdlImageCodec : public ResourceCodec
 {
 public:
     virtual std::string GetName() { return "<SdlImageCodec>"; }
+    virtual uint32_t GetCapabilities() { return can_load | can_save | can_stream; }
+    virtual match Probe(ResourceProbe const &probe);
     virtual ResourceCodecData* Load(std::string const &path);
+    virtual ResourceCodecData* LoadProbe(ResourceProbe &probe);
     virtual bool Save(std::string const &path, ResourceCodecData* data);
 
     static SDL_Surface *Create32BppSurface(ivec2 size);
+
+private:
+    static ResourceCodecData* Convert(SDL_Surface *surface);
 };
 
 DECLARE_IMAGE_CODEC(SdlImageCodec, 50)
 
+ResourceCodec::match SdlImageCodec::Probe(ResourceProbe const &probe)
+{
+    if (!probe.exists())
+        return match::no;
+
+    /* Formats SDL_image recognises by their signature */
+    if (probe.has_magic("\x89PNG\r\n\x1a\n", 8)
+         || probe.has_magic("\xff\xd8\xff", 3)
+         || probe.has_magic("GIF8", 4)
+         || probe.has_magic("BM", 2)
+         || probe.has_magic("II*\0", 4) || probe.has_magic("MM\0*", 4)
+         || (probe.has_magic("RIFF", 4) && probe.has_magic("WEBP", 4, 8))
+         || probe.has_magic("/* XPM */", 9))
+        return match::yes;
+
+    /* Other formats, such as TGA, have no reliable signature */
+    return match::maybe;
+}
+
 ResourceCodecData* SdlImageCodec::Load(std::string const &path)
 {
     SDL_Surface *surface = IMG_Load(sys::get_data_path(path).c_str());
@@ -58,6 +83,32 @@ ResourceCodecData* SdlImageCodec::Load(std::string const &path)
         return nullptr;
     }
 
+    return Convert(surface);
+}
+
+ResourceCodecData* SdlImageCodec::LoadProbe(ResourceProbe &probe)
+{
+    auto const &bytes = probe.data();
+    SDL_RWops *rw = SDL_RWFromConstMem(bytes.data(), (int)bytes.size());
+    if (!rw)
+        return nullptr;
+
+    /* The extension is only a hint for formats without a signature */
+    SDL_Surface *surface = IMG_LoadTyped_RW(rw, 1, probe.extension().c_str());
+
+    if (!surface)
+    {
+#if !LOL_BUILD_RELEASE
+        msg::error("could not load old_image %s\n", probe.path().c_str());
+#endif
+        return nullptr;
+    }
+
+    return Convert(surface);
+}
+
+ResourceCodecData* SdlImageCodec::Convert(SDL_Surface *surface)
+{
     ivec2 size(surface->w, surface->h);
 
     if (surface->format->BytesPerPixel != 4)
@@ -32,8 +32,8 @@ old_image old_image::Crop(ibox2 box) const
     if (fmt != PixelFormat::Unknown)
     {
         dst.set_format(fmt);
-        uint8_t const *srcp = (uint8_t const *)m_data->m_pixels[(int)fmt];
-        uint8_t *dstp = (uint8_t *)dst.m_data->m_pixels[(int)fmt];
+        uint8_t const *srcp = (uint8_t const *)m_data->m_pixels[(int)fmt]->data();
+        uint8_t *dstp = (uint8_t *)dst.lock();
         uint8_t bpp = BytesPerPixel(fmt);
 
         int len = dstsize.x;
@@ -59,6 +59,8 @@ old_image old_image::Crop(ibox2 box) const
                        len * bpp);
             }
         }
+
+        dst.unlock(dstp);
     }
 
     return dst;
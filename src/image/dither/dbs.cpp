@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004–2023 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004–2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,175 +12,262 @@
 
 #include <lol/engine-internal.h>
 
+#include "../image-private.h"
+
+#include <atomic> // std::atomic
+#include <cstdlib> // std::abs
+#include <vector> // std::vector
+
 /*
  * Direct Binary Search dithering
+ *
+ * The perceived error is e = p ∗ (g − f), where p is a model of the human
+ * visual system, g the halftone and f the original. Writing c_pp for the
+ * autocorrelation of p and c_ep = c_pp ∗ (g − f), changing g by a0 at m
+ * and by a1 at m′ changes |e|² by
+ *
+ *   (a0² + a1²) c_pp(0) + 2 a0 a1 c_pp(m − m′) + 2 a0 c_ep(m) + 2 a1 c_ep(m′)
+ *
+ * so every trial costs O(1), and only accepted changes update c_ep.
  */
 
-#define CELL 16
-
+/* Radius of the HVS filter; c_pp has twice that radius */
 #define N 7
 #define NN ((N * 2 + 1))
+#define R (N * 2)
+#define RR ((R * 2 + 1))
+
+/* Changes in a cell update c_ep up to R + 1 pixels away from it, so cells
+ * two steps apart never touch the same data and can run concurrently. */
+#define CELL 32
+
+static_assert(CELL > 2 * (R + 1), "DBS cells are too small for the filter");
 
 namespace lol
 {
 
-/* FIXME: though the algorithm is supposed to stop, we do not have a real,
- * guaranteed stop condition here. */
-old_image old_image::dither_dbs() const
+old_image old_image::dither_dbs(int max_passes, float epsilon,
+                                std::vector<dbs_pass> *stats) const
 {
-    ivec2 isize = size();
+    ivec2 const isize = size();
+    int const count = isize.x * isize.y;
 
     /* Build our human visual system kernel. */
-    old_array2d<float> ker;
-    ker.resize(ivec2(NN, NN));
+    float ker[NN][NN];
     float t = 0.f;
     for (int j = 0; j < NN; j++)
         for (int i = 0; i < NN; i++)
         {
             vec2 v = vec2((float)(i - N), (float)(j - N));
-            ker[i][j] = exp(-sqlength(v / 1.6f) / 2.f)
+            ker[j][i] = exp(-sqlength(v / 1.6f) / 2.f)
                       + exp(-sqlength(v / 0.6f) / 2.f);
-            t += ker[i][j];
+            t += ker[j][i];
         }
 
     for (int j = 0; j < NN; j++)
         for (int i = 0; i < NN; i++)
-            ker[i][j] /= t;
-
-    /* A list of cells in our picture. If no change is done to a cell
-     * for two iterations, we stop considering changes to it. */
-    ivec2 const csize = (isize + ivec2(CELL - 1)) / CELL;
-    old_array2d<int> changelist(csize);
-    memset(changelist.data(), 0, changelist.bytes());
+            ker[j][i] /= t;
 
-    old_image dst = *this;
-    dst.set_format(PixelFormat::Y_F32);
+    /* Its autocorrelation */
+    float cpp[RR][RR];
+    for (int dy = -R; dy <= R; ++dy)
+        for (int dx = -R; dx <= R; ++dx)
+        {
+            float sum = 0.f;
+            for (int j = max(0, -dy); j < min(NN, NN - dy); ++j)
+                for (int i = max(0, -dx); i < min(NN, NN - dx); ++i)
+                    sum += ker[j][i] * ker[j + dy][i + dx];
+            cpp[dy + R][dx + R] = sum;
+        }
 
-    old_image tmp1 = dst.Convolution(ker);
-    old_array2d<float> &tmp1data = tmp1.lock2d<PixelFormat::Y_F32>();
+    old_image dst = dither_random();
+    float *g = dst.lock<PixelFormat::Y_F32>();
 
-    dst = dst.dither_random();
-    old_array2d<float> &dstdata = dst.lock2d<PixelFormat::Y_F32>();
+    old_image src = *this;
+    float const *f = src.lock<PixelFormat::Y_F32>();
 
-    old_image tmp2 = dst.Convolution(ker);
-    old_array2d<float> &tmp2data = tmp2.lock2d<PixelFormat::Y_F32>();
+    /* Initial c_ep, computed in a single pass */
+    std::vector<float> cep(count, 0.f);
 
-    for (int run = 0, last_change = 0; ; ++run)
+    parallel_rows(isize, sizeof(float) * RR, R, [&](int y0, int y1)
     {
-        int const cell = run % (csize.x * csize.y);
-        int const cx = cell % csize.x;
-        int const cy = cell / csize.x;
+        for (int y = y0; y < y1; ++y)
+        {
+            float *line = &cep[y * isize.x];
+            for (int dy = max(-R, -y); dy <= min(R, isize.y - 1 - y); ++dy)
+            {
+                int const row = (y + dy) * isize.x;
+                for (int dx = -R; dx <= R; ++dx)
+                {
+                    float const w = cpp[dy + R][dx + R];
+                    int const x0 = max(0, -dx), x1 = min(isize.x, isize.x - dx);
+                    for (int x = x0; x < x1; ++x)
+                        line[x] += w * (g[row + x + dx] - f[row + x + dx]);
+                }
+            }
+        }
+    });
 
-        /* Bail out if no change was done for the last full old_image run */
-        if (run > last_change + csize.x * csize.y)
-            break;
+    double error = 0.0;
+    for (int n = 0; n < count; ++n)
+        error += double(g[n] - f[n]) * cep[n];
+
+    /* Apply changes of a0 at m and a1 at m + op; op may point in any
+     * direction, so the affected area extends R pixels around both. */
+    auto update = [&](ivec2 m, float a0, ivec2 op, float a1)
+    {
+        for (int dy = min(0, op.y) - R; dy <= max(0, op.y) + R; ++dy)
+        {
+            int const y = m.y + dy;
+            if (y < 0 || y >= isize.y)
+                continue;
+            int const x0 = max(0, m.x + min(0, op.x) - R);
+            int const x1 = min(isize.x, m.x + max(0, op.x) + R + 1);
+            for (int x = x0; x < x1; ++x)
+            {
+                int const dx = x - m.x;
+                float delta = 0.f;
+                if (std::abs(dx) <= R && std::abs(dy) <= R)
+                    delta += a0 * cpp[dy + R][dx + R];
+                if (a1 != 0.f && std::abs(dx - op.x) <= R && std::abs(dy - op.y) <= R)
+                    delta += a1 * cpp[dy - op.y + R][dx - op.x + R];
+                cep[y * isize.x + x] += delta;
+            }
+        }
+    };
 
-        /* Skip cell if it was already ignored twice */
-        if (changelist[cx][cy] >= 2)
-            continue;
+    static ivec2 const op_list[] =
+    {
+        { 0, 1 },   { 0, -1 }, { -1, 0 }, { 1, 0 },
+        { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 },
+    };
 
+    /* Try every toggle and swap for each pixel of a cell, and keep the
+     * best one; return the number of changes and their effect on |e|². */
+    auto visit = [&](ivec2 cell, double &gain) -> int
+    {
+        float const c0 = cpp[R][R];
         int changes = 0;
 
-        for (int pixel = 0; pixel < CELL * CELL; ++pixel)
+        ivec2 const p0 = cell * CELL, p1 = min(p0 + ivec2(CELL), isize);
+        for (int y = p0.y; y < p1.y; ++y)
+        for (int x = p0.x; x < p1.x; ++x)
         {
-            ivec2 const pos(cx * CELL + pixel % CELL,
-                            cy * CELL + pixel / CELL);
+            ivec2 const m(x, y);
+            float const a0 = 1.f - 2.f * g[y * isize.x + x];
+            float const e0 = cep[y * isize.x + x];
 
-            if (!(pos >= ivec2(0)) || !(pos < isize))
-                continue;
-
-            /* The best operation we can do */
+            /* Toggle */
+            float best = a0 * a0 * c0 + 2.f * a0 * e0;
             ivec2 best_op(0);
-            float best_error = 0.f;
-
-            float d = dstdata[pos];
-
-            /* Compute the effect of all possible toggle and swaps */
-            static ivec2 const op_list[] =
-            {
-                { 0, 0 },
-                { 0, 1 },   { 0, -1 }, { -1, 0 }, { 1, 0 },
-                { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 },
-            };
 
+            /* Swaps */
             for (ivec2 const &op : op_list)
             {
-                if (!(pos + op >= ivec2(0)) || !(pos + op < isize))
+                ivec2 const m2 = m + op;
+                if (!(m2 >= ivec2(0)) || !(m2 < isize))
                     continue;
-
-                bool flip = (op == ivec2(0));
-
-                float d2 = flip ? 1 - d : dstdata[pos + op];
-
-                if (!flip && d2 == d)
+                if (g[m2.y * isize.x + m2.x] == g[y * isize.x + x])
                     continue;
 
-                /* TODO: implement min/max for 3+ arguments */
-                int imin = max(max(-N, op.x - N), -pos.x);
-                int imax = min(min(N + 1, op.x + NN - N), isize.x - pos.x);
-                int jmin = max(max(-N, op.y - N), -pos.y);
-                int jmax = min(min(N + 1, op.y + NN - N), isize.y - pos.y);
-
-                float error = 0.f;
-                for (int j = jmin; j < jmax; j++)
-                for (int i = imin; i < imax; i++)
-                {
-                    ivec2 pos2 = pos + ivec2(i, j);
-
-                    float m = ker[i + N][j + N];
-                    if (!flip)
-                        m -= ker[i - op.x + N][j - op.y + N];
-                    float p = tmp1data[pos2];
-                    float q1 = tmp2data[pos2];
-                    float q2 = q1 + m * (d2 - d);
-                    error += sq(q1 - p) - sq(q2 - p);
-                }
-
-                if (error > best_error)
+                float de = 2.f * (c0 - cpp[op.y + R][op.x + R])
+                         + 2.f * a0 * (e0 - cep[m2.y * isize.x + m2.x]);
+                if (de < best)
                 {
-                    best_error = error;
+                    best = de;
                     best_op = op;
                 }
             }
 
-            /* Only apply the change if interesting */
-            if (best_error > 0.f)
+            /* Only apply the change if interesting; the margin keeps
+             * rounding errors from toggling pixels back and forth. */
+            if (best >= -1e-6f * c0)
+                continue;
+
+            g[y * isize.x + x] += a0;
+            if (best_op == ivec2(0))
+                update(m, a0, ivec2(0), 0.f);
+            else
             {
-                bool flip = (best_op == ivec2(0));
+                ivec2 const m2 = m + best_op;
+                g[m2.y * isize.x + m2.x] -= a0;
+                update(m, a0, best_op, -a0);
+            }
 
-                float d2 = flip ? 1 - d : dstdata[pos + best_op];
-                dstdata[pos + best_op] = d;
-                dstdata[pos] = d2;
+            gain += best;
+            ++changes;
+        }
 
-                for (int j = -N; j <= N; j++)
-                for (int i = -N; i <= N; i++)
-                {
-                    ivec2 off(i, j);
-                    float delta = (d2 - d) * ker[i + N][j + N];
+        return changes;
+    };
 
-                    if (pos + off >= ivec2(0) && pos + off < isize)
-                        tmp2data[pos + off] += delta;
+    /* A list of cells in our picture, and whether they changed during the
+     * last pass. Cells are only visited again if they or one of their
+     * neighbours changed. */
+    ivec2 const csize = (isize + ivec2(CELL - 1)) / CELL;
+    std::vector<uint8_t> changed(csize.x * csize.y, 1);
+    std::vector<uint8_t> active(csize.x * csize.y);
 
-                    if (!flip && pos + off + best_op >= ivec2(0)
-                         && pos + off + best_op < isize)
-                        tmp2data[pos + off + best_op] -= delta;
-                }
+    auto &pool = image_thread_pool();
 
-                ++changes;
-                last_change = run;
+    for (int pass = 0; pass < max_passes; ++pass)
+    {
+        int cells = 0;
+        for (int cy = 0; cy < csize.y; ++cy)
+            for (int cx = 0; cx < csize.x; ++cx)
+            {
+                uint8_t a = 0;
+                for (int j = max(cy - 1, 0); j <= min(cy + 1, csize.y - 1); ++j)
+                    for (int i = max(cx - 1, 0); i <= min(cx + 1, csize.x - 1); ++i)
+                        a |= changed[j * csize.x + i];
+                active[cy * csize.x + cx] = a;
+                cells += a;
             }
+
+        std::fill(changed.begin(), changed.end(), 0);
+
+        std::atomic<int> changes = 0;
+        std::vector<double> gains(csize.x * csize.y, 0.0);
+
+        /* Checkerboard schedule: four phases, each of which visits every
+         * other cell in both directions */
+        for (int phase = 0; phase < 4; ++phase)
+        {
+            ivec2 const start(phase & 1, phase >> 1);
+            ivec2 const psize = (csize - start + ivec2(1)) / 2;
+
+            pool.parallel_for(size_t(max(psize.x * psize.y, 0)), 1,
+                              [&](size_t begin, size_t end)
+            {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    ivec2 cell = start + 2 * ivec2(int(k) % psize.x, int(k) / psize.x);
+                    int const c = cell.y * csize.x + cell.x;
+                    if (!active[c])
+                        continue;
+
+                    int n = visit(cell, gains[c]);
+                    changed[c] = n > 0;
+                    changes += n;
+                }
+            });
         }
 
-        if (changes == 0)
-            ++changelist[cx][cy];
+        /* Sum in a fixed order so that stats do not depend on threads */
+        for (double gain : gains)
+            error += gain;
+
+        if (stats)
+            stats->push_back(dbs_pass { changes, cells, float(error / count) });
+
+        if (changes == 0 || changes <= epsilon * count)
+            break;
     }
 
-    tmp1.unlock2d(tmp1data);
-    tmp2.unlock2d(tmp2data);
-    dst.unlock2d(dstdata);
+    src.unlock(f);
+    dst.unlock(g);
 
     return dst;
 }
 
 } /* namespace lol */
-
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,6 +12,10 @@
 
 #include <lol/engine-internal.h>
 
+#include "../image-private.h"
+
+#include <vector> // std::vector
+
 /*
  * Generic error diffusion functions
  */
@@ -19,58 +23,140 @@
 namespace lol
 {
 
-/* Perform a generic error diffusion dithering. The first non-zero
- * element in ker is treated as the current pixel. All other non-zero
- * elements are the error diffusion coefficients.
- * Making the matrix generic is not terribly slower: the performance
- * hit is around 4% for Floyd-Steinberg and 13% for JaJuNi, with the
- * benefit of a lot less code. */
-old_image old_image::dither_ediff(old_array2d<float> const &ker, ScanMode scan) const
+void ediff_fixed::load(ivec2 size, uint8_t const *src, int16_t *dst)
 {
-    old_image dst = *this;
-
-    ivec2 isize = dst.size();
-    ivec2 ksize = ker.sizes();
+    parallel_pixels(size, sizeof(int16_t), [&](int n0, int n1)
+    {
+        for (int n = n0; n < n1; ++n)
+            dst[n] = int16_t(src[n] << bits);
+    });
+}
 
-    int kx;
-    for (kx = 0; kx < ksize.x; kx++)
-        if (ker[kx][0] > 0.f)
-            break;
+void ediff_fixed::store(ivec2 size, int16_t const *src, uint8_t *dst)
+{
+    parallel_pixels(size, sizeof(int16_t), [&](int n0, int n1)
+    {
+        for (int n = n0; n < n1; ++n)
+            dst[n] = src[n] ? 255 : 0;
+    });
+}
 
-    float *pixels = dst.lock<PixelFormat::Y_F32>();
-    for (int y = 0; y < isize.y; y++)
+/* One error diffusion coefficient, relative to the current pixel and
+ * to the scan direction */
+struct ediff_tap
+{
+    int dx, dy;
+    float w;
+    int32_t fixed;
+};
+
+/* The first non-zero element in ker is treated as the current pixel. All
+ * other non-zero elements are the error diffusion coefficients. */
+struct ediff_kernel
+{
+    ediff_kernel(old_array2d<float> const &ker)
+      : size(ker.sizes()),
+        rows(size.y + 1, 0)
     {
-        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+        for (kx = 0; kx < size.x; kx++)
+            if (ker[kx][0] > 0.f)
+                break;
 
-        for (int x = 0; x < isize.x; x++)
+        /* Taps sorted by row, so that rows[k] is the number of taps that
+         * are less than k rows below the current pixel */
+        for (int j = 0; j < size.y; j++)
         {
-            int x2 = reverse ? isize.x - 1 - x : x;
-            int s = reverse ? -1 : 1;
-
-            float p = pixels[y * isize.x + x2];
-            float q = p < 0.5f ? 0.f : 1.f;
-            pixels[y * isize.x + x2] = q;
+            for (int i = 0; i < size.x; i++)
+                if ((j > 0 || i > kx) && ker[i][j] != 0.f)
+                    taps.push_back({ i - kx, j, ker[i][j], ediff_fixed::weight(ker[i][j]) });
+            rows[j + 1] = (int)taps.size();
+        }
+    }
 
-            float e = (p - q);
+    /* Rows are processed as a wavefront on the image thread pool; see
+     * parallel_wavefront(). */
+    template<typename T, typename Q, typename D>
+    void run(T *pixels, ivec2 isize, ScanMode scan,
+             Q const &quantize, D const &diffuse) const
+    {
+        /* Taps of pixels in [xmin, xmax) never leave the row */
+        int const xmin = kx, xmax = isize.x - (size.x - 1 - kx);
 
-            for (int j = 0; j < ksize.y && y < isize.y - j; j++)
-                for (int i = 0; i < ksize.x; i++)
-                {
-                    if (j == 0 && i <= kx)
-                        continue;
+        parallel_wavefront(isize, size.x, scan, [&](int y, int n0, int n1)
+        {
+            bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+            int const s = reverse ? -1 : 1;
+            int const ntaps = rows[lol::min(size.y, isize.y - y)];
 
-                    if (x + i - kx < 0 || x + i - kx >= isize.x)
-                        continue;
+            for (int x = n0; x < n1; x++)
+            {
+                int x2 = reverse ? isize.x - 1 - x : x;
+                T *p = pixels + y * isize.x + x2;
+                auto e = quantize(*p);
 
-                    pixels[(y + j) * isize.x + x2 + (i - kx) * s]
-                       += e * ker[i][j];
+                if (x >= xmin && x < xmax)
+                {
+                    for (int k = 0; k < ntaps; ++k)
+                        diffuse(p[taps[k].dy * isize.x + taps[k].dx * s], e, taps[k]);
                 }
-        }
+                else
+                {
+                    for (int k = 0; k < ntaps; ++k)
+                        if (x + taps[k].dx >= 0 && x + taps[k].dx < isize.x)
+                            diffuse(p[taps[k].dy * isize.x + taps[k].dx * s], e, taps[k]);
+                }
+            }
+        });
     }
+
+    ivec2 size;
+    int kx;
+    std::vector<ediff_tap> taps;
+    std::vector<int> rows;
+};
+
+/* Perform a generic error diffusion dithering on floats */
+old_image old_image::dither_ediff(old_array2d<float> const &ker, ScanMode scan) const
+{
+    old_image dst = *this;
+    float *pixels = dst.lock<PixelFormat::Y_F32>();
+
+    ediff_kernel(ker).run(pixels, dst.size(), scan, [](float &p) -> float
+    {
+        float q = p < 0.5f ? 0.f : 1.f;
+        float e = p - q;
+        p = q;
+        return e;
+    },
+    [](float &v, float e, ediff_tap const &t) { v += e * t.w; });
+
     dst.unlock(pixels);
+    return dst;
+}
+
+/* Same, with fixed-point arithmetic on 8-bit pixels */
+old_image old_image::dither_ediff_u8(old_array2d<float> const &ker, ScanMode scan) const
+{
+    old_image dst = *this;
+    ivec2 isize = dst.size();
+    uint8_t *pixels = dst.lock<PixelFormat::Y_8>();
+
+    std::vector<int16_t> tmp(isize.x * isize.y);
+    ediff_fixed::load(isize, pixels, tmp.data());
 
+    ediff_kernel(ker).run(tmp.data(), isize, scan, [](int16_t &v) -> int32_t
+    {
+        int32_t q = v < ediff_fixed::half ? 0 : ediff_fixed::one;
+        int32_t e = v - q;
+        v = int16_t(q);
+        return e;
+    },
+    [](int16_t &v, int32_t e, ediff_tap const &t) { ediff_fixed::add(v, e, t.fixed); });
+
+    ediff_fixed::store(isize, tmp.data(), pixels);
+
+    dst.unlock(pixels);
     return dst;
 }
 
 } /* namespace lol */
-
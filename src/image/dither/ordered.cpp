@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,6 +12,19 @@
 
 #include <lol/engine-internal.h>
 
+#include "../image-private.h"
+
+#include <cmath>  // std::floor
+#include <vector> // std::vector
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define LOL_ORDERED_SSE2 1
+#elif defined __ARM_NEON && defined __aarch64__
+#   include <arm_neon.h>
+#   define LOL_ORDERED_NEON 1
+#endif
+
 /*
  * Bayer ordered dithering functions
  */
@@ -19,12 +32,9 @@
 namespace lol
 {
 
-static old_image dither_helper(old_image const &img, old_array2d<float> const &ker,
-                           float scale, float angle);
-
 old_image old_image::dither_ordered(old_array2d<float> const &ker) const
 {
-    return dither_helper(*this, ker, 1.0f, 0.0f);
+    return threshold_map(ker, size()).dither(*this);
 }
 
 old_image old_image::dither_halftone(float radius, float angle) const
@@ -36,37 +46,211 @@ old_image old_image::dither_halftone(float radius, float angle) const
     int k = (int)std::round(radius * PRECISION * lol::sqrt(2.f));
     old_array2d<float> ker = old_image::kernel::halftone(ivec2(k, k));
 
-    return dither_helper(*this, ker, 1.f / PRECISION, angle + F_PI / 4.f);
+    return threshold_map(ker, size(), 1.f / PRECISION, angle + F_PI / 4.f).dither(*this);
 }
 
-static old_image dither_helper(old_image const &img, old_array2d<float> const &ker,
-                           float scale, float angle)
+/*
+ * Threshold maps
+ *
+ * Thresholds are stored as bytes: an 8-bit pixel p is above threshold k
+ * exactly when p > floor(255 k). Without rotation, image rows that use
+ * the same kernel row share a table row; otherwise every row has its own.
+ */
+
+old_image::threshold_map::threshold_map(old_array2d<float> const &ker, ivec2 size,
+                                        float scale, float angle)
+  : m_size(size),
+    m_pitch((size.x + 15) & ~15)
 {
-    ivec2 isize = img.size();
-    ivec2 ksize = ker.sizes();
+    ivec2 const ksize = ker.sizes();
+    double const cost = std::cos((double)angle);
+    double const sint = std::sin((double)angle);
+    bool const rotated = sint != 0.0 || cost != 1.0;
 
-    float cost = lol::cos(angle);
-    float sint = lol::sin(angle);
+    auto threshold = [&](int kx, int ky) -> uint8_t
+    {
+        float t = std::floor(ker[kx][ky] * 255.f);
+        return (uint8_t)lol::clamp(t, 0.f, 255.f);
+    };
 
-    old_image ret = img;
-    float *dstp = ret.lock<PixelFormat::Y_F32>();
+    auto wrap = [](double u, int n) -> int
+    {
+        int i = (int)std::floor(u) % n;
+        return i < 0 ? i + n : i;
+    };
 
-    for (int y = 0; y < isize.y; y++)
+    m_rows.resize(size.y);
+    if (!rotated)
     {
-        for (int x = 0; x < isize.x; x++)
+        /* One table row per kernel row that is actually used */
+        std::vector<int> index(ksize.y, -1);
+        int count = 0;
+        for (int y = 0; y < size.y; ++y)
         {
-            int kx = (int)((cost * x - sint * y + 2 * isize.x * isize.y) / scale) % ksize.x;
-            int ky = (int)((cost * y + sint * x + 2 * isize.x * isize.y) / scale) % ksize.y;
+            int ky = wrap(y / scale, ksize.y);
+            if (index[ky] < 0)
+                index[ky] = count++;
+            m_rows[y] = index[ky];
+        }
 
-            float p = dstp[y * isize.x + x];
-            dstp[y * isize.x + x] = (p > ker[kx][ky]) ? 1.f : 0.f;
+        m_table.resize(size_t(count) * m_pitch, 255);
+        for (int ky = 0; ky < ksize.y; ++ky)
+        {
+            if (index[ky] < 0)
+                continue;
+            uint8_t *row = &m_table[size_t(index[ky]) * m_pitch];
+            for (int x = 0; x < size.x; ++x)
+                row[x] = threshold(wrap(x / scale, ksize.x), ky);
         }
     }
+    else
+    {
+        m_table.resize(size_t(size.y) * m_pitch, 255);
+        parallel_rows(size, 1, 0, [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                m_rows[y] = y;
+                uint8_t *row = &m_table[size_t(y) * m_pitch];
+                for (int x = 0; x < size.x; ++x)
+                {
+                    int kx = wrap((cost * x - sint * y) / scale, ksize.x);
+                    int ky = wrap((cost * y + sint * x) / scale, ksize.y);
+                    row[x] = threshold(kx, ky);
+                }
+            }
+        });
+    }
+}
+
+#if LOL_ORDERED_SSE2
+/* Bit-reversed bytes, to turn SSE2 lane masks into MSB-first bytes */
+static uint8_t const *reversed_bits()
+{
+    static uint8_t const *table = []()
+    {
+        static uint8_t t[256];
+        for (int i = 0; i < 256; ++i)
+        {
+            int r = 0;
+            for (int b = 0; b < 8; ++b)
+                r |= ((i >> b) & 1) << (7 - b);
+            t[i] = (uint8_t)r;
+        }
+        return t;
+    }();
+    return table;
+}
+#endif
+
+template<bool PACKED>
+void old_image::threshold_map::run(uint8_t const *src, uint8_t *dst) const
+{
+    int const width = m_size.x;
+    size_t const dst_pitch = PACKED ? size_t(width + 7) / 8 : size_t(width);
+
+    parallel_rows(m_size, 1, 0, [&](int y0, int y1)
+    {
+        for (int y = y0; y < y1; ++y)
+        {
+            uint8_t const *t = &m_table[size_t(m_rows[y]) * m_pitch];
+            uint8_t const *s = src + size_t(y) * width;
+            uint8_t *d = dst + size_t(y) * dst_pitch;
+            int x = 0;
+
+#if LOL_ORDERED_SSE2
+            uint8_t const *rev = reversed_bits();
+            __m128i const zero = _mm_setzero_si128();
+            for (; x + 32 <= width; x += 32)
+            {
+                /* p > t exactly when p − t does not saturate to zero */
+                __m128i le0 = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_loadu_si128((__m128i const *)(s + x)),
+                                                           _mm_loadu_si128((__m128i const *)(t + x))), zero);
+                __m128i le1 = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_loadu_si128((__m128i const *)(s + x + 16)),
+                                                           _mm_loadu_si128((__m128i const *)(t + x + 16))), zero);
+                if (PACKED)
+                {
+                    int m = ~(_mm_movemask_epi8(le0) | (_mm_movemask_epi8(le1) << 16));
+                    d[x / 8] = rev[m & 0xff];
+                    d[x / 8 + 1] = rev[(m >> 8) & 0xff];
+                    d[x / 8 + 2] = rev[(m >> 16) & 0xff];
+                    d[x / 8 + 3] = rev[(m >> 24) & 0xff];
+                }
+                else
+                {
+                    __m128i ones = _mm_cmpeq_epi8(zero, zero);
+                    _mm_storeu_si128((__m128i *)(d + x), _mm_xor_si128(le0, ones));
+                    _mm_storeu_si128((__m128i *)(d + x + 16), _mm_xor_si128(le1, ones));
+                }
+            }
+#elif LOL_ORDERED_NEON
+            static uint8_t const weights[16] = { 128, 64, 32, 16, 8, 4, 2, 1,
+                                                 128, 64, 32, 16, 8, 4, 2, 1 };
+            uint8x16_t const w = vld1q_u8(weights);
+            for (; x + 32 <= width; x += 32)
+            {
+                uint8x16_t gt0 = vcgtq_u8(vld1q_u8(s + x), vld1q_u8(t + x));
+                uint8x16_t gt1 = vcgtq_u8(vld1q_u8(s + x + 16), vld1q_u8(t + x + 16));
+                if (PACKED)
+                {
+                    uint8x16_t b0 = vandq_u8(gt0, w), b1 = vandq_u8(gt1, w);
+                    d[x / 8] = vaddv_u8(vget_low_u8(b0));
+                    d[x / 8 + 1] = vaddv_u8(vget_high_u8(b0));
+                    d[x / 8 + 2] = vaddv_u8(vget_low_u8(b1));
+                    d[x / 8 + 3] = vaddv_u8(vget_high_u8(b1));
+                }
+                else
+                {
+                    vst1q_u8(d + x, gt0);
+                    vst1q_u8(d + x + 16, gt1);
+                }
+            }
+#endif
+
+            if (PACKED)
+            {
+                /* x is a multiple of 8 here */
+                for (; x < width; x += 8)
+                {
+                    uint8_t bits = 0;
+                    for (int i = 0; i < 8 && x + i < width; ++i)
+                        bits |= (s[x + i] > t[x + i]) << (7 - i);
+                    d[x / 8] = bits;
+                }
+            }
+            else
+            {
+                for (; x < width; ++x)
+                    d[x] = s[x] > t[x] ? 255 : 0;
+            }
+        }
+    });
+}
+
+void old_image::threshold_map::dither_u8(uint8_t const *src, uint8_t *dst) const
+{
+    run<false>(src, dst);
+}
+
+void old_image::threshold_map::dither_1bit(uint8_t const *src, uint8_t *dst) const
+{
+    run<true>(src, dst);
+}
+
+old_image old_image::threshold_map::dither(old_image const &src) const
+{
+    old_image tmp = src;
+    old_image ret(m_size);
+
+    uint8_t const *srcp = tmp.lock<PixelFormat::Y_8>();
+    uint8_t *dstp = ret.lock<PixelFormat::Y_8>();
+
+    dither_u8(srcp, dstp);
 
     ret.unlock(dstp);
+    tmp.unlock(srcp);
 
     return ret;
 }
 
 } /* namespace lol */
-
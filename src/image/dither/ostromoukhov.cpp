@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,6 +12,10 @@
 
 #include <lol/engine-internal.h>
 
+#include "../image-private.h"
+
+#include <vector> // std::vector
+
 /*
  * Ostromoukhov dithering functions
  *
@@ -71,22 +75,25 @@ static inline vec3 GetDiffusion(float v)
     return ret;
 }
 
+/* Each pixel spreads its error to the next pixel and to two pixels on
+ * the next row, so rows run as a wavefront with a lag of three pixels. */
 old_image old_image::dither_ostromoukhov(ScanMode scan) const
 {
     old_image dst = *this;
 
-    float *pixels = dst.lock<PixelFormat::Y_F32>();
     int w = dst.size().x;
     int h = dst.size().y;
 
-    for (int y = 0; y < h; y++)
+    float *pixels = dst.lock<PixelFormat::Y_F32>();
+
+    parallel_wavefront(dst.size(), 3, scan, [&](int y, int n0, int n1)
     {
         bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+        int s = reverse ? -1 : 1;
 
-        for (int x = 0; x < w; x++)
+        for (int x = n0; x < n1; x++)
         {
             int x2 = reverse ? w - 1 - x : x;
-            int s = reverse ? -1 : 1;
 
             float p = pixels[y * w + x2];
             float q = p < 0.5f ? 0.f : 1.f;
@@ -103,12 +110,68 @@ old_image old_image::dither_ostromoukhov(ScanMode scan) const
                 pixels[(y + 1) * w + x2] += e[2];
             }
         }
-    }
+    });
 
     dst.unlock(pixels);
 
     return dst;
 }
 
+/* Same, with fixed-point weights looked up per input value */
+old_image old_image::dither_ostromoukhov_u8(ScanMode scan) const
+{
+    old_image dst = *this;
+
+    int w = dst.size().x;
+    int h = dst.size().y;
+
+    int32_t table[256][3];
+    for (int i = 0; i < 256; ++i)
+    {
+        vec3 d = GetDiffusion(i / 255.f);
+        table[i][1] = ediff_fixed::weight(d[1]);
+        table[i][2] = ediff_fixed::weight(d[2]);
+        table[i][0] = 256 - table[i][1] - table[i][2];
+    }
+
+    uint8_t *pixels = dst.lock<PixelFormat::Y_8>();
+
+    std::vector<int16_t> tmp(w * h);
+    ediff_fixed::load(dst.size(), pixels, tmp.data());
+
+    parallel_wavefront(dst.size(), 3, scan, [&](int y, int n0, int n1)
+    {
+        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+        int s = reverse ? -1 : 1;
+
+        for (int x = n0; x < n1; x++)
+        {
+            int x2 = reverse ? w - 1 - x : x;
+
+            int16_t v = tmp[y * w + x2];
+            int32_t q = v < ediff_fixed::half ? 0 : ediff_fixed::one;
+            tmp[y * w + x2] = int16_t(q);
+
+            int32_t e = v - q;
+            int const round = 1 << (ediff_fixed::bits - 1);
+            int32_t const *d = table[lol::clamp((v + round) >> ediff_fixed::bits, 0, 255)];
+
+            if (x < w - 1)
+                ediff_fixed::add(tmp[y * w + x2 + s], e, d[0]);
+            if (y < h - 1)
+            {
+                if (x > 0)
+                    ediff_fixed::add(tmp[(y + 1) * w + x2 - s], e, d[1]);
+                ediff_fixed::add(tmp[(y + 1) * w + x2], e, d[2]);
+            }
+        }
+    });
+
+    ediff_fixed::store(dst.size(), tmp.data(), pixels);
+
+    dst.unlock(pixels);
+    return dst;
+}
+
 } /* namespace lol */
 
@@ -12,6 +12,8 @@
 
 #include <lol/engine-internal.h>
 
+#include "../image-private.h"
+
 #include <vector>
 
 /*
@@ -111,37 +113,40 @@ static old_image NonSepConv(old_image &src, old_array2d<float> const &in_kernel)
     old_array2d<pixel_t> const &srcp = src.lock2d<FORMAT>();
     old_array2d<pixel_t> &dstp = dst.lock2d<FORMAT>();
 
-    for (int y = 0; y < size.y; y++)
+    parallel_rows(size, sizeof(pixel_t), ksize.y / 2, [&](int y0, int y1)
     {
-        for (int x = 0; x < size.x; x++)
+        for (int y = y0; y < y1; y++)
         {
-            pixel_t pixel(0.f);
-
-            for (int dy = 0; dy < ksize.y; dy++)
+            for (int x = 0; x < size.x; x++)
             {
-                int y2 = y + dy - ksize.y / 2;
-                if (y2 < 0)
-                    y2 = WRAP_Y ? size.y - 1 - ((-y2 - 1) % size.y) : 0;
-                else if (y2 >= size.y)
-                    y2 = WRAP_Y ? y2 % size.y : size.y - 1;
+                pixel_t pixel(0.f);
 
-                for (int dx = 0; dx < ksize.x; dx++)
+                for (int dy = 0; dy < ksize.y; dy++)
                 {
-                    float f = in_kernel[dx][dy];
-
-                    int x2 = x + dx - ksize.x / 2;
-                    if (x2 < 0)
-                        x2 = WRAP_X ? size.x - 1 - ((-x2 - 1) % size.x) : 0;
-                    else if (x2 >= size.x)
-                        x2 = WRAP_X ? x2 % size.x : size.x - 1;
-
-                    pixel += f * srcp[x2][y2];
+                    int y2 = y + dy - ksize.y / 2;
+                    if (y2 < 0)
+                        y2 = WRAP_Y ? size.y - 1 - ((-y2 - 1) % size.y) : 0;
+                    else if (y2 >= size.y)
+                        y2 = WRAP_Y ? y2 % size.y : size.y - 1;
+
+                    for (int dx = 0; dx < ksize.x; dx++)
+                    {
+                        float f = in_kernel[dx][dy];
+
+                        int x2 = x + dx - ksize.x / 2;
+                        if (x2 < 0)
+                            x2 = WRAP_X ? size.x - 1 - ((-x2 - 1) % size.x) : 0;
+                        else if (x2 >= size.x)
+                            x2 = WRAP_X ? x2 % size.x : size.x - 1;
+
+                        pixel += f * srcp[x2][y2];
+                    }
                 }
-            }
 
-            dstp[x][y] = lol::clamp(pixel, 0.0f, 1.0f);
+                dstp[x][y] = lol::clamp(pixel, 0.0f, 1.0f);
+            }
         }
-    }
+    });
 
     src.unlock2d(srcp);
     dst.unlock2d(dstp);
@@ -206,47 +211,55 @@ static old_image SepConv(old_image &src, std::vector<float> const &hvec,
 
     old_array2d<pixel_t> tmp(size);
 
-    for (int y = 0; y < size.y; y++)
+    parallel_rows(size, sizeof(pixel_t), 0, [&](int y0, int y1)
     {
-        for (int x = 0; x < size.x; x++)
+        for (int y = y0; y < y1; y++)
         {
-            pixel_t pixel(0.f);
-
-            for (int dx = 0; dx < ksize.x; dx++)
+            for (int x = 0; x < size.x; x++)
             {
-                int x2 = x + dx - ksize.x / 2;
-                if (x2 < 0)
-                    x2 = WRAP_X ? size.x - 1 - ((-x2 - 1) % size.x) : 0;
-                else if (x2 >= size.x)
-                    x2 = WRAP_X ? x2 % size.x : size.x - 1;
+                pixel_t pixel(0.f);
 
-                pixel += hvec[dx] * srcp[x2][y];
-            }
+                for (int dx = 0; dx < ksize.x; dx++)
+                {
+                    int x2 = x + dx - ksize.x / 2;
+                    if (x2 < 0)
+                        x2 = WRAP_X ? size.x - 1 - ((-x2 - 1) % size.x) : 0;
+                    else if (x2 >= size.x)
+                        x2 = WRAP_X ? x2 % size.x : size.x - 1;
+
+                    pixel += hvec[dx] * srcp[x2][y];
+                }
 
-            tmp[x][y] = pixel;
+                tmp[x][y] = pixel;
+            }
         }
-    }
+    });
 
-    for (int y = 0; y < size.y; y++)
+    /* The vertical pass needs the whole horizontal pass to be done, since
+     * it reads rows from neighbouring bands. */
+    parallel_rows(size, sizeof(pixel_t), ksize.y / 2, [&](int y0, int y1)
     {
-        for (int x = 0; x < size.x; x++)
+        for (int y = y0; y < y1; y++)
         {
-            pixel_t pixel(0.f);
-
-            for (int j = 0; j < ksize.y; j++)
+            for (int x = 0; x < size.x; x++)
             {
-                int y2 = y + j - ksize.y / 2;
-                if (y2 < 0)
-                    y2 = WRAP_Y ? size.y - 1 - ((-y2 - 1) % size.y) : 0;
-                else if (y2 >= size.y)
-                    y2 = WRAP_Y ? y2 % size.y : size.y - 1;
+                pixel_t pixel(0.f);
 
-                pixel += vvec[j] * tmp[x][y2];
-            }
+                for (int j = 0; j < ksize.y; j++)
+                {
+                    int y2 = y + j - ksize.y / 2;
+                    if (y2 < 0)
+                        y2 = WRAP_Y ? size.y - 1 - ((-y2 - 1) % size.y) : 0;
+                    else if (y2 >= size.y)
+                        y2 = WRAP_Y ? y2 % size.y : size.y - 1;
 
-            dstp[x][y] = lol::clamp(pixel, 0.0f, 1.0f);
+                    pixel += vvec[j] * tmp[x][y2];
+                }
+
+                dstp[x][y] = lol::clamp(pixel, 0.0f, 1.0f);
+            }
         }
-    }
+    });
 
     src.unlock2d(srcp);
     dst.unlock2d(dstp);
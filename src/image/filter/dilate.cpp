@@ -12,6 +12,8 @@
 
 #include <lol/engine-internal.h>
 
+#include "../image-private.h"
+
 /*
  * Dilate and erode functions
  */
@@ -34,21 +36,24 @@ old_image old_image::Dilate()
         float const *srcp = lock<PixelFormat::Y_F32>();
         float *dstp = ret.lock<PixelFormat::Y_F32>();
 
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                float t = srcp[y * isize.x + x];
-                t = lol::max(t, srcp[y * isize.x + x2]);
-                t = lol::max(t, srcp[y * isize.x + x3]);
-                t = lol::max(t, srcp[y2 * isize.x + x]);
-                t = lol::max(t, srcp[y3 * isize.x + x]);
-                dstp[y * isize.x + x] = t;
-            }
+        parallel_rows(isize, sizeof(float), 1, [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+                for (int x = 0; x < isize.x; ++x)
+                {
+                    int y2 = lol::max(y - 1, 0);
+                    int x2 = lol::max(x - 1, 0);
+                    int y3 = lol::min(y + 1, isize.y - 1);
+                    int x3 = lol::min(x + 1, isize.x - 1);
+
+                    float t = srcp[y * isize.x + x];
+                    t = lol::max(t, srcp[y * isize.x + x2]);
+                    t = lol::max(t, srcp[y * isize.x + x3]);
+                    t = lol::max(t, srcp[y2 * isize.x + x]);
+                    t = lol::max(t, srcp[y3 * isize.x + x]);
+                    dstp[y * isize.x + x] = t;
+                }
+        });
 
         unlock(srcp);
         ret.unlock(dstp);
@@ -58,21 +63,24 @@ old_image old_image::Dilate()
         vec4 const *srcp = lock<PixelFormat::RGBA_F32>();
         vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
 
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                vec3 t = srcp[y * isize.x + x].rgb;
-                t = lol::max(t, srcp[y * isize.x + x2].rgb);
-                t = lol::max(t, srcp[y * isize.x + x3].rgb);
-                t = lol::max(t, srcp[y2 * isize.x + x].rgb);
-                t = lol::max(t, srcp[y3 * isize.x + x].rgb);
-                dstp[y * isize.x + x] = vec4(t, srcp[y * isize.x + x].a);
-            }
+        parallel_rows(isize, sizeof(vec4), 1, [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+                for (int x = 0; x < isize.x; ++x)
+                {
+                    int y2 = lol::max(y - 1, 0);
+                    int x2 = lol::max(x - 1, 0);
+                    int y3 = lol::min(y + 1, isize.y - 1);
+                    int x3 = lol::min(x + 1, isize.x - 1);
+
+                    vec3 t = srcp[y * isize.x + x].rgb;
+                    t = lol::max(t, srcp[y * isize.x + x2].rgb);
+                    t = lol::max(t, srcp[y * isize.x + x3].rgb);
+                    t = lol::max(t, srcp[y2 * isize.x + x].rgb);
+                    t = lol::max(t, srcp[y3 * isize.x + x].rgb);
+                    dstp[y * isize.x + x] = vec4(t, srcp[y * isize.x + x].a);
+                }
+        });
 
         unlock(srcp);
         ret.unlock(dstp);
@@ -91,21 +99,24 @@ old_image old_image::Erode()
         float const *srcp = lock<PixelFormat::Y_F32>();
         float *dstp = ret.lock<PixelFormat::Y_F32>();
 
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                float t = srcp[y * isize.x + x];
-                t = lol::max(t, srcp[y * isize.x + x2]);
-                t = lol::max(t, srcp[y * isize.x + x3]);
-                t = lol::max(t, srcp[y2 * isize.x + x]);
-                t = lol::max(t, srcp[y3 * isize.x + x]);
-                dstp[y * isize.x + x] = t;
-            }
+        parallel_rows(isize, sizeof(float), 1, [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+                for (int x = 0; x < isize.x; ++x)
+                {
+                    int y2 = lol::max(y - 1, 0);
+                    int x2 = lol::max(x - 1, 0);
+                    int y3 = lol::min(y + 1, isize.y - 1);
+                    int x3 = lol::min(x + 1, isize.x - 1);
+
+                    float t = srcp[y * isize.x + x];
+                    t = lol::max(t, srcp[y * isize.x + x2]);
+                    t = lol::max(t, srcp[y * isize.x + x3]);
+                    t = lol::max(t, srcp[y2 * isize.x + x]);
+                    t = lol::max(t, srcp[y3 * isize.x + x]);
+                    dstp[y * isize.x + x] = t;
+                }
+        });
 
         unlock(srcp);
         ret.unlock(dstp);
@@ -115,21 +126,24 @@ old_image old_image::Erode()
         vec4 const *srcp = lock<PixelFormat::RGBA_F32>();
         vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
 
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                vec3 t = srcp[y * isize.x + x].rgb;
-                t = lol::min(t, srcp[y * isize.x + x2].rgb);
-                t = lol::min(t, srcp[y * isize.x + x3].rgb);
-                t = lol::min(t, srcp[y2 * isize.x + x].rgb);
-                t = lol::min(t, srcp[y3 * isize.x + x].rgb);
-                dstp[y * isize.x + x] = vec4(t, srcp[y * isize.x + x].a);
-            }
+        parallel_rows(isize, sizeof(vec4), 1, [&](int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+                for (int x = 0; x < isize.x; ++x)
+                {
+                    int y2 = lol::max(y - 1, 0);
+                    int x2 = lol::max(x - 1, 0);
+                    int y3 = lol::min(y + 1, isize.y - 1);
+                    int x3 = lol::min(x + 1, isize.x - 1);
+
+                    vec3 t = srcp[y * isize.x + x].rgb;
+                    t = lol::min(t, srcp[y * isize.x + x2].rgb);
+                    t = lol::min(t, srcp[y * isize.x + x3].rgb);
+                    t = lol::min(t, srcp[y2 * isize.x + x].rgb);
+                    t = lol::min(t, srcp[y3 * isize.x + x].rgb);
+                    dstp[y * isize.x + x] = vec4(t, srcp[y * isize.x + x].a);
+                }
+        });
 
         unlock(srcp);
         ret.unlock(dstp);
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,138 +12,454 @@
 
 #include <lol/engine-internal.h>
 
+#include <algorithm> // std::nth_element
+#include <cstdint> // uint8_t, uint16_t
+#include <vector> // std::vector
+
+#if defined __SSE__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define LOL_MEDIAN_SSE 1
+#elif defined __ARM_NEON && defined __aarch64__
+#   include <arm_neon.h>
+#   define LOL_MEDIAN_NEON 1
+#endif
+
+#include "../image-private.h"
+
 /*
  * Median filter functions
+ *
+ * All filters wrap around the image edges.
+ *  - 8-bit greyscale images use a sliding histogram (Perreault & Hébert,
+ *    “Median Filtering in Constant Time”): one histogram per column is
+ *    moved down one row at a time, and the kernel histogram is moved
+ *    right by adding and removing whole column histograms. The cost per
+ *    pixel does not depend on the kernel size.
+ *  - float greyscale images use a sorting network for 3×3 kernels and
+ *    partial selection for the other sizes.
+ *  - colour images compute the geometric median of the neighbourhood
+ *    with Weiszfeld’s algorithm, four neighbours at a time.
  */
 
-/* FIXME: this is in desperate want of optimisation. Here is what could
- * be done to improve the performance:
- *  - prefetch the neighbourhood; most neighbours are the same as the
- *    previous pixels.
- *  - use a better sort algorithm; bubble sort is ridiculous
- *  - even better, use state-of-the art median selection, ie. O(3n), for
- *    most common combinations (9, 25, 49, 81). */
-
 namespace lol
 {
 
-static int cmpfloat(void const *i1, void const *i2)
+namespace
 {
-    float a = *(float const *)i1;
-    float b = *(float const *)i2;
 
-    return (a > b) - (a < b);
+/* Positive modulo, for wrapping coordinates around the image */
+inline int wrap(int x, int n)
+{
+    x %= n;
+    return x < 0 ? x + n : x;
 }
 
-old_image old_image::Median(ivec2 ksize) const
+/* Wrapped coordinates for [-k, size + k), so that the inner loops
+ * never need to wrap anything themselves. */
+std::vector<int> wrap_table(int size, int k)
 {
-    ivec2 const isize = size();
-    old_image tmp = *this;
-    old_image ret(isize);
+    std::vector<int> ret(size + 2 * k);
+    for (int i = 0; i < size + 2 * k; ++i)
+        ret[i] = wrap(i - k, size);
+    return ret;
+}
 
-    if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
+//
+// Sliding histogram median for 8-bit images
+//
+
+struct histogram
+{
+    uint16_t coarse[16];
+    uint16_t fine[256];
+
+    void clear()
     {
-        ivec2 const lsize = 2 * ksize + ivec2(1);
-        old_array2d<float> list(lsize);
+        std::fill(coarse, coarse + 16, 0);
+        std::fill(fine, fine + 256, 0);
+    }
 
-        float *srcp = tmp.lock<PixelFormat::Y_F32>();
-        float *dstp = ret.lock<PixelFormat::Y_F32>();
+    /* These loops have no dependencies and are vectorised by the compiler */
+    void add(histogram const &h)
+    {
+        for (int i = 0; i < 16; ++i)
+            coarse[i] += h.coarse[i];
+        for (int i = 0; i < 256; ++i)
+            fine[i] += h.fine[i];
+    }
+
+    void add_sub(histogram const &h1, histogram const &h2)
+    {
+        for (int i = 0; i < 16; ++i)
+            coarse[i] += h1.coarse[i] - h2.coarse[i];
+        for (int i = 0; i < 256; ++i)
+            fine[i] += h1.fine[i] - h2.fine[i];
+    }
+
+    /* Find the value of the given rank; coarse bins tell which 16 fine
+     * bins to look at. */
+    uint8_t select(int rank) const
+    {
+        int c = 0;
+        for (; rank >= coarse[c]; ++c)
+            rank -= coarse[c];
+        int f = c * 16;
+        for (; rank >= fine[f]; ++f)
+            rank -= fine[f];
+        return uint8_t(f);
+    }
+};
+
+void median_u8(uint8_t const *srcp, uint8_t *dstp, ivec2 isize, ivec2 ksize)
+{
+    ivec2 const lsize = 2 * ksize + ivec2(1);
+    int const rank = lsize.x * lsize.y / 2;
+    auto const xmap = wrap_table(isize.x, ksize.x);
+
+    /* Filling the column histograms costs as much as 2k+1 rows, so use
+     * one tall band per thread rather than cache-sized bands. */
+    auto &pool = image_thread_pool();
+    size_t const rows = std::max(size_t(isize.y) / pool.concurrency(), size_t(1));
+
+    pool.parallel_for(size_t(isize.y), rows, [&](size_t band_begin, size_t band_end)
+    {
+        int const y0 = int(band_begin), y1 = int(band_end);
+
+        /* Each band moves its own column histograms down */
+        std::vector<histogram> cols(isize.x);
+        for (auto &h : cols)
+            h.clear();
 
-        for (int y = 0; y < isize.y; y++)
+        for (int j = -ksize.y; j <= ksize.y; ++j)
         {
-            for (int x = 0; x < isize.x; x++)
+            uint8_t const *row = srcp + wrap(y0 + j, isize.y) * isize.x;
+            for (int x = 0; x < isize.x; ++x)
             {
-                /* Make a list of neighbours */
-                for (int j = -ksize.y; j <= ksize.y; j++)
-                {
-                    int y2 = y + j;
-                    if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
-                    else if (y2 > 0) y2 = y2 % isize.y;
+                ++cols[x].coarse[row[x] >> 4];
+                ++cols[x].fine[row[x]];
+            }
+        }
 
-                    for (int i = -ksize.x; i <= ksize.x; i++)
-                    {
-                        int x2 = x + i;
-                        if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
-                        else if (x2 > 0) x2 = x2 % isize.x;
+        histogram h;
 
-                        list[i + ksize.x][j + ksize.y] = srcp[y2 * isize.x + x2];
-                    }
-                }
+        for (int y = y0; y < y1; ++y)
+        {
+            /* Build the kernel histogram for the first pixel, then slide */
+            h.clear();
+            for (int i = 0; i < lsize.x; ++i)
+                h.add(cols[xmap[i]]);
 
-                /* Sort the list */
-                qsort(&list[0][0], lsize.x * lsize.y, sizeof(float), cmpfloat);
+            for (int x = 0; x < isize.x; ++x)
+            {
+                dstp[y * isize.x + x] = h.select(rank);
+                if (x + 1 < isize.x)
+                    h.add_sub(cols[xmap[x + lsize.x]], cols[xmap[x]]);
+            }
 
-                /* Store the median value */
-                dstp[y * isize.x + x] = *(&list[0][0] + lsize.x * lsize.y / 2);
+            if (y + 1 == y1)
+                break;
+
+            /* Move the column histograms down one row */
+            uint8_t const *out = srcp + wrap(y - ksize.y, isize.y) * isize.x;
+            uint8_t const *in = srcp + wrap(y + ksize.y + 1, isize.y) * isize.x;
+            for (int x = 0; x < isize.x; ++x)
+            {
+                --cols[x].coarse[out[x] >> 4];
+                --cols[x].fine[out[x]];
+                ++cols[x].coarse[in[x] >> 4];
+                ++cols[x].fine[in[x]];
             }
         }
+    });
+}
 
-        tmp.unlock(srcp);
-        ret.unlock(dstp);
-    }
-    else
+//
+// Sorting network and selection for float images
+//
+
+/* Median of 9 values (Paeth, as optimised by Devillard), applied to a
+ * block of pixels at once; the compiler turns each step into min/max
+ * vector instructions. */
+int const MED9_LANES = 8;
+
+inline void med9(float (&p)[9][MED9_LANES], float *out)
+{
+    auto sort = [&](int a, int b)
     {
-        ivec2 const lsize = 2 * ksize + ivec2(1);
-        old_array2d<vec3> list(lsize);
+        for (int i = 0; i < MED9_LANES; ++i)
+        {
+            float t = p[a][i];
+            p[a][i] = std::min(t, p[b][i]);
+            p[b][i] = std::max(t, p[b][i]);
+        }
+    };
+
+    sort(1, 2); sort(4, 5); sort(7, 8);
+    sort(0, 1); sort(3, 4); sort(6, 7);
+    sort(1, 2); sort(4, 5); sort(7, 8);
+    sort(0, 3); sort(5, 8); sort(4, 7);
+    sort(3, 6); sort(1, 4); sort(2, 5);
+    sort(4, 7); sort(4, 2); sort(6, 4);
+    sort(4, 2);
+
+    for (int i = 0; i < MED9_LANES; ++i)
+        out[i] = p[4][i];
+}
 
-        vec4 *srcp = tmp.lock<PixelFormat::RGBA_F32>();
-        vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
+void median_f32(float const *srcp, float *dstp, ivec2 isize, ivec2 ksize)
+{
+    ivec2 const lsize = 2 * ksize + ivec2(1);
+    int const count = lsize.x * lsize.y;
+    auto const xmap = wrap_table(isize.x, ksize.x);
+
+    parallel_rows(isize, sizeof(float), ksize.y, [&](int y0, int y1)
+    {
+        /* Each band needs its own list of neighbours */
+        std::vector<float> list(count);
+        std::vector<float const *> rows(lsize.y);
 
-        for (int y = 0; y < isize.y; y++)
+        for (int y = y0; y < y1; y++)
         {
-            for (int x = 0; x < isize.x; x++)
+            for (int j = 0; j < lsize.y; ++j)
+                rows[j] = srcp + wrap(y + j - ksize.y, isize.y) * isize.x;
+
+            if (ksize.x == 1 && ksize.y == 1)
             {
-                /* Make a list of neighbours */
-                for (int j = -ksize.y; j <= ksize.y; j++)
+                for (int x = 0; x < isize.x; x += MED9_LANES)
                 {
-                    int y2 = y + j;
-                    if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
-                    else if (y2 > 0) y2 = y2 % isize.y;
-
-                    for (int i = -ksize.x; i <= ksize.x; i++)
+                    /* Lanes past the end of the row are computed, but
+                     * never stored. */
+                    float p[9][MED9_LANES], out[MED9_LANES];
+                    for (int i = 0; i < MED9_LANES; ++i)
                     {
-                        int x2 = x + i;
-                        if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
-                        else if (x2 > 0) x2 = x2 % isize.x;
-
-                        list[i + ksize.x][j + ksize.y] = srcp[y2 * isize.x + x2].rgb;
+                        int x2 = std::min(x + i, isize.x - 1);
+                        for (int j = 0; j < 3; ++j)
+                            for (int k = 0; k < 3; ++k)
+                                p[3 * j + k][i] = rows[j][xmap[x2 + k]];
                     }
+
+                    med9(p, out);
+
+                    for (int i = 0; i < MED9_LANES && x + i < isize.x; ++i)
+                        dstp[y * isize.x + x + i] = out[i];
                 }
+                continue;
+            }
+
+            for (int x = 0; x < isize.x; x++)
+            {
+                /* Make a list of neighbours */
+                float *p = list.data();
+                for (int j = 0; j < lsize.y; ++j)
+                    for (int i = 0; i < lsize.x; ++i)
+                        *p++ = rows[j][xmap[x + i]];
+
+                /* Only the median needs to be in place */
+                std::nth_element(list.begin(), list.begin() + count / 2, list.end());
+                dstp[y * isize.x + x] = list[count / 2];
+            }
+        }
+    });
+}
+
+//
+// Geometric median for colour images
+//
+
+/* Neighbours stored as separate channels, padded to a multiple of four
+ * with zero-weight entries so that the vector loop needs no tail. */
+struct neighbours
+{
+    neighbours(int count)
+      : n((count + 3) & ~3),
+        r(n, 0.f), g(n, 0.f), b(n, 0.f), w(n, 0.f)
+    {}
+
+    int n;
+    std::vector<float> r, g, b, w;
+};
 
-                /* Algorithm constants, empirically chosen */
-                int const N = 5;
-                float const K = 1.5f;
+/* Compute the sums for one step of Weiszfeld’s algorithm */
+void weiszfeld_sums(neighbours const &l, vec3 median, vec3 &s1, float &s2)
+{
+#if LOL_MEDIAN_SSE
+    __m128 const mr = _mm_set1_ps(median.r);
+    __m128 const mg = _mm_set1_ps(median.g);
+    __m128 const mb = _mm_set1_ps(median.b);
+    __m128 const eps = _mm_set1_ps(1e-10f);
+    __m128 ar = _mm_setzero_ps(), ag = _mm_setzero_ps();
+    __m128 ab = _mm_setzero_ps(), aw = _mm_setzero_ps();
+
+    for (int i = 0; i < l.n; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(&l.r[i]);
+        __m128 g = _mm_loadu_ps(&l.g[i]);
+        __m128 b = _mm_loadu_ps(&l.b[i]);
+        __m128 dr = _mm_sub_ps(r, mr), dg = _mm_sub_ps(g, mg), db = _mm_sub_ps(b, mb);
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                               _mm_mul_ps(db, db));
+        __m128 d = _mm_div_ps(_mm_loadu_ps(&l.w[i]),
+                              _mm_add_ps(eps, _mm_sqrt_ps(d2)));
+        ar = _mm_add_ps(ar, _mm_mul_ps(r, d));
+        ag = _mm_add_ps(ag, _mm_mul_ps(g, d));
+        ab = _mm_add_ps(ab, _mm_mul_ps(b, d));
+        aw = _mm_add_ps(aw, d);
+    }
+
+    /* Transpose so that each register holds one lane of every sum */
+    _MM_TRANSPOSE4_PS(ar, ag, ab, aw);
+    float sums[4];
+    _mm_storeu_ps(sums, _mm_add_ps(_mm_add_ps(ar, ag), _mm_add_ps(ab, aw)));
+    s1 = vec3(sums[0], sums[1], sums[2]);
+    s2 = sums[3];
+#elif LOL_MEDIAN_NEON
+    float32x4_t const mr = vdupq_n_f32(median.r);
+    float32x4_t const mg = vdupq_n_f32(median.g);
+    float32x4_t const mb = vdupq_n_f32(median.b);
+    float32x4_t const eps = vdupq_n_f32(1e-10f);
+    float32x4_t ar = vdupq_n_f32(0.f), ag = ar, ab = ar, aw = ar;
+
+    for (int i = 0; i < l.n; i += 4)
+    {
+        float32x4_t r = vld1q_f32(&l.r[i]);
+        float32x4_t g = vld1q_f32(&l.g[i]);
+        float32x4_t b = vld1q_f32(&l.b[i]);
+        float32x4_t dr = vsubq_f32(r, mr), dg = vsubq_f32(g, mg), db = vsubq_f32(b, mb);
+        float32x4_t d2 = vaddq_f32(vaddq_f32(vmulq_f32(dr, dr), vmulq_f32(dg, dg)),
+                                   vmulq_f32(db, db));
+        float32x4_t d = vdivq_f32(vld1q_f32(&l.w[i]),
+                                  vaddq_f32(eps, vsqrtq_f32(d2)));
+        ar = vaddq_f32(ar, vmulq_f32(r, d));
+        ag = vaddq_f32(ag, vmulq_f32(g, d));
+        ab = vaddq_f32(ab, vmulq_f32(b, d));
+        aw = vaddq_f32(aw, d);
+    }
+
+    s1 = vec3(vaddvq_f32(ar), vaddvq_f32(ag), vaddvq_f32(ab));
+    s2 = vaddvq_f32(aw);
+#else
+    s1 = vec3(0.f);
+    s2 = 0.f;
+    for (int i = 0; i < l.n; ++i)
+    {
+        vec3 c(l.r[i], l.g[i], l.b[i]);
+        float d = l.w[i] / (1e-10f + distance(median, c));
+        s1 += c * d;
+        s2 += d;
+    }
+#endif
+}
+
+vec3 weiszfeld(neighbours const &l)
+{
+    /* Algorithm constants, empirically chosen */
+    int const N = 5;
+    float const K = 1.5f;
+
+    /* Iterate using Weiszfeld’s algorithm */
+    vec3 oldmed(0.f), median(0.f);
+    for (int iter = 0; ; ++iter)
+    {
+        oldmed = median;
+        vec3 s1;
+        float s2;
+        weiszfeld_sums(l, median, s1, s2);
+        median = s1 / s2;
+
+        if (iter > 1 && iter < N)
+        {
+            median += K * (median - oldmed);
+        }
+
+        if (iter > 3 && distance(oldmed, median) < 1.e-5f)
+            break;
+    }
+
+    return median;
+}
 
-                /* Iterate using Weiszfeld’s algorithm */
-                vec3 oldmed(0.f), median(0.f);
-                for (int iter = 0; ; ++iter)
+/* Weighted geometric median with the kernel centred on each pixel */
+void median_rgb(vec4 const *srcp, vec4 *dstp, ivec2 isize,
+                old_array2d<float> const &ker)
+{
+    ivec2 const ksize = ker.sizes();
+    ivec2 const half = ksize / 2;
+    auto const xmap = wrap_table(isize.x, half.x);
+
+    parallel_rows(isize, sizeof(vec4), half.y, [&](int y0, int y1)
+    {
+        /* Each band needs its own list of neighbours */
+        neighbours list(ksize.x * ksize.y);
+        for (int j = 0; j < ksize.y; ++j)
+            for (int i = 0; i < ksize.x; ++i)
+                list.w[j * ksize.x + i] = ker[i][j];
+
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = 0; x < isize.x; x++)
+            {
+                /* Make a list of neighbours */
+                for (int j = 0; j < ksize.y; j++)
                 {
-                    oldmed = median;
-                    vec3 s1(0.f);
-                    float s2 = 0.f;
-                    for (int j = 0; j < lsize.y; ++j)
-                        for (int i = 0; i < lsize.x; ++i)
-                        {
-                            float d = 1.0f /
-                                      (1e-10f + distance(median, list[i][j]));
-                            s1 += list[i][j] * d;
-                            s2 += d;
-                        }
-                    median = s1 / s2;
-
-                    if (iter > 1 && iter < N)
+                    vec4 const *row = srcp + wrap(y + j - half.y, isize.y) * isize.x;
+                    for (int i = 0; i < ksize.x; i++)
                     {
-                        median += K * (median - oldmed);
+                        vec4 const &c = row[xmap[x + i]];
+                        list.r[j * ksize.x + i] = c.r;
+                        list.g[j * ksize.x + i] = c.g;
+                        list.b[j * ksize.x + i] = c.b;
                     }
-
-                    if (iter > 3 && distance(oldmed, median) < 1.e-5f)
-                        break;
                 }
 
                 /* Store the median value */
-                dstp[y * isize.x + x] = vec4(median, srcp[y * isize.x + x].a);
+                dstp[y * isize.x + x] = vec4(weiszfeld(list), srcp[y * isize.x + x].a);
             }
         }
+    });
+}
+
+} // anonymous namespace
+
+old_image old_image::Median(ivec2 ksize) const
+{
+    ivec2 const isize = size();
+    old_image tmp = *this;
+    old_image ret(isize);
+
+    ivec2 const lsize = 2 * ksize + ivec2(1);
+
+    /* The histogram counts are 16-bit, which is enough for radii up to 127 */
+    if (format() == PixelFormat::Y_8 && lsize.x * lsize.y <= 0xffff)
+    {
+        uint8_t *srcp = tmp.lock<PixelFormat::Y_8>();
+        uint8_t *dstp = ret.lock<PixelFormat::Y_8>();
+
+        median_u8(srcp, dstp, isize, ksize);
+
+        tmp.unlock(srcp);
+        ret.unlock(dstp);
+    }
+    else if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
+    {
+        float *srcp = tmp.lock<PixelFormat::Y_F32>();
+        float *dstp = ret.lock<PixelFormat::Y_F32>();
+
+        median_f32(srcp, dstp, isize, ksize);
+
+        tmp.unlock(srcp);
+        ret.unlock(dstp);
+    }
+    else
+    {
+        vec4 *srcp = tmp.lock<PixelFormat::RGBA_F32>();
+        vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
+
+        old_array2d<float> ker(lsize);
+        for (int j = 0; j < lsize.y; ++j)
+            for (int i = 0; i < lsize.x; ++i)
+                ker[i][j] = 1.f;
+
+        median_rgb(srcp, dstp, isize, ker);
 
         tmp.unlock(srcp);
         ret.unlock(dstp);
@@ -166,67 +482,10 @@ old_image old_image::Median(old_array2d<float> const &ker) const
     else
 #endif
     {
-        ivec2 const ksize = ker.sizes();
-        old_array2d<vec3> list(ksize);
-
         vec4 *srcp = tmp.lock<PixelFormat::RGBA_F32>();
         vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
 
-        for (int y = 0; y < isize.y; y++)
-        {
-            for (int x = 0; x < isize.x; x++)
-            {
-                /* Make a list of neighbours */
-                for (int j = 0; j < ksize.y; j++)
-                {
-                    int y2 = y + j - ksize.y / 2;
-                    if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
-                    else if (y2 > 0) y2 = y2 % isize.y;
-
-                    for (int i = 0; i < ksize.x; i++)
-                    {
-                        int x2 = x + i - ksize.x / 2;
-                        if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
-                        else if (x2 > 0) x2 = x2 % isize.x;
-
-                        list[i][j] = srcp[y2 * isize.x + x2].rgb;
-                    }
-                }
-
-                /* Algorithm constants, empirically chosen */
-                int const N = 5;
-                float const K = 1.5f;
-
-                /* Iterate using Weiszfeld’s algorithm */
-                vec3 oldmed(0.f), median(0.f);
-                for (int iter = 0; ; ++iter)
-                {
-                    oldmed = median;
-                    vec3 s1(0.f);
-                    float s2 = 0.f;
-                    for (int j = 0; j < ksize.y; ++j)
-                        for (int i = 0; i < ksize.x; ++i)
-                        {
-                            float d = ker[i][j] /
-                                      (1e-10f + distance(median, list[i][j]));
-                            s1 += list[i][j] * d;
-                            s2 += d;
-                        }
-                    median = s1 / s2;
-
-                    if (iter > 1 && iter < N)
-                    {
-                        median += K * (median - oldmed);
-                    }
-
-                    if (iter > 3 && distance(oldmed, median) < 1.e-5f)
-                        break;
-                }
-
-                /* Store the median value */
-                dstp[y * isize.x + x] = vec4(median, srcp[y * isize.x + x].a);
-            }
-        }
+        median_rgb(srcp, dstp, isize, ker);
 
         tmp.unlock(srcp);
         ret.unlock(dstp);
@@ -236,4 +495,3 @@ old_image old_image::Median(old_array2d<float> const &ker) const
 }
 
 } /* namespace lol */
-
@@ -13,6 +13,8 @@
 #include <lol/engine-internal.h>
 #include <lol/color>
 
+#include "../image-private.h"
+
 /*
  * YUV conversion functions
  */
@@ -23,11 +25,13 @@ namespace lol
 old_image old_image::YUVToRGB() const
 {
     old_image ret = *this;
-    int count = size().x * size().y;
 
     vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
-    for (int n = 0; n < count; ++n)
-        pixels[n] = color::yuv_to_rgb(pixels[n]);
+    parallel_pixels(size(), sizeof(vec4), [&](int n0, int n1)
+    {
+        for (int n = n0; n < n1; ++n)
+            pixels[n] = color::yuv_to_rgb(pixels[n]);
+    });
     ret.unlock(pixels);
 
     return ret;
@@ -36,11 +40,13 @@ old_image old_image::YUVToRGB() const
 old_image old_image::RGBToYUV() const
 {
     old_image ret = *this;
-    int count = size().x * size().y;
 
     vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
-    for (int n = 0; n < count; ++n)
-        pixels[n] = color::rgb_to_yuv(pixels[n]);
+    parallel_pixels(size(), sizeof(vec4), [&](int n0, int n1)
+    {
+        for (int n = n0; n < n1; ++n)
+            pixels[n] = color::rgb_to_yuv(pixels[n]);
+    });
     ret.unlock(pixels);
 
     return ret;
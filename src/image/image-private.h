@@ -12,7 +12,16 @@
 
 #pragma once
 
-#include <map>
+#include <lol/engine/sys> // lol::sys::thread_pool
+
+#include <algorithm> // std::min, std::max
+#include <atomic>    // std::atomic
+#include <cmath>     // std::lround
+#include <cstddef>   // ptrdiff_t
+#include <cstring>   // memcpy
+#include <map>       // std::map
+#include <memory>    // std::shared_ptr, std::unique_ptr
+#include <thread>    // std::this_thread::yield
 
 //
 // The ImageCodecData class
@@ -22,28 +31,53 @@
 namespace lol
 {
 
+/* Pixel memory accounting; see old_image::get_memory_stats() */
+void pixel_memory_add(ptrdiff_t bytes);
+void pixel_memory_evicted(size_t planes);
+void pixel_memory_copied();
+bool pixel_memory_over_budget();
+
 class PixelDataBase
 {
 public:
+    PixelDataBase(size_t bytes) : m_bytes(bytes) { pixel_memory_add(m_bytes); }
+    PixelDataBase(PixelDataBase const &) = delete;
+    inline virtual ~PixelDataBase() { pixel_memory_add(-ptrdiff_t(m_bytes)); }
+
     virtual void *data() = 0;
     virtual void const *data() const = 0;
     virtual void *data2d() = 0;
     virtual void const *data2d() const = 0;
+    virtual PixelDataBase *clone() const = 0;
 
-    inline virtual ~PixelDataBase() {}
+    size_t bytes() const { return m_bytes; }
+
+private:
+    size_t m_bytes;
 };
 
 template<PixelFormat T>
 class PixelData : public PixelDataBase
 {
 public:
-    inline PixelData(ivec2 size) { m_array2d.resize(size); }
+    inline PixelData(ivec2 size)
+      : PixelDataBase(size_t(size.x) * size.y * sizeof(typename PixelType<T>::type))
+    {
+        m_array2d.resize(size);
+    }
 
     virtual void *data() { return m_array2d.data(); }
     virtual void const *data() const { return m_array2d.data(); }
     virtual void *data2d() { return &m_array2d; }
     virtual void const *data2d() const { return &m_array2d; }
 
+    virtual PixelDataBase *clone() const
+    {
+        auto ret = new PixelData<T>(m_array2d.sizes());
+        memcpy(ret->data(), data(), bytes());
+        return ret;
+    }
+
     old_array2d<typename PixelType<T>::type> m_array2d;
 };
 
@@ -59,16 +93,183 @@ public:
         m_format(PixelFormat::Unknown)
     {}
 
+    /* Make sure the current bitplane is not shared with another image
+     * before it gets written to. */
+    PixelDataBase *unshare()
+    {
+        auto &plane = m_pixels[(int)m_format];
+        if (plane.use_count() > 1)
+        {
+            plane.reset(plane->clone());
+            pixel_memory_copied();
+        }
+        return plane.get();
+    }
+
+    /* Release the bitplanes that are not in the current format, or in
+     * the optional extra format. They do not hold anything useful, since
+     * every lock() is a write, but they are kept to avoid reallocations
+     * unless memory is short. */
+    void trim(PixelFormat keep = PixelFormat::Unknown)
+    {
+        size_t planes = 0;
+        for (auto it = m_pixels.begin(); it != m_pixels.end(); )
+        {
+            if (it->first != (int)m_format && it->first != (int)keep)
+            {
+                it = m_pixels.erase(it);
+                ++planes;
+            }
+            else
+                ++it;
+        }
+        if (planes)
+            pixel_memory_evicted(planes);
+    }
+
     ivec2 m_size;
 
     /* The wrap modes for pixel access */
     WrapMode m_wrap_x, m_wrap_y;
 
-    /* A map of the various available bitplanes */
-    std::map<int, PixelDataBase *> m_pixels;
+    /* A map of the various available bitplanes, shared between copies
+     * of an image until one of them is locked for writing */
+    std::map<int, std::shared_ptr<PixelDataBase>> m_pixels;
     /* The last bitplane being accessed for writing */
     PixelFormat m_format;
 };
 
-} /* namespace lol */
+/* Rec. 601 luma coefficients, for all colour to grey conversions */
+static float const luma_r = 0.299f, luma_g = 0.587f, luma_b = 0.114f;
+
+/* Separate float channels for a run of pixels. Grey formats load the
+ * same value in r, g and b, and store r. Formats without alpha load 1. */
+struct channels
+{
+    float *r, *g, *b, *a;
+};
+
+void load_channels(PixelFormat fmt, void const *src, size_t n, size_t count,
+                   channels const &c);
+void store_channels(PixelFormat fmt, void *dst, size_t n, size_t count,
+                    channels const &c);
+
+//
+// Parallel image processing
+// -------------------------
+// Filters split their output into bands of rows and process them on a
+// thread pool. Bands are sized so that the rows they write, plus the halo
+// rows they read above and below, fit in a core’s cache.
+//
+
+/* The pool used by all image filters; see old_image::set_threads() */
+sys::thread_pool &image_thread_pool();
+
+/* Call fn(y0, y1) for bands [y0, y1) covering all the rows of an image
+ * of the given size. Bands may run concurrently, so fn must only write
+ * to the rows it was given and keep any scratch storage local. */
+template<typename F>
+static inline void parallel_rows(ivec2 size, size_t pixel_size, int halo, F const &fn)
+{
+    size_t const cache_size = 256 * 1024;
+    size_t const row_size = std::max(size_t(size.x) * pixel_size, size_t(1));
+
+    int rows = int(cache_size / row_size) - 2 * halo;
+    rows = std::min(std::max(rows, 1), std::max(size.y, 1));
 
+    image_thread_pool().parallel_for(size_t(std::max(size.y, 0)), size_t(rows),
+                                     [&](size_t y0, size_t y1)
+    {
+        fn(int(y0), int(y1));
+    });
+}
+
+/* Call fn(n0, n1) for ranges of pixel indices; for point operations */
+template<typename F>
+static inline void parallel_pixels(ivec2 size, size_t pixel_size, F const &fn)
+{
+    parallel_rows(size, pixel_size, 0, [&](int y0, int y1)
+    {
+        fn(y0 * size.x, y1 * size.x);
+    });
+}
+
+/* Error diffusion on 8-bit images works on 16-bit pixels with 5
+ * fractional bits, and weights with 8 fractional bits. Diffused values
+ * stay well within [-one, 2 × one] for any kernel whose weights sum to
+ * one, so no saturation is needed. */
+struct ediff_fixed
+{
+    static int const bits = 5;
+    static int const one = 255 << bits;
+    static int const half = 255 << (bits - 1);
+
+    static int32_t weight(float w) { return (int32_t)std::lround(w * 256.f); }
+
+    static void add(int16_t &v, int32_t e, int32_t w)
+    {
+        v = int16_t(v + ((e * w + 128) >> 8));
+    }
+
+    /* Dithering is done on a separate 16-bit buffer; the 8-bit pixels
+     * are only written at the end, since byte stores may alias anything
+     * and would slow down the diffusion loop. */
+    static void load(ivec2 size, uint8_t const *src, int16_t *dst);
+    static void store(ivec2 size, int16_t const *src, uint8_t *dst);
+};
+
+/* Call fn(y, n0, n1) for consecutive runs [n0, n1) of the pixels of each
+ * row, counted in scan order. Rows run concurrently, but a row does not
+ * get past pixel n before the row above has processed n + lag pixels,
+ * or all of them if it scans in the other direction. With lag at least
+ * the width of an error diffusion kernel, every pixel receives its error
+ * terms in the same order as in a serial scan, so results are identical
+ * whatever the number of threads. */
+template<typename F>
+static inline void parallel_wavefront(ivec2 size, int lag, ScanMode scan, F const &fn)
+{
+    /* Pixels processed between two progress updates */
+    int const block = 64;
+
+    std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[std::max(size.y, 1)]);
+    for (int y = 0; y < size.y; ++y)
+        progress[y].store(0, std::memory_order_relaxed);
+
+    /* Rows are handed out in order, so the row a thread waits for is
+     * always being processed by another thread, or already done. */
+    std::atomic<int> next_row(0);
+
+    auto &pool = image_thread_pool();
+    pool.parallel_for(size_t(pool.concurrency()), 1, [&](size_t, size_t)
+    {
+        for (int y = next_row++; y < size.y; y = next_row++)
+        {
+            bool const turn = scan == ScanMode::Serpentine;
+
+            for (int n = 0; n < size.x; )
+            {
+                int end = std::min(size.x, n + block);
+
+                if (y > 0)
+                {
+                    int avail;
+                    for (;;)
+                    {
+                        int done = progress[y - 1].load(std::memory_order_acquire);
+                        avail = done == size.x ? size.x : turn ? 0 : done - lag;
+                        if (avail > n)
+                            break;
+                        std::this_thread::yield();
+                    }
+                    end = std::min(end, avail);
+                }
+
+                fn(y, n, end);
+                n = end;
+                progress[y].store(n, std::memory_order_release);
+            }
+        }
+    });
+}
+
+} /* namespace lol */
@@ -16,10 +16,87 @@
 
 #include <cassert>   // assert
 #include <algorithm> // std::swap
+#include <atomic>    // std::atomic
+#include <memory>    // std::unique_ptr
 
 namespace lol
 {
 
+/*
+ * Thread pool for image processing
+ */
+
+static std::unique_ptr<sys::thread_pool> g_image_pool;
+
+sys::thread_pool &image_thread_pool()
+{
+    return g_image_pool ? *g_image_pool : sys::thread_pool::get();
+}
+
+void old_image::set_threads(int count)
+{
+    /* The caller takes part in the work, so it counts as one thread */
+    if (count <= 0)
+        g_image_pool.reset();
+    else
+        g_image_pool = std::make_unique<sys::thread_pool>(count - 1);
+}
+
+/*
+ * Pixel memory accounting
+ */
+
+static std::atomic<size_t> g_pixel_bytes(0), g_pixel_peak(0);
+static std::atomic<uint64_t> g_pixel_copies(0), g_pixel_evictions(0);
+static std::atomic<size_t> g_pixel_budget(size_t(512) << 20);
+
+void pixel_memory_add(ptrdiff_t bytes)
+{
+    size_t total = g_pixel_bytes += size_t(bytes);
+    size_t peak = g_pixel_peak;
+    while (total > peak && !g_pixel_peak.compare_exchange_weak(peak, total))
+        ;
+}
+
+void pixel_memory_evicted(size_t planes)
+{
+    g_pixel_evictions += planes;
+}
+
+void pixel_memory_copied()
+{
+    ++g_pixel_copies;
+}
+
+bool pixel_memory_over_budget()
+{
+    return g_pixel_bytes > g_pixel_budget;
+}
+
+old_image::memory_stats old_image::get_memory_stats()
+{
+    return memory_stats{ g_pixel_bytes, g_pixel_peak,
+                         g_pixel_copies, g_pixel_evictions };
+}
+
+void old_image::set_memory_budget(size_t bytes)
+{
+    g_pixel_budget = bytes;
+}
+
+size_t old_image::memory_usage() const
+{
+    size_t ret = 0;
+    for (auto const &kv : m_data->m_pixels)
+        ret += kv.second->bytes();
+    return ret;
+}
+
+void old_image::trim()
+{
+    m_data->trim();
+}
+
 /*
  * Public old_image class
  */
@@ -57,9 +134,6 @@ old_image & old_image::operator =(old_image other)
 
 old_image::~old_image()
 {
-    for (auto &kv : m_data->m_pixels)
-        delete kv.second;
-
     delete m_data;
 }
 
@@ -68,8 +142,9 @@ void old_image::Copy(uint8_t* src_pixels, ivec2 const& size, PixelFormat fmt)
     assert(fmt != PixelFormat::Unknown);
     resize(size);
     set_format(fmt);
-    memcpy(m_data->m_pixels[(int)fmt]->data(), src_pixels,
-            size.x * size.y * BytesPerPixel(fmt));
+    void *dst = lock();
+    memcpy(dst, src_pixels, size.x * size.y * BytesPerPixel(fmt));
+    unlock(dst);
 }
 
 void old_image::Copy(old_image const &src)
@@ -77,14 +152,13 @@ void old_image::Copy(old_image const &src)
     ivec2 size = src.size();
     PixelFormat fmt = src.format();
 
+    /* Only the current bitplane holds useful data; share it until one
+     * of the images is locked. */
     resize(size);
+    m_data->m_pixels.clear();
+    m_data->m_format = fmt;
     if (fmt != PixelFormat::Unknown)
-    {
-        set_format(fmt);
-        memcpy(m_data->m_pixels[(int)fmt]->data(),
-            src.m_data->m_pixels[(int)fmt]->data(),
-            size.x * size.y * BytesPerPixel(fmt));
-    }
+        m_data->m_pixels[(int)fmt] = src.m_data->m_pixels[(int)fmt];
 }
 
 void old_image::DummyFill()
@@ -130,8 +204,6 @@ void old_image::resize(ivec2 size)
 
     if (m_data->m_size != size)
     {
-        for (auto &kv : m_data->m_pixels)
-            delete kv.second;
         m_data->m_pixels.clear();
         m_data->m_format = PixelFormat::Unknown;
     }
@@ -161,7 +233,7 @@ template<PixelFormat T> typename PixelType<T>::type *old_image::lock()
 {
     set_format(T);
 
-    return (typename PixelType<T>::type *)m_data->m_pixels[(int)T]->data();
+    return (typename PixelType<T>::type *)m_data->unshare()->data();
 }
 
 /* The lock2d() method */
@@ -169,7 +241,7 @@ void *old_image::lock2d_helper(PixelFormat T)
 {
     set_format(T);
 
-    return m_data->m_pixels[(int)T]->data2d();
+    return m_data->unshare()->data2d();
 }
 
 template<typename T>
@@ -197,7 +269,7 @@ void *old_image::lock()
 {
     assert(m_data->m_format != PixelFormat::Unknown);
 
-    return m_data->m_pixels[(int)m_data->m_format]->data();
+    return m_data->unshare()->data();
 }
 
 void old_image::unlock(void const *pixels)
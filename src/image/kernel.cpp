@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,6 +12,22 @@
 
 #include <lol/engine-internal.h>
 
+#include <atomic>  // std::atomic
+#include <cstdint> // uint32_t, uint64_t
+#include <cstdio>  // fopen, snprintf
+#include <cstring> // memcmp
+#if !defined _LIBCPP_HAS_NO_FILESYSTEM_LIBRARY && !defined _LIBCPP_AVAILABILITY_HAS_NO_FILESYSTEM_LIBRARY
+#   include <filesystem> // std::filesystem::path
+#endif
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#if _WIN32
+#   include <process.h> // _getpid
+#else
+#   include <unistd.h>  // getpid
+#endif
+
 /*
  * Stock kernels
  */
@@ -77,100 +93,367 @@ old_array2d<float> old_image::kernel::halftone(ivec2 size)
     return normalize(ret);
 }
 
-old_array2d<float> old_image::kernel::blue_noise(ivec2 size, ivec2 gsize)
+/*
+ * Blue noise using Ulichney’s void-and-cluster method
+ *
+ * Every pixel has an energy: the sum of a Gaussian splatted around each
+ * dot. The tightest cluster is the dot with the highest energy, and the
+ * largest void is the empty pixel with the lowest energy. Dots and empty
+ * pixels are kept in two indexed heaps ordered by energy, so that placing
+ * a dot only costs a heap update for each pixel under the Gaussian,
+ * instead of a scan of the whole image.
+ */
+
+class energy_heap
 {
-    float const epsilon = 1.f / (size.x * size.y + 1);
-    gsize = lol::min(size, gsize);
+public:
+    /* mul is 1 to keep the highest energy on top, -1 for the lowest */
+    energy_heap(std::vector<float> const &energy, float mul)
+      : m_energy(energy),
+        m_pos(energy.size(), -1),
+        m_mul(mul)
+    {}
+
+    bool empty() const { return m_heap.empty(); }
+    int top() const { return m_heap[0]; }
+    bool contains(int n) const { return m_pos[n] >= 0; }
+
+    void clear()
+    {
+        for (int n : m_heap)
+            m_pos[n] = -1;
+        m_heap.clear();
+    }
 
-    old_array2d<float> ret(size);
-    old_array2d<vec2> dots(size);
+    void push(int n)
+    {
+        m_pos[n] = (int)m_heap.size();
+        m_heap.push_back(n);
+        up(m_pos[n]);
+    }
+
+    void remove(int n)
+    {
+        int i = m_pos[n];
+        int last = m_heap.back();
+        m_heap.pop_back();
+        m_pos[n] = -1;
+        if (last != n)
+        {
+            place(i, last);
+            update(last);
+        }
+    }
+
+    /* Call after the energy of n has changed */
+    void update(int n)
+    {
+        int i = m_pos[n];
+        if (i > 0 && before(n, m_heap[(i - 1) / 2]))
+            up(i);
+        else
+            down(i);
+    }
+
+private:
+    /* Ties go to the lowest index, which is what a raster scan would find */
+    bool before(int a, int b) const
+    {
+        float ka = m_energy[a] * m_mul, kb = m_energy[b] * m_mul;
+        return ka > kb || (ka == kb && a < b);
+    }
+
+    void place(int i, int n)
+    {
+        m_heap[i] = n;
+        m_pos[n] = i;
+    }
+
+    void up(int i)
+    {
+        int n = m_heap[i];
+        while (i > 0 && before(n, m_heap[(i - 1) / 2]))
+        {
+            place(i, m_heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, n);
+    }
+
+    void down(int i)
+    {
+        int const count = (int)m_heap.size();
+        int n = m_heap[i];
+        for (;;)
+        {
+            int child = 2 * i + 1;
+            if (child >= count)
+                break;
+            if (child + 1 < count && before(m_heap[child + 1], m_heap[child]))
+                ++child;
+            if (!before(m_heap[child], n))
+                break;
+            place(i, m_heap[child]);
+            i = child;
+        }
+        place(i, n);
+    }
+
+    std::vector<float> const &m_energy;
+    std::vector<int> m_heap, m_pos;
+    float m_mul;
+};
+
+static old_array2d<float> make_blue_noise(ivec2 size, ivec2 gsize, uint32_t seed)
+{
+    int const count = size.x * size.y;
+    float const epsilon = 1.f / (count + 1);
 
     /* Create a small Gaussian kernel for filtering */
-    old_array2d<float> gaussian(gsize);
+    std::vector<float> gaussian(gsize.x * gsize.y);
     for (int j = 0; j < gsize.y; ++j)
     for (int i = 0; i < gsize.x; ++i)
     {
         ivec2 const distance = gsize / 2 - ivec2(i, j);
-        gaussian[i][j] = lol::exp(-lol::sqlength(distance)
-                                    / (0.05f * gsize.x * gsize.y));
+        gaussian[j * gsize.x + i] = lol::exp(-lol::sqlength(distance)
+                                               / (0.05f * gsize.x * gsize.y));
     }
 
-    /* Helper function to find voids and clusters */
-    auto setdot = [&] (ivec2 pos, float val)
+    std::vector<float> energy(count, 0.f);
+    std::vector<uint8_t> dots(count, 0);
+    energy_heap clusters(energy, 1.f), voids(energy, -1.f);
+
+    /* Add or remove a dot, and fix the heaps for every pixel whose
+     * energy changed */
+    auto setdot = [&](int n, bool on)
     {
-        float const delta = val - dots[pos][0];
-        dots[pos][0] = val;
+        dots[n] = on;
+        float const delta = on ? 1.f : -1.f;
+        int const x0 = n % size.x - gsize.x / 2 + size.x;
+        int const y0 = n / size.x - gsize.y / 2 + size.y;
 
         for (int j = 0; j < gsize.y; ++j)
-        for (int i = 0; i < gsize.x; ++i)
-            dots[(pos.x + i - gsize.x / 2 + size.x) % size.x]
-                [(pos.y + j - gsize.y / 2 + size.y) % size.y]
-                [1] += gaussian[i][j] * delta;
-    };
-
-    auto best = [&] (float val, float mul) -> ivec2
-    {
-        float maxval = -(float)(size.x * size.y);
-        ivec2 coord(0, 0);
-        for (int y = 0; y < size.y; ++y)
-        for (int x = 0; x < size.x; ++x)
         {
-            if (dots[x][y][0] != val)
-                continue;
-
-            float total = dots[x][y][1];
-            if (total * mul > maxval)
+            int const row = (y0 + j) % size.y * size.x;
+            for (int i = 0; i < gsize.x; ++i)
             {
-                maxval = total * mul;
-                coord = ivec2(x, y);
+                int const m = row + (x0 + i) % size.x;
+                energy[m] += gaussian[j * gsize.x + i] * delta;
+                if (clusters.contains(m))
+                    clusters.update(m);
+                else if (voids.contains(m))
+                    voids.update(m);
             }
         }
+    };
 
-        return coord;
+    /* Generate an array with about 10% random dots. The generator is ours
+     * rather than lol::rand() so that a seed always gives the same kernel,
+     * whatever the platform. */
+    uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+    auto next = [&](int range) -> int
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (int)((state >> 33) % (uint64_t)range);
     };
 
-    /* Generate an array with about 10% random dots */
-    int const ndots = (size.x * size.y + 9) / 10;
-    memset((void *)dots.data(), 0, dots.bytes());
-    for (int n = 0; n < ndots; )
+    int const ndots = (count + 9) / 10;
+    for (int placed = 0; placed < ndots; )
     {
-        ivec2 pos(lol::rand(size.x), lol::rand(size.y));
-        if (dots[pos][0])
+        int n = next(count);
+        if (dots[n])
             continue;
-        setdot(ivec2(pos), 1.0f);
-        ++n;
+        setdot(n, true);
+        ++placed;
     }
 
-    /* Rearrange 1s so that they occupy the largest voids */
+    for (int n = 0; n < count; ++n)
+    {
+        if (dots[n])
+            clusters.push(n);
+        else
+            voids.push(n);
+    }
+
+    /* Move dots from the tightest clusters to the largest voids until the
+     * pattern is stable */
     for (;;)
     {
-        ivec2 bestcluster = best(1.0f, 1.0f);
-        setdot(bestcluster, 0.0f);
-        ivec2 bestvoid = best(0.0f, -1.0f);
-        setdot(bestvoid, 1.0f);
-        if (bestcluster == bestvoid)
+        int cluster = clusters.top();
+        clusters.remove(cluster);
+        voids.push(cluster);
+        setdot(cluster, false);
+
+        int hole = voids.top();
+        voids.remove(hole);
+        clusters.push(hole);
+        setdot(hole, true);
+
+        if (cluster == hole)
             break;
     }
 
-    /* Reorder all 1s and replace them with 0.0001 */
-    for (int n = ndots; n--; )
+    std::vector<float> const proto_energy = energy;
+    std::vector<uint8_t> const proto_dots = dots;
+
+    old_array2d<float> ret(size);
+
+    /* Rank the dots by removing the tightest cluster each time */
+    voids.clear();
+    for (int rank = ndots; rank--; )
     {
-        ivec2 bestcluster = best(1.0f, 1.0f);
-        ret[bestcluster] = (n + 1.0f) * epsilon;
-        setdot(bestcluster, 0.0001f);
+        int cluster = clusters.top();
+        clusters.remove(cluster);
+        setdot(cluster, false);
+        ret[cluster % size.x][cluster / size.x] = (rank + 1.f) * epsilon;
     }
 
-    /* Reorder all 0s and replace them with 0.0001 */
-    for (int n = ndots; n < size.x * size.y; ++n)
+    /* Go back to the prototype and rank the remaining pixels by filling
+     * the largest void each time */
+    energy = proto_energy;
+    dots = proto_dots;
+    for (int n = 0; n < count; ++n)
+        if (!dots[n])
+            voids.push(n);
+
+    for (int rank = ndots; rank < count; ++rank)
     {
-        ivec2 bestvoid = best(0.0f, -1.0f);
-        ret[bestvoid] = (n + 1.0f) * epsilon;
-        setdot(bestvoid, 0.0001f);
+        int hole = voids.top();
+        voids.remove(hole);
+        setdot(hole, true);
+        ret[hole % size.x][hole / size.x] = (rank + 1.f) * epsilon;
     }
 
     return ret;
 }
 
+/*
+ * Kernel cache
+ *
+ * Generated kernels are stored as raw floats after a small header that
+ * repeats the generation parameters; any mismatch means regenerating.
+ */
+
+#if !defined _LIBCPP_HAS_NO_FILESYSTEM_LIBRARY && !defined _LIBCPP_AVAILABILITY_HAS_NO_FILESYSTEM_LIBRARY
+#   define LOL_KERNEL_CACHE 1
+#endif
+
+static std::string g_cache_dir;
+static bool g_cache_dir_set = false;
+
+void old_image::kernel::set_cache_dir(std::string const &dir)
+{
+    g_cache_dir = dir;
+    g_cache_dir_set = true;
+}
+
+#if LOL_KERNEL_CACHE
+static std::filesystem::path cache_dir()
+{
+    if (g_cache_dir_set)
+        return g_cache_dir;
+
+    std::error_code ec;
+    auto tmp = std::filesystem::temp_directory_path(ec);
+    return ec ? std::filesystem::path() : tmp / "lol-kernels";
+}
+
+static char const cache_magic[8] = { 'L', 'O', 'L', 'K', 'E', 'R', 'N', '1' };
+
+static bool load_cached(std::filesystem::path const &path,
+                        int32_t const (&params)[5], old_array2d<float> &ret)
+{
+    FILE *fp = fopen(path.string().c_str(), "rb");
+    if (!fp)
+        return false;
+
+    char magic[8];
+    int32_t header[5];
+    size_t const count = size_t(params[0]) * params[1];
+    std::vector<float> values(count);
+    bool ok = fread(magic, sizeof(magic), 1, fp) == 1
+           && fread(header, sizeof(header), 1, fp) == 1
+           && memcmp(magic, cache_magic, sizeof(magic)) == 0
+           && memcmp(header, params, sizeof(header)) == 0
+           && fread(values.data(), sizeof(float), count, fp) == count;
+    fclose(fp);
+
+    if (!ok)
+        return false;
+
+    for (size_t n = 0; n < count; ++n)
+        ret[int(n % params[0])][int(n / params[0])] = values[n];
+    return true;
+}
+
+static void save_cached(std::filesystem::path const &path,
+                        int32_t const (&params)[5], old_array2d<float> const &kernel)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    size_t const count = size_t(params[0]) * params[1];
+    std::vector<float> values(count);
+    for (size_t n = 0; n < count; ++n)
+        values[n] = kernel[int(n % params[0])][int(n / params[0])];
+
+    /* Write to a temporary file first so that concurrent tools never
+     * read a partial kernel. The name is unique to this process and call,
+     * so that writers never share a file. */
+    static std::atomic<unsigned> counter = 0;
+#if _WIN32
+    unsigned const pid = (unsigned)_getpid();
+#else
+    unsigned const pid = (unsigned)getpid();
+#endif
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%u-%u.tmp", pid, counter++);
+    auto tmp = path;
+    tmp += suffix;
+    FILE *fp = fopen(tmp.string().c_str(), "wb");
+    if (!fp)
+        return;
+
+    bool ok = fwrite(cache_magic, sizeof(cache_magic), 1, fp) == 1
+           && fwrite(params, sizeof(params), 1, fp) == 1
+           && fwrite(values.data(), sizeof(float), count, fp) == count;
+    ok = fclose(fp) == 0 && ok;
+
+    if (ok)
+        std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec)
+        std::filesystem::remove(tmp, ec);
+}
+#endif
+
+old_array2d<float> old_image::kernel::blue_noise(ivec2 size, ivec2 gsize,
+                                                 uint32_t seed)
+{
+    gsize = lol::min(size, gsize);
+
+#if LOL_KERNEL_CACHE
+    auto dir = cache_dir();
+    if (dir.empty())
+        return make_blue_noise(size, gsize, seed);
+
+    char name[64];
+    snprintf(name, sizeof(name), "blue-noise-%dx%d-%dx%d-%u.bin",
+             size.x, size.y, gsize.x, gsize.y, (unsigned)seed);
+    auto path = dir / name;
+    int32_t const params[5] = { size.x, size.y, gsize.x, gsize.y, (int32_t)seed };
+
+    old_array2d<float> cached(size);
+    if (load_cached(path, params, cached))
+        return cached;
+
+    auto ret = make_blue_noise(size, gsize, seed);
+    save_cached(path, params, ret);
+    return ret;
+#else
+    return make_blue_noise(size, gsize, seed);
+#endif
+}
+
 struct Dot
 {
     int x, y;
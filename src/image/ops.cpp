@@ -0,0 +1,426 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include "image-private.h"
+
+#include <algorithm> // std::min, std::max
+#include <cassert>   // assert
+#include <cmath>     // std::fabs
+#include <mutex>     // std::mutex
+
+/*
+ * Lazy point operations
+ *
+ * Pixels are processed in chunks small enough for their float channels
+ * to stay in the L1 cache: each chunk is loaded from the source planes,
+ * goes through every operation of the chain, and is stored in the
+ * destination plane. The loops work on whole chunks so that the compiler
+ * can vectorise them.
+ */
+
+namespace lol
+{
+
+class pixel_ops_impl
+{
+public:
+    typedef old_image::pixel_ops::op op;
+    typedef old_image::pixel_ops::op_type op_type;
+
+    /* A planar view of one image */
+    struct plane
+    {
+        PixelFormat format;
+        void const *data;
+    };
+
+    /* An operation with everything needed to run it */
+    struct step
+    {
+        op o;
+        plane other;
+        bool grey_in, grey_out;
+    };
+
+    static int const CHUNK = 256;
+
+    struct chunk
+    {
+        alignas(16) float r[CHUNK], g[CHUNK], b[CHUNK], a[CHUNK];
+
+        /* The loops always run on whole chunks, so never leave garbage
+         * values in the unused part of the last one. */
+        chunk()
+        {
+            std::fill(r, r + CHUNK, 0.f);
+            std::fill(g, g + CHUNK, 0.f);
+            std::fill(b, b + CHUNK, 0.f);
+            std::fill(a, a + CHUNK, 0.f);
+        }
+
+        channels get() { return channels{ r, g, b, a }; }
+    };
+
+    static bool is_grey(PixelFormat fmt)
+    {
+        return fmt == PixelFormat::Y_8 || fmt == PixelFormat::Y_F32;
+    }
+
+    static plane get_plane(old_image const &im)
+    {
+        PixelFormat fmt = im.m_data->m_format;
+        return plane{ fmt, im.m_data->m_pixels[(int)fmt]->data() };
+    }
+
+    static old_image eval(old_image::pixel_ops const &ops);
+
+private:
+    static void run(step const &s, chunk &c, chunk &tmp, size_t n, size_t count);
+    static void run(std::vector<step> const &steps, size_t end, plane src,
+                    chunk &c, chunk &tmp, size_t n, size_t count);
+
+    template<typename F>
+    static void unary(chunk &c, bool grey, F const &f)
+    {
+        for (int i = 0; i < CHUNK; ++i)
+            c.r[i] = f(c.r[i]);
+        if (grey)
+            return;
+        for (int i = 0; i < CHUNK; ++i)
+            c.g[i] = f(c.g[i]);
+        for (int i = 0; i < CHUNK; ++i)
+            c.b[i] = f(c.b[i]);
+    }
+
+    /* Binary operations also apply to alpha, like the old vec4 code */
+    template<typename F>
+    static void binary(chunk &c, chunk const &d, bool grey, F const &f)
+    {
+        for (int i = 0; i < CHUNK; ++i)
+            c.r[i] = f(c.r[i], d.r[i]);
+        if (grey)
+            return;
+        for (int i = 0; i < CHUNK; ++i)
+            c.g[i] = f(c.g[i], d.g[i]);
+        for (int i = 0; i < CHUNK; ++i)
+            c.b[i] = f(c.b[i], d.b[i]);
+        for (int i = 0; i < CHUNK; ++i)
+            c.a[i] = f(c.a[i], d.a[i]);
+    }
+};
+
+void pixel_ops_impl::run(step const &s, chunk &c, chunk &tmp, size_t n, size_t count)
+{
+    using std::min, std::max;
+
+    /* Going from grey to colour only needs the other channels filled;
+     * alpha is already 1. Going to grey only happens in Threshold. */
+    if (s.grey_in && !s.grey_out)
+    {
+        std::copy(c.r, c.r + CHUNK, c.g);
+        std::copy(c.r, c.r + CHUNK, c.b);
+    }
+
+    if (s.other.data)
+        load_channels(s.other.format, s.other.data, n, count, tmp.get());
+
+    bool const grey = s.grey_out;
+    vec3 const val = s.o.val;
+
+    switch (s.o.type)
+    {
+    case op_type::AutoContrast:
+        /* val holds the minimum and the scale, computed by eval() */
+        unary(c, grey, [=](float x) { return (x - val.x) * val.y; });
+        break;
+    case op_type::Affine:
+        if (val.z != 0.f)
+            unary(c, grey, [=](float x) { return min(max(x * val.x + val.y, 0.f), 1.f); });
+        else
+            unary(c, grey, [=](float x) { return x * val.x + val.y; });
+        break;
+    case op_type::Invert:
+        unary(c, grey, [](float x) { return 1.f - x; });
+        break;
+    case op_type::Threshold:
+        if (!s.grey_in)
+        {
+            for (int i = 0; i < CHUNK; ++i)
+                c.r[i] = luma_r * c.r[i] + luma_g * c.g[i] + luma_b * c.b[i];
+        }
+        for (int i = 0; i < CHUNK; ++i)
+            c.r[i] = c.r[i] > val.x ? 1.f : 0.f;
+        break;
+    case op_type::ThresholdRGB:
+        for (int i = 0; i < CHUNK; ++i)
+            c.r[i] = c.r[i] > val.r ? 1.f : 0.f;
+        for (int i = 0; i < CHUNK; ++i)
+            c.g[i] = c.g[i] > val.g ? 1.f : 0.f;
+        for (int i = 0; i < CHUNK; ++i)
+            c.b[i] = c.b[i] > val.b ? 1.f : 0.f;
+        break;
+    case op_type::Mix:
+        binary(c, tmp, grey, [=](float x, float y) { return x + (y - x) * val.x; });
+        break;
+    case op_type::Min:
+        binary(c, tmp, grey, [](float x, float y) { return min(x, y); });
+        break;
+    case op_type::Max:
+        binary(c, tmp, grey, [](float x, float y) { return max(x, y); });
+        break;
+    case op_type::Overlay:
+        binary(c, tmp, grey, [](float x, float y) { return x * (x + 2.f * y * (1.f - x)); });
+        break;
+    case op_type::Screen:
+        binary(c, tmp, grey, [](float x, float y) { return x + y - x * y; });
+        break;
+    case op_type::Multiply:
+        binary(c, tmp, grey, [](float x, float y) { return x * y; });
+        break;
+    case op_type::Divide:
+        binary(c, tmp, grey, [](float x, float y) { return x / (max(x, y) + 1e-8f); });
+        break;
+    case op_type::Add:
+        binary(c, tmp, grey, [](float x, float y) { return min(x + y, 1.f); });
+        break;
+    case op_type::Sub:
+        binary(c, tmp, grey, [](float x, float y) { return max(x - y, 0.f); });
+        break;
+    case op_type::Difference:
+        binary(c, tmp, grey, [](float x, float y) { return std::fabs(x - y); });
+        break;
+    }
+}
+
+/* Load a chunk of the source and run the first steps on it */
+void pixel_ops_impl::run(std::vector<step> const &steps, size_t end, plane src,
+                         chunk &c, chunk &tmp, size_t n, size_t count)
+{
+    load_channels(src.format, src.data, n, count, c.get());
+    for (size_t i = 0; i < end; ++i)
+        run(steps[i], c, tmp, n, count);
+}
+
+old_image pixel_ops_impl::eval(old_image::pixel_ops const &ops)
+{
+    old_image const &src = ops.m_src;
+    ivec2 const size = src.size();
+
+    if (src.format() == PixelFormat::Unknown)
+        return src;
+
+    /* Work out which steps happen in greyscale */
+    std::vector<step> steps;
+    bool grey = is_grey(src.format());
+    for (auto const &o : ops.m_ops)
+    {
+        step s { o, plane{ PixelFormat::Unknown, nullptr }, grey, grey };
+        if (o.other)
+        {
+            assert(o.other->size() == size);
+            s.other = get_plane(*o.other);
+            s.grey_out = grey && is_grey(s.other.format);
+        }
+        else if (o.type == op_type::Threshold)
+            s.grey_out = true;
+        else if (o.type == op_type::ThresholdRGB)
+            s.grey_out = false;
+        grey = s.grey_out;
+        steps.push_back(s);
+    }
+
+    plane const in = get_plane(src);
+
+    /* Auto contrast needs the range of the values it sees, which means
+     * running the previous steps once without storing anything. */
+    for (size_t k = 0; k < steps.size(); ++k)
+    {
+        if (steps[k].o.type != op_type::AutoContrast)
+            continue;
+
+        float min_val = 1.f, max_val = 0.f;
+        std::mutex lock;
+
+        parallel_pixels(size, sizeof(vec4), [&](int n0, int n1)
+        {
+            chunk c, tmp;
+            float band_min = 1.f, band_max = 0.f;
+            for (size_t n = size_t(n0); n < size_t(n1); n += CHUNK)
+            {
+                size_t m = std::min(size_t(n1) - n, size_t(CHUNK));
+                run(steps, k, in, c, tmp, n, m);
+                for (float const *p : { c.r, c.g, c.b })
+                {
+                    for (size_t i = 0; i < m; ++i)
+                    {
+                        band_min = std::min(band_min, p[i]);
+                        band_max = std::max(band_max, p[i]);
+                    }
+                    if (steps[k].grey_in)
+                        break;
+                }
+            }
+
+            std::unique_lock<std::mutex> l(lock);
+            min_val = std::min(min_val, band_min);
+            max_val = std::max(max_val, band_max);
+        });
+
+        float t = max_val > min_val ? 1.f / (max_val - min_val) : 1.f;
+        steps[k].o.val = vec3(min_val, t, 0.f);
+    }
+
+    PixelFormat const fmt = grey ? PixelFormat::Y_F32 : PixelFormat::RGBA_F32;
+    old_image dst(size);
+    dst.set_format(fmt);
+    void *out = dst.lock();
+
+    parallel_pixels(size, sizeof(vec4), [&](int n0, int n1)
+    {
+        chunk c, tmp;
+        for (size_t n = size_t(n0); n < size_t(n1); n += CHUNK)
+        {
+            size_t m = std::min(size_t(n1) - n, size_t(CHUNK));
+            run(steps, steps.size(), in, c, tmp, n, m);
+            store_channels(fmt, out, n, m, c.get());
+        }
+    });
+
+    dst.unlock(out);
+    return dst;
+}
+
+/*
+ * Public pixel_ops class
+ */
+
+old_image::pixel_ops old_image::ops() const
+{
+    return pixel_ops(*this);
+}
+
+old_image::pixel_ops::pixel_ops(old_image const &src)
+  : m_src(src)
+{
+}
+
+old_image::pixel_ops &old_image::pixel_ops::push(op_type type, vec3 val,
+                                                 old_image const *other)
+{
+    m_ops.push_back(op{ type, val, other });
+    return *this;
+}
+
+/*
+ * TODO: the current approach is naive; we should use the histogram in order
+ * to decide how to change the contrast.
+ */
+old_image::pixel_ops &old_image::pixel_ops::auto_contrast()
+{
+    return push(op_type::AutoContrast, vec3(0.f));
+}
+
+old_image::pixel_ops &old_image::pixel_ops::brightness(float val)
+{
+    return push(op_type::Affine, vec3(1.f, val, 1.f));
+}
+
+old_image::pixel_ops &old_image::pixel_ops::contrast(float val)
+{
+    if (val >= 0.f)
+    {
+        if (val > 0.99999f)
+            val = 0.99999f;
+
+        val = 1.f / (1.f - val);
+    }
+    else
+    {
+        val = lol::clamp(1.f + val, 0.f, 1.f);
+    }
+
+    return push(op_type::Affine, vec3(val, -0.5f * val + 0.5f, 1.f));
+}
+
+old_image::pixel_ops &old_image::pixel_ops::invert()
+{
+    return push(op_type::Invert, vec3(0.f));
+}
+
+old_image::pixel_ops &old_image::pixel_ops::threshold(float val)
+{
+    return push(op_type::Threshold, vec3(val));
+}
+
+old_image::pixel_ops &old_image::pixel_ops::threshold(vec3 val)
+{
+    return push(op_type::ThresholdRGB, val);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::mix(old_image const &other, float alpha)
+{
+    return push(op_type::Mix, vec3(alpha), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::min(old_image const &other)
+{
+    return push(op_type::Min, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::max(old_image const &other)
+{
+    return push(op_type::Max, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::overlay(old_image const &other)
+{
+    return push(op_type::Overlay, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::screen(old_image const &other)
+{
+    return push(op_type::Screen, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::multiply(old_image const &other)
+{
+    return push(op_type::Multiply, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::divide(old_image const &other)
+{
+    return push(op_type::Divide, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::add(old_image const &other)
+{
+    return push(op_type::Add, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::sub(old_image const &other)
+{
+    return push(op_type::Sub, vec3(0.f), &other);
+}
+
+old_image::pixel_ops &old_image::pixel_ops::difference(old_image const &other)
+{
+    return push(op_type::Difference, vec3(0.f), &other);
+}
+
+old_image old_image::pixel_ops::eval() const
+{
+    return pixel_ops_impl::eval(*this);
+}
+
+} /* namespace lol */
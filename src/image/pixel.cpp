@@ -13,50 +13,661 @@
 #include <lol/engine-internal.h>
 
 #include <lol/msg>
+#include <algorithm> // std::min, std::max
 #include <cassert>
+#include <cstring> // memcpy
 
 #include "image-private.h"
 
 namespace lol
 {
 
-static float u8tof32(uint8_t pixel)
+/*
+ * Pixel conversion kernels
+ *
+ * Every conversion goes through the same three steps: load pixels as float
+ * r, g, b, a channels, compute the luma when going from colour to grey,
+ * and store the channels in the destination format. Loading and storing
+ * are specialised for each format, so converting never needs an
+ * intermediate plane. The SIMD versions handle 8 pixels at a time and
+ * perform the same operations, in the same order, as the scalar version.
+ */
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define LOL_PIXEL_SSE2 1
+#elif defined __ARM_NEON && defined __aarch64__
+#   include <arm_neon.h>
+#   define LOL_PIXEL_NEON 1
+#endif
+
+namespace
+{
+
+//
+// Scalar pixel access
+//
+
+inline float u8tof32(uint8_t x)
 {
-    //return pow((float)pixel / 255.f, global_gamma);
-    return pixel / 255.f;
+    //return pow((float)x / 255.f, global_gamma);
+    return x / 255.f;
 }
 
-static vec4 u8tof32(u8vec4 pixel)
+inline uint8_t f32tou8(float x)
 {
-    //vec4 ret;
-    //ret.r = pow((float)pixel.r / 255.f, global_gamma);
-    //ret.g = pow((float)pixel.g / 255.f, global_gamma);
-    //ret.b = pow((float)pixel.b / 255.f, global_gamma);
-    return (vec4)pixel / 255.f;
+    return (uint8_t)std::min(std::max(x * 255.99f, 0.f), 255.f);
 }
 
-static vec3 u8tof32(u8vec3 pixel)
+template<PixelFormat F> struct pixel_io;
+
+template<> struct pixel_io<PixelFormat::Y_8>
+{
+    static bool const grey = true;
+
+    static inline void load(void const *p, size_t n, float &r, float &g, float &b, float &a)
+    {
+        r = g = b = u8tof32(((uint8_t const *)p)[n]);
+        a = 1.f;
+    }
+
+    static inline void store(void *p, size_t n, float r, float, float, float)
+    {
+        ((uint8_t *)p)[n] = f32tou8(r);
+    }
+};
+
+template<> struct pixel_io<PixelFormat::RGB_8>
+{
+    static bool const grey = false;
+
+    static inline void load(void const *p, size_t n, float &r, float &g, float &b, float &a)
+    {
+        uint8_t const *src = (uint8_t const *)p + 3 * n;
+        r = u8tof32(src[0]);
+        g = u8tof32(src[1]);
+        b = u8tof32(src[2]);
+        a = 1.f;
+    }
+
+    static inline void store(void *p, size_t n, float r, float g, float b, float)
+    {
+        uint8_t *dst = (uint8_t *)p + 3 * n;
+        dst[0] = f32tou8(r);
+        dst[1] = f32tou8(g);
+        dst[2] = f32tou8(b);
+    }
+};
+
+template<> struct pixel_io<PixelFormat::RGBA_8>
+{
+    static bool const grey = false;
+
+    static inline void load(void const *p, size_t n, float &r, float &g, float &b, float &a)
+    {
+        uint8_t const *src = (uint8_t const *)p + 4 * n;
+        r = u8tof32(src[0]);
+        g = u8tof32(src[1]);
+        b = u8tof32(src[2]);
+        a = u8tof32(src[3]);
+    }
+
+    static inline void store(void *p, size_t n, float r, float g, float b, float a)
+    {
+        uint8_t *dst = (uint8_t *)p + 4 * n;
+        dst[0] = f32tou8(r);
+        dst[1] = f32tou8(g);
+        dst[2] = f32tou8(b);
+        dst[3] = f32tou8(a);
+    }
+};
+
+template<> struct pixel_io<PixelFormat::Y_F32>
+{
+    static bool const grey = true;
+
+    static inline void load(void const *p, size_t n, float &r, float &g, float &b, float &a)
+    {
+        r = g = b = ((float const *)p)[n];
+        a = 1.f;
+    }
+
+    static inline void store(void *p, size_t n, float r, float, float, float)
+    {
+        ((float *)p)[n] = r;
+    }
+};
+
+template<> struct pixel_io<PixelFormat::RGB_F32>
 {
-    //vec3 ret;
-    //ret.r = pow((float)pixel.r / 255.f, global_gamma);
-    //ret.g = pow((float)pixel.g / 255.f, global_gamma);
-    //ret.b = pow((float)pixel.b / 255.f, global_gamma);
-    return (vec3)pixel / 255.f;
+    static bool const grey = false;
+
+    static inline void load(void const *p, size_t n, float &r, float &g, float &b, float &a)
+    {
+        float const *src = (float const *)p + 3 * n;
+        r = src[0];
+        g = src[1];
+        b = src[2];
+        a = 1.f;
+    }
+
+    static inline void store(void *p, size_t n, float r, float g, float b, float)
+    {
+        float *dst = (float *)p + 3 * n;
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+    }
+};
+
+template<> struct pixel_io<PixelFormat::RGBA_F32>
+{
+    static bool const grey = false;
+
+    static inline void load(void const *p, size_t n, float &r, float &g, float &b, float &a)
+    {
+        float const *src = (float const *)p + 4 * n;
+        r = src[0];
+        g = src[1];
+        b = src[2];
+        a = src[3];
+    }
+
+    static inline void store(void *p, size_t n, float r, float g, float b, float a)
+    {
+        float *dst = (float *)p + 4 * n;
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
+    }
+};
+
+template<PixelFormat SRC, PixelFormat DST>
+void convert_scalar(void const *src, void *dst, size_t begin, size_t end)
+{
+    for (size_t n = begin; n < end; ++n)
+    {
+        float r, g, b, a;
+        pixel_io<SRC>::load(src, n, r, g, b, a);
+        if (!pixel_io<SRC>::grey && pixel_io<DST>::grey)
+            r = luma_r * r + luma_g * g + luma_b * b;
+        pixel_io<DST>::store(dst, n, r, g, b, a);
+    }
 }
 
-static uint8_t f32tou8(float pixel)
+//
+// SIMD pixel access: 8 pixels at a time, as two registers per channel
+//
+
+#if LOL_PIXEL_SSE2 || LOL_PIXEL_NEON
+
+#if LOL_PIXEL_SSE2
+typedef __m128 f4;
+typedef __m128i i4;
+
+inline f4 set1(float x) { return _mm_set1_ps(x); }
+inline f4 add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+inline f4 mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+
+/* Same operations as u8tof32() and f32tou8() */
+inline f4 i4tof4(i4 x) { return _mm_div_ps(_mm_cvtepi32_ps(x), set1(255.f)); }
+inline i4 f4toi4(f4 x)
 {
-    return (uint8_t)(pixel * 255.99f);
+    x = _mm_mul_ps(x, set1(255.99f));
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x, set1(0.f)), set1(255.f)));
 }
+#else
+typedef float32x4_t f4;
 
-static u8vec3 f32tou8(vec3 pixel)
+inline f4 set1(float x) { return vdupq_n_f32(x); }
+inline f4 add(f4 a, f4 b) { return vaddq_f32(a, b); }
+inline f4 mul(f4 a, f4 b) { return vmulq_f32(a, b); }
+
+/* Same operations as u8tof32() and f32tou8() */
+inline void u8tof4(uint8x8_t x, f4 &lo, f4 &hi)
 {
-    return (u8vec3)(pixel * 255.99f);
+    uint16x8_t w = vmovl_u8(x);
+    lo = vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(w))), set1(255.f));
+    hi = vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(w))), set1(255.f));
 }
 
-static u8vec4 f32tou8(vec4 pixel)
+inline uint8x8_t f4tou8(f4 lo, f4 hi)
 {
-    return (u8vec4)(pixel * 255.99f);
+    lo = vminq_f32(vmaxq_f32(vmulq_f32(lo, set1(255.99f)), set1(0.f)), set1(255.f));
+    hi = vminq_f32(vmaxq_f32(vmulq_f32(hi, set1(255.99f)), set1(0.f)), set1(255.f));
+    return vmovn_u16(vcombine_u16(vmovn_u32(vcvtq_u32_f32(lo)),
+                                  vmovn_u32(vcvtq_u32_f32(hi))));
+}
+#endif
+
+struct block
+{
+    f4 r[2], g[2], b[2], a[2];
+};
+
+template<PixelFormat F> struct pixel_simd;
+
+template<> struct pixel_simd<PixelFormat::Y_8>
+{
+    static inline void load(void const *p, size_t n, block &k)
+    {
+#if LOL_PIXEL_SSE2
+        i4 x = _mm_loadl_epi64((i4 const *)((uint8_t const *)p + n));
+        x = _mm_unpacklo_epi8(x, _mm_setzero_si128());
+        k.r[0] = i4tof4(_mm_unpacklo_epi16(x, _mm_setzero_si128()));
+        k.r[1] = i4tof4(_mm_unpackhi_epi16(x, _mm_setzero_si128()));
+#else
+        u8tof4(vld1_u8((uint8_t const *)p + n), k.r[0], k.r[1]);
+#endif
+        for (int i : { 0, 1 })
+        {
+            k.g[i] = k.b[i] = k.r[i];
+            k.a[i] = set1(1.f);
+        }
+    }
+
+    static inline void store(void *p, size_t n, block const &k)
+    {
+#if LOL_PIXEL_SSE2
+        i4 x = _mm_packs_epi32(f4toi4(k.r[0]), f4toi4(k.r[1]));
+        _mm_storel_epi64((i4 *)((uint8_t *)p + n), _mm_packus_epi16(x, x));
+#else
+        vst1_u8((uint8_t *)p + n, f4tou8(k.r[0], k.r[1]));
+#endif
+    }
+};
+
+template<> struct pixel_simd<PixelFormat::RGBA_8>
+{
+    static inline void load(void const *p, size_t n, block &k)
+    {
+#if LOL_PIXEL_SSE2
+        for (int i : { 0, 1 })
+        {
+            i4 x = _mm_loadu_si128((i4 const *)((uint8_t const *)p + 4 * n) + i);
+            i4 const mask = _mm_set1_epi32(0xff);
+            k.r[i] = i4tof4(_mm_and_si128(x, mask));
+            k.g[i] = i4tof4(_mm_and_si128(_mm_srli_epi32(x, 8), mask));
+            k.b[i] = i4tof4(_mm_and_si128(_mm_srli_epi32(x, 16), mask));
+            k.a[i] = i4tof4(_mm_srli_epi32(x, 24));
+        }
+#else
+        uint8x8x4_t x = vld4_u8((uint8_t const *)p + 4 * n);
+        u8tof4(x.val[0], k.r[0], k.r[1]);
+        u8tof4(x.val[1], k.g[0], k.g[1]);
+        u8tof4(x.val[2], k.b[0], k.b[1]);
+        u8tof4(x.val[3], k.a[0], k.a[1]);
+#endif
+    }
+
+    static inline void store(void *p, size_t n, block const &k)
+    {
+#if LOL_PIXEL_SSE2
+        for (int i : { 0, 1 })
+        {
+            i4 x = _mm_or_si128(_mm_or_si128(f4toi4(k.r[i]),
+                                             _mm_slli_epi32(f4toi4(k.g[i]), 8)),
+                                _mm_or_si128(_mm_slli_epi32(f4toi4(k.b[i]), 16),
+                                             _mm_slli_epi32(f4toi4(k.a[i]), 24)));
+            _mm_storeu_si128((i4 *)((uint8_t *)p + 4 * n) + i, x);
+        }
+#else
+        uint8x8x4_t x;
+        x.val[0] = f4tou8(k.r[0], k.r[1]);
+        x.val[1] = f4tou8(k.g[0], k.g[1]);
+        x.val[2] = f4tou8(k.b[0], k.b[1]);
+        x.val[3] = f4tou8(k.a[0], k.a[1]);
+        vst4_u8((uint8_t *)p + 4 * n, x);
+#endif
+    }
+};
+
+template<> struct pixel_simd<PixelFormat::RGB_8>
+{
+    static inline void load(void const *p, size_t n, block &k)
+    {
+#if LOL_PIXEL_SSE2
+        /* Expand to RGBA and reuse the RGBA_8 code; the alpha byte is
+         * replaced with 1.f below. */
+        alignas(16) uint8_t tmp[32];
+        uint8_t const *src = (uint8_t const *)p + 3 * n;
+        for (int i = 0; i < 8; ++i)
+        {
+            tmp[4 * i + 0] = src[3 * i + 0];
+            tmp[4 * i + 1] = src[3 * i + 1];
+            tmp[4 * i + 2] = src[3 * i + 2];
+            tmp[4 * i + 3] = 0;
+        }
+        pixel_simd<PixelFormat::RGBA_8>::load(tmp, 0, k);
+#else
+        uint8x8x3_t x = vld3_u8((uint8_t const *)p + 3 * n);
+        u8tof4(x.val[0], k.r[0], k.r[1]);
+        u8tof4(x.val[1], k.g[0], k.g[1]);
+        u8tof4(x.val[2], k.b[0], k.b[1]);
+#endif
+        k.a[0] = k.a[1] = set1(1.f);
+    }
+
+    static inline void store(void *p, size_t n, block const &k)
+    {
+#if LOL_PIXEL_SSE2
+        alignas(16) uint8_t tmp[32];
+        pixel_simd<PixelFormat::RGBA_8>::store(tmp, 0, k);
+        uint8_t *dst = (uint8_t *)p + 3 * n;
+        for (int i = 0; i < 8; ++i)
+        {
+            dst[3 * i + 0] = tmp[4 * i + 0];
+            dst[3 * i + 1] = tmp[4 * i + 1];
+            dst[3 * i + 2] = tmp[4 * i + 2];
+        }
+#else
+        uint8x8x3_t x;
+        x.val[0] = f4tou8(k.r[0], k.r[1]);
+        x.val[1] = f4tou8(k.g[0], k.g[1]);
+        x.val[2] = f4tou8(k.b[0], k.b[1]);
+        vst3_u8((uint8_t *)p + 3 * n, x);
+#endif
+    }
+};
+
+template<> struct pixel_simd<PixelFormat::Y_F32>
+{
+    static inline void load(void const *p, size_t n, block &k)
+    {
+        float const *src = (float const *)p + n;
+        for (int i : { 0, 1 })
+        {
+#if LOL_PIXEL_SSE2
+            k.r[i] = k.g[i] = k.b[i] = _mm_loadu_ps(src + 4 * i);
+#else
+            k.r[i] = k.g[i] = k.b[i] = vld1q_f32(src + 4 * i);
+#endif
+            k.a[i] = set1(1.f);
+        }
+    }
+
+    static inline void store(void *p, size_t n, block const &k)
+    {
+        float *dst = (float *)p + n;
+        for (int i : { 0, 1 })
+        {
+#if LOL_PIXEL_SSE2
+            _mm_storeu_ps(dst + 4 * i, k.r[i]);
+#else
+            vst1q_f32(dst + 4 * i, k.r[i]);
+#endif
+        }
+    }
+};
+
+template<> struct pixel_simd<PixelFormat::RGB_F32>
+{
+    static inline void load(void const *p, size_t n, block &k)
+    {
+        float const *src = (float const *)p + 3 * n;
+        for (int i : { 0, 1 })
+        {
+#if LOL_PIXEL_SSE2
+            /* x0 = r0 g0 b0 r1, x1 = g1 b1 r2 g2, x2 = b2 r3 g3 b3 */
+            f4 x0 = _mm_loadu_ps(src + 12 * i);
+            f4 x1 = _mm_loadu_ps(src + 12 * i + 4);
+            f4 x2 = _mm_loadu_ps(src + 12 * i + 8);
+            f4 u = _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(2, 1, 3, 2)); // r2 g2 r3 g3
+            f4 v = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(1, 0, 2, 1)); // g0 b0 g1 b1
+            k.r[i] = _mm_shuffle_ps(x0, u, _MM_SHUFFLE(2, 0, 3, 0));
+            k.g[i] = _mm_shuffle_ps(v, u, _MM_SHUFFLE(3, 1, 2, 0));
+            k.b[i] = _mm_shuffle_ps(v, x2, _MM_SHUFFLE(3, 0, 3, 1));
+#else
+            float32x4x3_t x = vld3q_f32(src + 12 * i);
+            k.r[i] = x.val[0];
+            k.g[i] = x.val[1];
+            k.b[i] = x.val[2];
+#endif
+            k.a[i] = set1(1.f);
+        }
+    }
+
+    static inline void store(void *p, size_t n, block const &k)
+    {
+        float *dst = (float *)p + 3 * n;
+        for (int i : { 0, 1 })
+        {
+#if LOL_PIXEL_SSE2
+            f4 rg_lo = _mm_unpacklo_ps(k.r[i], k.g[i]); // r0 g0 r1 g1
+            f4 rg_hi = _mm_unpackhi_ps(k.r[i], k.g[i]); // r2 g2 r3 g3
+            f4 w = _mm_shuffle_ps(k.b[i], rg_lo, _MM_SHUFFLE(2, 2, 0, 0)); // b0 b0 r1 r1
+            f4 y = _mm_shuffle_ps(rg_lo, k.b[i], _MM_SHUFFLE(1, 1, 3, 3)); // g1 g1 b1 b1
+            f4 z = _mm_shuffle_ps(k.b[i], rg_hi, _MM_SHUFFLE(3, 2, 2, 2)); // b2 b2 r3 g3
+            f4 q = _mm_shuffle_ps(rg_hi, k.b[i], _MM_SHUFFLE(3, 3, 3, 3)); // g3 g3 b3 b3
+            _mm_storeu_ps(dst + 12 * i, _mm_shuffle_ps(rg_lo, w, _MM_SHUFFLE(2, 0, 1, 0)));
+            _mm_storeu_ps(dst + 12 * i + 4, _mm_shuffle_ps(y, rg_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+            _mm_storeu_ps(dst + 12 * i + 8, _mm_shuffle_ps(z, q, _MM_SHUFFLE(2, 0, 2, 0)));
+#else
+            float32x4x3_t x;
+            x.val[0] = k.r[i];
+            x.val[1] = k.g[i];
+            x.val[2] = k.b[i];
+            vst3q_f32(dst + 12 * i, x);
+#endif
+        }
+    }
+};
+
+template<> struct pixel_simd<PixelFormat::RGBA_F32>
+{
+    static inline void load(void const *p, size_t n, block &k)
+    {
+        float const *src = (float const *)p + 4 * n;
+        for (int i : { 0, 1 })
+        {
+#if LOL_PIXEL_SSE2
+            f4 x0 = _mm_loadu_ps(src + 16 * i);
+            f4 x1 = _mm_loadu_ps(src + 16 * i + 4);
+            f4 x2 = _mm_loadu_ps(src + 16 * i + 8);
+            f4 x3 = _mm_loadu_ps(src + 16 * i + 12);
+            _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+            k.r[i] = x0; k.g[i] = x1; k.b[i] = x2; k.a[i] = x3;
+#else
+            float32x4x4_t x = vld4q_f32(src + 16 * i);
+            k.r[i] = x.val[0];
+            k.g[i] = x.val[1];
+            k.b[i] = x.val[2];
+            k.a[i] = x.val[3];
+#endif
+        }
+    }
+
+    static inline void store(void *p, size_t n, block const &k)
+    {
+        float *dst = (float *)p + 4 * n;
+        for (int i : { 0, 1 })
+        {
+#if LOL_PIXEL_SSE2
+            f4 x0 = k.r[i], x1 = k.g[i], x2 = k.b[i], x3 = k.a[i];
+            _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+            _mm_storeu_ps(dst + 16 * i, x0);
+            _mm_storeu_ps(dst + 16 * i + 4, x1);
+            _mm_storeu_ps(dst + 16 * i + 8, x2);
+            _mm_storeu_ps(dst + 16 * i + 12, x3);
+#else
+            float32x4x4_t x;
+            x.val[0] = k.r[i];
+            x.val[1] = k.g[i];
+            x.val[2] = k.b[i];
+            x.val[3] = k.a[i];
+            vst4q_f32(dst + 16 * i, x);
+#endif
+        }
+    }
+};
+
+template<PixelFormat SRC, PixelFormat DST>
+void convert(void const *src, void *dst, size_t begin, size_t end)
+{
+    size_t n = begin;
+    for (; n + 8 <= end; n += 8)
+    {
+        block k;
+        pixel_simd<SRC>::load(src, n, k);
+        if (!pixel_io<SRC>::grey && pixel_io<DST>::grey)
+        {
+            for (int i : { 0, 1 })
+                k.r[i] = add(add(mul(set1(luma_r), k.r[i]),
+                                 mul(set1(luma_g), k.g[i])),
+                             mul(set1(luma_b), k.b[i]));
+        }
+        pixel_simd<DST>::store(dst, n, k);
+    }
+
+    /* Run the last pixels through the same code using temporary storage,
+     * so that results never depend on where the band boundaries are. */
+    if (n < end)
+    {
+        size_t const src_bpp = BytesPerPixel(SRC), dst_bpp = BytesPerPixel(DST);
+        alignas(16) uint8_t tmp_src[8 * 16] = {}, tmp_dst[8 * 16];
+        memcpy(tmp_src, (uint8_t const *)src + n * src_bpp, (end - n) * src_bpp);
+        convert<SRC, DST>(tmp_src, tmp_dst, 0, 8);
+        memcpy((uint8_t *)dst + n * dst_bpp, tmp_dst, (end - n) * dst_bpp);
+    }
+}
+
+#else
+
+template<PixelFormat SRC, PixelFormat DST>
+void convert(void const *src, void *dst, size_t begin, size_t end)
+{
+    convert_scalar<SRC, DST>(src, dst, begin, end);
+}
+
+#endif
+
+//
+// Conversion from and to separate float channels, for point operations
+//
+
+template<PixelFormat F>
+void load_channels(void const *src, size_t n, size_t count, channels const &c)
+{
+    size_t i = 0;
+#if LOL_PIXEL_SSE2 || LOL_PIXEL_NEON
+    for (; i + 8 <= count; i += 8)
+    {
+        block k;
+        pixel_simd<F>::load(src, n + i, k);
+        for (int j : { 0, 1 })
+        {
+#   if LOL_PIXEL_SSE2
+            _mm_storeu_ps(c.r + i + 4 * j, k.r[j]);
+            _mm_storeu_ps(c.g + i + 4 * j, k.g[j]);
+            _mm_storeu_ps(c.b + i + 4 * j, k.b[j]);
+            _mm_storeu_ps(c.a + i + 4 * j, k.a[j]);
+#   else
+            vst1q_f32(c.r + i + 4 * j, k.r[j]);
+            vst1q_f32(c.g + i + 4 * j, k.g[j]);
+            vst1q_f32(c.b + i + 4 * j, k.b[j]);
+            vst1q_f32(c.a + i + 4 * j, k.a[j]);
+#   endif
+        }
+    }
+#endif
+
+    /* Loading is exact, so the scalar code gives the same results */
+    for (; i < count; ++i)
+        pixel_io<F>::load(src, n + i, c.r[i], c.g[i], c.b[i], c.a[i]);
+}
+
+template<PixelFormat F>
+void store_channels(void *dst, size_t n, size_t count, channels const &c)
+{
+    size_t i = 0;
+#if LOL_PIXEL_SSE2 || LOL_PIXEL_NEON
+    for (; i + 8 <= count; i += 8)
+    {
+        block k;
+        for (int j : { 0, 1 })
+        {
+#   if LOL_PIXEL_SSE2
+            k.r[j] = _mm_loadu_ps(c.r + i + 4 * j);
+            k.g[j] = _mm_loadu_ps(c.g + i + 4 * j);
+            k.b[j] = _mm_loadu_ps(c.b + i + 4 * j);
+            k.a[j] = _mm_loadu_ps(c.a + i + 4 * j);
+#   else
+            k.r[j] = vld1q_f32(c.r + i + 4 * j);
+            k.g[j] = vld1q_f32(c.g + i + 4 * j);
+            k.b[j] = vld1q_f32(c.b + i + 4 * j);
+            k.a[j] = vld1q_f32(c.a + i + 4 * j);
+#   endif
+        }
+        pixel_simd<F>::store(dst, n + i, k);
+    }
+#endif
+
+    for (; i < count; ++i)
+        pixel_io<F>::store(dst, n + i, c.r[i], c.g[i], c.b[i], c.a[i]);
+}
+
+typedef void (*convert_fn)(void const *, void *, size_t, size_t);
+
+template<PixelFormat SRC>
+convert_fn get_converter(PixelFormat dst)
+{
+    switch (dst)
+    {
+        case PixelFormat::Y_8: return convert<SRC, PixelFormat::Y_8>;
+        case PixelFormat::RGB_8: return convert<SRC, PixelFormat::RGB_8>;
+        case PixelFormat::RGBA_8: return convert<SRC, PixelFormat::RGBA_8>;
+        case PixelFormat::Y_F32: return convert<SRC, PixelFormat::Y_F32>;
+        case PixelFormat::RGB_F32: return convert<SRC, PixelFormat::RGB_F32>;
+        case PixelFormat::RGBA_F32: return convert<SRC, PixelFormat::RGBA_F32>;
+        default: return nullptr;
+    }
+}
+
+convert_fn get_converter(PixelFormat src, PixelFormat dst)
+{
+    switch (src)
+    {
+        case PixelFormat::Y_8: return get_converter<PixelFormat::Y_8>(dst);
+        case PixelFormat::RGB_8: return get_converter<PixelFormat::RGB_8>(dst);
+        case PixelFormat::RGBA_8: return get_converter<PixelFormat::RGBA_8>(dst);
+        case PixelFormat::Y_F32: return get_converter<PixelFormat::Y_F32>(dst);
+        case PixelFormat::RGB_F32: return get_converter<PixelFormat::RGB_F32>(dst);
+        case PixelFormat::RGBA_F32: return get_converter<PixelFormat::RGBA_F32>(dst);
+        default: return nullptr;
+    }
+}
+
+} // anonymous namespace
+
+void load_channels(PixelFormat fmt, void const *src, size_t n, size_t count,
+                   channels const &c)
+{
+    switch (fmt)
+    {
+        case PixelFormat::Y_8: load_channels<PixelFormat::Y_8>(src, n, count, c); break;
+        case PixelFormat::RGB_8: load_channels<PixelFormat::RGB_8>(src, n, count, c); break;
+        case PixelFormat::RGBA_8: load_channels<PixelFormat::RGBA_8>(src, n, count, c); break;
+        case PixelFormat::Y_F32: load_channels<PixelFormat::Y_F32>(src, n, count, c); break;
+        case PixelFormat::RGB_F32: load_channels<PixelFormat::RGB_F32>(src, n, count, c); break;
+        case PixelFormat::RGBA_F32: load_channels<PixelFormat::RGBA_F32>(src, n, count, c); break;
+        default: assert(false); break;
+    }
+}
+
+void store_channels(PixelFormat fmt, void *dst, size_t n, size_t count,
+                    channels const &c)
+{
+    switch (fmt)
+    {
+        case PixelFormat::Y_8: store_channels<PixelFormat::Y_8>(dst, n, count, c); break;
+        case PixelFormat::RGB_8: store_channels<PixelFormat::RGB_8>(dst, n, count, c); break;
+        case PixelFormat::RGBA_8: store_channels<PixelFormat::RGBA_8>(dst, n, count, c); break;
+        case PixelFormat::Y_F32: store_channels<PixelFormat::Y_F32>(dst, n, count, c); break;
+        case PixelFormat::RGB_F32: store_channels<PixelFormat::RGB_F32>(dst, n, count, c); break;
+        case PixelFormat::RGBA_F32: store_channels<PixelFormat::RGBA_F32>(dst, n, count, c); break;
+        default: assert(false); break;
+    }
 }
 
 /*
@@ -72,58 +683,38 @@ PixelFormat old_image::format() const
  *
  * From:   To→  1  2  3  4  5  6
  * Y_8       1  .  o  o  x  x  x
- * RGB_8     2  ~  .  o  ~  x  x
- * RGBA_8    3  ~  o  .  ~  x  x
- * Y_F32     4  #  ~  ~  .  o  o
- * RGB_F32   5  ~  #  ~  #  .  o
- * RGBA_F32  6  ~  ~  #  ~  o  .
+ * RGB_8     2  #  .  o  x  x  x
+ * RGBA_8    3  #  o  .  x  x  x
+ * Y_F32     4  #  #  #  .  o  o
+ * RGB_F32   5  #  #  #  #  .  o
+ * RGBA_F32  6  #  #  #  #  o  .
  *
  * . no conversion necessary
- * ~ intermediate conversion to RGBA_F32 or RGB_F32
  * o easy conversion (add/remove alpha and/or convert gray→color)
  * x lossless conversion (u8 to float)
- * # lossy conversion (dithering and/or convert color→gray)
+ * # lossy conversion (quantisation and/or convert color→gray)
+ *
+ * All of them are done in a single pass, without intermediate planes.
  */
 void old_image::set_format(PixelFormat fmt)
 {
     PixelFormat old_fmt = m_data->m_format;
 
-    /* Preliminary intermediate conversions */
-    if (old_fmt == PixelFormat::RGBA_8 && fmt == PixelFormat::Y_F32)
-        set_format(PixelFormat::RGBA_F32);
-    else if (old_fmt == PixelFormat::RGB_8 && fmt == PixelFormat::Y_F32)
-        set_format(PixelFormat::RGBA_F32);
-    else if (old_fmt == PixelFormat::Y_F32 && fmt == PixelFormat::RGBA_8)
-        set_format(PixelFormat::RGBA_F32);
-    else if (old_fmt == PixelFormat::Y_F32 && fmt == PixelFormat::RGB_8)
-        set_format(PixelFormat::RGBA_F32);
-    else if (old_fmt == PixelFormat::RGB_F32 && fmt == PixelFormat::RGBA_8)
-        set_format(PixelFormat::RGBA_F32);
-    else if (old_fmt == PixelFormat::RGBA_F32 && fmt == PixelFormat::Y_F32)
-        set_format(PixelFormat::RGB_F32);
-    else if (old_fmt == PixelFormat::RGBA_F32 && fmt == PixelFormat::RGB_8)
-        set_format(PixelFormat::RGB_F32);
-    else if (old_fmt == PixelFormat::RGB_8 && fmt == PixelFormat::Y_8)
-        set_format(PixelFormat::RGB_F32);
-    else if (old_fmt == PixelFormat::RGBA_8 && fmt == PixelFormat::Y_8)
-        set_format(PixelFormat::RGB_F32);
-    else if (old_fmt == PixelFormat::RGB_F32 && fmt == PixelFormat::Y_8)
-        set_format(PixelFormat::Y_F32);
-    else if (old_fmt == PixelFormat::RGBA_F32 && fmt == PixelFormat::Y_8)
-        set_format(PixelFormat::Y_F32);
-
-    old_fmt = m_data->m_format;
-
     /* Set the new active pixel format */
     m_data->m_format = fmt;
 
     ivec2 isize = size();
-    int count = isize.x * isize.y;
 
-    /* If we never used this format, allocate a new buffer: we will
-     * obviously need it. */
-    if (m_data->m_pixels[(int)fmt] == nullptr)
+    /* If we have no buffer of our own for this format, allocate a new
+     * one: we will obviously need it. A shared buffer in the current
+     * format is only copied when it gets locked. */
+    auto &plane = m_data->m_pixels[(int)fmt];
+    if (!plane || (fmt != old_fmt && plane.use_count() > 1))
     {
+        /* Make room first if we are holding unused buffers */
+        if (pixel_memory_over_budget())
+            m_data->trim(old_fmt);
+
         PixelDataBase *data = nullptr;
 #if __GNUC__
 #pragma GCC diagnostic push
@@ -152,7 +743,7 @@ void old_image::set_format(PixelFormat fmt)
 #if __GNUC__
 #pragma GCC diagnostic pop
 #endif
-        m_data->m_pixels[(int)fmt] = data;
+        plane.reset(data);
     }
 
     /* If the requested format is already the current format, or if the
@@ -160,199 +751,29 @@ void old_image::set_format(PixelFormat fmt)
     if (fmt == old_fmt || old_fmt == PixelFormat::Unknown)
         return;
 
-    /* Easy conversions: just add or remove channels */
-    if (old_fmt == PixelFormat::Y_8 && fmt == PixelFormat::RGB_8)
-    {
-        uint8_t *src = (uint8_t *)m_data->m_pixels[(int)old_fmt]->data();
-        u8vec3 *dest = (u8vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8vec3(src[n]);
-    }
-    else if (old_fmt == PixelFormat::Y_8 && fmt == PixelFormat::RGBA_8)
-    {
-        uint8_t *src = (uint8_t *)m_data->m_pixels[(int)old_fmt]->data();
-        u8vec4 *dest = (u8vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8vec4(u8vec3(src[n]), 255);
-    }
-    else if (old_fmt == PixelFormat::RGBA_8 && fmt == PixelFormat::RGB_8)
-    {
-        u8vec4 *src = (u8vec4 *)m_data->m_pixels[(int)old_fmt]->data();
-        u8vec3 *dest = (u8vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = src[n].rgb;
-    }
-    else if (old_fmt == PixelFormat::RGB_8 && fmt == PixelFormat::RGBA_8)
-    {
-        u8vec3 *src = (u8vec3 *)m_data->m_pixels[(int)old_fmt]->data();
-        u8vec4 *dest = (u8vec4 *)m_data->m_pixels[(int)fmt]->data();
+    void const *src = m_data->m_pixels[(int)old_fmt]->data();
+    void *dst = m_data->m_pixels[(int)fmt]->data();
+    size_t pixel_size = std::max(BytesPerPixel(old_fmt), BytesPerPixel(fmt));
 
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8vec4(src[n], 255);
-    }
-    else if (old_fmt == PixelFormat::RGBA_F32 && fmt == PixelFormat::RGB_F32)
-    {
-        vec4 *src = (vec4 *)m_data->m_pixels[(int)old_fmt]->data();
-        vec3 *dest = (vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = src[n].rgb;
-    }
-    else if (old_fmt == PixelFormat::RGB_F32 && fmt == PixelFormat::RGBA_F32)
-    {
-        vec3 *src = (vec3 *)m_data->m_pixels[(int)old_fmt]->data();
-        vec4 *dest = (vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = vec4(src[n], 1.f);
-    }
-    else if (old_fmt == PixelFormat::Y_F32 && fmt == PixelFormat::RGB_F32)
-    {
-        float *src = (float *)m_data->m_pixels[(int)old_fmt]->data();
-        vec3 *dest = (vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = vec3(src[n]);
-    }
-    else if (old_fmt == PixelFormat::Y_F32 && fmt == PixelFormat::RGBA_F32)
-    {
-        float *src = (float *)m_data->m_pixels[(int)old_fmt]->data();
-        vec4 *dest = (vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = vec4(vec3(src[n]), 1.0f);
-    }
-    /* Lossless conversions: u8 to float */
-    else if (old_fmt == PixelFormat::Y_8 && fmt == PixelFormat::Y_F32)
-    {
-        uint8_t *src = (uint8_t *)m_data->m_pixels[(int)old_fmt]->data();
-        float *dest = (float *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(src[n]);
-    }
-    else if (old_fmt == PixelFormat::Y_8 && fmt == PixelFormat::RGB_F32)
-    {
-        uint8_t *src = (uint8_t *)m_data->m_pixels[(int)old_fmt]->data();
-        vec3 *dest = (vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(u8vec3(src[n]));
-    }
-    else if (old_fmt == PixelFormat::RGB_8 && fmt == PixelFormat::RGB_F32)
-    {
-        u8vec3 *src = (u8vec3 *)m_data->m_pixels[(int)old_fmt]->data();
-        vec3 *dest = (vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(src[n]);
-    }
-    else if (old_fmt == PixelFormat::RGBA_8 && fmt == PixelFormat::RGB_F32)
-    {
-        u8vec4 *src = (u8vec4 *)m_data->m_pixels[(int)old_fmt]->data();
-        vec3 *dest = (vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(src[n].rgb);
-    }
-    else if (old_fmt == PixelFormat::Y_8 && fmt == PixelFormat::RGBA_F32)
-    {
-        uint8_t *src = (uint8_t *)m_data->m_pixels[(int)old_fmt]->data();
-        vec4 *dest = (vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(u8vec4(u8vec3(src[n]), 255));
-    }
-    else if (old_fmt == PixelFormat::RGB_8 && fmt == PixelFormat::RGBA_F32)
-    {
-        u8vec3 *src = (u8vec3 *)m_data->m_pixels[(int)old_fmt]->data();
-        vec4 *dest = (vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(u8vec4(src[n], 255));
-    }
-    else if (old_fmt == PixelFormat::RGBA_8 && fmt == PixelFormat::RGBA_F32)
-    {
-        u8vec4 *src = (u8vec4 *)m_data->m_pixels[(int)old_fmt]->data();
-        vec4 *dest = (vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = u8tof32(src[n]);
-    }
-    /* Other conversions */
-    else if (old_fmt == PixelFormat::RGB_F32 && fmt == PixelFormat::Y_F32)
-    {
-        vec3 *src = (vec3 *)m_data->m_pixels[(int)old_fmt]->data();
-        float *dest = (float *)m_data->m_pixels[(int)fmt]->data();
-
-        vec3 const coeff(0.299f, 0.587f, 0.114f);
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = dot(coeff, src[n]);
-    }
-    else if (old_fmt == PixelFormat::Y_F32 && fmt == PixelFormat::Y_8)
-    {
-        float *src = (float *)m_data->m_pixels[(int)old_fmt]->data();
-        uint8_t *dest = (uint8_t *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = f32tou8(src[n]);
-    }
-    else if (old_fmt == PixelFormat::RGB_F32 && fmt == PixelFormat::RGB_8)
-    {
-        vec3 *src = (vec3 *)m_data->m_pixels[(int)old_fmt]->data();
-        u8vec3 *dest = (u8vec3 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = f32tou8(src[n]);
-    }
-    else if (old_fmt == PixelFormat::RGBA_F32 && fmt == PixelFormat::RGBA_8)
-    {
-        vec4 *src = (vec4 *)m_data->m_pixels[(int)old_fmt]->data();
-        u8vec4 *dest = (u8vec4 *)m_data->m_pixels[(int)fmt]->data();
-
-        for (int n = 0; n < count; ++n)
-            dest[n] = f32tou8(src[n]);
-#if 0
-        init_tables();
-
-        for (int y = 0; y < isize.y; y++)
-            for (int x = 0; x < isize.x; x++)
-                for (i = 0; i < 4; i++)
-                {
-                    double p, e;
-                    uint8_t d;
-
-                    p = src[4 * (y * isize.x + x) + i];
-
-                    if (p < 0.) d = 0.;
-                    else if (p > 1.) d = 255;
-                    else d = (int)(255.999 * pow(p, 1. / global_gamma));
-
-                    dest[4 * (y * isize.x + x) + i] = d;
-
-                    e = (p - u8tof32(d)) / 16;
-                    if (x < isize.x - 1)
-                        src[4 * (y * isize.x + x + 1) + i] += e * 7;
-                    if (y < isize.y - 1)
-                    {
-                        if (x > 0)
-                            src[4 * ((y + 1) * isize.x + x - 1) + i] += e * 3;
-                        src[4 * ((y + 1) * isize.x + x) + i] += e * 5;
-                        if (x < isize.x - 1)
-                            src[4 * ((y + 1) * isize.x + x + 1) + i] += e;
-                    }
-                }
-#endif
-    }
-    else
+    auto convert_fn = get_converter(old_fmt, fmt);
+    if (!convert_fn)
     {
         msg::error("Unable to find old_image conversion from %d to %d",
                    (int)old_fmt, (int)fmt);
+        return;
     }
+
+    parallel_pixels(isize, pixel_size, [&](int n0, int n1)
+    {
+        convert_fn(src, dst, size_t(n0), size_t(n1));
+    });
+
+    /* The previous buffer is now stale. Only keep it around for reuse if
+     * it is ours and memory allows. */
+    if (m_data->m_pixels[(int)old_fmt].use_count() > 1)
+        m_data->m_pixels.erase((int)old_fmt);
+    else if (pixel_memory_over_budget())
+        m_data->trim();
 }
 
 } /* namespace lol */
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,7 +12,11 @@
 
 #include <lol/engine-internal.h>
 
-#include <vector> // std::vector
+#include "image-private.h"
+
+#include <cmath>   // std::fabs, std::sin, std::lround
+#include <cstdint> // int64_t
+#include <vector>  // std::vector
 
 /*
  * Image resizing functions
@@ -21,7 +25,8 @@
 namespace lol
 {
 
-static old_image ResizeBicubic(old_image &src, ivec2 size);
+static old_image ResizeSeparable(old_image &src, ivec2 size,
+                                 ResampleAlgorithm algorithm);
 static old_image ResizeBresenham(old_image &src, ivec2 size);
 
 old_image old_image::Resize(ivec2 size, ResampleAlgorithm algorithm)
@@ -29,115 +34,374 @@ old_image old_image::Resize(ivec2 size, ResampleAlgorithm algorithm)
     switch (algorithm)
     {
         case ResampleAlgorithm::Bicubic:
-            return ResizeBicubic(*this, size);
+        case ResampleAlgorithm::Lanczos3:
+        case ResampleAlgorithm::Mitchell:
+            return ResizeSeparable(*this, size, algorithm);
         case ResampleAlgorithm::Bresenham:
         default:
             return ResizeBresenham(*this, size);
     }
 }
 
-static old_image ResizeBicubic(old_image &src, ivec2 size)
+/*
+ * Separable resampling
+ *
+ * Images are resized horizontally, then vertically, using tables of
+ * source indices and weights computed once per destination column and
+ * row. Colours are premultiplied by alpha while filtering, so that
+ * transparent pixels do not bleed into their neighbours.
+ *
+ * Bicubic keeps its historical behaviour: Catmull-Rom interpolation on a
+ * grid where the corner pixels are aligned. Lanczos3 and Mitchell align
+ * pixel centres and widen the filter when downscaling, which is what
+ * mipmaps and thumbnails need.
+ */
+
+/* Mitchell-Netravali cubic; B = 0, C = 0.5 is Catmull-Rom */
+static float cubic(float x, float b, float c)
 {
-    old_image dst(size);
-    ivec2 const oldsize = src.size();
+    x = std::fabs(x);
+    if (x < 1.f)
+        return ((12.f - 9.f * b - 6.f * c) * x * x * x
+                 + (-18.f + 12.f * b + 6.f * c) * x * x
+                 + (6.f - 2.f * b)) / 6.f;
+    if (x < 2.f)
+        return ((-b - 6.f * c) * x * x * x + (6.f * b + 30.f * c) * x * x
+                 + (-12.f * b - 48.f * c) * x + (8.f * b + 24.f * c)) / 6.f;
+    return 0.f;
+}
 
-    vec4 const *srcp = src.lock<PixelFormat::RGBA_F32>();
-    vec4 *dstp = dst.lock<PixelFormat::RGBA_F32>();
+static float lanczos3(float x)
+{
+    if (x == 0.f)
+        return 1.f;
+    if (std::fabs(x) >= 3.f)
+        return 0.f;
+    float const pi_x = F_PI * x;
+    return 3.f * std::sin(pi_x) * std::sin(pi_x / 3.f) / (pi_x * pi_x);
+}
+
+/* For each destination pixel, the source pixels to read and how much
+ * each of them contributes; source indices are clamped to the image. */
+struct resample_table
+{
+    int taps;
+    std::vector<int> index;
+    std::vector<float> weight;
+    /* Fixed-point weights for 8-bit images, summing to 1 << FIX_BITS */
+    std::vector<int32_t> fixed;
 
-    float scalex = size.x > 1 ? (oldsize.x - 1.f) / (size.x - 1) : 1.f;
-    float scaley = size.y > 1 ? (oldsize.y - 1.f) / (size.y - 1) : 1.f;
+    static int const FIX_BITS = 14;
 
-    for (int y = 0; y < size.y; ++y)
+    resample_table(int src_size, int dst_size, ResampleAlgorithm algorithm)
     {
-        float yfloat = scaley * y;
-        int yint = (int)yfloat;
-        float y1 = yfloat - yint;
+        if (algorithm == ResampleAlgorithm::Bicubic)
+        {
+            float scale = dst_size > 1 ? (src_size - 1.f) / (dst_size - 1) : 1.f;
 
-        vec4 const *p0 = srcp + oldsize.x * lol::min(lol::max(0, yint - 1), oldsize.y - 1);
-        vec4 const *p1 = srcp + oldsize.x * lol::min(lol::max(0, yint    ), oldsize.y - 1);
-        vec4 const *p2 = srcp + oldsize.x * lol::min(lol::max(0, yint + 1), oldsize.y - 1);
-        vec4 const *p3 = srcp + oldsize.x * lol::min(lol::max(0, yint + 2), oldsize.y - 1);
+            taps = 4;
+            resize(dst_size);
+            for (int i = 0; i < dst_size; ++i)
+            {
+                float pos = scale * i;
+                int first = (int)pos - 1;
+                for (int k = 0; k < taps; ++k)
+                {
+                    index[i * taps + k] = lol::clamp(first + k, 0, src_size - 1);
+                    weight[i * taps + k] = cubic(pos - float(first + k), 0.f, 0.5f);
+                }
+            }
+        }
+        else
+        {
+            float const radius = algorithm == ResampleAlgorithm::Lanczos3 ? 3.f : 2.f;
+            float const scale = float(src_size) / dst_size;
+            float const fscale = lol::max(scale, 1.f);
+            float const support = radius * fscale;
+
+            taps = (int)std::ceil(support) * 2 + 1;
+            resize(dst_size);
+            for (int i = 0; i < dst_size; ++i)
+            {
+                float center = (i + 0.5f) * scale - 0.5f;
+                int first = (int)std::floor(center - support) + 1;
+                for (int k = 0; k < taps; ++k)
+                {
+                    float x = (float(first + k) - center) / fscale;
+                    index[i * taps + k] = lol::clamp(first + k, 0, src_size - 1);
+                    weight[i * taps + k] = algorithm == ResampleAlgorithm::Lanczos3
+                                         ? lanczos3(x) : cubic(x, 1.f / 3, 1.f / 3);
+                }
+            }
+        }
+
+        normalize(dst_size);
+    }
 
-        for (int x = 0; x < size.x; ++x)
+private:
+    void resize(int dst_size)
+    {
+        index.resize(dst_size * taps);
+        weight.resize(dst_size * taps);
+        fixed.resize(dst_size * taps);
+    }
+
+    void normalize(int dst_size)
+    {
+        for (int i = 0; i < dst_size; ++i)
         {
-            float xfloat = scalex * x;
-            int xint = (int)xfloat;
-            float x1 = xfloat - xint;
-
-            int const i0 = lol::min(lol::max(0, xint - 1), oldsize.x - 1);
-            int const i1 = lol::min(lol::max(0, xint    ), oldsize.x - 1);
-            int const i2 = lol::min(lol::max(0, xint + 1), oldsize.x - 1);
-            int const i3 = lol::min(lol::max(0, xint + 2), oldsize.x - 1);
-
-            vec4 a00 = p1[i1];
-            vec4 a01 = .5f * (p2[i1] - p0[i1]);
-            vec4 a02 = p0[i1] - 2.5f * p1[i1]
-                        + 2.f * p2[i1] - .5f * p3[i1];
-            vec4 a03 = .5f * (p3[i1] - p0[i1]) + 1.5f * (p1[i1] - p2[i1]);
-
-            vec4 a10 = .5f * (p1[i2] - p1[i0]);
-            vec4 a11 = .25f * (p0[i0] - p2[i0] - p0[i2] + p2[i2]);
-            vec4 a12 = .5f * (p0[i2] - p0[i0]) + 1.25f * (p1[i0] - p1[i2])
-                        + .25f * (p3[i0] - p3[i2]) + p2[i2] - p2[i0];
-            vec4 a13 = .25f * (p0[i0] - p3[i0] - p0[i2] + p3[i2])
-                        + .75f * (p2[i0] - p1[i0] + p1[i2] - p2[i2]);
-
-            vec4 a20 = p1[i0] - 2.5f * p1[i1]
-                        + 2.f * p1[i2] - .5f * p1[i3];
-            vec4 a21 = .5f * (p2[i0] - p0[i0]) + 1.25f * (p0[i1] - p2[i1])
-                        + .25f * (p0[i3] - p2[i3]) - p0[i2] + p2[i2];
-            vec4 a22 = p0[i0] - p3[i2] - 2.5f * (p1[i0] + p0[i1])
-                        + 2.f * (p2[i0] + p0[i2]) - .5f * (p3[i0] + p0[i3])
-                        + 6.25f * p1[i1] - 5.f * (p2[i1] + p1[i2])
-                        + 1.25f * (p3[i1] + p1[i3])
-                        + 4.f * p2[i2] - p2[i3] + .25f * p3[i3];
-            vec4 a23 = 1.5f * (p1[i0] - p2[i0]) + .5f * (p3[i0] - p0[i0])
-                        + 1.25f * (p0[i1] - p3[i1])
-                        + 3.75f * (p2[i1] - p1[i1]) + p3[i2] - p0[i2]
-                        + 3.f * (p1[i2] - p2[i2]) + .25f * (p0[i3] - p3[i3])
-                        + .75f * (p2[i3] - p1[i3]);
-
-            vec4 a30 = .5f * (p1[i3] - p1[i0]) + 1.5f * (p1[i1] - p1[i2]);
-            vec4 a31 = .25f * (p0[i0] - p2[i0]) + .25f * (p2[i3] - p0[i3])
-                        + .75f * (p2[i1] - p0[i1] + p0[i2] - p2[i2]);
-            vec4 a32 = -.5f * p0[i0] + 1.25f * p1[i0] - p2[i0]
-                        + .25f * p3[i0] + 1.5f * p0[i1] - 3.75f * p1[i1]
-                        + 3.f * p2[i1] - .75f * p3[i1] - 1.5f * p0[i2]
-                        + 3.75f * p1[i2] - 3.f * p2[i2] + .75f * p3[i2]
-                        + .5f * p0[i3] - 1.25f * p1[i3] + p2[i3]
-                        - .25f * p3[i3];
-            vec4 a33 = .25f * p0[i0] - .75f * p1[i0] + .75f * p2[i0]
-                        - .25f * p3[i0] - .75f * p0[i1] + 2.25f * p1[i1]
-                        - 2.25f * p2[i1] + .75f * p3[i1] + .75f * p0[i2]
-                        - 2.25f * p1[i2] + 2.25f * p2[i2] - .75f * p3[i2]
-                        - .25f * p0[i3] + .75f * p1[i3] - .75f * p2[i3]
-                        + .25f * p3[i3];
-
-            float y2 = y1 * y1; float y3 = y2 * y1;
-            float x2 = x1 * x1; float x3 = x2 * x1;
-
-            vec4 p = a00 + a01 * y1 + a02 * y2 + a03 * y3
-                   + a10 * x1 + a11 * x1 * y1 + a12 * x1 * y2 + a13 * x1 * y3
-                   + a20 * x2 + a21 * x2 * y1 + a22 * x2 * y2 + a23 * x2 * y3
-                   + a30 * x3 + a31 * x3 * y1 + a32 * x3 * y2 + a33 * x3 * y3;
-
-            dstp[y * size.x + x] = lol::clamp(p, 0.f, 1.f);
+            float *w = &weight[i * taps];
+            int32_t *f = &fixed[i * taps];
+
+            float sum = 0.f;
+            for (int k = 0; k < taps; ++k)
+                sum += w[k];
+            for (int k = 0; k < taps; ++k)
+                w[k] /= sum;
+
+            /* Put the rounding error on the largest weight so that flat
+             * areas stay exactly flat. */
+            int32_t fsum = 0;
+            int largest = 0;
+            for (int k = 0; k < taps; ++k)
+            {
+                f[k] = (int32_t)std::lround(w[k] * (1 << FIX_BITS));
+                fsum += f[k];
+                if (w[k] > w[largest])
+                    largest = k;
+            }
+            f[largest] += (1 << FIX_BITS) - fsum;
         }
     }
+};
+
+#if defined __SSE__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define LOL_RESAMPLE_SSE 1
+#elif defined __ARM_NEON
+#   include <arm_neon.h>
+#   define LOL_RESAMPLE_NEON 1
+#endif
+
+/* Weighted sum of vec4 pixels; one pixel fits in one SIMD register */
+static inline vec4 weighted_sum(vec4 const *line, int const *index,
+                                float const *weight, int taps)
+{
+#if LOL_RESAMPLE_SSE
+    __m128 acc = _mm_setzero_ps();
+    for (int k = 0; k < taps; ++k)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weight[k]),
+                                         _mm_loadu_ps(&line[index[k]].x)));
+    vec4 ret;
+    _mm_storeu_ps(&ret.x, acc);
+    return ret;
+#elif LOL_RESAMPLE_NEON
+    float32x4_t acc = vdupq_n_f32(0.f);
+    for (int k = 0; k < taps; ++k)
+        acc = vmlaq_n_f32(acc, vld1q_f32(&line[index[k]].x), weight[k]);
+    vec4 ret;
+    vst1q_f32(&ret.x, acc);
+    return ret;
+#else
+    vec4 acc(0.f);
+    for (int k = 0; k < taps; ++k)
+        acc += weight[k] * line[index[k]];
+    return acc;
+#endif
+}
 
-    dst.unlock(dstp);
-    src.unlock(srcp);
+static void ResizeFloat(vec4 const *srcp, ivec2 oldsize, vec4 *dstp, ivec2 size,
+                        resample_table const &tx, resample_table const &ty)
+{
+    /* Horizontal pass, premultiplying each source row first */
+    std::vector<vec4> tmp(size_t(size.x) * oldsize.y);
+
+    parallel_rows(oldsize, sizeof(vec4), 0, [&](int y0, int y1)
+    {
+        std::vector<vec4> line(oldsize.x);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            vec4 const *row = srcp + y * oldsize.x;
+            for (int x = 0; x < oldsize.x; ++x)
+            {
+                float a = row[x].a;
+                line[x] = vec4(row[x].r * a, row[x].g * a, row[x].b * a, a);
+            }
+
+            for (int x = 0; x < size.x; ++x)
+                tmp[y * size.x + x] = weighted_sum(line.data(), &tx.index[x * tx.taps],
+                                                   &tx.weight[x * tx.taps], tx.taps);
+        }
+    });
+
+    /* Vertical pass; whole rows are accumulated so that the compiler can
+     * vectorise the inner loop. */
+    parallel_rows(size, sizeof(vec4), 0, [&](int y0, int y1)
+    {
+        int const count = size.x * 4;
+
+        for (int y = y0; y < y1; ++y)
+        {
+            float *acc = &dstp[y * size.x].x;
+            std::fill(acc, acc + count, 0.f);
+
+            for (int k = 0; k < ty.taps; ++k)
+            {
+                float const w = ty.weight[y * ty.taps + k];
+                float const *row = &tmp[ty.index[y * ty.taps + k] * size.x].x;
+                for (int i = 0; i < count; ++i)
+                    acc[i] += w * row[i];
+            }
+
+            for (int x = 0; x < size.x; ++x)
+            {
+                vec4 &p = dstp[y * size.x + x];
+                if (p.a > 0.f)
+                {
+                    float inva = 1.f / p.a;
+                    p = vec4(lol::clamp(p.r * inva, 0.f, 1.f),
+                             lol::clamp(p.g * inva, 0.f, 1.f),
+                             lol::clamp(p.b * inva, 0.f, 1.f),
+                             lol::min(p.a, 1.f));
+                }
+                else
+                    p = vec4(0.f);
+            }
+        }
+    });
+}
+
+/* Same as above with fixed-point arithmetic. Premultiplied colours and
+ * alpha are both scaled by 255 × 255. Intermediate values are not clamped,
+ * since ringing must cancel out in the second pass for colours to keep
+ * their ratio to alpha; with 14-bit weights, the worst case for Lanczos3
+ * still fits in 31 bits. */
+template<int C>
+static void ResizeU8(uint8_t const *srcp, ivec2 oldsize, uint8_t *dstp, ivec2 size,
+                     resample_table const &tx, resample_table const &ty)
+{
+    int const FIX_BITS = resample_table::FIX_BITS;
+    int32_t const round = 1 << (FIX_BITS - 1);
+    int32_t const top = 255 * 255;
+
+    std::vector<int32_t> tmp(size_t(size.x) * oldsize.y * C);
+
+    parallel_rows(oldsize, C * sizeof(int32_t), 0, [&](int y0, int y1)
+    {
+        std::vector<int32_t> line(size_t(oldsize.x) * C);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            uint8_t const *row = srcp + y * oldsize.x * C;
+            for (int x = 0; x < oldsize.x; ++x)
+            {
+                int32_t a = C == 4 ? row[x * C + 3] : 255;
+                for (int c = 0; c < C; ++c)
+                    line[x * C + c] = (C == 4 && c == 3 ? 255 : a) * row[x * C + c];
+            }
+
+            for (int x = 0; x < size.x; ++x)
+            {
+                int const *index = &tx.index[x * tx.taps];
+                int32_t const *w = &tx.fixed[x * tx.taps];
+                int32_t acc[C] = {};
+                for (int k = 0; k < tx.taps; ++k)
+                    for (int c = 0; c < C; ++c)
+                        acc[c] += w[k] * line[index[k] * C + c];
+                for (int c = 0; c < C; ++c)
+                    tmp[(y * size.x + x) * C + c] = (acc[c] + round) >> FIX_BITS;
+            }
+        }
+    });
+
+    parallel_rows(size, C * sizeof(int32_t), 0, [&](int y0, int y1)
+    {
+        int const count = size.x * C;
+        std::vector<int32_t> acc(count);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            std::fill(acc.begin(), acc.end(), 0);
+
+            for (int k = 0; k < ty.taps; ++k)
+            {
+                int32_t const w = ty.fixed[y * ty.taps + k];
+                int32_t const *row = &tmp[ty.index[y * ty.taps + k] * count];
+                for (int i = 0; i < count; ++i)
+                    acc[i] += w * row[i];
+            }
+
+            uint8_t *out = dstp + y * count;
+            for (int x = 0; x < size.x; ++x)
+            {
+                int32_t p[C];
+                for (int c = 0; c < C; ++c)
+                    p[c] = (acc[x * C + c] + round) >> FIX_BITS;
+
+                if (C == 4)
+                {
+                    int32_t a = p[3];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        int64_t v = a > 0 ? (int64_t(p[c]) * 255 + a / 2) / a : 0;
+                        out[x * C + c] = (uint8_t)lol::clamp(v, int64_t(0), int64_t(255));
+                    }
+                    out[x * C + 3] = (uint8_t)((lol::clamp(a, 0, top) + 127) / 255);
+                }
+                else
+                {
+                    for (int c = 0; c < C; ++c)
+                        out[x * C + c] = (uint8_t)((lol::clamp(p[c], 0, top) + 127) / 255);
+                }
+            }
+        }
+    });
+}
+
+static old_image ResizeSeparable(old_image &src, ivec2 size,
+                                 ResampleAlgorithm algorithm)
+{
+    old_image dst(size);
+    ivec2 const oldsize = src.size();
+
+    resample_table const tx(oldsize.x, size.x, algorithm);
+    resample_table const ty(oldsize.y, size.y, algorithm);
+
+    if (src.format() == PixelFormat::RGBA_8 || src.format() == PixelFormat::Y_8)
+    {
+        bool const rgba = src.format() == PixelFormat::RGBA_8;
+        uint8_t const *srcp = (uint8_t const *)src.lock();
+        dst.set_format(src.format());
+        uint8_t *dstp = (uint8_t *)dst.lock();
+
+        if (rgba)
+            ResizeU8<4>(srcp, oldsize, dstp, size, tx, ty);
+        else
+            ResizeU8<1>(srcp, oldsize, dstp, size, tx, ty);
+
+        dst.unlock(dstp);
+        src.unlock(srcp);
+    }
+    else
+    {
+        vec4 const *srcp = src.lock<PixelFormat::RGBA_F32>();
+        vec4 *dstp = dst.lock<PixelFormat::RGBA_F32>();
+
+        ResizeFloat(srcp, oldsize, dstp, size, tx, ty);
+
+        dst.unlock(dstp);
+        src.unlock(srcp);
+    }
 
     return dst;
 }
 
 /* This is Bresenham resizing. I “rediscovered” it independently but
  * it was actually first described in 1995 by Tim Kientzle in “Scaling
- * Bitmaps with Bresenham”. */
-
-/* FIXME: the algorithm does not handle alpha components properly. Resulting
- * alpha should be the mean alpha value of the neightbouring pixels, but
- * the colour components should be weighted with the alpha value. */
+ * Bitmaps with Bresenham”. Colours are accumulated premultiplied by
+ * alpha, so the resulting alpha is the mean of the covered pixels and
+ * the colours are weighted by their alpha. */
 static old_image ResizeBresenham(old_image &src, ivec2 size)
 {
     old_image dst(size);
@@ -147,60 +411,80 @@ static old_image ResizeBresenham(old_image &src, ivec2 size)
     vec4 const *srcp = src.lock<PixelFormat::RGBA_F32>();
     vec4 *dstp = dst.lock<PixelFormat::RGBA_F32>();
 
-    std::vector<vec4> aline, line;
-    aline.resize(size.x);
-    line.resize(size.x);
-    memset((void *)line.data(), 0, line.size() * sizeof(line[0]));
-
-    int remy = 0;
-
-    for (int y = 0, y0 = 0; y < size.y; y++)
+    /* Resample source row y0 horizontally into line */
+    auto resample_line = [&](int y0, vec4 *line)
     {
-        memset((void *)aline.data(), 0, aline.size() * sizeof(aline[0]));
+        vec4 col(0.f);
+        int remx = 0;
 
-        for (int toty = 0; toty < oldsize.y; )
+        for (int x = 0, x0 = 0; x < size.x; x++)
         {
-            if (remy == 0)
-            {
-                vec4 col(0.f);
-                int remx = 0;
+            vec4 acolor(0.f);
 
-                for (int x = 0, x0 = 0; x < size.x; x++)
+            for (int totx = 0; totx < oldsize.x; )
+            {
+                if (remx == 0)
                 {
-                    vec4 acolor(0.f);
+                    col = srcp[y0 * oldsize.x + x0];
+                    col = vec4(col.r * col.a, col.g * col.a, col.b * col.a, col.a);
+                    x0++;
+                    remx = size.x;
+                }
 
-                    for (int totx = 0; totx < oldsize.x; )
-                    {
-                        if (remx == 0)
-                        {
-                            col = srcp[y0 * oldsize.x + x0];
-                            x0++;
-                            remx = size.x;
-                        }
-
-                        int nx = lol::min(remx, oldsize.x - totx);
-                        acolor += (float)nx * col;
-                        totx += nx;
-                        remx -= nx;
-                    }
+                int nx = lol::min(remx, oldsize.x - totx);
+                acolor += (float)nx * col;
+                totx += nx;
+                remx -= nx;
+            }
 
-                    line[x] = acolor;
+            line[x] = acolor;
+        }
+    };
+
+    parallel_rows(size, sizeof(vec4), 0, [&](int ybegin, int yend)
+    {
+        std::vector<vec4> aline, line;
+        aline.resize(size.x);
+        line.resize(size.x);
+
+        /* Every destination row consumes oldsize.y units and every source
+         * row provides size.y units; work out where row ybegin starts and
+         * reload the partially consumed source row, if any. */
+        int64_t consumed = int64_t(ybegin) * oldsize.y;
+        int y0 = int((consumed + size.y - 1) / size.y);
+        int remy = int(int64_t(y0) * size.y - consumed);
+        if (remy)
+            resample_line(y0 - 1, line.data());
+
+        for (int y = ybegin; y < yend; y++)
+        {
+            memset((void *)aline.data(), 0, aline.size() * sizeof(aline[0]));
+
+            for (int toty = 0; toty < oldsize.y; )
+            {
+                if (remy == 0)
+                {
+                    resample_line(y0, line.data());
+                    y0++;
+                    remy = size.y;
                 }
 
-                y0++;
-                remy = size.y;
+                int ny = lol::min(remy, oldsize.y - toty);
+                for (int x = 0; x < size.x; x++)
+                    aline[x] += (float)ny * line[x];
+                toty += ny;
+                remy -= ny;
             }
 
-            int ny = lol::min(remy, oldsize.y - toty);
             for (int x = 0; x < size.x; x++)
-                aline[x] += (float)ny * line[x];
-            toty += ny;
-            remy -= ny;
+            {
+                vec4 const &p = aline[x];
+                float inva = p.a > 0.f ? 1.f / p.a : 0.f;
+                dstp[y * size.x + x] = vec4(p.r * inva, p.g * inva, p.b * inva,
+                                            p.a * invswsh);
+            }
         }
-
-        for (int x = 0; x < size.x; x++)
-            dstp[y * size.x + x] = aline[x] * invswsh;
-    }
+    });
 
     dst.unlock(dstp);
     src.unlock(srcp);
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //            © 2016—2017 Benjamin “Touky” Huet <huet.benjamin@gmail.com>
 //
 //  Lol Engine is free software. It comes without any warranty, to
@@ -14,7 +14,10 @@
 #pragma once
 
 #include <lol/utils>
-#include <vector>
+#include <cstdint> // uint8_t, uint32_t
+#include <cstdio>  // FILE
+#include <string>  // std::string
+#include <vector>  // std::vector
 
 //
 // The ResourceCodecData class
@@ -24,14 +27,80 @@
 namespace lol
 {
 
+    /* The first bytes of a file, read once by the loader and shown to
+     * every codec so that it can tell whether it knows the format. The
+     * file stays open so that codecs decoding from memory can get the
+     * rest of it without opening it again. */
+    class ResourceProbe
+    {
+    public:
+        static constexpr size_t header_size = 512;
+
+        ResourceProbe(std::string const &path);
+        ~ResourceProbe();
+
+        ResourceProbe(ResourceProbe const &) = delete;
+        ResourceProbe &operator =(ResourceProbe const &) = delete;
+
+        /* Lowercase, without the dot */
+        static std::string get_extension(std::string const &path);
+
+        std::string const &path() const { return m_path; }
+        /* Lowercase, without the dot */
+        std::string const &extension() const { return m_extension; }
+        /* False for files that are not on disk, such as bundled assets */
+        bool exists() const { return m_exists; }
+
+        /* At most header_size bytes from the start of the file */
+        std::vector<uint8_t> const &header() const { return m_header; }
+        bool has_magic(char const *magic, size_t len, size_t offset = 0) const;
+
+        /* The whole file; reads what is left after the header */
+        std::vector<uint8_t> const &data();
+
+    private:
+        std::string m_path, m_extension;
+        FILE *m_fp = nullptr;
+        bool m_exists = false;
+        std::vector<uint8_t> m_header, m_data;
+    };
+
     class ResourceCodec
     {
     public:
+        /* Capabilities */
+        enum : uint32_t
+        {
+            can_load = 1 << 0,
+            can_save = 1 << 1,
+            /* Decodes from the bytes in a ResourceProbe instead of the path */
+            can_stream = 1 << 2,
+        };
+
+        /* How confident a codec is that it can load some data */
+        enum class match : uint8_t
+        {
+            no,
+            maybe,
+            yes,
+        };
+
+        virtual ~ResourceCodec() { }
+
         virtual std::string GetName() { return "<ResourceCodec>"; }
+        virtual uint32_t GetCapabilities() { return can_load | can_save; }
+        /* Lowercase extensions this codec saves to; empty means any */
+        virtual std::vector<std::string> GetExtensions() { return {}; }
+
+        /* The default is for codecs that cannot look at the data, e.g.
+         * because they load from an asset bundle. */
+        virtual match Probe(ResourceProbe const &) { return match::maybe; }
+
         virtual ResourceCodecData* Load(std::string const &path) = 0;
+        /* Only called for codecs with can_stream */
+        virtual ResourceCodecData* LoadProbe(ResourceProbe &probe) { return Load(probe.path()); }
         virtual bool Save(std::string const &path, ResourceCodecData* data) = 0;
 
-        /* TODO: this should become more fine-grained */
         size_t m_priority;
     };
 
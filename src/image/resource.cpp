@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //            © 2016—2017 Benjamin “Touky” Huet <huet.benjamin@gmail.com>
 //
 //  Lol Engine is free software. It comes without any warranty, to
@@ -17,6 +17,9 @@
 #include "resource-private.h"
 
 #include <algorithm> /* for std::swap */
+#include <cctype>    /* for std::tolower */
+#include <cstring>   /* for std::memcmp */
+#include <map>       /* for std::map */
 
 namespace lol
 {
@@ -55,6 +58,63 @@ static bool RegisterAllCodecs(std::vector<ResourceCodec *> &codeclist)
     return true;
 }
 
+/*
+ * Probing files
+ */
+
+ResourceProbe::ResourceProbe(std::string const &path)
+  : m_path(path),
+    m_extension(get_extension(path))
+{
+    m_fp = fopen(sys::get_data_path(path).c_str(), "rb");
+    if (!m_fp)
+        return;
+
+    m_exists = true;
+    m_header.resize(header_size);
+    m_header.resize(fread(m_header.data(), 1, header_size, m_fp));
+}
+
+ResourceProbe::~ResourceProbe()
+{
+    if (m_fp)
+        fclose(m_fp);
+}
+
+std::string ResourceProbe::get_extension(std::string const &path)
+{
+    std::string ret;
+    size_t dot = path.find_last_of('.');
+    size_t sep = path.find_last_of("/\\");
+    if (dot != std::string::npos && (sep == std::string::npos || dot > sep))
+        for (char ch : path.substr(dot + 1))
+            ret += (char)std::tolower((unsigned char)ch);
+    return ret;
+}
+
+bool ResourceProbe::has_magic(char const *magic, size_t len, size_t offset) const
+{
+    return offset + len <= m_header.size()
+            && std::memcmp(m_header.data() + offset, magic, len) == 0;
+}
+
+std::vector<uint8_t> const &ResourceProbe::data()
+{
+    if (!m_fp)
+        return m_exists ? m_data : m_header;
+
+    /* Carry on from where the header ended */
+    m_data = std::move(m_header);
+    uint8_t buf[16384];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), m_fp)) > 0; )
+        m_data.insert(m_data.end(), buf, buf + n);
+
+    fclose(m_fp);
+    m_fp = nullptr;
+    m_header.assign(m_data.begin(), m_data.begin() + std::min(m_data.size(), header_size));
+    return m_data;
+}
+
 /*
 * Our static old_image loader
 */
@@ -67,10 +127,43 @@ public:
     inline StaticResourceLoader()
     {
         RegisterAllCodecs(m_codecs);
+
+        /* Index codecs by what they can do, keeping the priority order */
+        for (auto codec : m_codecs)
+        {
+            uint32_t caps = codec->GetCapabilities();
+            if (caps & ResourceCodec::can_load)
+                m_loaders.push_back(codec);
+            if (caps & ResourceCodec::can_save)
+            {
+                auto exts = codec->GetExtensions();
+                for (auto const &ext : exts)
+                    m_savers[ext];
+                if (exts.empty())
+                    m_any_savers.push_back(codec);
+            }
+        }
+
+        for (auto &it : m_savers)
+            for (auto codec : m_codecs)
+            {
+                if (!(codec->GetCapabilities() & ResourceCodec::can_save))
+                    continue;
+                auto exts = codec->GetExtensions();
+                if (exts.empty() || std::find(exts.begin(), exts.end(), it.first) != exts.end())
+                    it.second.push_back(codec);
+            }
+    }
+
+    std::vector<ResourceCodec *> const &savers(std::string const &ext) const
+    {
+        auto it = m_savers.find(ext);
+        return it == m_savers.end() ? m_any_savers : it->second;
     }
 
 private:
-    std::vector<ResourceCodec *> m_codecs;
+    std::vector<ResourceCodec *> m_codecs, m_loaders, m_any_savers;
+    std::map<std::string, std::vector<ResourceCodec *>> m_savers;
 }
 g_resource_loader;
 
@@ -80,11 +173,26 @@ g_resource_loader;
 
 ResourceCodecData* ResourceLoader::Load(std::string const &path)
 {
-    ResourceCodec* last_codec = nullptr;
-    for (auto codec : g_resource_loader.m_codecs)
+    ResourceProbe probe(path);
+
+    /* Codecs that recognise the data go first, then those that cannot
+     * tell; codecs that know they cannot load it are never tried. */
+    std::vector<ResourceCodec *> sure, unsure;
+    for (auto codec : g_resource_loader.m_loaders)
+    {
+        switch (codec->Probe(probe))
+        {
+        case ResourceCodec::match::yes: sure.push_back(codec); break;
+        case ResourceCodec::match::maybe: unsure.push_back(codec); break;
+        case ResourceCodec::match::no: break;
+        }
+    }
+    sure.insert(sure.end(), unsure.begin(), unsure.end());
+
+    for (auto codec : sure)
     {
-        last_codec = codec;
-        auto data = codec->Load(path);
+        auto data = codec->GetCapabilities() & ResourceCodec::can_stream
+                  ? codec->LoadProbe(probe) : codec->Load(path);
         if (data != nullptr)
         {
             msg::debug("old_image::load: codec %s succesfully loaded %s.\n",
@@ -94,17 +202,17 @@ ResourceCodecData* ResourceLoader::Load(std::string const &path)
     }
 
     //Log error, because we shouldn't be here
-    msg::error("old_image::load: last codec %s, error loading resource %s.\n",
-               last_codec->GetName().c_str(), path.c_str());
+    msg::error("old_image::load: tried %d codecs, error loading resource %s.\n",
+               (int)sure.size(), path.c_str());
     return nullptr;
 }
 
 bool ResourceLoader::Save(std::string const &path, ResourceCodecData* data)
 {
-    ResourceCodec* last_codec = nullptr;
-    for (auto codec : g_resource_loader.m_codecs)
+    auto const &codecs = g_resource_loader.savers(ResourceProbe::get_extension(path));
+
+    for (auto codec : codecs)
     {
-        last_codec = codec;
         if (codec->Save(path, data))
         {
             msg::debug("old_image::save: codec %s succesfully saved %s.\n",
@@ -114,11 +222,10 @@ bool ResourceLoader::Save(std::string const &path, ResourceCodecData* data)
     }
 
     //Log error, because we shouldn't be here
-    msg::error("old_image::save: last codec %s, error saving resource %s.\n",
-               last_codec->GetName().c_str(), path.c_str());
+    msg::error("old_image::save: tried %d codecs, error saving resource %s.\n",
+               (int)codecs.size(), path.c_str());
     return false;
 }
 
 
 } /* namespace lol */
-
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010–2024 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -15,19 +15,29 @@
 //
 // The audio interface
 // ———————————————————
-// Helper functions to set up the audio device.
+// Helper functions to set up the audio device. Streams are added and
+// removed through a lock-free queue, so the thread rendering audio never
+// waits for the game.
 //
 
 #include <functional>
 #include <lol/audio/stream>
+#include <type_traits>
 #include <unordered_map>
 
+#include "dsp.h"
+
 namespace lol::audio
 {
 
 void init();
 void shutdown();
 
+// Mix all running streams into buf, as interleaved 48 kHz stereo. This is
+// what the device callback calls; without a device, e.g. in tests, call it
+// from a single thread of your own. It does not allocate or lock.
+void render(float *buf, size_t frames);
+
 // Declare generic start_stream
 template<typename S, typename T = typename S::sample_type>
 int start_stream(std::shared_ptr<S> s0);
@@ -36,11 +46,16 @@ int start_stream(std::shared_ptr<S> s0);
 template<>
 int start_stream(std::shared_ptr<stream<float>> stream);
 
-// Definition for all the non-specialised start_stream
+// Definition for all the non-specialised start_stream. Channels and
+// frequency are adapted by the float version.
 template<typename S, typename T>
 inline int start_stream(std::shared_ptr<S> s0)
 {
-    std::shared_ptr<stream<float>> s = make_adapter<float>(s0, 2, 48000);
+    std::shared_ptr<stream<float>> s;
+    if constexpr (std::is_same_v<T, int16_t>)
+        s = dsp::make_output_adapter(std::shared_ptr<stream<int16_t>>(s0), 2, 48000);
+    else
+        s = make_adapter<float>(s0, s0->channels(), s0->frequency());
     return start_stream(s);
 }
 
@@ -0,0 +1,72 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// Audio signal processing
+// ———————————————————————
+// Sample kernels for the output path, using SSE2 or NEON when available,
+// and the streams that bring any stream to the mixer format.
+//
+
+#include <lol/audio/stream>
+#include <cstddef> // size_t
+#include <cstdint> // int16_t
+#include <memory>  // std::shared_ptr
+
+namespace lol::audio::dsp
+{
+
+// Convert 16-bit samples to floats in [-1, 1)
+void convert(int16_t const *src, float *dst, size_t samples);
+
+// Add src to dst
+void mix(float *dst, float const *src, size_t samples);
+
+// Change the channel count of interleaved frames. Mono is copied to every
+// channel, everything is averaged down to mono, and otherwise channels are
+// matched by index, extra ones being dropped or silent.
+void remix(float const *src, size_t src_channels,
+           float *dst, size_t dst_channels, size_t frames);
+
+// Bring samples smoothly into [-1, 1] with the sample::softclip() curve
+void softclip(float *buf, size_t samples);
+
+// Split interleaved frames into one buffer per channel
+void deinterleave(float const *src, size_t channels, float *const *dst, size_t frames);
+
+// Windowed sinc resampling with a polyphase filter bank
+class resampler : public stream<float>
+{
+public:
+    resampler(std::shared_ptr<stream<float>> src, int frequency);
+    ~resampler();
+
+    virtual size_t get(float *buf, size_t frames) override;
+    virtual std::optional<size_t> size() const override;
+    virtual std::optional<size_t> pos() const override;
+    virtual bool seek(size_t pos) override;
+
+private:
+    std::unique_ptr<class resampler_impl> impl;
+};
+
+// Wrap a stream so that it produces float frames with the given channel
+// count and frequency. Returns the stream itself if it already does.
+std::shared_ptr<stream<float>> make_output_adapter(std::shared_ptr<stream<int16_t>> s,
+                                                   size_t channels, int frequency);
+std::shared_ptr<stream<float>> make_output_adapter(std::shared_ptr<stream<float>> s,
+                                                   size_t channels, int frequency);
+
+} // namespace lol::audio::dsp
+
@@ -15,13 +15,21 @@
 //
 // The QOA decoder
 // ———————————————
+// Decodes one frame at a time as the stream is read, so memory use does
+// not depend on the length of the sound. Streamed files, whose length is
+// not in the header, are read until their last frame and have no size().
 //
 
 #include <lol/audio/stream>
+#include <string>
 
 namespace lol::audio
 {
 
+// The decoder keeps a copy of the encoded data
 std::shared_ptr<stream<int16_t>> make_qoa_decoder(uint8_t const *data, size_t size);
 
+// The file is mapped in memory where possible, and read otherwise
+std::shared_ptr<stream<int16_t>> make_qoa_decoder(std::string const &path);
+
 } // namespace lol
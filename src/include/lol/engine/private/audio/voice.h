@@ -0,0 +1,84 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// Voice management
+// ————————————————
+// A pool hands a fixed number of mixer voices to the sounds that matter
+// most: highest priority first, then loudest. The other sounds are virtual;
+// they are not mixed but keep track of their position, and resume where
+// they should be when they get a voice back.
+//
+
+#include <lol/audio/stream>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <memory>  // std::shared_ptr, std::unique_ptr
+
+namespace lol::audio
+{
+
+struct voice_params
+{
+    int category = 0;   // sounds sharing a concurrency cap
+    int priority = 0;   // higher priorities steal voices from lower ones
+    float volume = 1.f; // gain, including any distance attenuation
+    bool loop = false;
+};
+
+class voice_pool
+{
+public:
+    voice_pool(size_t voices = 32);
+    ~voice_pool();
+
+    // Sounds quieter than this are kept virtual
+    void set_threshold(float volume);
+
+    // Allow at most count sounds of a category, mixed or virtual. Past
+    // that, the weakest of them is stopped, which may be the new one.
+    void set_category_limit(int category, size_t count);
+
+    // Start a sound and return its handle, or 0 if it was dropped
+    uint64_t play(std::shared_ptr<stream<float>> s, voice_params const &params = {});
+    uint64_t play(std::shared_ptr<stream<int16_t>> s, voice_params const &params = {});
+
+    void stop(uint64_t id);
+    void stop_all();
+    void set_volume(uint64_t id, float volume);
+    void set_priority(uint64_t id, int priority);
+
+    // Whether the sound is still running, mixed or not
+    bool is_playing(uint64_t id) const;
+    bool is_virtual(uint64_t id) const;
+
+    // Advance virtual sounds, release finished ones and give the voices
+    // to the strongest sounds. Call once per frame.
+    void update(float seconds);
+
+    struct stats
+    {
+        size_t sounds = 0;  // currently running
+        size_t mixed = 0;   // of which have a voice
+        size_t stolen = 0;  // voices taken from a weaker sound
+        size_t dropped = 0; // new sounds refused by a category cap
+        size_t evicted = 0; // running sounds stopped to make room in one
+    };
+    stats get_stats() const;
+
+private:
+    std::unique_ptr<class voice_pool_impl> impl;
+};
+
+} // namespace lol::audio
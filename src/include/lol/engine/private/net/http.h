@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010–2024 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,6 +12,18 @@
 
 #pragma once
 
+//
+// The HTTP client
+// ———————————————
+// Requests are queued to a shared service that runs them on a bounded set
+// of worker threads. Connections are kept alive and reused, with a limit
+// on how many are open to the same host at the same time.
+//
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t
+#include <functional> // std::function
+#include <future>     // std::future
 #include <memory>
 #include <string>
 
@@ -26,6 +38,52 @@ enum class status : uint8_t
     error   = 3,
 };
 
+struct response
+{
+    // HTTP status code, or -1 if no response was received
+    int code = -1;
+
+    // The body, unless it was streamed elsewhere
+    std::string body;
+
+    // Number of body bytes received
+    size_t size = 0;
+
+    bool ok() const { return code >= 200 && code < 300; }
+};
+
+// Receives the body as it arrives; returning false aborts the request
+using body_sink = std::function<bool(char const *data, size_t size)>;
+
+class service
+{
+public:
+    // Run at most this many requests at once, with no more than
+    // per_host of them on the same host
+    explicit service(int workers = 8, int per_host = 4);
+    ~service();
+
+    // A process-wide service, created on first use
+    static service &get();
+
+    // Queue a GET request. The callback, if any, is called from a worker
+    // thread once the request is done.
+    std::future<response> fetch(std::string const &url);
+    void fetch(std::string const &url, std::function<void(response)> callback);
+
+    // Same, but give the body to a sink instead of keeping it
+    std::future<response> fetch(std::string const &url, body_sink sink);
+
+    // Same, writing the body to a caller-provided buffer that must stay
+    // valid until the request is done. A body that does not fit fails the
+    // request, and size tells how much of it was copied.
+    std::future<response> fetch(std::string const &url, void *buf, size_t capacity);
+
+private:
+    std::unique_ptr<class service_impl> impl;
+};
+
+// A single request at a time, for code that polls its status
 class client
 {
 public:
@@ -35,7 +93,7 @@ public:
     // Enqueue a query
     void get(std::string const &url);
 
-    // Reset state
+    // Reset state; the result of a pending query is discarded
     void reset();
 
     // Get current URL, status (may be pending), and result
@@ -44,7 +102,7 @@ public:
     std::string const & result() const;
 
 private:
-    std::unique_ptr<class client_impl> impl;
+    std::shared_ptr<class client_impl> impl;
 };
 
-} // namespace lol::net::http
\ No newline at end of file
+} // namespace lol::net::http
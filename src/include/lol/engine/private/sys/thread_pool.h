@@ -0,0 +1,55 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The thread pool
+// ———————————————
+// A fixed set of worker threads that share index ranges between them. Each
+// thread starts with an equal slice of the range and, when it runs out of
+// work, steals half of what remains from another thread.
+//
+
+#include <cstddef> // size_t
+#include <functional> // std::function
+#include <memory> // std::unique_ptr
+
+namespace lol::sys
+{
+
+class thread_pool
+{
+public:
+    // Create a pool with the given number of worker threads. A negative
+    // value means one worker per hardware thread, not counting the caller.
+    explicit thread_pool(int workers = -1);
+    ~thread_pool();
+
+    // A process-wide pool, created on first use.
+    static thread_pool &get();
+
+    // Number of threads taking part in parallel_for(), caller included.
+    int concurrency() const;
+
+    // Call fn(begin, end) on consecutive chunks of [0, count) that are at
+    // most grain items long. The calling thread takes part in the work and
+    // the call only returns once every chunk has been processed. Calls made
+    // from inside fn() run serially on the current thread.
+    void parallel_for(size_t count, size_t grain,
+                      std::function<void(size_t, size_t)> const &fn);
+
+private:
+    std::unique_ptr<class thread_pool_impl> impl;
+};
+
+} // namespace lol::sys
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -11,19 +11,21 @@
 //
 
 #include <lol/engine-internal.h>
+#include <lol/engine/audio>
 #include <lol/msg>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <memory>
+#include <vector>
 
-#if LOL_USE_SDL_MIXER
+#if LOL_USE_SDL
 #   if HAVE_SDL2_SDL_H
 #       include <SDL2/SDL.h>
-#       include <SDL2/SDL_mixer.h>
 #   elif HAVE_SDL_H
 #       include <SDL.h>
-#       include <SDL_mixer.h>
 #   endif
 #endif
 
@@ -33,6 +35,77 @@ namespace lol
 /* The sample cache */
 static entity_dict<sample> sample_cache;
 
+/*
+ * A view on decoded samples; every sound playing a sample gets one
+ */
+
+class sample_stream : public audio::stream<int16_t>
+{
+public:
+    sample_stream(std::shared_ptr<std::vector<int16_t> const> pcm,
+                  size_t channels, int frequency)
+      : audio::stream<int16_t>(channels, frequency),
+        m_pcm(pcm)
+    {}
+
+    virtual size_t get(int16_t *buf, size_t frames) override
+    {
+        size_t todo = std::min(frames, m_pcm->size() / m_channels - m_pos);
+        std::copy_n(m_pcm->data() + m_pos * m_channels, todo * m_channels, buf);
+        m_pos += todo;
+        return todo;
+    }
+
+    virtual std::optional<size_t> size() const override
+    {
+        return m_pcm->size() / m_channels;
+    }
+
+    virtual std::optional<size_t> pos() const override
+    {
+        return m_pos;
+    }
+
+    virtual bool seek(size_t pos) override
+    {
+        m_pos = std::min(pos, m_pcm->size() / m_channels);
+        return true;
+    }
+
+private:
+    std::shared_ptr<std::vector<int16_t> const> m_pcm;
+    size_t m_pos = 0;
+};
+
+/*
+ * Updates the voice pool once per game tick
+ */
+
+class voice_ticker : public entity
+{
+public:
+    voice_ticker(audio::voice_pool &pool)
+      : m_pool(pool)
+    {}
+
+    virtual std::string GetName() const override
+    {
+        return "<voice_ticker>";
+    }
+
+protected:
+    virtual void tick_game(float seconds) override
+    {
+        entity::tick_game(seconds);
+
+        // Give the mixer voices to the sounds that matter most
+        m_pool.update(seconds);
+    }
+
+private:
+    audio::voice_pool &m_pool;
+};
+
 /*
  * sample implementation class
  */
@@ -42,13 +115,65 @@ class sample_data
     friend class sample;
 
 private:
+    bool load(std::string const &path);
+
     std::string m_name;
-#if defined LOL_USE_SDL_MIXER
-    Mix_Chunk *m_chunk;
-    int m_channel;
-#endif
+    std::shared_ptr<std::vector<int16_t>> m_pcm;
+    size_t m_channels = 2;
+    int m_frequency = 22050;
+
+    // The last sound started by play() or loop()
+    uint64_t m_sound = 0;
 };
 
+bool sample_data::load(std::string const &path)
+{
+    std::string file = sys::get_data_path(path);
+
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".qoa") == 0)
+    {
+        auto s = audio::make_qoa_decoder(file);
+        if (!s->channels() || !s->frequency())
+            return false;
+
+        m_channels = s->channels();
+        m_frequency = s->frequency();
+        std::vector<int16_t> buf(4096 * m_channels);
+        while (size_t n = s->get(buf.data(), 4096))
+            m_pcm->insert(m_pcm->end(), buf.begin(), buf.begin() + n * m_channels);
+        return true;
+    }
+
+#if LOL_USE_SDL
+    SDL_AudioSpec spec;
+    Uint8 *data;
+    Uint32 len;
+    if (!SDL_LoadWAV(file.c_str(), &spec, &data, &len))
+        return false;
+
+    // Bring whatever the file holds to 16-bit samples
+    SDL_AudioCVT cvt;
+    SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+                      AUDIO_S16SYS, spec.channels, spec.freq);
+    std::vector<Uint8> bytes(len * std::max(cvt.len_mult, 1));
+    std::memcpy(bytes.data(), data, len);
+    SDL_FreeWAV(data);
+
+    cvt.buf = bytes.data();
+    cvt.len = (int)len;
+    if (cvt.needed && SDL_ConvertAudio(&cvt) < 0)
+        return false;
+
+    m_channels = spec.channels;
+    m_frequency = spec.freq;
+    m_pcm->resize((cvt.needed ? cvt.len_cvt : len) / sizeof(int16_t));
+    std::memcpy(m_pcm->data(), bytes.data(), m_pcm->size() * sizeof(int16_t));
+    return true;
+#else
+    return false;
+#endif
+}
+
 /*
  * Public sample class
  */
@@ -56,31 +181,41 @@ private:
 sample *sample::create(std::string const &path)
 {
     auto ret = sample_cache.get(path);
-    return ret ? ret : sample_cache.set(path, new sample(path));
+    if (!ret)
+        ret = sample_cache.set(path, new sample(path));
+    Ticker::Ref(ret);
+    return ret;
 }
 
 sample *sample::create(void const *samples, size_t len)
 {
-    return new sample(samples, len);
+    auto ret = new sample(samples, len);
+    Ticker::Ref(ret);
+    return ret;
 }
 
 void sample::destroy(sample *s)
 {
-    // FIXME: decrement!
-    sample_cache.erase(s);
+    // The ticker releases the sample once nobody holds it
+    if (Ticker::Unref(s) == 0)
+        sample_cache.erase(s);
 }
 
 sample::sample(std::string const &path)
   : data(std::make_unique<sample_data>())
 {
     data->m_name = std::string("<sample> ") + path;
+    data->m_pcm = std::make_shared<std::vector<int16_t>>();
 
-#if defined LOL_USE_SDL_MIXER
-    data->m_chunk = Mix_LoadWAV(sys::get_data_path(path).c_str());
-    if (!data->m_chunk)
-        msg::error("could not load sample %s: %s\n", path.c_str(), Mix_GetError());
-    data->m_channel = -1;
+    if (!data->load(path))
+    {
+#if LOL_USE_SDL
+        msg::error("could not load sample %s: %s\n", path.c_str(), SDL_GetError());
+#else
+        msg::error("could not load sample %s\n", path.c_str());
 #endif
+        data->m_pcm->clear();
+    }
 }
 
 sample::sample(void const *samples, size_t len)
@@ -88,19 +223,14 @@ sample::sample(void const *samples, size_t len)
 {
     data->m_name = std::string("<sample>");
 
-#if defined LOL_USE_SDL_MIXER
-    // FIXME: this requires that the data is kept around; should we copy it?
-    data->m_chunk = Mix_QuickLoad_RAW((Uint8 *)const_cast<void *>(samples), (Uint32)len);
-    data->m_channel = -1;
-#endif
+    // Raw data is 16-bit stereo at 22.05 kHz; keep a copy so that the
+    // caller does not need to hold on to it
+    auto p = static_cast<int16_t const *>(samples);
+    data->m_pcm = std::make_shared<std::vector<int16_t>>(p, p + len / sizeof(int16_t));
 }
 
 sample::~sample()
 {
-#if defined LOL_USE_SDL_MIXER
-    if (data->m_chunk)
-        Mix_FreeChunk(data->m_chunk);
-#endif
 }
 
 void sample::tick_game(float seconds)
@@ -113,30 +243,43 @@ std::string sample::GetName() const
     return data->m_name;
 }
 
-void sample::play()
+audio::voice_pool &sample::voices()
 {
-#if defined LOL_USE_SDL_MIXER
-    if (data->m_chunk)
-        data->m_channel = Mix_PlayChannel(-1, data->m_chunk, 0);
-#endif
+    static audio::voice_pool pool;
+
+    // Ticked for as long as the program runs
+    static voice_ticker *ticker = []()
+    {
+        auto ret = new voice_ticker(pool);
+        Ticker::Ref(ret);
+        return ret;
+    }();
+    (void)ticker;
+
+    return pool;
 }
 
-void sample::loop()
+void sample::play(audio::voice_params const &params)
 {
-#if defined LOL_USE_SDL_MIXER
-    if (data->m_chunk)
-        data->m_channel = Mix_PlayChannel(-1, data->m_chunk, -1);
-#endif
+    if (data->m_pcm->empty())
+        return;
+
+    auto s = std::make_shared<sample_stream>(data->m_pcm, data->m_channels, data->m_frequency);
+    data->m_sound = voices().play(std::shared_ptr<audio::stream<int16_t>>(s), params);
+}
+
+void sample::loop(audio::voice_params const &params)
+{
+    audio::voice_params looped = params;
+    looped.loop = true;
+    play(looped);
 }
 
 void sample::stop()
 {
-#if defined LOL_USE_SDL_MIXER
-    if (data->m_channel >= 0)
-        Mix_HaltChannel(data->m_channel);
-    data->m_channel = -1;
-#endif
+    if (data->m_sound)
+        voices().stop(data->m_sound);
+    data->m_sound = 0;
 }
 
 } /* namespace lol */
-
@@ -20,6 +20,7 @@
 // Ticker class for the ticking logic and the linked list implementation.
 //
 
+#include <atomic>   // std::atomic
 #include <map>      // std::map
 #include <string>   // std::string
 #include <stdint.h>
@@ -47,6 +48,12 @@ public:
         release_draw = 1 << 4,
         destroying   = 1 << 5,
         autorelease  = 1 << 6,
+        // Set by entities whose tick_game() may run concurrently with
+        // the other parallel entities of the same tick group
+        parallel_game = 1 << 7,
+        // Ticker bookkeeping: in at least one draw list / out of all lists
+        drawable     = 1 << 8,
+        dead         = 1 << 9,
     };
 
     inline void add_flags(flags f);
@@ -72,8 +79,11 @@ protected:
     tickable::group::draw m_drawgroup;
 
 private:
-    flags m_flags = flags::none;
+    // Atomic because the game and draw threads may update it concurrently
+    // when the ticker pipelines frames
+    std::atomic<uint16_t> m_flags = 0;
     int m_ref = 0;
+    int m_autolist_index = -1;
     uint64_t m_scene_mask = 0;
 };
 
@@ -92,9 +102,9 @@ static inline entity::flags operator ^(entity::flags a, entity::flags b)
     return (entity::flags)((uint16_t)a ^ (uint16_t)b);
 }
 
-inline void entity::add_flags(entity::flags f) { m_flags = m_flags | f; }
-inline void entity::remove_flags(entity::flags f) { m_flags = (m_flags | f) ^ f; }
-inline bool entity::has_flags(entity::flags f) { return (m_flags & f) != flags::none; }
+inline void entity::add_flags(entity::flags f) { m_flags.fetch_or((uint16_t)f); }
+inline void entity::remove_flags(entity::flags f) { m_flags.fetch_and((uint16_t)~(uint16_t)f); }
+inline bool entity::has_flags(entity::flags f) { return (m_flags & (uint16_t)f) != 0; }
 
 template<typename T> struct entity_dict
 {
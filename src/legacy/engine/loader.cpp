@@ -0,0 +1,279 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+#include <lol/msg>
+
+#include <algorithm> // std::max
+#include <chrono>    // std::chrono::steady_clock
+#include <utility>   // std::move
+
+namespace lol
+{
+
+/*
+ * Request queue
+ */
+
+loader_queue::loader_queue(load_function fn)
+  : m_load(fn)
+{
+}
+
+double loader_queue::now()
+{
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(t).count();
+}
+
+uint64_t loader_queue::load(std::string const &path, int priority, loader::callback fn)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    uint64_t id = ++m_last_id;
+    m_requests[id] = path;
+    ++m_stats.requests;
+
+    auto it = m_jobs.find(path);
+    if (it != m_jobs.end())
+    {
+        // Join the pending load, and move it forward if we are in a hurry
+        auto &j = it->second;
+        j.requests.push_back(request { id, now(), fn });
+        ++m_stats.shared;
+        if (j.status == state::queued && priority > j.priority)
+        {
+            m_queue.erase(make_key(j, path));
+            j.priority = priority;
+            m_queue.insert(make_key(j, path));
+        }
+        return id;
+    }
+
+    auto &j = m_jobs[path];
+    j.priority = priority;
+    j.seq = ++m_last_seq;
+    j.requests.push_back(request { id, now(), fn });
+    m_queue.insert(make_key(j, path));
+
+    m_stats.queued = (int)m_queue.size();
+    m_stats.max_queued = std::max(m_stats.max_queued, m_stats.queued);
+
+    lock.unlock();
+    m_cv.notify_one();
+    return id;
+}
+
+void loader_queue::set_priority(uint64_t request, int priority)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_requests.find(request);
+    if (it == m_requests.end())
+        return;
+
+    auto &path = it->second;
+    auto &j = m_jobs[path];
+    if (j.status != state::queued || j.priority == priority)
+        return;
+
+    m_queue.erase(make_key(j, path));
+    j.priority = priority;
+    m_queue.insert(make_key(j, path));
+}
+
+bool loader_queue::cancel(uint64_t request)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_requests.find(request);
+    if (it == m_requests.end())
+        return false;
+
+    std::string path = std::move(it->second);
+    m_requests.erase(it);
+    ++m_stats.cancelled;
+
+    auto jt = m_jobs.find(path);
+    auto &j = jt->second;
+    j.requests.erase(std::find_if(j.requests.begin(), j.requests.end(),
+                                  [&](loader_queue::request const &r) { return r.id == request; }));
+    if (!j.requests.empty())
+        return true;
+
+    // Nobody is interested any more. A load that is under way is left
+    // alone, and serve() throws its result away.
+    switch (j.status)
+    {
+    case state::queued:
+        m_queue.erase(make_key(j, path));
+        m_stats.queued = (int)m_queue.size();
+        m_jobs.erase(jt);
+        break;
+    case state::done:
+        m_done.erase(std::find(m_done.begin(), m_done.end(), path));
+        m_jobs.erase(jt);
+        break;
+    case state::loading:
+        break;
+    }
+
+    return true;
+}
+
+loader::stats loader_queue::get_stats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    loader::stats ret = m_stats;
+    if (m_delivered)
+        ret.latency = float(m_total_latency / m_delivered);
+    if (ret.loaded + ret.failed)
+        ret.load_time = float(m_total_load_time / (ret.loaded + ret.failed));
+    return ret;
+}
+
+bool loader_queue::serve(bool wait)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (wait)
+        m_cv.wait(lock, [&]() { return m_quit || !m_queue.empty(); });
+    if (m_quit)
+        return false;
+    if (m_queue.empty())
+        return true;
+
+    std::string path = std::get<2>(*m_queue.begin());
+    m_queue.erase(m_queue.begin());
+    m_stats.queued = (int)m_queue.size();
+    m_jobs[path].status = state::loading;
+    lock.unlock();
+
+    double start = now();
+    std::shared_ptr<ResourceCodecData> data(m_load(path));
+    double time = now() - start;
+
+    lock.lock();
+    m_total_load_time += time;
+    ++(data ? m_stats.loaded : m_stats.failed);
+
+    // Loading jobs are never removed by cancel(), so this one is still here
+    auto jt = m_jobs.find(path);
+    if (jt->second.requests.empty())
+    {
+        m_jobs.erase(jt);
+        return true;
+    }
+
+    jt->second.status = state::done;
+    jt->second.data = std::move(data);
+    m_done.push_back(path);
+    return true;
+}
+
+void loader_queue::deliver()
+{
+    std::vector<job> jobs;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        double const t = now();
+        for (auto const &path : m_done)
+        {
+            auto jt = m_jobs.find(path);
+            for (auto const &r : jt->second.requests)
+            {
+                double latency = t - r.time;
+                m_total_latency += latency;
+                m_stats.max_latency = std::max(m_stats.max_latency, float(latency));
+                ++m_delivered;
+                m_requests.erase(r.id);
+            }
+            jobs.push_back(std::move(jt->second));
+            m_jobs.erase(jt);
+        }
+        m_done.clear();
+    }
+
+    // Callbacks may queue new requests, so run them without the lock
+    for (auto const &j : jobs)
+        for (auto const &r : j.requests)
+            r.fn(j.data);
+}
+
+void loader_queue::start()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_quit = false;
+}
+
+void loader_queue::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cv.notify_all();
+}
+
+/*
+ * Public loader class
+ */
+
+static loader_queue g_loader([](std::string const &path)
+{
+    return ResourceLoader::Load(path);
+});
+
+uint64_t loader::load(std::string const &path, int priority, callback fn)
+{
+    return g_loader.load(path, priority, fn);
+}
+
+void loader::set_priority(uint64_t request, int priority)
+{
+    g_loader.set_priority(request, priority);
+}
+
+bool loader::cancel(uint64_t request)
+{
+    return g_loader.cancel(request);
+}
+
+loader::stats loader::get_stats()
+{
+    return g_loader.get_stats();
+}
+
+bool loader::serve(bool wait)
+{
+    return g_loader.serve(wait);
+}
+
+void loader::deliver()
+{
+    g_loader.deliver();
+}
+
+void loader::start()
+{
+    g_loader.start();
+}
+
+void loader::stop()
+{
+    g_loader.stop();
+}
+
+} /* namespace lol */
+
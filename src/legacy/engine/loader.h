@@ -0,0 +1,160 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The loader class
+// ————————————————
+// Loads resources on the ticker’s disk thread. Requests are served by
+// priority, requests for a path that is already pending share a single
+// load, and results are handed to the game thread at the start of a tick.
+//
+
+#include <stdint.h>           // uint64_t
+#include <condition_variable> // std::condition_variable
+#include <functional>         // std::function
+#include <map>                // std::map
+#include <memory>             // std::shared_ptr
+#include <mutex>              // std::mutex
+#include <set>                // std::set
+#include <string>             // std::string
+#include <tuple>              // std::tuple
+#include <vector>             // std::vector
+
+namespace lol
+{
+
+class ResourceCodecData;
+
+class loader
+{
+public:
+    // Called on the game thread; data is null if the resource could not
+    // be loaded. Requests that shared a load also share the data.
+    using callback = std::function<void(std::shared_ptr<ResourceCodecData> data)>;
+
+    // Queue a request and return its identifier. Higher priorities are
+    // loaded first, and requests of equal priority in the order they came.
+    static uint64_t load(std::string const &path, int priority, callback fn);
+
+    // Change the priority of a request that is still waiting for the disk.
+    static void set_priority(uint64_t request, int priority);
+
+    // Forget about a request. If no other request shares its path, the
+    // load is dropped or, if already under way, its result is discarded.
+    // Returns false if the callback already ran or is about to.
+    static bool cancel(uint64_t request);
+
+    struct stats
+    {
+        int queued = 0;          // paths waiting for the disk thread
+        int max_queued = 0;
+        int requests = 0;
+        int shared = 0;          // requests that joined a pending load
+        int cancelled = 0;
+        int loaded = 0, failed = 0;
+        float latency = 0.f;     // average, from request to delivery, in seconds
+        float max_latency = 0.f; // in seconds
+        float load_time = 0.f;   // average time spent loading, in seconds
+    };
+    static stats get_stats();
+
+private:
+    friend class ticker_data;
+
+    // Called by the ticker: serve one request, optionally waiting for one
+    // to arrive, and return false once stopped.
+    static bool serve(bool wait);
+    static void deliver();
+    static void start();
+    static void stop();
+
+    loader() {}
+};
+
+//
+// The queue behind the loader class. It owns no thread: serve() runs on
+// whichever thread does the loading, and deliver() on the one that wants
+// the results. The load function is ResourceLoader::Load() for the
+// engine’s loader, and can be replaced when driving a queue by hand.
+//
+
+class loader_queue
+{
+public:
+    using load_function = std::function<ResourceCodecData *(std::string const &path)>;
+
+    loader_queue(load_function fn);
+
+    uint64_t load(std::string const &path, int priority, loader::callback fn);
+    void set_priority(uint64_t request, int priority);
+    bool cancel(uint64_t request);
+    loader::stats get_stats();
+
+    bool serve(bool wait);
+    void deliver();
+    void start();
+    void stop();
+
+private:
+    static double now();
+
+    struct request
+    {
+        uint64_t id;
+        double time;
+        loader::callback fn;
+    };
+
+    enum class state : uint8_t
+    {
+        queued,
+        loading,
+        done,
+    };
+
+    struct job
+    {
+        int priority = 0;
+        uint64_t seq = 0;
+        state status = state::queued;
+        std::vector<request> requests;
+        std::shared_ptr<ResourceCodecData> data;
+    };
+
+    // Highest priority first, then first come first served
+    using key = std::tuple<int, uint64_t, std::string>;
+    static key make_key(job const &j, std::string const &path)
+    {
+        return key(-j.priority, j.seq, path);
+    }
+
+    load_function m_load;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_quit = false;
+
+    // Every path with at least one request that was not delivered yet
+    std::map<std::string, job> m_jobs;
+    std::set<key> m_queue;
+    std::map<uint64_t, std::string> m_requests;
+    std::vector<std::string> m_done;
+    uint64_t m_last_id = 0, m_last_seq = 0;
+
+    loader::stats m_stats;
+    double m_total_latency = 0.0, m_total_load_time = 0.0;
+    int m_delivered = 0;
+};
+
+} /* namespace lol */
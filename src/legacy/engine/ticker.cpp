@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -11,10 +11,15 @@
 //
 
 #include <lol/engine-internal.h>
+#include <lol/engine/sys> // lol::sys::thread_pool
 #include <lol/msg>
 
+#include <algorithm>     // std::clamp
+#include <atomic>        // std::atomic
 #include <cassert>       // assert
+#include <mutex>         // std::mutex
 #include <unordered_set> // std::unordered_set
+#include <utility>       // std::swap
 #include <cstdlib>
 #include <functional>
 #include <vector>        // std::vector
@@ -38,26 +43,42 @@ public:
         if (thread::has_threads())
         {
             gamethread = std::make_unique<thread>(std::bind(&ticker_data::GameThreadMain, this));
-            drawtick.push(1);
+            /* Start by drawing the empty frame 0 so that entities can be
+             * created before the game thread starts ticking. */
+            drawtick.push(0);
 
+            loader::start();
             diskthread = std::make_unique<thread>(std::bind(&ticker_data::DiskThreadMain, this));
         }
     }
 
     ~ticker_data()
     {
-        assert(DEPRECATED_nentities == 0);
-        assert(DEPRECATED_m_autolist.size() == 0);
+#if !LOL_BUILD_RELEASE
+        /* Entities still alive now would point to a dead ticker */
+        if (DEPRECATED_nentities || DEPRECATED_m_autolist.size())
+            msg::error("ticker destroyed with %d entities left\n", DEPRECATED_nentities);
+#endif
 
         msg::debug("%d frames required to quit\n", m_frame - m_quitframe);
 
-        if (thread::has_threads())
+        stop_threads();
+    }
+
+    /* Let the game thread run the ticks it was given, then join it and
+     * the disk thread. The game thread ticks through the global data
+     * pointer, so this must happen before that pointer is reset. */
+    void stop_threads()
+    {
+        if (gamethread)
         {
             gametick.push(0);
-            disktick.push(0);
-            gamethread.release();
-            diskthread.release();
-            assert(drawtick.size() == 0);
+            gamethread.reset(); // joins the thread
+        }
+        if (diskthread)
+        {
+            loader::stop();
+            diskthread.reset(); // joins the thread
         }
     }
 
@@ -70,23 +91,67 @@ private:
 
     std::unordered_set<std::shared_ptr<tickable>> m_tickables;
 
-    /* Entity management */
+    /* Entity management. Every inserted entity is in exactly one game
+     * list, and in one draw list per scene it is relevant to. */
+    static int constexpr draw_groups = (int)tickable::group::draw::end - (int)tickable::group::draw::begin;
     std::vector<entity *> DEPRECATED_m_todolist, DEPRECATED_m_todolist_delayed, DEPRECATED_m_autolist;
-    std::vector<entity *> DEPRECATED_m_list[(int)tickable::group::all::end];
-    std::vector<int> DEPRECATED_m_scenes[(int)tickable::group::all::end];
+    std::vector<entity *> DEPRECATED_m_list[(int)tickable::group::game::end];
+    std::vector<std::vector<entity *>> m_draw_lists[draw_groups];
     int DEPRECATED_nentities = 0;
 
-    /* Fixed framerate management */
-    int m_frame = 0, m_recording = 0;
+    /* Fixed framerate management. The game thread measures time and the
+     * draw thread waits; bias is only touched by the draw thread, which
+     * learns about elapsed time through the frame snapshots. */
+    int m_frame = 0;
+    std::atomic<int> m_recording = 0;
     timer m_timer;
-    float deltatime = 0.f, bias = 0.f, fps = 0.f;
+    float deltatime = 0.f, elapsed = 0.f, bias = 0.f, fps = 0.f;
+    bool late = false;
 #if LOL_BUILD_DEBUG
     float keepalive = 0;
 #endif
 
+    /* Parallel game tick. The requested thread count is applied by the
+     * game thread at the start of a tick, never while the pool is busy. */
+    std::atomic<int> m_game_threads_request = 0;
+    int m_game_threads = 0;
+    std::unique_ptr<sys::thread_pool> m_pool;
+    std::vector<entity *> m_parallel_list;
+
+    /* Frame pipelining: each game tick fills the snapshot of its frame,
+     * and the draw thread only ever reads from that snapshot. */
+    static int constexpr max_depth = 3;
+
+    struct frame_snapshot
+    {
+        int frame = 0;
+        float deltatime = 0.f;
+        float elapsed = 0.f; /* to add to the bias, unless late */
+        bool late = false;   /* the frame took too long; reset the bias */
+        double start = 0.0;
+        std::vector<entity *> draw_list[draw_groups];
+    };
+
+    struct depth_stats
+    {
+        int frames = 0;
+        double latency = 0.0, max_latency = 0.0, time = 0.0;
+    };
+
+    frame_snapshot m_snapshots[max_depth];
+    std::atomic<int> m_depth_request = 1, m_drawn_frame = 0;
+    int m_depth = 1; /* tickets currently in flight; draw thread only */
+    std::vector<std::pair<int, entity *>> m_graveyard;
+    timer m_clock;
+    std::mutex m_stats_mutex;
+    depth_stats m_stats[max_depth + 1];
+    double m_last_draw = 0.0;
+    int m_last_depth = 0;
+
     /* The three main functions (for now) */
     static void GameThreadTick();
-    static void DrawThreadTick();
+    static void tick_game_entity(entity *e);
+    static void DrawThreadTick(frame_snapshot const &snapshot);
     static void DiskThreadTick();
 
     /* The associated background threads */
@@ -94,7 +159,7 @@ private:
     void DrawThreadMain(); /* unused for now */
     void DiskThreadMain();
     std::unique_ptr<thread> gamethread, diskthread;
-    queue<int> gametick, drawtick, disktick;
+    queue<int> gametick, drawtick;
 
     /* Shutdown management */
     int m_quit = 0, m_quitframe = 0, m_quitdelay = 20, m_panic = 0;
@@ -117,6 +182,42 @@ void ticker::remove(std::shared_ptr<tickable> entity)
     data->m_tickables.erase(entity);
 }
 
+void ticker::set_game_threads(int count)
+{
+    // Takes effect at the start of the next game tick
+    data->m_game_threads_request = count > 1 && thread::has_threads() ? count : 0;
+}
+
+void ticker::set_pipeline_depth(int depth)
+{
+    // The draw thread adds or withholds tickets until the new depth is reached
+    data->m_depth_request = std::clamp(depth, 1, ticker_data::max_depth);
+}
+
+int ticker::get_pipeline_depth()
+{
+    return data->m_depth_request;
+}
+
+ticker::pipeline_stats ticker::get_pipeline_stats(int depth)
+{
+    pipeline_stats ret;
+    if (depth < 1 || depth > ticker_data::max_depth)
+        return ret;
+
+    std::lock_guard<std::mutex> lock(data->m_stats_mutex);
+    auto const &s = data->m_stats[depth];
+    ret.frames = s.frames;
+    if (s.frames)
+    {
+        ret.latency = float(s.latency / s.frames);
+        ret.max_latency = float(s.max_latency);
+    }
+    if (s.time > 0.0)
+        ret.throughput = float(s.frames / s.time);
+    return ret;
+}
+
 //
 // Old API for entities
 //
@@ -129,6 +230,7 @@ void Ticker::Register(entity *entity)
     data->DEPRECATED_m_todolist_delayed.push_back(entity);
 
     /* Objects are autoreleased by default. Put them in a list. */
+    entity->m_autolist_index = (int)data->DEPRECATED_m_autolist.size();
     data->DEPRECATED_m_autolist.push_back(entity);
     entity->add_flags(entity::flags::autorelease);
     entity->m_ref = 1;
@@ -143,16 +245,16 @@ void Ticker::Ref(entity *entity)
 
     if (entity->has_flags(entity::flags::autorelease))
     {
-        /* Get the entity out of the autorelease list. This is usually
-         * very fast since the last entry in autolist is the last
-         * registered entity. */
-        for (size_t i = data->DEPRECATED_m_autolist.size(); i--; )
+        /* Get the entity out of the autorelease list by moving the last
+         * entry into its slot; the list order does not matter. */
+        auto &autolist = data->DEPRECATED_m_autolist;
+        if (entity->m_autolist_index >= 0)
         {
-            if (data->DEPRECATED_m_autolist[i] == entity)
-            {
-                remove_at(data->DEPRECATED_m_autolist, i);
-                break;
-            }
+            entity *last = autolist.back();
+            autolist[entity->m_autolist_index] = last;
+            last->m_autolist_index = entity->m_autolist_index;
+            autolist.pop_back();
+            entity->m_autolist_index = -1;
         }
         entity->remove_flags(entity::flags::autorelease);
     }
@@ -183,10 +285,11 @@ void ticker_data::GameThreadMain()
 
         GameThreadTick();
 
-        drawtick.push(1);
+        /* Tell the draw thread which frame is ready */
+        drawtick.push(m_frame);
     }
 
-    drawtick.push(0);
+    drawtick.push(-1);
 
 #if LOL_BUILD_DEBUG
     msg::debug("ticker game thread terminated\n");
@@ -201,11 +304,11 @@ void ticker_data::DrawThreadMain() /* unused */
 
     for (;;)
     {
-        int tick = drawtick.pop();
-        if (!tick)
+        int frame = drawtick.pop();
+        if (frame < 0)
             break;
 
-        DrawThreadTick();
+        DrawThreadTick(m_snapshots[frame % max_depth]);
 
         gametick.push(1);
     }
@@ -217,8 +320,16 @@ void ticker_data::DrawThreadMain() /* unused */
 
 void ticker_data::DiskThreadMain()
 {
-    /* FIXME: temporary hack to avoid crashes on the PS3 */
-    disktick.pop();
+#if LOL_BUILD_DEBUG
+    msg::debug("ticker disk thread initialised\n");
+#endif
+
+    while (loader::serve(true))
+        ;
+
+#if LOL_BUILD_DEBUG
+    msg::debug("ticker disk thread terminated\n");
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -229,6 +340,11 @@ void ticker_data::GameThreadTick()
 
     Profiler::Start(Profiler::STAT_TICK_GAME);
 
+    double frame_start = data->m_clock.poll();
+
+    Profiler::MarkFrame(data->m_frame + 1);
+    ProfilerZone zone("tick_game");
+
 #if 0
     msg::debug("-------------------------------------\n");
     for (int g = 0; g < (int)tickable::group::all::end; ++g)
@@ -247,10 +363,23 @@ void ticker_data::GameThreadTick()
 
     data->m_frame++;
 
+    /* Resize the parallel tick pool if asked to. Its worker threads come
+     * in addition to the game thread. */
+    int const game_threads = data->m_game_threads_request;
+    if (game_threads != data->m_game_threads)
+    {
+        data->m_pool.reset();
+        if (game_threads)
+            data->m_pool = std::make_unique<sys::thread_pool>(game_threads - 1);
+        data->m_game_threads = game_threads;
+    }
+
     /* Ensure some randomness */
     (void)rand<int>();
 
     /* If recording with fixed framerate, set deltatime to a fixed value */
+    data->elapsed = 0.f;
+    data->late = false;
     if (data->m_recording && data->fps)
     {
         data->deltatime = 1.f / data->fps;
@@ -258,14 +387,14 @@ void ticker_data::GameThreadTick()
     else
     {
         data->deltatime = data->m_timer.get();
-        data->bias += data->deltatime;
+        data->elapsed = data->deltatime;
     }
 
     /* Do not go below 15 fps */
     if (data->deltatime > 1.f / 15.f)
     {
         data->deltatime = 1.f / 15.f;
-        data->bias = 0.f;
+        data->late = true;
     }
 
 #if LOL_BUILD_DEBUG
@@ -280,6 +409,9 @@ void ticker_data::GameThreadTick()
     data->handle_shutdown();
     data->collect_garbage();
 
+    /* Hand over resources that finished loading since the last tick */
+    loader::deliver();
+
     /* Insert waiting objects into the appropriate lists */
     while (data->DEPRECATED_m_todolist.size())
     {
@@ -296,26 +428,23 @@ void ticker_data::GameThreadTick()
         data->DEPRECATED_m_list[(int)e->m_gamegroup].push_back(e);
         if (engine::has_opengl() && e->m_drawgroup != tickable::group::draw::none)
         {
-            if (data->DEPRECATED_m_scenes[(int)e->m_drawgroup].size() < Scene::GetCount())
-                data->DEPRECATED_m_scenes[(int)e->m_drawgroup].resize(Scene::GetCount());
+            auto &lists = data->m_draw_lists[(int)e->m_drawgroup - (int)tickable::group::draw::begin];
+            if (lists.size() < Scene::GetCount())
+                lists.resize(Scene::GetCount());
 
-            int added_count = 0;
             for (size_t i = 0; i < Scene::GetCount(); i++)
             {
-                //If entity is concerned by this scene, add it in the list
+                // If entity is concerned by this scene, add it in the list
                 if (Scene::GetScene(i).IsRelevant(e))
                 {
-                    insert_at(data->DEPRECATED_m_list[(int)e->m_drawgroup], data->DEPRECATED_m_scenes[(int)e->m_drawgroup][i], e);
-                    added_count++;
+                    lists[i].push_back(e);
+                    e->add_flags(entity::flags::drawable);
                 }
-                //Update scene index
-                data->DEPRECATED_m_scenes[(int)e->m_drawgroup][i] += added_count;
             }
         }
     }
 
-    data->DEPRECATED_m_todolist = data->DEPRECATED_m_todolist_delayed;
-    data->DEPRECATED_m_todolist_delayed.clear();
+    std::swap(data->DEPRECATED_m_todolist, data->DEPRECATED_m_todolist_delayed);
 
     for (int g = (int)tickable::group::game::begin; g < (int)tickable::group::game::end; ++g)
     {
@@ -341,43 +470,92 @@ void ticker_data::GameThreadTick()
     /* Tick objects for the game loop */
     for (int g = (int)tickable::group::game::begin; g < (int)tickable::group::game::end && !data->m_quit /* Stop as soon as required */; ++g)
     {
+        auto &parallel_list = data->m_parallel_list;
+        parallel_list.clear();
+
+        /* Tick serial entities right away and put aside the ones that
+         * declared they can be ticked concurrently. */
         for (size_t i = 0; i < data->DEPRECATED_m_list[g].size() && !data->m_quit /* Stop as soon as required */; ++i)
         {
             entity *e = data->DEPRECATED_m_list[g][i];
 
-            if (e->has_flags(entity::flags::init_game)
-                 && !e->has_flags(entity::flags::destroying))
+            if (!e->has_flags(entity::flags::init_game)
+                 || e->has_flags(entity::flags::destroying))
+                continue;
+
+            if (data->m_pool && e->has_flags(entity::flags::parallel_game))
+                parallel_list.push_back(e);
+            else
+                tick_game_entity(e);
+        }
+
+        /* This returns once every entity was ticked, so that the next
+         * group never sees a half-ticked one. */
+        if (parallel_list.size())
+        {
+            data->m_pool->parallel_for(parallel_list.size(), 64, [&](size_t begin, size_t end)
             {
-#if !LOL_BUILD_RELEASE
-                if (e->m_tickstate != tickable::state::idle)
-                    msg::error("entity %s [%p] not idle for game tick\n",
-                               e->GetName().c_str(), e);
-                e->m_tickstate = tickable::state::pre_game;
-#endif
-                e->tick_game(data->deltatime);
-#if !LOL_BUILD_RELEASE
-                if (e->m_tickstate != tickable::state::post_game)
-                    msg::error("entity %s [%p] missed super game tick\n",
-                               e->GetName().c_str(), e);
-                e->m_tickstate = tickable::state::idle;
-#endif
-            }
+                for (size_t i = begin; i < end && !data->m_quit; ++i)
+                    tick_game_entity(parallel_list[i]);
+            });
         }
     }
 
+    /* Take a snapshot of what the draw thread needs for this frame */
+    auto &snapshot = data->m_snapshots[data->m_frame % max_depth];
+    snapshot.frame = data->m_frame;
+    snapshot.deltatime = data->deltatime;
+    snapshot.elapsed = data->elapsed;
+    snapshot.late = data->late;
+    snapshot.start = frame_start;
+    for (int g = 0; g < draw_groups; ++g)
+    {
+        /* Scene lists are concatenated in scene order */
+        auto &list = snapshot.draw_list[g];
+        list.clear();
+        for (auto const &scene_list : data->m_draw_lists[g])
+            list.insert(list.end(), scene_list.begin(), scene_list.end());
+    }
+
     Profiler::Stop(Profiler::STAT_TICK_GAME);
 }
 
+void ticker_data::tick_game_entity(entity *e)
+{
+#if !LOL_BUILD_RELEASE
+    if (e->m_tickstate != tickable::state::idle)
+        msg::error("entity %s [%p] not idle for game tick\n",
+                   e->GetName().c_str(), e);
+    e->m_tickstate = tickable::state::pre_game;
+#endif
+    if (Profiler::ZonesEnabled())
+    {
+        ProfilerZone zone(e->GetName());
+        e->tick_game(data->deltatime);
+    }
+    else
+        e->tick_game(data->deltatime);
+#if !LOL_BUILD_RELEASE
+    if (e->m_tickstate != tickable::state::post_game)
+        msg::error("entity %s [%p] missed super game tick\n",
+                   e->GetName().c_str(), e);
+    e->m_tickstate = tickable::state::idle;
+#endif
+}
+
 //-----------------------------------------------------------------------------
-void ticker_data::DrawThreadTick()
+void ticker_data::DrawThreadTick(frame_snapshot const &snapshot)
 {
     Profiler::Start(Profiler::STAT_TICK_DRAW);
+    ProfilerZone zone("tick_draw");
 
-    for (int g = (int)tickable::group::draw::begin; g < (int)tickable::group::draw::end; ++g)
+    float const deltatime = snapshot.deltatime;
+    bool const zones = Profiler::ZonesEnabled();
+
+    for (auto const &list : snapshot.draw_list)
     {
-        for (size_t i = 0; i < data->DEPRECATED_m_list[g].size(); ++i)
+        for (entity *e : list)
         {
-            entity *e = data->DEPRECATED_m_list[g][i];
 
             if (!e->has_flags(entity::flags::init_draw))
             {
@@ -402,7 +580,7 @@ void ticker_data::DrawThreadTick()
         // Enable display
         scene.start_frame();
 
-        scene.pre_render(data->deltatime);
+        scene.pre_render(deltatime);
 
         /* Tick objects for the draw loop */
         for (int g = (int)tickable::group::draw::begin; g < (int)tickable::group::draw::end && !data->m_quit /* Stop as soon as required */; ++g)
@@ -416,9 +594,10 @@ void ticker_data::DrawThreadTick()
                 break;
             }
 
-            for (size_t i = 0; i < data->DEPRECATED_m_list[g].size() && !data->m_quit /* Stop as soon as required */; ++i)
+            auto const &list = snapshot.draw_list[g - (int)tickable::group::draw::begin];
+            for (size_t i = 0; i < list.size() && !data->m_quit /* Stop as soon as required */; ++i)
             {
-                entity *e = data->DEPRECATED_m_list[g][i];
+                entity *e = list[i];
 
                 if (e->has_flags(entity::flags::init_draw)
                      && !e->has_flags(entity::flags::destroying))
@@ -429,7 +608,13 @@ void ticker_data::DrawThreadTick()
                                    e->GetName().c_str(), e);
                     e->m_tickstate = tickable::state::pre_draw;
 #endif
-                    e->tick_draw(data->deltatime, scene);
+                    if (zones)
+                    {
+                        ProfilerZone entity_zone(e->GetName());
+                        e->tick_draw(deltatime, scene);
+                    }
+                    else
+                        e->tick_draw(deltatime, scene);
 #if !LOL_BUILD_RELEASE
                     if (e->m_tickstate != tickable::state::post_draw)
                         msg::error("entity %s [%p] missed super draw tick\n",
@@ -441,14 +626,34 @@ void ticker_data::DrawThreadTick()
         }
 
         /* Do the render step */
-        scene.render(data->deltatime);
+        scene.render(deltatime);
 
-        scene.post_render(data->deltatime);
+        scene.post_render(deltatime);
 
         // Disable display
         scene.end_frame();
     }
 
+    /* Entities that were removed after this frame can now be deleted */
+    data->m_drawn_frame = snapshot.frame;
+
+    /* Update pipelining statistics for the current depth, ignoring the
+     * initial empty frame */
+    if (snapshot.frame)
+    {
+        std::lock_guard<std::mutex> lock(data->m_stats_mutex);
+        double now = data->m_clock.poll();
+        double latency = now - snapshot.start;
+        auto &stats = data->m_stats[data->m_depth];
+        ++stats.frames;
+        stats.latency += latency;
+        stats.max_latency = std::max(stats.max_latency, latency);
+        if (data->m_last_depth == data->m_depth)
+            stats.time += now - data->m_last_draw;
+        data->m_last_draw = now;
+        data->m_last_depth = data->m_depth;
+    }
+
     Profiler::Stop(Profiler::STAT_TICK_DRAW);
 }
 
@@ -463,19 +668,27 @@ void ticker_data::handle_shutdown()
         int n = 0;
         m_panic = 2 * (m_panic + 1);
 
-        for (int g = 0; g < (int)tickable::group::all::end && n < m_panic; ++g)
-        for (size_t i = 0; i < DEPRECATED_m_list[g].size() && n < m_panic; ++i)
+        auto poke = [&](std::vector<entity *> const &list)
         {
-            entity * e = DEPRECATED_m_list[g][i];
-            if (e->m_ref)
+            for (size_t i = 0; i < list.size() && n < m_panic; ++i)
             {
+                entity * e = list[i];
+                if (e->m_ref)
+                {
 #if !LOL_BUILD_RELEASE
-                msg::error("poking %s\n", e->GetName().c_str());
+                    msg::error("poking %s\n", e->GetName().c_str());
 #endif
-                e->m_ref--;
-                n++;
+                    e->m_ref--;
+                    n++;
+                }
             }
-        }
+        };
+
+        for (auto const &list : DEPRECATED_m_list)
+            poke(list);
+        for (auto const &lists : m_draw_lists)
+            for (auto const &list : lists)
+                poke(list);
 
 #if !LOL_BUILD_RELEASE
         if (n)
@@ -491,57 +704,76 @@ void ticker_data::collect_garbage()
 {
     /* Garbage collect objects that can be destroyed. We can do this
      * before inserting awaiting objects, because only objects already
-     * in the tick lists can be marked for destruction. */
-    std::unordered_set<entity*> destroy_list;
-    for (int g = 0; g < (int)tickable::group::all::end; ++g)
+     * in the tick lists can be marked for destruction.
+     *
+     * Each list is compacted in a single pass that keeps the tick order,
+     * so removing any number of entities costs one walk over the list. */
+    for (auto &list : DEPRECATED_m_list)
     {
-        for (size_t i = DEPRECATED_m_list[g].size(); i--;)
+        size_t kept = 0;
+        for (entity *e : list)
         {
-            entity *e = DEPRECATED_m_list[g][i];
-
-            if (!e->has_flags(entity::flags::destroying))
+            // Entities missing from all draw lists never get a draw tick,
+            // so they do not need to wait for one to be released.
+            if (e->m_ref <= 0 && !e->has_flags(entity::flags::drawable))
+                e->add_flags(entity::flags::destroying | entity::flags::release_draw);
+
+            if (e->has_flags(entity::flags::destroying)
+                 && e->has_flags(entity::flags::release_game)
+                 && e->has_flags(entity::flags::release_draw))
             {
-                if (e->m_ref <= 0 && g >= (int)tickable::group::draw::begin)
-                    e->add_flags(entity::flags::destroying);
+                // Every entity is in exactly one game list, so this is
+                // where we decide it is gone for good.
+                e->add_flags(entity::flags::dead);
+                m_graveyard.push_back(std::make_pair(m_frame, e));
                 continue;
             }
 
-            // If entity is being destroyed but not released yet, retry later.
-            if (!e->has_flags(entity::flags::release_game)
-                 || !e->has_flags(entity::flags::release_draw))
-                continue;
-
-            // If entity is to be destroyed, remove it.
-            remove_at(DEPRECATED_m_list[g], i);
+            list[kept++] = e;
+        }
+        list.resize(kept);
+    }
 
-            // Draw group specific logic
-            if (engine::has_opengl() && g >= (int)tickable::group::game::end)
+    for (auto &lists : m_draw_lists)
+    {
+        for (auto &list : lists)
+        {
+            size_t kept = 0;
+            for (entity *e : list)
             {
-                int removal_count = 0;
-                for (size_t j = 0; j < Scene::GetCount(); j++)
-                {
-                    // If entity is concerned by this scene, add it in the list
-                    if (Scene::GetScene(j).IsRelevant(e))
-                        removal_count++;
-                    // Update scene index
-                    DEPRECATED_m_scenes[(int)e->m_drawgroup][j] -= removal_count;
-                }
-            }
+                if (e->has_flags(entity::flags::dead))
+                    continue;
 
-            destroy_list.insert(e);
+                if (e->m_ref <= 0)
+                    e->add_flags(entity::flags::destroying);
+
+                list[kept++] = e;
+            }
+            list.resize(kept);
         }
     }
 
-    for (entity* e : destroy_list)
+    /* Entities removed during frame F may still appear in the snapshots
+     * of frames up to F - 1, so wait until those were drawn. */
+    int const drawn_frame = m_drawn_frame;
+    size_t kept = 0;
+    for (auto const &it : m_graveyard)
     {
-        delete e;
-        --DEPRECATED_nentities;
+        if (it.first - 1 <= drawn_frame)
+        {
+            delete it.second;
+            --DEPRECATED_nentities;
+        }
+        else
+            m_graveyard[kept++] = it;
     }
+    m_graveyard.resize(kept);
 }
 
+/* Without threads, load at most one resource per frame */
 void ticker_data::DiskThreadTick()
 {
-    ;
+    loader::serve(false);
 }
 
 void Ticker::SetState(entity * /* entity */, uint32_t /* state */)
@@ -564,27 +796,56 @@ void ticker::setup(float fps)
 
 void ticker::teardown()
 {
-    data.release();
+    if (!data)
+        return;
+
+    data->stop_threads();
+    data.reset();
 }
 
 void ticker::tick_draw()
 {
+    int frame;
+
     if (thread::has_threads())
     {
-        int n = data->drawtick.pop();
-        if (n == 0)
+        frame = data->drawtick.pop();
+        if (frame < 0)
             return;
     }
     else
+    {
         ticker_data::GameThreadTick();
+        frame = data->m_frame;
+    }
 
-    ticker_data::DrawThreadTick();
+    auto const &snapshot = data->m_snapshots[frame % ticker_data::max_depth];
+    ticker_data::DrawThreadTick(snapshot);
+
+    /* Account for the time the game thread measured, before the snapshot
+     * may be reused for a later frame */
+    if (snapshot.late)
+        data->bias = 0.f;
+    else
+        data->bias += snapshot.elapsed;
 
     Profiler::Start(Profiler::STAT_TICK_BLIT);
 
-    /* Signal game thread that it can carry on */
+    /* Signal game thread that it can carry on. There are always as many
+     * tickets in flight as the pipeline depth, so give back more or fewer
+     * than we got if the depth was changed. */
     if (thread::has_threads())
-        data->gametick.push(1);
+    {
+        int depth = data->m_depth_request;
+        if (data->m_depth > depth)
+            --data->m_depth;
+        else
+        {
+            for (; data->m_depth < depth; ++data->m_depth)
+                data->gametick.push(1);
+            data->gametick.push(1);
+        }
+    }
     else
         ticker_data::DiskThreadTick();
 
@@ -627,7 +888,9 @@ void Ticker::Shutdown()
     /* We're bailing out. Release all autorelease objects. */
     while (data->DEPRECATED_m_autolist.size())
     {
-        --data->DEPRECATED_m_autolist.back()->m_ref;
+        entity *e = data->DEPRECATED_m_autolist.back();
+        --e->m_ref;
+        e->m_autolist_index = -1;
         data->DEPRECATED_m_autolist.pop_back();
     }
 
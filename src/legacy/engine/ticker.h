@@ -36,6 +36,30 @@ public:
     static void add(std::shared_ptr<tickable> entity);
     static void remove(std::shared_ptr<tickable> entity);
 
+    // Tick entities flagged parallel_game on this many threads. Tick groups
+    // still run one after the other. Zero (the default) disables it. The
+    // change applies from the next game tick.
+    static void set_game_threads(int count);
+
+    // Let the game thread run up to this many frames (1 to 3) ahead of the
+    // draw thread. With more than one frame in flight, tick_draw() may run
+    // while the game thread ticks a later frame, so drawn entities must not
+    // read state that tick_game() is modifying.
+    static void set_pipeline_depth(int depth);
+    static int get_pipeline_depth();
+
+    // Frame pipelining statistics, gathered separately for each depth.
+    // Latency is measured from the start of the game tick to the end of
+    // the draw tick of the same frame.
+    struct pipeline_stats
+    {
+        int frames = 0;
+        float latency = 0.f;     // average, in seconds
+        float max_latency = 0.f; // in seconds
+        float throughput = 0.f;  // frames per second
+    };
+    static pipeline_stats get_pipeline_stats(int depth);
+
     // The old API
     static void Register(class entity *entity);
     static void Ref(class entity *entity);
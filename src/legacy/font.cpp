@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //                   2013 Jean-Yves Lamoureux <jylam@lnxscene.org>
 //
 //  Lol Engine is free software. It comes without any warranty, to
@@ -33,7 +33,6 @@ class FontData
 private:
     std::string m_name;
     TileSet *tileset;
-    ivec2 size;
 };
 
 /*
@@ -57,8 +56,22 @@ Font::Font(std::string const &path)
 {
     data->m_name = "<font> " + path;
 
-    data->tileset = TileSet::create(path, ivec2::zero, ivec2(16));
-    data->size = data->tileset->GetTileSize(0);
+    /* Text layout needs the glyph size right away, so unlike other
+     * tilesets, fonts are loaded synchronously. If the file cannot be
+     * read, the tileset is left to the loader queue like any other. */
+    auto img = new old_image();
+    if (img->load(path))
+    {
+        data->tileset = TileSet::create(path, img, ivec2::zero, ivec2(16));
+        /* The path was already a tileset, which keeps its own image */
+        if (data->tileset->GetImage() != img)
+            delete img;
+    }
+    else
+    {
+        delete img;
+        data->tileset = TileSet::create(path, ivec2::zero, ivec2(16));
+    }
 
     m_drawgroup = tickable::group::draw::texture;
 }
@@ -87,6 +100,7 @@ std::string Font::GetName() const
 
 void Font::Print(Scene &scene, vec3 pos, std::string const &str, vec2 scale, float spacing)
 {
+    ivec2 const size = GetSize();
     float origin_x = pos.x;
     for (int i = 0; i < (int)str.length(); ++i)
     {
@@ -98,26 +112,26 @@ void Font::Print(Scene &scene, vec3 pos, std::string const &str, vec2 scale, flo
             pos.x = origin_x;
             break;
         case '\b': /* backspace */
-            pos.x -= data->size.x * scale.x;
+            pos.x -= size.x * scale.x;
             break;
         case '\n': /* new line */
             pos.x = origin_x;
-            pos.y -= data->size.y * scale.y;
+            pos.y -= size.y * scale.y;
             break;
         default:
             if (ch != ' ')
                 scene.AddTile(data->tileset, ch & 255, pos, scale, 0.0f);
-            pos.x += data->size.x * scale.x;
+            pos.x += size.x * scale.x;
             break;
         }
 
-        pos.x += data->size.x * scale.x * spacing;
+        pos.x += size.x * scale.x * spacing;
     }
 }
 
 ivec2 Font::GetSize() const
 {
-    return data->size;
+    return data->tileset->GetTileSize(0);
 }
 
 } /* namespace lol */
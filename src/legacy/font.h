@@ -41,6 +41,9 @@ protected:
 public:
     /* New methods */
     void Print(Scene &scene, vec3 pos, std::string const &str, vec2 scale = vec2(1.0f), float spacing = 0.0f);
+    /* The glyph size. Fonts are loaded synchronously by create(), so it is
+     * known right away; it is zero if the font file could not be read, or
+     * if the same path was already a tileset that is still loading. */
     ivec2 GetSize() const;
 
 private:
@@ -15,6 +15,8 @@
 
 #include "lolgl.h"
 
+#include <algorithm> // std::max
+
 // FIXME: can we make this more generic?
 #if defined __EMSCRIPTEN__ || defined HAVE_GLES_2X
     #define glGenVertexArrays glGenVertexArraysOES
@@ -36,6 +38,8 @@ class VertexBufferData
     friend class VertexDeclaration;
 
     size_t m_size;
+    size_t m_lock_offset = 0, m_lock_size = 0;
+    bool m_uploaded = false;
 
 #if defined LOL_USE_GLEW || defined HAVE_GL_2X || defined HAVE_GLES_2X
     GLuint m_vbo;
@@ -403,8 +407,8 @@ void *VertexBuffer::lock(size_t offset, size_t size)
     if (!m_data->m_size)
         return nullptr;
 
-    /* FIXME: is there a way to use "size"? */
-    (void)size;
+    m_data->m_lock_offset = offset;
+    m_data->m_lock_size = size;
     return m_data->m_memory + offset;
 }
 
@@ -415,10 +419,146 @@ void VertexBuffer::unlock()
 
 #if defined LOL_USE_GLEW || defined HAVE_GL_2X || defined HAVE_GLES_2X
     glBindBuffer(GL_ARRAY_BUFFER, m_data->m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, m_data->m_size, m_data->m_memory,
-                 GL_STATIC_DRAW);
+    /* Once the GPU storage exists, only upload what was locked */
+    if (m_data->m_uploaded && m_data->m_lock_size)
+        glBufferSubData(GL_ARRAY_BUFFER, m_data->m_lock_offset,
+                        m_data->m_lock_size,
+                        m_data->m_memory + m_data->m_lock_offset);
+    else
+        glBufferData(GL_ARRAY_BUFFER, m_data->m_size, m_data->m_memory,
+                     GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_data->m_uploaded = true;
 #endif
 }
 
+void VertexBuffer::orphan()
+{
+    if (!m_data->m_size)
+        return;
+
+#if defined LOL_USE_GLEW || defined HAVE_GL_2X || defined HAVE_GLES_2X
+    glBindBuffer(GL_ARRAY_BUFFER, m_data->m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_data->m_size, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_data->m_uploaded = true;
+#endif
+}
+
+//
+// The stream_ring class
+// ---------------------
+//
+
+stream_ring::stream_ring(int depth, size_t capacity)
+  : m_arenas(std::max(depth, 1))
+{
+    for (auto &a : m_arenas)
+        a.capacity = capacity;
+}
+
+void stream_ring::begin_frame()
+{
+    m_stats.high_water = std::max(m_stats.high_water, m_frame_size);
+    m_current = (m_current + 1) % depth();
+    m_frame_size = 0;
+    ++m_stats.frames;
+
+    /* Grow the arena before the frame starts if a previous frame needed
+     * more room; this avoids growing in the middle of the next one. */
+    auto &a = m_arenas[m_current];
+    a.used = 0;
+    if (a.capacity < m_stats.high_water)
+    {
+        while (a.capacity < m_stats.high_water)
+            a.capacity = std::max(a.capacity * 2, size_t(1));
+        ++a.generation;
+        ++m_stats.allocations;
+    }
+}
+
+size_t stream_ring::allocate(size_t count)
+{
+    auto &a = m_arenas[m_current];
+    m_frame_size += count;
+
+    if (a.used + count > a.capacity)
+    {
+        /* Size the new storage for the whole frame so far, even though
+         * previous allocations stay in the old storage, so that the next
+         * overflow is less likely. */
+        while (a.capacity < std::max(m_frame_size, a.used + count))
+            a.capacity = std::max(a.capacity * 2, size_t(1));
+        a.used = 0;
+        ++a.generation;
+        ++m_stats.allocations;
+    }
+
+    size_t first = a.used;
+    a.used += count;
+    return first;
+}
+
+//
+// The stream_buffer class
+// -----------------------
+//
+
+stream_buffer::stream_buffer(std::vector<size_t> const &strides, int depth)
+  : m_ring(depth),
+    m_strides(strides),
+    m_vbos(m_ring.depth(), std::vector<std::shared_ptr<VertexBuffer>>(strides.size())),
+    m_generations(m_ring.depth(), uint64_t(-1))
+{
+}
+
+void stream_buffer::begin_frame()
+{
+    m_ring.begin_frame();
+
+    /* If the storage is reused, orphan it so that the driver never has to
+     * wait for the frame that last used it. */
+    if (m_generations[m_ring.arena()] == m_ring.generation())
+    {
+        for (auto &vb : m_vbos[m_ring.arena()])
+            vb->orphan();
+    }
+}
+
+size_t stream_buffer::allocate(size_t count)
+{
+    size_t first = m_ring.allocate(count);
+    ensure_storage();
+    return first;
+}
+
+void *stream_buffer::lock(int stream, size_t first, size_t count)
+{
+    size_t stride = m_strides[stream];
+    return m_vbos[m_ring.arena()][stream]->lock(first * stride, count * stride);
+}
+
+void stream_buffer::unlock(int stream)
+{
+    m_vbos[m_ring.arena()][stream]->unlock();
+}
+
+std::shared_ptr<VertexBuffer> stream_buffer::buffer(int stream) const
+{
+    return m_vbos[m_ring.arena()][stream];
+}
+
+void stream_buffer::ensure_storage()
+{
+    int arena = m_ring.arena();
+    if (m_generations[arena] == m_ring.generation())
+        return;
+
+    /* Buffers being replaced may still be in use by draw calls issued
+     * earlier; the driver keeps their storage alive until it is done. */
+    for (size_t i = 0; i < m_strides.size(); ++i)
+        m_vbos[arena][i] = std::make_shared<VertexBuffer>(m_ring.capacity() * m_strides[i]);
+    m_generations[arena] = m_ring.generation();
+}
+
 } // namespace lol
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -15,11 +15,14 @@
 //
 // The sample class
 // ----------------
-// A sample is a unique sound sample.
+// A sample is a unique sound sample, decoded once and shared by all the
+// sounds playing it. Playback goes through a pool of mixer voices.
 //
 
 #include "engine/entity.h"
 
+#include <lol/engine/audio> // lol::audio::voice_pool
+
 #include <stdint.h>
 
 namespace lol
@@ -43,10 +46,13 @@ protected:
 
 public:
     /* New methods */
-    void play();
-    void loop();
+    void play(audio::voice_params const &params = {});
+    void loop(audio::voice_params const &params = {});
     void stop();
 
+    // The voice pool shared by all samples, updated every game tick
+    static audio::voice_pool &voices();
+
 private:
     std::unique_ptr<class sample_data> data;
 };
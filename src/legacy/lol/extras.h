@@ -26,6 +26,7 @@
 
 // Engine
 #include <lol/../engine/ticker.h>
+#include <lol/../engine/loader.h>
 #include <lol/../engine/world.h>
 #include <lol/../engine/entity.h>
 #include <lol/../engine/worldentity.h>
@@ -19,8 +19,11 @@
 
 #include <lol/half>
 
+#include <cstdint>
 #include <cstring>
 #include <map>
+#include <memory>
+#include <vector>
 
 namespace lol
 {
@@ -42,9 +45,16 @@ public:
         unlock();
     }
 
+    /* Only the locked range is uploaded by unlock(), unless size is zero,
+     * in which case the whole buffer is. */
     void *lock(size_t offset, size_t size);
     void unlock();
 
+    /* Give the current GPU storage back to the driver and get fresh
+     * storage of the same size, so that writing to it never waits for
+     * draw calls still using the old contents. */
+    void orphan();
+
 private:
     class VertexBufferData *m_data;
 };
@@ -257,5 +267,91 @@ private:
     int m_count;
 };
 
-} /* namespace lol */
+//
+// The stream_ring class
+// ---------------------
+// A ring of growable arenas for per-frame vertex data. Every frame uses
+// the next arena in the ring, and allocations within a frame are a simple
+// bump of an offset. Arenas are grown to fit the largest frame seen so far,
+// so that once the data size stabilises no more storage is ever created.
+// This class only deals with element counts and never touches the GPU.
+//
+
+class stream_ring
+{
+public:
+    stream_ring(int depth = 3, size_t capacity = 1024);
+
+    /* Switch to the next arena in the ring and forget what it contained. */
+    void begin_frame();
+
+    /* Reserve count consecutive elements in the current arena and return
+     * the index of the first one. If the arena is too small, it is grown
+     * and everything previously allocated from it becomes invalid; check
+     * generation() to know when storage needs to be recreated. */
+    size_t allocate(size_t count);
+
+    int arena() const { return m_current; }
+    int depth() const { return int(m_arenas.size()); }
+    size_t capacity() const { return m_arenas[m_current].capacity; }
+    uint64_t generation() const { return m_arenas[m_current].generation; }
+
+    struct stats
+    {
+        uint64_t frames = 0;
+        uint64_t allocations = 0; // number of arena (re)creations
+        size_t high_water = 0;    // largest frame seen, in elements
+    };
+
+    stats const &get_stats() const { return m_stats; }
+
+private:
+    struct arena_info
+    {
+        size_t capacity = 0, used = 0;
+        uint64_t generation = 0;
+    };
 
+    std::vector<arena_info> m_arenas;
+    int m_current = 0;
+    size_t m_frame_size = 0;
+    stats m_stats;
+};
+
+//
+// The stream_buffer class
+// -----------------------
+// Persistent vertex buffers driven by a stream_ring: one VertexBuffer per
+// arena and per stream, sharing the same element indices so that they can
+// be bound together and drawn with DrawElements(type, first, count).
+//
+
+class stream_buffer
+{
+public:
+    /* One stream per vertex buffer, each with its own element size. */
+    stream_buffer(std::vector<size_t> const &strides, int depth = 3);
+
+    void begin_frame();
+
+    /* Reserve count elements in every stream; returns the first index. */
+    size_t allocate(size_t count);
+
+    /* Get a pointer to elements [first, first + count) of a stream. The
+     * data is uploaded by unlock(). */
+    void *lock(int stream, size_t first, size_t count);
+    void unlock(int stream);
+
+    std::shared_ptr<VertexBuffer> buffer(int stream) const;
+    stream_ring const &ring() const { return m_ring; }
+
+private:
+    void ensure_storage();
+
+    stream_ring m_ring;
+    std::vector<size_t> m_strides;
+    std::vector<std::vector<std::shared_ptr<VertexBuffer>>> m_vbos;
+    std::vector<uint64_t> m_generations;
+};
+
+} /* namespace lol */
@@ -23,6 +23,7 @@
 #include <../legacy/lol/math/geometry.h> // ibox2
 
 #include <string>
+#include <vector>
 
 namespace lol
 {
@@ -43,6 +44,8 @@ enum class ResampleAlgorithm : uint8_t
 {
     Bicubic,
     Bresenham,
+    Lanczos3,
+    Mitchell,
 };
 
 enum class EdiffAlgorithm : uint8_t
@@ -117,8 +120,15 @@ public:
 
         static old_array2d<float> bayer(ivec2 size);
         static old_array2d<float> halftone(ivec2 size);
+        /* The same seed always gives the same kernel. Kernels used to be
+         * random; pass a different seed for each one to get that back. */
         static old_array2d<float> blue_noise(ivec2 size,
-                                         ivec2 gsize = ivec2(7, 7));
+                                         ivec2 gsize = ivec2(7, 7),
+                                         uint32_t seed = 0);
+
+        /* Where generated kernels are cached; an empty string disables
+         * the cache. Defaults to a subdirectory of the temp directory. */
+        static void set_cache_dir(std::string const &dir);
         static old_array2d<float> ediff(EdiffAlgorithm algorithm);
         static old_array2d<float> gaussian(vec2 radius,
                                        float angle = 0.f,
@@ -132,6 +142,26 @@ public:
     old_image Resize(ivec2 size, ResampleAlgorithm algorithm);
     old_image Crop(ibox2 box) const;
 
+    /* Number of threads used by image processing functions. Zero or less
+     * uses one per hardware thread. Must not be called while an image is
+     * being processed. */
+    static void set_threads(int count);
+
+    /* Pixel memory. Copies of an image share their pixels until one of
+     * them is locked. Buffers for other formats than the current one are
+     * kept for reuse until the total pixel memory goes over the budget
+     * (512 MiB by default), or until trim() is called. */
+    struct memory_stats
+    {
+        size_t bytes, peak_bytes;
+        uint64_t copies, evictions;
+    };
+
+    size_t memory_usage() const;
+    void trim();
+    static memory_stats get_memory_stats();
+    static void set_memory_budget(size_t bytes);
+
     /* Image processing */
     old_image AutoContrast() const;
     old_image Brightness(float val) const;
@@ -153,9 +183,28 @@ public:
     old_image dither_ediff(old_array2d<float> const &kernel,
                            ScanMode scan = ScanMode::Raster) const;
     old_image dither_ostromoukhov(ScanMode scan = ScanMode::Raster) const;
+
+    /* Error diffusion above works on floats and gives a Y_F32 image. These
+     * use 8-bit fixed point instead: they are faster, give a Y_8 image of
+     * 0 and 255, and do not match the float result pixel for pixel. */
+    old_image dither_ediff_u8(old_array2d<float> const &kernel,
+                              ScanMode scan = ScanMode::Raster) const;
+    old_image dither_ostromoukhov_u8(ScanMode scan = ScanMode::Raster) const;
     old_image dither_ordered(old_array2d<float> const &kernel) const;
     old_image dither_halftone(float radius, float angle) const;
-    old_image dither_dbs() const;
+
+    /* Direct binary search stops after max_passes over the image, or
+     * once a pass changes no more than epsilon × pixel count pixels.
+     * If stats is not null, one entry is appended per pass. */
+    struct dbs_pass
+    {
+        int changes;    // pixels toggled or swapped
+        int cells;      // cells visited
+        float error;    // mean perceived squared error after the pass
+    };
+
+    old_image dither_dbs(int max_passes = 32, float epsilon = 0.f,
+                         std::vector<dbs_pass> *stats = nullptr) const;
 
     /* Combine images */
     static old_image Merge(old_image &src1, old_image &src2, float alpha);
@@ -170,11 +219,133 @@ public:
     static old_image Sub(old_image &src1, old_image &src2);
     static old_image Difference(old_image &src1, old_image &src2);
 
+    /* Lazy point operations, applied in a single pass */
+    class pixel_ops;
+    pixel_ops ops() const;
+
+    /* Ordered dithering with a precomputed threshold map */
+    class threshold_map;
+
 private:
+    friend class pixel_ops_impl;
+
     void *lock2d_helper(PixelFormat T);
 
     class image_data *m_data;
 };
 
+// old_image::pixel_ops -----------------------------------------------------------
+//
+// Records a chain of per-pixel operations and applies all of them in one
+// pass when eval() is called: the source planes are read once, whatever
+// their format, and the result is written once.
+//
+//   old_image out = im.ops().brightness(0.1f).contrast(0.2f).invert().eval();
+//
+// Operations work on Y_F32 data when all inputs are greyscale, and on
+// RGBA_F32 data otherwise, like the equivalent old_image methods. All
+// images used in the chain must outlive it, and have the same size.
+class old_image::pixel_ops
+{
+public:
+    pixel_ops(old_image const &src);
+
+    pixel_ops &auto_contrast();
+    pixel_ops &brightness(float val);
+    pixel_ops &contrast(float val);
+    pixel_ops &invert();
+    pixel_ops &threshold(float val);
+    pixel_ops &threshold(vec3 val);
+
+    /* Combine with another image */
+    pixel_ops &mix(old_image const &other, float alpha);
+    pixel_ops &min(old_image const &other);
+    pixel_ops &max(old_image const &other);
+    pixel_ops &overlay(old_image const &other);
+    pixel_ops &screen(old_image const &other);
+    pixel_ops &multiply(old_image const &other);
+    pixel_ops &divide(old_image const &other);
+    pixel_ops &add(old_image const &other);
+    pixel_ops &sub(old_image const &other);
+    pixel_ops &difference(old_image const &other);
+
+    old_image eval() const;
+
+private:
+    friend class pixel_ops_impl;
+
+    enum class op_type : uint8_t
+    {
+        AutoContrast,
+        Affine,
+        Invert,
+        Threshold,
+        ThresholdRGB,
+        Mix,
+        Min,
+        Max,
+        Overlay,
+        Screen,
+        Multiply,
+        Divide,
+        Add,
+        Sub,
+        Difference,
+    };
+
+    struct op
+    {
+        op_type type;
+        /* Affine: scale, offset, clamp; Threshold: values; Mix: alpha */
+        vec3 val;
+        old_image const *other;
+    };
+
+    pixel_ops &push(op_type type, vec3 val, old_image const *other = nullptr);
+
+    old_image const &m_src;
+    std::vector<op> m_ops;
+};
+
+// old_image::threshold_map -------------------------------------------------------
+//
+// A dithering kernel, scaled and rotated for a given image size and stored
+// as 8-bit thresholds, so that pixels can be compared many at a time. Build
+// it once and reuse it for every frame of that size:
+//
+//   old_image::threshold_map map(old_image::kernel::bayer(ivec2(8)), size);
+//   map.dither_1bit(frame, bits);
+//
+// Source pixels are Y_8, stored contiguously.
+class old_image::threshold_map
+{
+public:
+    threshold_map(old_array2d<float> const &ker, ivec2 size,
+                  float scale = 1.f, float angle = 0.f);
+
+    ivec2 size() const { return m_size; }
+
+    /* Dither an image of the map’s size; the result is Y_8. The source is
+     * converted to Y_8 first, so float pixels are quantised to 8 bits
+     * before being compared with the thresholds. */
+    old_image dither(old_image const &src) const;
+
+    /* One byte per pixel, 0 or 255 */
+    void dither_u8(uint8_t const *src, uint8_t *dst) const;
+
+    /* One bit per pixel, most significant bit first; each row starts on
+     * a new byte */
+    void dither_1bit(uint8_t const *src, uint8_t *dst) const;
+
+private:
+    template<bool PACKED> void run(uint8_t const *src, uint8_t *dst) const;
+
+    ivec2 m_size;
+    int m_pitch;
+    /* Threshold rows, and the one used by each image row */
+    std::vector<uint8_t> m_table;
+    std::vector<int> m_rows;
+};
+
 } /* namespace lol */
 
@@ -13,6 +13,7 @@
 
 #include <lol/engine-internal.h>
 
+#include <atomic>
 #include <string>
 #include <cstring>
 #include <cstdlib>
@@ -31,6 +32,83 @@ extern "C"
 }
 #endif // __EMSCRIPTEN__
 
+/*
+ * Intrusive multiple-producer, single-consumer queue (after Dmitry Vyukov’s
+ * design). Producers only do one atomic exchange; the consumer owns m_tail.
+ */
+class message_queue
+{
+public:
+    struct node
+    {
+        node() : m_msg(0, std::string()) {}
+        node(MessageList&& msg) : m_msg(std::move(msg)) {}
+
+        std::atomic<node *> m_next = nullptr;
+        MessageList m_msg;
+    };
+
+    message_queue()
+      : m_head(&m_stub),
+        m_tail(&m_stub)
+    {
+    }
+
+    ~message_queue()
+    {
+        while (node *n = pop())
+            delete n;
+    }
+
+    void push(node *n)
+    {
+        n->m_next.store(nullptr, std::memory_order_relaxed);
+        node *prev = m_head.exchange(n, std::memory_order_acq_rel);
+        prev->m_next.store(n, std::memory_order_release);
+    }
+
+    // Returns nullptr if the queue is empty, or if the next producer has
+    // not finished linking its node yet; it will be there next time.
+    node *pop()
+    {
+        node *tail = m_tail;
+        node *next = tail->m_next.load(std::memory_order_acquire);
+
+        if (tail == &m_stub)
+        {
+            if (!next)
+                return nullptr;
+            m_tail = tail = next;
+            next = next->m_next.load(std::memory_order_acquire);
+        }
+
+        if (next)
+        {
+            m_tail = next;
+            return tail;
+        }
+
+        if (tail != m_head.load(std::memory_order_acquire))
+            return nullptr;
+
+        // Only one node left: put the stub back behind it so that the
+        // node can be detached.
+        push(&m_stub);
+        next = tail->m_next.load(std::memory_order_acquire);
+        if (next)
+        {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    std::atomic<node *> m_head;
+    node *m_tail;
+    node m_stub;
+};
+
 /*
  * The global g_messageservice object, initialised by MessageService::Setup()
  */
@@ -52,7 +130,8 @@ MessageService::~MessageService()
 void MessageService::Setup()
 {
     g_messageservice = new MessageService();
-    g_messageservice->m_bucket.resize(MessageBucket::MAX);
+    for (int i = 0; i < MessageBucket::MAX; ++i)
+        g_messageservice->m_bucket.push_back(std::make_unique<message_queue>());
 }
 
 void MessageService::Destroy()
@@ -63,12 +142,17 @@ void MessageService::Destroy()
 
 //-----------------------------------------------------------------------------
 bool MessageService::Send(MessageBucket id, const std::string& message)
+{
+    return Send(id, std::string(message));
+}
+
+bool MessageService::Send(MessageBucket id, std::string&& message)
 {
     if (g_messageservice)
     {
         MessageService& g = *g_messageservice;
-        auto& bucket = g.m_bucket[id.ToScalar()];
-        bucket.push_back(MessageList(time(nullptr), message));
+        auto& bucket = *g.m_bucket[id.ToScalar()];
+        bucket.push(new message_queue::node(MessageList(time(nullptr), std::move(message))));
         return true;
     }
     return false;
@@ -90,13 +174,13 @@ bool MessageService::FetchFirst(MessageBucket id, std::string& message, time_t&
     if (g_messageservice)
     {
         MessageService& g = *g_messageservice;
-        auto& bucket = g.m_bucket[id.ToScalar()];
+        auto& bucket = *g.m_bucket[id.ToScalar()];
 
-        if (bucket.size())
+        if (auto *n = bucket.pop())
         {
-            message = bucket[0].m_message;
-            timestamp = bucket[0].m_timestamp;
-            remove_at(bucket, 0);
+            message = std::move(n->m_msg.m_message);
+            timestamp = n->m_msg.m_timestamp;
+            delete n;
             return true;
         }
     }
@@ -116,22 +200,41 @@ bool MessageService::FetchAll(MessageBucket id, std::string& message)
 
 bool MessageService::FetchAll(MessageBucket id, std::string& message, time_t& first_timestamp)
 {
+    message = "";
+
+    std::vector<MessageList> messages;
+    if (!FetchAll(id, messages))
+        return false;
+
+    // Concatenate with a single allocation
+    size_t size = 0;
+    for (auto const& m : messages)
+        size += m.m_message.size();
+    message.reserve(size);
+
+    first_timestamp = messages[0].m_timestamp;
+    for (auto const& m : messages)
+        message += m.m_message;
+    return true;
+}
+
+size_t MessageService::FetchAll(MessageBucket id, std::vector<MessageList>& messages)
+{
+    size_t count = 0;
+
     if (g_messageservice)
     {
         MessageService& g = *g_messageservice;
-        auto& bucket = g.m_bucket[id.ToScalar()];
-        message = "";
+        auto& bucket = *g.m_bucket[id.ToScalar()];
 
-        if (bucket.size())
+        while (auto *n = bucket.pop())
         {
-            first_timestamp = bucket[0].m_timestamp;
-            for (size_t i = 0; i < bucket.size(); ++i)
-                message += bucket[i].m_message;
-            bucket.clear();
-            return true;
+            messages.push_back(std::move(n->m_msg));
+            delete n;
+            ++count;
         }
     }
-    return false;
+    return count;
 }
 
 } // namespace lol
@@ -15,6 +15,8 @@
 
 #include <string>
 #include <map>
+#include <memory>
+#include <vector>
 
 //
 // The Message Service class
@@ -75,12 +77,20 @@ struct MessageList
     {
     }
 
+    MessageList(time_t timestamp, std::string&& message)
+      : m_timestamp(timestamp),
+        m_message(std::move(message))
+    {
+    }
+
     time_t m_timestamp;
     std::string m_message;
 };
 
 /*
-    A template class perhaps ?
+    Send() may be called from any thread; each bucket is a lock-free
+    multiple-producer queue. The Fetch*() functions must only be called
+    from one thread at a time per bucket.
 */
 class MessageService
 {
@@ -97,13 +107,18 @@ public:
 
     //Common interactions
     static bool Send(MessageBucket id, const std::string& message);
+    static bool Send(MessageBucket id, std::string&& message);
     static bool FetchFirst(MessageBucket id, std::string& message);
     static bool FetchFirst(MessageBucket id, std::string& message, time_t &timestamp);
     static bool FetchAll(MessageBucket id, std::string& message);
     static bool FetchAll(MessageBucket id, std::string& message, time_t &first_timestamp);
 
+    //Batch interaction: move all pending messages to the end of a list
+    //and return how many there were
+    static size_t FetchAll(MessageBucket id, std::vector<MessageList>& messages);
+
 private:
-    std::vector<std::vector<MessageList> >  m_bucket;
+    std::vector<std::unique_ptr<class message_queue> > m_bucket;
 };
 
 extern MessageService *g_messageservice;
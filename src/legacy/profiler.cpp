@@ -9,9 +9,20 @@
 //
 
 #include <lol/engine-internal.h>
+#include <lol/file>   // lol::file::write
+#include <lol/format> // std::format
+#include <lol/msg>    // lol::msg
 
+#include <algorithm>     // std::min, std::find_if
+#include <atomic>        // std::atomic
+#include <chrono>        // std::chrono::steady_clock
 #include <cstdlib>
+#include <memory>        // std::unique_ptr
+#include <mutex>         // std::mutex
 #include <stdint.h>
+#include <string>        // std::string
+#include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
 
 namespace lol
 {
@@ -72,5 +83,269 @@ float Profiler::GetMax(int id)
     return data[id].max;
 }
 
+/*
+ * Zone recording
+ */
+
+namespace
+{
+
+enum class zone_event_type : uint32_t
+{
+    begin,
+    end,
+    frame,
+};
+
+struct zone_event
+{
+    uint64_t time; // nanoseconds since the profiler was created
+    uint32_t id;   // name index, or frame number for frame marks
+    zone_event_type type;
+};
+
+// Each thread owns one of these and is the only one to write to it, so
+// that recording is just a store and an atomic increment. It is freed
+// when the thread exits, and the zones it holds are dropped with it.
+struct zone_buffer
+{
+    static size_t const SIZE = 1 << 16;
+
+    int tid = 0;
+    std::atomic<uint64_t> head = 0;
+    zone_event events[SIZE];
+};
+
+struct zone_registry
+{
+    std::mutex lock;
+    std::vector<std::unique_ptr<zone_buffer>> buffers;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::atomic<bool> enabled = false;
+    int last_tid = 0;
+};
+
+zone_registry &zones()
+{
+    static zone_registry ret;
+    return ret;
+}
+
+// Threads that never record a zone never get a buffer
+struct thread_buffer_owner
+{
+    ~thread_buffer_owner()
+    {
+        if (!buffer)
+            return;
+
+        auto &z = zones();
+        std::unique_lock<std::mutex> lock(z.lock);
+        auto it = std::find_if(z.buffers.begin(), z.buffers.end(),
+                               [&](auto const &b) { return b.get() == buffer; });
+        if (it != z.buffers.end())
+            z.buffers.erase(it);
+    }
+
+    zone_buffer *buffer = nullptr;
+};
+
+thread_local thread_buffer_owner t_buffer;
+thread_local std::unordered_map<std::string, uint32_t> t_ids;
+
+// Whether each open zone of this thread was recorded, so that its end is
+// recorded the same way even if zones were toggled in the meantime
+thread_local std::vector<bool> t_open;
+
+zone_buffer &thread_buffer()
+{
+    if (!t_buffer.buffer)
+    {
+        auto &z = zones();
+        std::unique_lock<std::mutex> lock(z.lock);
+        z.buffers.push_back(std::make_unique<zone_buffer>());
+        t_buffer.buffer = z.buffers.back().get();
+        t_buffer.buffer->tid = ++z.last_tid;
+    }
+    return *t_buffer.buffer;
+}
+
+uint32_t zone_id(std::string const &name)
+{
+    if (auto it = t_ids.find(name); it != t_ids.end())
+        return it->second;
+
+    auto &z = zones();
+    std::unique_lock<std::mutex> lock(z.lock);
+    auto it = z.ids.find(name);
+    if (it == z.ids.end())
+    {
+        it = z.ids.emplace(name, (uint32_t)z.names.size()).first;
+        z.names.push_back(name);
+    }
+    return t_ids[name] = it->second;
+}
+
+void record(zone_buffer &b, uint32_t id, zone_event_type type)
+{
+    auto time = std::chrono::steady_clock::now() - zones().start;
+    uint64_t head = b.head.load(std::memory_order_relaxed);
+    auto &e = b.events[head % zone_buffer::SIZE];
+    e.time = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+    e.id = id;
+    e.type = type;
+    b.head.store(head + 1, std::memory_order_release);
+}
+
+// Copy the events of a buffer that are guaranteed not to have been
+// overwritten while we were reading them. The writer may be halfway
+// through the slot at new_head, so that one is not trusted either.
+std::vector<zone_event> read_events(zone_buffer const &b)
+{
+    uint64_t head = b.head.load(std::memory_order_acquire);
+    uint64_t tail = head > zone_buffer::SIZE ? head - zone_buffer::SIZE : 0;
+
+    std::vector<zone_event> ret;
+    for (uint64_t i = tail; i < head; ++i)
+        ret.push_back(b.events[i % zone_buffer::SIZE]);
+
+    uint64_t new_head = b.head.load(std::memory_order_acquire);
+    uint64_t overwritten = new_head + 1 > zone_buffer::SIZE + tail ? new_head + 1 - zone_buffer::SIZE - tail : 0;
+    ret.erase(ret.begin(), ret.begin() + std::min(overwritten, (uint64_t)ret.size()));
+    return ret;
+}
+
+std::string json_escape(std::string const &s)
+{
+    std::string ret;
+    for (char ch : s)
+    {
+        if (ch == '"' || ch == '\\')
+            ret += '\\';
+        if ((unsigned char)ch < 0x20)
+            ret += std::format("\\u{:04x}", (int)ch);
+        else
+            ret += ch;
+    }
+    return ret;
+}
+
+} // anonymous namespace
+
+void Profiler::EnableZones(bool enable)
+{
+    zones().enabled = enable;
+}
+
+bool Profiler::ZonesEnabled()
+{
+    return zones().enabled;
+}
+
+void Profiler::BeginZone(char const *name)
+{
+    // Avoid building a string when not recording
+    if (zones().enabled)
+        BeginZone(std::string(name));
+    else
+        t_open.push_back(false);
+}
+
+void Profiler::BeginZone(std::string const &name)
+{
+    bool const enabled = zones().enabled;
+    t_open.push_back(enabled);
+    if (enabled)
+        record(thread_buffer(), zone_id(name), zone_event_type::begin);
+}
+
+void Profiler::EndZone()
+{
+    if (t_open.empty())
+        return;
+
+    bool const recorded = t_open.back();
+    t_open.pop_back();
+    if (recorded)
+        record(*t_buffer.buffer, 0, zone_event_type::end);
+}
+
+void Profiler::MarkFrame(int frame)
+{
+    if (zones().enabled)
+        record(thread_buffer(), (uint32_t)frame, zone_event_type::frame);
+}
+
+bool Profiler::SaveTrace(std::string const &path, int first_frame, int last_frame)
+{
+    auto &z = zones();
+
+    std::vector<std::pair<int, std::vector<zone_event>>> threads;
+    std::vector<std::string> names;
+    {
+        std::unique_lock<std::mutex> lock(z.lock);
+        for (auto const &b : z.buffers)
+            threads.push_back(std::make_pair(b->tid, read_events(*b)));
+        names = z.names;
+    }
+
+    // Find the time range covered by the requested frames
+    uint64_t range_start = UINT64_MAX, range_end = UINT64_MAX;
+    for (auto const &t : threads)
+        for (auto const &e : t.second)
+        {
+            if (e.type != zone_event_type::frame)
+                continue;
+            if ((int)e.id == first_frame)
+                range_start = std::min(range_start, e.time);
+            else if ((int)e.id > last_frame && e.time > range_start)
+                range_end = std::min(range_end, e.time);
+        }
+
+    if (range_start == UINT64_MAX)
+    {
+        msg::error("frame %d is not in the profiler history\n", first_frame);
+        return false;
+    }
+
+    std::string json = "{\"traceEvents\":[\n";
+    char const *sep = "";
+
+    for (auto const &t : threads)
+    {
+        json += std::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+                            "\"args\":{{\"name\":\"thread {}\"}}}}", sep, t.first, t.first);
+        sep = ",\n";
+
+        // Match begin and end events; zones still open are dropped
+        std::vector<zone_event> stack;
+        for (auto const &e : t.second)
+        {
+            if (e.type == zone_event_type::begin)
+                stack.push_back(e);
+            else if (e.type == zone_event_type::end && stack.size())
+            {
+                auto const &b = stack.back();
+                if (b.time >= range_start && b.time < range_end)
+                    json += std::format("{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+                                        "\"ts\":{:.3f},\"dur\":{:.3f}}}", sep,
+                                        json_escape(names[b.id]), t.first,
+                                        b.time * 1e-3, (e.time - b.time) * 1e-3);
+                stack.pop_back();
+            }
+            else if (e.type == zone_event_type::frame
+                      && e.time >= range_start && e.time < range_end)
+                json += std::format("{}{{\"name\":\"frame {}\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,"
+                                    "\"tid\":{},\"ts\":{:.3f}}}", sep, e.id, t.first, e.time * 1e-3);
+        }
+    }
+
+    json += "\n]}\n";
+
+    return file::write(path, json);
+}
+
 } /* namespace lol */
 
@@ -15,8 +15,13 @@
 // -------------------
 // The Profiler is a static class that collects statistic counters.
 //
+// It also records nested, named zones from any thread into per-thread
+// ring buffers, which can be saved in the Chrome trace-event format. A
+// thread’s buffer, and the zones in it, go away when the thread exits.
+//
 
 #include <stdint.h>
+#include <string>
 
 namespace lol
 {
@@ -48,9 +53,34 @@ public:
     static float GetAvg(int id);
     static float GetMax(int id);
 
+    // Zones are only recorded while enabled, and a zone’s end is only
+    // recorded if its beginning was. Recording only takes a lock the
+    // first time a thread sees a given zone name.
+    static void EnableZones(bool enable);
+    static bool ZonesEnabled();
+    static void BeginZone(char const *name);
+    static void BeginZone(std::string const &name);
+    static void EndZone();
+
+    // Mark the start of a frame; used to pick frames when saving a trace
+    static void MarkFrame(int frame);
+
+    // Save the zones that started between the beginning of first_frame and
+    // the end of last_frame as Chrome trace-event JSON
+    static bool SaveTrace(std::string const &path, int first_frame, int last_frame);
+
 private:
     Profiler() {}
 };
 
+// A zone that lasts as long as the object
+class ProfilerZone
+{
+public:
+    inline ProfilerZone(char const *name) { Profiler::BeginZone(name); }
+    inline ProfilerZone(std::string const &name) { Profiler::BeginZone(name); }
+    inline ~ProfilerZone() { Profiler::EndZone(); }
+};
+
 } /* namespace lol */
 
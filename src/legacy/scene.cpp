@@ -19,6 +19,7 @@
 #include <vector>   // std::vector
 #include <array>    // std::array
 #include <cstdlib>
+#include <cstring>  // memcpy
 
 #if defined(_WIN32)
 #   define WIN32_LEAN_AND_MEAN 1
@@ -114,9 +115,11 @@ Scene::Scene(ivec2 size)
     m_tile_api.m_palette_shader = 0;
     m_tile_api.m_vdecl = std::make_shared<VertexDeclaration>(VertexStream<vec3>(VertexUsage::Position),
                                                              VertexStream<vec2>(VertexUsage::TexCoord));
+    m_tile_api.m_stream = std::make_shared<stream_buffer>(std::vector<size_t>{ sizeof(vec3), sizeof(vec2) });
 
     m_line_api.m_shader = 0;
     m_line_api.m_vdecl = std::make_shared<VertexDeclaration>(VertexStream<vec4,vec4>(VertexUsage::Position, VertexUsage::Color));
+    m_line_api.m_stream = std::make_shared<stream_buffer>(std::vector<size_t>{ 2 * sizeof(vec4) });
 
     m_line_api.m_debug_mask = 1;
 }
@@ -238,7 +241,6 @@ void Scene::Reset()
                 ReleasePrimitiveRenderer(int(idx--), key);
     }
 
-    m_tile_api.m_bufs.clear();
     m_tile_api.m_lights.clear();
 }
 
@@ -467,10 +469,111 @@ void Scene::render_primitives()
     }
 }
 
+// Map a float to an unsigned integer with the same ordering; -0 and 0
+// give the same value
+static inline uint32_t sortable_float(float f)
+{
+    if (f == 0.f)
+        f = 0.f;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+int tile_sorter::sort(std::vector<Tile> &tiles)
+{
+    if (tiles.empty())
+        return 0;
+
+    auto &keys = m_keys;
+    auto &tmp = m_keys_tmp;
+    auto &ids = m_tileset_ids;
+    int draw_calls = 0;
+
+    keys.resize(tiles.size());
+    tmp.resize(tiles.size());
+    ids.clear();
+
+    /* Build the keys: depth layer in the high bits, then a dense tileset
+     * index in order of first appearance. */
+    TileSet const *last = nullptr;
+    uint32_t last_id = 0;
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        if (i == 0 || tiles[i].m_tileset != last)
+        {
+            last = tiles[i].m_tileset;
+            last_id = ids.emplace(last, uint32_t(ids.size())).first->second;
+            ++draw_calls;
+        }
+        uint64_t layer = sortable_float(tiles[i].m_model[3].z);
+        keys[i] = std::make_pair(layer << 32 | last_id, uint32_t(i));
+    }
+
+    /* LSD radix sort, one byte at a time. Bytes that are the same for all
+     * keys are skipped, which is most of them in a typical 2D scene. */
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t count[256] = { 0 };
+        for (auto const &k : keys)
+            ++count[(k.first >> shift) & 0xff];
+
+        if (count[(keys[0].first >> shift) & 0xff] == keys.size())
+            continue;
+
+        size_t offset = 0;
+        for (auto &c : count)
+        {
+            size_t n = c;
+            c = offset;
+            offset += n;
+        }
+
+        for (auto const &k : keys)
+            tmp[count[(k.first >> shift) & 0xff]++] = k;
+        std::swap(keys, tmp);
+    }
+
+    m_sorted.resize(tiles.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        m_sorted[i] = tiles[keys[i].second];
+    std::swap(tiles, m_sorted);
+    return draw_calls;
+}
+
+/* An index buffer with the 0 1 2 2 1 3 pattern for at least count quads */
+std::shared_ptr<IndexBuffer> const &Scene::quad_indices(size_t count)
+{
+    auto &ibo = m_tile_api.m_ibo;
+    if (ibo && ibo->size() >= count * 6 * sizeof(uint32_t))
+        return ibo;
+
+    size_t quads = 1024;
+    while (quads < count)
+        quads *= 2;
+
+    ibo = std::make_shared<IndexBuffer>(quads * 6 * sizeof(uint32_t));
+    auto *indices = (uint32_t *)ibo->lock(0, 0);
+    for (uint32_t q = 0; q < quads; ++q)
+    {
+        *indices++ = 4 * q + 0;
+        *indices++ = 4 * q + 1;
+        *indices++ = 4 * q + 2;
+        *indices++ = 4 * q + 2;
+        *indices++ = 4 * q + 1;
+        *indices++ = 4 * q + 3;
+    }
+    ibo->unlock();
+    ibo->Unbind();
+    return ibo;
+}
+
 void Scene::render_tiles() // XXX: rename to Blit()
 {
     render_context rc(m_renderer);
 
+    m_tile_stats = tile_stats();
+
     /* Early test if nothing needs to be rendered */
     if (m_tile_api.m_tiles.empty() && m_tile_api.m_palettes.empty())
         return;
@@ -489,6 +592,8 @@ void Scene::render_tiles() // XXX: rename to Blit()
     if (!m_tile_api.m_palette_shader && !m_tile_api.m_palettes.empty())
         m_tile_api.m_palette_shader = Shader::Create(LOLFX_RESOURCE_NAME(gpu_palette));
 
+    m_tile_api.m_stream->begin_frame();
+
     for (int p = 0; p < 2; p++)
     {
         auto shader = (p == 0) ? m_tile_api.m_shader : m_tile_api.m_palette_shader;
@@ -497,6 +602,9 @@ void Scene::render_tiles() // XXX: rename to Blit()
         if (tiles.empty())
             continue;
 
+        m_tile_stats.unsorted_draw_calls += m_tile_api.m_sorter.sort(tiles);
+        m_tile_stats.tiles += int(tiles.size());
+
         ShaderUniform uni_mat, uni_tex, uni_pal, uni_texsize;
         ShaderAttrib attr_pos, attr_tex;
         attr_pos = shader->GetAttribLocation(VertexUsage::Position, 0);
@@ -515,30 +623,28 @@ void Scene::render_tiles() // XXX: rename to Blit()
         uni_pal = m_tile_api.m_palette_shader ? m_tile_api.m_palette_shader->GetUniformLocation("u_palette") : ShaderUniform();
         uni_texsize = shader->GetUniformLocation("u_texsize");
 
-        for (size_t buf = 0, i = 0, n; i < tiles.size(); i = n, buf += 2)
+        for (size_t i = 0, n; i < tiles.size(); i = n)
         {
             /* Count how many quads will be needed */
             for (n = i + 1; n < tiles.size(); n++)
                 if (tiles[i].m_tileset != tiles[n].m_tileset)
                     break;
 
-            /* Create a vertex array object */
-            auto vb1 = std::make_shared<VertexBuffer>(6 * (n - i) * sizeof(vec3));
-            vec3 *vertex = (vec3 *)vb1->lock(0, 0);
-            auto vb2 = std::make_shared<VertexBuffer>(6 * (n - i) * sizeof(vec2));
-            vec2 *texture = (vec2 *)vb2->lock(0, 0);
+            /* Reserve room in this frame’s streaming buffers */
+            auto &stream = *m_tile_api.m_stream;
+            size_t first = stream.allocate(4 * (n - i));
+            vec3 *vertex = (vec3 *)stream.lock(0, first, 4 * (n - i));
+            vec2 *texture = (vec2 *)stream.lock(1, first, 4 * (n - i));
 
-            m_tile_api.m_bufs.push_back(vb1);
-            m_tile_api.m_bufs.push_back(vb2);
+            tiles[i].m_tileset->BlitTiles(std::span<Tile const>(tiles.data() + i, n - i),
+                                          vertex, texture);
 
-            for (size_t j = i; j < n; j++)
-            {
-                tiles[i].m_tileset->BlitTile(tiles[j].m_id, tiles[j].m_model,
-                                vertex + 6 * (j - i), texture + 6 * (j - i));
-            }
+            stream.unlock(0);
+            stream.unlock(1);
 
-            vb1->unlock();
-            vb2->unlock();
+            /* Quads are 4 vertices each, and every allocation is a multiple
+             * of 4, so the same index pattern works for all of them. */
+            auto const &ibo = quad_indices(first / 4 + (n - i));
 
             /* Bind texture */
             if (tiles[i].m_tileset->GetPalette())
@@ -560,11 +666,15 @@ void Scene::render_tiles() // XXX: rename to Blit()
 
             /* Bind vertex and texture coordinate buffers */
             m_tile_api.m_vdecl->Bind();
-            m_tile_api.m_vdecl->SetStream(vb1, attr_pos);
-            m_tile_api.m_vdecl->SetStream(vb2, attr_tex);
+            m_tile_api.m_vdecl->SetStream(stream.buffer(0), attr_pos);
+            m_tile_api.m_vdecl->SetStream(stream.buffer(1), attr_tex);
 
             /* Draw arrays */
-            m_tile_api.m_vdecl->DrawElements(MeshPrimitive::Triangles, 0, int(n - i) * 6);
+            ibo->Bind();
+            m_tile_api.m_vdecl->DrawIndexedElements(MeshPrimitive::Triangles, int(n - i) * 6,
+                    (short const *)(uintptr_t)(first / 4 * 6 * sizeof(uint32_t)), 4);
+            ibo->Unbind();
+            ++m_tile_stats.draw_calls;
             m_tile_api.m_vdecl->Unbind();
             tiles[i].m_tileset->Unbind();
         }
@@ -597,8 +707,11 @@ void Scene::render_lines(float seconds)
     if (!m_line_api.m_shader)
         m_line_api.m_shader = Shader::Create(LOLFX_RESOURCE_NAME(gpu_line));
 
-    std::vector<std::array<vec4,4>> buff;
-    buff.resize(linecount);
+    /* Write the lines straight into this frame’s streaming buffer */
+    auto &stream = *m_line_api.m_stream;
+    stream.begin_frame();
+    size_t first = stream.allocate(2 * linecount);
+    auto *buff = (std::array<vec4,4> *)stream.lock(0, first, 2 * linecount);
     int real_linecount = 0;
 
     mat4 const inv_view_proj = inverse(GetCamera()->GetProjection() * GetCamera()->GetView());
@@ -621,8 +734,7 @@ void Scene::render_lines(float seconds)
             linecount--;
         }
     }
-    auto vb = std::make_shared<VertexBuffer>(buff.size() * sizeof(buff[0]));
-    vb->set_data(buff.data(), buff.size() * sizeof(buff[0]));
+    stream.unlock(0);
 
     m_line_api.m_shader->Bind();
 
@@ -639,8 +751,8 @@ void Scene::render_lines(float seconds)
     m_line_api.m_shader->SetUniform(uni_mat, GetCamera()->GetView());
 
     m_line_api.m_vdecl->Bind();
-    m_line_api.m_vdecl->SetStream(vb, attr_pos, attr_col);
-    m_line_api.m_vdecl->DrawElements(MeshPrimitive::Lines, 0, 2 * real_linecount);
+    m_line_api.m_vdecl->SetStream(stream.buffer(0), attr_pos, attr_col);
+    m_line_api.m_vdecl->DrawElements(MeshPrimitive::Lines, int(first), 2 * real_linecount);
     m_line_api.m_vdecl->Unbind();
     m_line_api.m_shader->Unbind();
 
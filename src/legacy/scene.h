@@ -27,6 +27,8 @@
 #include <lol/gpu/framebuffer.h>
 #include <lol/thread>
 
+#include <unordered_map> // std::unordered_map
+#include <utility>  // std::pair
 #include <vector>   // std::vector
 #include <memory>   // std::shared_ptr
 #include <stdint.h> // uintptr_t
@@ -47,6 +49,25 @@ struct Tile
     int m_id;
 };
 
+/* Sorts tiles by depth layer (back to front), then by tileset within each
+ * layer, so that each tileset needs one draw call per layer. Within a layer,
+ * tilesets come in the order they first appear in the list: tiles at the
+ * same depth from different tilesets may be drawn in another order than
+ * they were submitted, so give them different depths if their blending
+ * order matters. Tiles at the same depth from the same tileset keep their
+ * submission order. The scratch storage is kept to avoid reallocating. */
+class tile_sorter
+{
+public:
+    /* Returns how many draw calls the tiles needed in submission order */
+    int sort(std::vector<Tile> &tiles);
+
+private:
+    std::vector<Tile> m_sorted;
+    std::vector<std::pair<uint64_t, uint32_t>> m_keys, m_keys_tmp;
+    std::unordered_map<TileSet const *, uint32_t> m_tileset_ids;
+};
+
 class PrimitiveRenderer
 {
     friend class Scene;
@@ -157,6 +178,18 @@ public:
     void AddTile(class TileSet *tileset, int id, vec3 pos, vec2 scale, float radians);
     void AddTile(class TileSet *tileset, int id, mat4 model);
 
+    /* Tile statistics for the last frame. Tiles are sorted by depth layer
+     * then tileset before being drawn (see tile_sorter); unsorted_draw_calls
+     * is how many draw calls plain submission order would have needed. */
+    struct tile_stats
+    {
+        int tiles = 0;
+        int draw_calls = 0;
+        int unsorted_draw_calls = 0;
+    };
+
+    tile_stats const &get_tile_stats() const { return m_tile_stats; }
+
 public:
     void AddLine(vec3 a, vec3 b, vec4 color);
     void AddLine(vec3 a, vec3 b, vec4 color, float duration, uint32_t mask);
@@ -176,6 +209,7 @@ public:
 private:
     void render_primitives();
     void render_tiles();
+    std::shared_ptr<IndexBuffer> const &quad_indices(size_t count);
     void render_lines(float seconds);
 
     ivec2 m_size, m_wanted_size;
@@ -234,6 +268,7 @@ private:
         int /*m_mask,*/ m_debug_mask;
         std::shared_ptr<Shader> m_shader;
         std::shared_ptr<VertexDeclaration> m_vdecl;
+        std::shared_ptr<stream_buffer> m_stream;
     }
     m_line_api;
 
@@ -249,9 +284,15 @@ private:
         std::shared_ptr<Shader> m_palette_shader;
 
         std::shared_ptr<VertexDeclaration> m_vdecl;
-        std::vector<std::shared_ptr<VertexBuffer>> m_bufs;
+        /* Shared by tiles and palettes: positions and texture coords */
+        std::shared_ptr<stream_buffer> m_stream;
+        std::shared_ptr<IndexBuffer> m_ibo;
+
+        tile_sorter m_sorter;
     }
     m_tile_api;
+
+    tile_stats m_tile_stats;
 };
 
 } /* namespace lol */
@@ -32,10 +32,14 @@ public:
     std::string m_name;
 
     /* Pixels, then texture coordinates */
-    ivec2 m_image_size, m_texture_size;
+    ivec2 m_image_size = ivec2(0);
+    ivec2 m_texture_size = ivec2(0);
 
     old_image *m_image = nullptr;
     Texture *m_texture = nullptr;
+
+    /* The loader request while the image is not there yet */
+    uint64_t m_request = 0;
 };
 
 } /* namespace lol */
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010–2023 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -54,24 +54,34 @@ TextureImage::TextureImage(std::string const &path, old_image* img)
 
 TextureImage::~TextureImage()
 {
+    /* A load still in flight must not call back into a dead object */
+    if (m_data->m_request)
+        loader::cancel(m_data->m_request);
     delete m_data;
 }
 
 void TextureImage::Init(std::string const &path)
 {
-    Init(path, ResourceLoader::Load(path));
+    m_data->m_name = "<textureimage> " + path;
+    m_drawgroup = tickable::group::draw::texture;
+
+    /* The image is loaded on the disk thread and handed over at the start
+     * of a game tick; until then, there is no image and no texture. */
+    m_data->m_request = loader::load(path, 0, [this, path](std::shared_ptr<ResourceCodecData> data)
+    {
+        m_data->m_request = 0;
+        Init(path, data.get());
+    });
 }
 
 void TextureImage::Init(std::string const &path, ResourceCodecData* loaded_data)
 {
-    //Load image if available
+    //Load image if available; the data still belongs to the caller
     auto image_data = dynamic_cast<ResourceImageData*>(loaded_data);
     if (image_data != nullptr)
     {
         Init(path, new old_image(*image_data->m_image));
     }
-
-    delete image_data;
 }
 
 void TextureImage::Init(std::string const &path, old_image* img)
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -17,6 +17,14 @@
 #include <cstdio>
 #include <cstring>
 
+#if defined __SSE__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define LOL_BLIT_SSE 1
+#elif defined __ARM_NEON
+#   include <arm_neon.h>
+#   define LOL_BLIT_NEON 1
+#endif
+
 #if defined _WIN32
 #   define WIN32_LEAN_AND_MEAN
 #   include <windows.h>
@@ -35,12 +43,6 @@ static entity_dict<TileSet> tileset_cache;
  * TileSet implementation class
  */
 
-struct tile_def
-{
-    ibox2 pixel_coords;
-    box2 tex_coords;
-};
-
 class TileSetData
 {
     friend class TileSet;
@@ -49,6 +51,11 @@ protected:
     /* Pixels, then texture coordinates */
     std::vector<tile_def> m_tiles;
     ivec2 m_tile_size;
+
+    /* A grid requested while the image was still loading, and the first
+     * of its tiles */
+    ivec2 m_grid_size = ivec2(0), m_grid_count = ivec2(0);
+    int m_grid_first = -1;
 };
 
 /*
@@ -84,25 +91,7 @@ TileSet *TileSet::create(std::string const &path, ivec2 size, ivec2 count)
     if (!ret)
     {
         ret = tileset_cache.set(path, new TileSet(path));
-
-        /* If count is valid, fix size; otherwise, fix count. */
-        if (count.x > 0 && count.y > 0)
-        {
-            size = ret->m_data->m_image_size / count;
-        }
-        else
-        {
-            if (size.x <= 0 || size.y <= 0)
-                size = ivec2(32, 32);
-            count = max(ivec2(1, 1), ret->m_data->m_image_size / size);
-        }
-
-        for (int j = 0; j < count.y; ++j)
-        for (int i = 0; i < count.x; ++i)
-        {
-            ret->define_tile(ibox2(size * ivec2(i, j),
-                                   size * ivec2(i + 1, j + 1)));
-        }
+        ret->define_grid(size, count);
     }
 
     return ret;
@@ -114,25 +103,7 @@ TileSet *TileSet::create(std::string const &path, old_image* img, ivec2 size, iv
     if (!ret)
     {
         ret = tileset_cache.set(path, new TileSet(path, img));
-
-        /* If count is valid, fix size; otherwise, fix count. */
-        if (count.x > 0 && count.y > 0)
-        {
-            size = ret->m_data->m_image_size / count;
-        }
-        else
-        {
-            if (size.x <= 0 || size.y <= 0)
-                size = ivec2(32, 32);
-            count = max(ivec2(1, 1), ret->m_data->m_image_size / size);
-        }
-
-        for (int j = 0; j < count.y; ++j)
-        for (int i = 0; i < count.x; ++i)
-        {
-            ret->define_tile(ibox2(size * ivec2(i, j),
-                                   size * ivec2(i + 1, j + 1)));
-        }
+        ret->define_grid(size, count);
     }
 
     return ret;
@@ -149,6 +120,7 @@ TileSet::TileSet(std::string const &path)
     m_tileset_data(new TileSetData()),
     m_palette(nullptr)
 {
+    m_data->m_name = "<tileset> " + path;
 }
 
 TileSet::TileSet(std::string const &path, old_image *img)
@@ -165,6 +137,29 @@ TileSet::~TileSet()
 
 void TileSet::Init(std::string const &path, ResourceCodecData* loaded_data)
 {
+    super::Init(path, loaded_data);
+
+    /* Tiles defined while loading only get texture coordinates now */
+    for (auto &t : m_tileset_data->m_tiles)
+        t.tex_coords = texels(t.pixel_coords);
+
+    /* Then the grid asked for while loading, in its reserved tiles */
+    auto &d = *m_tileset_data;
+    if (d.m_grid_first >= 0)
+    {
+        auto tiles = grid(d.m_grid_size, d.m_grid_count);
+        if (d.m_grid_count.x > 0 && d.m_grid_count.y > 0)
+        {
+            for (size_t n = 0; n < tiles.size(); ++n)
+                d.m_tiles[d.m_grid_first + n] = tile_def { tiles[n], texels(tiles[n]) };
+        }
+        else
+        {
+            define_tiles_by_box(tiles);
+        }
+        d.m_grid_first = -1;
+    }
+
     //Load tileset if available
     auto tileset_data = dynamic_cast<ResourceTilesetData*>(loaded_data);
     if (tileset_data != nullptr)
@@ -173,8 +168,6 @@ void TileSet::Init(std::string const &path, ResourceCodecData* loaded_data)
     }
 
     m_data->m_name = "<tileset> " + path;
-
-    super::Init(path, loaded_data);
 }
 
 void TileSet::Init(std::string const &path, old_image* img)
@@ -198,13 +191,64 @@ void TileSet::clear_all()
 
 int TileSet::define_tile(ibox2 rect)
 {
-    m_tileset_data->m_tiles.push_back(tile_def {
-             rect,
-             box2((vec2)rect.aa / (vec2)m_data->m_texture_size,
-                  (vec2)rect.bb / (vec2)m_data->m_texture_size) });
+    m_tileset_data->m_tiles.push_back(tile_def { rect, texels(rect) });
     return int(m_tileset_data->m_tiles.size()) - 1;
 }
 
+box2 TileSet::texels(ibox2 rect) const
+{
+    /* Before the image is loaded, there is no texture to map to */
+    if (m_data->m_texture_size == ivec2(0))
+        return box2(vec2(0.f), vec2(0.f));
+
+    return box2((vec2)rect.aa / (vec2)m_data->m_texture_size,
+                (vec2)rect.bb / (vec2)m_data->m_texture_size);
+}
+
+/* If count is valid, fix size; otherwise, fix count */
+std::vector<ibox2> TileSet::grid(ivec2 size, ivec2 count) const
+{
+    if (count.x > 0 && count.y > 0)
+    {
+        size = m_data->m_image_size / count;
+    }
+    else
+    {
+        if (size.x <= 0 || size.y <= 0)
+            size = ivec2(32, 32);
+        count = max(ivec2(1, 1), m_data->m_image_size / size);
+    }
+
+    std::vector<ibox2> ret;
+    for (int j = 0; j < count.y; ++j)
+    for (int i = 0; i < count.x; ++i)
+    {
+        ret.push_back(ibox2(size * ivec2(i, j),
+                            size * ivec2(i + 1, j + 1)));
+    }
+    return ret;
+}
+
+/* While the image is loading, the grid is only remembered. If its count
+ * is known, empty tiles are reserved so that their ids can be used. */
+void TileSet::define_grid(ivec2 size, ivec2 count)
+{
+    if (!m_data->m_request)
+    {
+        auto tiles = grid(size, count);
+        define_tiles_by_box(tiles);
+        return;
+    }
+
+    auto &d = *m_tileset_data;
+    d.m_grid_size = size;
+    d.m_grid_count = count;
+    d.m_grid_first = int(d.m_tiles.size());
+    if (count.x > 0 && count.y > 0)
+        d.m_tiles.resize(d.m_tiles.size() + count.x * count.y,
+                         tile_def { ibox2(ivec2(0), ivec2(0)), box2(vec2(0.f), vec2(0.f)) });
+}
+
 void TileSet::define_tile(ivec2 count)
 {
     ivec2 size = m_data->m_image_size / count;
@@ -259,41 +303,126 @@ TileSet const* TileSet::GetPalette() const
     return m_palette;
 }
 
-void TileSet::BlitTile(uint32_t id, mat4 model, vec3 *vertex, vec2 *texture)
+void TileSet::BlitTiles(std::span<Tile const> tiles, vec3 *vertex, vec2 *texture)
 {
-    ibox2 pixels = m_tileset_data->m_tiles[id].pixel_coords;
-    box2 texels = m_tileset_data->m_tiles[id].tex_coords;
-    float dtx = texels.extent().x;
-    float dty = texels.extent().y;
-    float tx = texels.aa.x;
-    float ty = texels.aa.y;
+    if (!m_data->m_image && m_data->m_texture)
+    {
+        blit_quads(tiles, m_tileset_data->m_tiles.data(), vertex, texture);
+    }
+    else
+    {
+        memset((void *)vertex, 0, 4 * tiles.size() * sizeof(vec3));
+        memset((void *)texture, 0, 4 * tiles.size() * sizeof(vec2));
+    }
+}
 
-    vec3 pos = (model * vec4(0.f, 0.f, 0.f, 1.f)).xyz;
-    vec3 extent_x = 0.5f * pixels.extent().x * (model * vec4::axis_x).xyz;
-    vec3 extent_y = 0.5f * pixels.extent().y * (model * vec4::axis_y).xyz;
+//Quad generation -------------------------------------------------------------
 
-    if (!m_data->m_image && m_data->m_texture)
+/* Both versions below must perform the exact same operations in the same
+ * order: the quad centre is the translation column of the model matrix,
+ * and the half extents are the X and Y columns scaled by half the tile
+ * size in pixels. */
+
+void blit_quads_scalar(std::span<Tile const> tiles, tile_def const *defs,
+                       vec3 *vertex, vec2 *texture)
+{
+    for (auto const &t : tiles)
     {
+        tile_def const &def = defs[t.m_id];
+        ivec2 size = def.pixel_coords.extent();
+        box2 texels = def.tex_coords;
+
+        vec3 pos = t.m_model[3].xyz;
+        vec3 extent_x = (0.5f * size.x) * t.m_model[0].xyz;
+        vec3 extent_y = (0.5f * size.y) * t.m_model[1].xyz;
+
         *vertex++ = pos + extent_x + extent_y;
         *vertex++ = pos - extent_x + extent_y;
         *vertex++ = pos + extent_x - extent_y;
-        *vertex++ = pos + extent_x - extent_y;
-        *vertex++ = pos - extent_x + extent_y;
         *vertex++ = pos - extent_x - extent_y;
 
-        *texture++ = vec2(tx + dtx, ty);
-        *texture++ = vec2(tx,       ty);
-        *texture++ = vec2(tx + dtx, ty + dty);
-        *texture++ = vec2(tx + dtx, ty + dty);
-        *texture++ = vec2(tx,       ty);
-        *texture++ = vec2(tx,       ty + dty);
+        float tx = texels.aa.x, ty = texels.aa.y;
+        float tx2 = tx + texels.extent().x, ty2 = ty + texels.extent().y;
+        *texture++ = vec2(tx2, ty);
+        *texture++ = vec2(tx,  ty);
+        *texture++ = vec2(tx2, ty2);
+        *texture++ = vec2(tx,  ty2);
     }
-    else
+}
+
+#if LOL_BLIT_SSE || LOL_BLIT_NEON
+static inline void blit_quad_simd(Tile const &t, tile_def const &def,
+                                  float *vertex, float *texture)
+{
+    ivec2 size = def.pixel_coords.extent();
+    box2 texels = def.tex_coords;
+    float hx = 0.5f * size.x, hy = 0.5f * size.y;
+    float tx = texels.aa.x, ty = texels.aa.y;
+    float tx2 = tx + texels.extent().x, ty2 = ty + texels.extent().y;
+
+#if LOL_BLIT_SSE
+    __m128 pos = _mm_loadu_ps(&t.m_model[3][0]);
+    __m128 ex = _mm_mul_ps(_mm_set1_ps(hx), _mm_loadu_ps(&t.m_model[0][0]));
+    __m128 ey = _mm_mul_ps(_mm_set1_ps(hy), _mm_loadu_ps(&t.m_model[1][0]));
+
+    __m128 a = _mm_add_ps(_mm_add_ps(pos, ex), ey);
+    __m128 b = _mm_add_ps(_mm_sub_ps(pos, ex), ey);
+    __m128 c = _mm_sub_ps(_mm_add_ps(pos, ex), ey);
+    __m128 d = _mm_sub_ps(_mm_sub_ps(pos, ex), ey);
+
+    /* Pack four xyz triplets into three registers */
+    __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 2, 2));
+    __m128 cd = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0, 0, 2, 2));
+    _mm_storeu_ps(vertex + 0, _mm_shuffle_ps(a, ab, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(vertex + 4, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 1)));
+    _mm_storeu_ps(vertex + 8, _mm_shuffle_ps(cd, d, _MM_SHUFFLE(2, 1, 2, 0)));
+
+    _mm_storeu_ps(texture + 0, _mm_setr_ps(tx2, ty, tx, ty));
+    _mm_storeu_ps(texture + 4, _mm_setr_ps(tx2, ty2, tx, ty2));
+#else
+    float32x4_t pos = vld1q_f32(&t.m_model[3][0]);
+    float32x4_t ex = vmulq_n_f32(vld1q_f32(&t.m_model[0][0]), hx);
+    float32x4_t ey = vmulq_n_f32(vld1q_f32(&t.m_model[1][0]), hy);
+
+    float32x4_t a = vaddq_f32(vaddq_f32(pos, ex), ey);
+    float32x4_t b = vaddq_f32(vsubq_f32(pos, ex), ey);
+    float32x4_t c = vsubq_f32(vaddq_f32(pos, ex), ey);
+    float32x4_t d = vsubq_f32(vsubq_f32(pos, ex), ey);
+
+    /* Overlapping stores: each one overwrites the previous w lane */
+    vst1q_f32(vertex + 0, a);
+    vst1q_f32(vertex + 3, b);
+    vst1q_f32(vertex + 6, c);
+    vst1_f32(vertex + 9, vget_low_f32(d));
+    vst1q_lane_f32(vertex + 11, d, 2);
+
+    float const uv[8] = { tx2, ty, tx, ty, tx2, ty2, tx, ty2 };
+    vst1q_f32(texture + 0, vld1q_f32(uv));
+    vst1q_f32(texture + 4, vld1q_f32(uv + 4));
+#endif
+}
+#endif
+
+void blit_quads(std::span<Tile const> tiles, tile_def const *defs,
+                vec3 *vertex, vec2 *texture)
+{
+#if LOL_BLIT_SSE || LOL_BLIT_NEON
+    float *v = &vertex[0].x, *uv = &texture[0].x;
+    size_t i = 0, n = tiles.size();
+
+    /* Four quads per iteration, i.e. 48 position and 32 texture floats */
+    for (; i + 4 <= n; i += 4, v += 48, uv += 32)
     {
-        memset((void *)vertex, 0, 6 * sizeof(vec3));
-        memset((void *)texture, 0, 6 * sizeof(vec2));
+        blit_quad_simd(tiles[i + 0], defs[tiles[i + 0].m_id], v + 0,  uv + 0);
+        blit_quad_simd(tiles[i + 1], defs[tiles[i + 1].m_id], v + 12, uv + 8);
+        blit_quad_simd(tiles[i + 2], defs[tiles[i + 2].m_id], v + 24, uv + 16);
+        blit_quad_simd(tiles[i + 3], defs[tiles[i + 3].m_id], v + 36, uv + 24);
     }
+
+    blit_quads_scalar(tiles.subspan(i), defs, vertex + 4 * i, texture + 4 * i);
+#else
+    blit_quads_scalar(tiles, defs, vertex, texture);
+#endif
 }
 
 } /* namespace lol */
-
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2020 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -30,6 +30,7 @@
 */
 #include "textureimage.h"
 
+#include <lol/std/span> // std::span
 #include <vector> // std::vector
 
 namespace lol
@@ -37,12 +38,30 @@ namespace lol
 
 class TextureImageData;
 class TileSetData;
+struct Tile;
+
+struct tile_def
+{
+    ibox2 pixel_coords;
+    box2 tex_coords;
+};
+
+/* Write 4 vertices and 4 texture coordinates per tile, to be drawn with
+ * the index pattern 0 1 2 2 1 3 repeated for each quad. The tile ids are
+ * looked up in defs. The SIMD version, when available, gives bit-exact
+ * results compared to the scalar one. */
+void blit_quads_scalar(std::span<Tile const> tiles, tile_def const *defs,
+                       vec3 *vertex, vec2 *texture);
+void blit_quads(std::span<Tile const> tiles, tile_def const *defs,
+                vec3 *vertex, vec2 *texture);
 
 class TileSet : public TextureImage
 {
     typedef TextureImage super;
 
 public:
+    /* Tilesets created from a path load their image in the background;
+     * until it arrives, there is no texture and tiles have no size. */
     static TileSet *create(std::string const &path);
     static TileSet *create(std::string const &path, old_image* img);
     static TileSet *create(std::string const &path, old_image* img, std::vector<ibox2>& tiles);
@@ -59,6 +78,10 @@ private:
     TileSet(std::string const &path);
     TileSet(std::string const &path, old_image *img);
 
+    std::vector<ibox2> grid(ivec2 size, ivec2 count) const;
+    void define_grid(ivec2 size, ivec2 count);
+    box2 texels(ibox2 rect) const;
+
 protected:
     virtual void Init(std::string const &path, ResourceCodecData* loaded_data);
     virtual void Init(std::string const &path, old_image* img);
@@ -80,7 +103,8 @@ public:
     void SetPalette(TileSet* palette);
     TileSet* GetPalette();
     TileSet const * GetPalette() const;
-    void BlitTile(uint32_t id, mat4 model, vec3 *vertex, vec2 *texture);
+    /* All tiles must belong to this tileset; see blit_quads() */
+    void BlitTiles(std::span<Tile const> tiles, vec3 *vertex, vec2 *texture);
 
 protected:
     TileSetData *m_tileset_data;
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010–2024 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -31,13 +31,20 @@
 #elif __EMSCRIPTEN__
 #   include <emscripten/fetch.h>
 #else
-#   include <lol/thread>
 #   include <httplib.h>
+#   include <condition_variable>
+#   include <deque>
+#   include <mutex>
+#   include <thread>
+#   include <unordered_map>
+#   include <vector>
 #endif
 
-#include <utility>
+#include <algorithm> // std::max, std::min
+#include <atomic>
+#include <cstring>   // std::memcpy
 #include <memory>
-#include <regex>
+#include <utility>
 
 namespace lol
 {
@@ -48,105 +55,305 @@ namespace net
 namespace http
 {
 
-class client_impl
+struct request
+{
+    std::string url;
+    body_sink sink; // keep the body in the response if empty
+    std::function<void(response)> done;
+};
+
+static void finish(request &req, response &&res)
+{
+    if (!res.ok())
+        msg::error("downloading %s failed, HTTP failure status code: %d.\n",
+                   req.url.c_str(), res.code);
+    req.done(std::move(res));
+}
+
+class service_impl
 {
 public:
 #if __NX__ || __SCE__ || _GAMING_XBOX
-    void get(std::string const &url)
+    service_impl(int, int) {}
+
+    void submit(request &&req)
     {
-        msg::error("downloading %s failed: not implemented\n", url.c_str());
-        m_status = status::error;
+        msg::error("downloading %s failed: not implemented\n", req.url.c_str());
+        req.done(response {});
     }
 #elif __EMSCRIPTEN__
-    ~client_impl()
-    {
-        emscripten_fetch_close(m_fetch);
-    }
+    service_impl(int, int) {}
 
-    void get(std::string const &url)
+    // The browser queues and runs the requests for us
+    void submit(request &&req)
     {
+        auto *data = new request(std::move(req));
+
         emscripten_fetch_attr_t attr;
         emscripten_fetch_attr_init(&attr);
-        strcpy(attr.requestMethod, "GET");
-        attr.userData = this;
+        std::strcpy(attr.requestMethod, "GET");
+        attr.userData = data;
         attr.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY;
-        attr.onsuccess = client_impl::on_success;
-        attr.onerror = client_impl::on_failure;
-        m_fetch = emscripten_fetch(&attr, url.c_str());
+        attr.onsuccess = service_impl::on_done;
+        attr.onerror = service_impl::on_done;
+        emscripten_fetch(&attr, data->url.c_str());
     }
 
-    static void on_success(emscripten_fetch_t *fetch)
+    static void on_done(emscripten_fetch_t *fetch)
+    {
+        std::unique_ptr<request> req(static_cast<request *>(fetch->userData));
+
+        response res;
+        res.code = fetch->status ? fetch->status : -1;
+        if (!req->sink)
+            res.body.assign(fetch->data, size_t(fetch->numBytes));
+        else if (!req->sink(fetch->data, size_t(fetch->numBytes)))
+            res.code = -1;
+        if (res.code != -1)
+            res.size = size_t(fetch->numBytes);
+        emscripten_fetch_close(fetch);
+
+        finish(*req, std::move(res));
+    }
+#else
+    service_impl(int workers, int per_host)
+      : m_per_host(std::max(per_host, 1))
     {
-        auto *that = (client_impl *)fetch->userData;
-        that->m_result.assign(fetch->data, fetch->numBytes);
-        that->m_status = status::success;
+        for (int i = 0; i < std::max(workers, 1); ++i)
+            m_threads.emplace_back([this]() { worker_main(); });
     }
 
-    static void on_failure(emscripten_fetch_t *fetch)
+    ~service_impl()
     {
-        auto *that = (client_impl *)fetch->userData;
-        msg::error("downloading %s failed, HTTP failure status code: %d.\n",
-                   fetch->url, fetch->status);
-        that->m_status = status::error;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+
+        for (auto &t : m_threads)
+            t.join();
+
+        // Whatever did not start yet fails
+        for (auto &j : m_queue)
+            j.req.done(response {});
     }
 
-    emscripten_fetch_t *m_fetch = nullptr;
-#else
-    ~client_impl()
+    void submit(request &&req)
+    {
+        job j { std::move(req) };
+        if (!split_url(j.req.url, j.host, j.path))
+        {
+            finish(j.req, response {});
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(j));
+        }
+        m_wake.notify_one();
+    }
+
+private:
+    struct job
+    {
+        request req;
+        std::string host; // scheme, host and port
+        std::string path; // path and query
+    };
+
+    // Split a URL where the path starts, dropping any fragment. The scheme
+    // is optional, like it is for httplib::Client.
+    static bool split_url(std::string const &url, std::string &host, std::string &path)
     {
-        delete m_thread;
+        size_t start = url.find("://");
+        start = start == std::string::npos ? 0 : start + 3;
+
+        size_t const end = url.find_first_of("/?#", start);
+        if (end == start || start == url.size())
+            return false;
+
+        host = url.substr(0, end);
+        path = end == std::string::npos ? "" : url.substr(end, url.find('#', end) - end);
+        if (path.empty() || path[0] != '/')
+            path.insert(0, "/");
+        return true;
     }
 
-    void get(std::string const& url)
+    // Connections to a host; busy ones are in use by a worker
+    struct host
     {
-        // This regex is copied from cpp-httplib
-        const static std::regex re(
-            R"(^((?:[^:/?#]+:)?(?://[^/?#]*)?)([^?#]*(?:\?[^#]*)?)(?:#.*)?)");
+        std::vector<std::unique_ptr<httplib::Client>> idle;
+        int busy = 0;
+    };
 
-        std::smatch m;
-        if (!std::regex_match(url, m, re))
+    // The first queued job whose host has a connection to spare
+    std::deque<job>::iterator runnable()
+    {
+        for (auto it = m_queue.begin(); it != m_queue.end(); ++it)
         {
-            m_status = status::error;
-            return;
+            auto h = m_hosts.find(it->host);
+            if (h == m_hosts.end() || h->second.busy < m_per_host)
+                return it;
         }
+        return m_queue.end();
+    }
+
+    void worker_main()
+    {
+        for (;;)
+        {
+            job j;
+            std::unique_ptr<httplib::Client> cli;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                auto it = m_queue.end();
+                m_wake.wait(lock, [&]() { return m_quit || (it = runnable()) != m_queue.end(); });
+                if (m_quit)
+                    return;
 
-        auto scheme_and_host = m[1].str();
-        auto path = m[2].str();
+                j = std::move(*it);
+                m_queue.erase(it);
 
-        m_client = std::make_shared<httplib::Client>(scheme_and_host);
-        m_client->set_follow_location(true);
+                auto &h = m_hosts[j.host];
+                ++h.busy;
+                if (!h.idle.empty())
+                {
+                    cli = std::move(h.idle.back());
+                    h.idle.pop_back();
+                }
+            }
+
+            if (!cli)
+            {
+                cli = std::make_unique<httplib::Client>(j.host);
+                cli->set_keep_alive(true);
+                cli->set_follow_location(true);
 #ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-        m_client->enable_server_certificate_verification(false);
+                cli->enable_server_certificate_verification(false);
 #endif
+            }
+
+            response res = run(*cli, j);
 
-        m_thread = new lol::thread([this, path](thread *)
-        {
-            auto res = m_client->Get(path);
-            if (res && res->status == 200)
             {
-                m_result = std::move(res->body);
-                m_status = status::success;
+                std::unique_lock<std::mutex> lock(m_mutex);
+                auto &h = m_hosts[j.host];
+                --h.busy;
+                h.idle.push_back(std::move(cli));
             }
-            else
+            // Another job may have been waiting for this host
+            m_wake.notify_all();
+
+            finish(j.req, std::move(res));
+        }
+    }
+
+    static response run(httplib::Client &cli, job &j)
+    {
+        response res;
+
+        auto result = cli.Get(j.path,
+            [&](httplib::Response const &r)
             {
-                msg::error("downloading %s failed, HTTP failure status code: %d.\n",
-                           m_url.c_str(), res ? res->status : -1);
-                m_status = status::error;
-            }
-        });
+                res.code = r.status;
+                return true;
+            },
+            [&](char const *data, size_t size)
+            {
+                if (j.req.sink)
+                {
+                    if (!j.req.sink(data, size))
+                        return false;
+                }
+                else
+                    res.body.append(data, size);
+                res.size += size;
+                return true;
+            });
+
+        // Also covers requests aborted by the sink
+        if (!result)
+            res.code = -1;
+        return res;
     }
 
-    lol::thread *m_thread = nullptr;
-    std::shared_ptr<httplib::Client> m_client;
+    int const m_per_host;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<job> m_queue;
+    std::unordered_map<std::string, host> m_hosts;
+    bool m_quit = false;
 #endif
+};
+
+//
+// The service
+//
+
+service::service(int workers, int per_host)
+  : impl(std::make_unique<service_impl>(workers, per_host))
+{
+}
+
+service::~service()
+{
+}
 
-    status m_status;
+service &service::get()
+{
+    static service s;
+    return s;
+}
+
+std::future<response> service::fetch(std::string const &url)
+{
+    return fetch(url, body_sink());
+}
+
+void service::fetch(std::string const &url, std::function<void(response)> callback)
+{
+    impl->submit(request { url, body_sink(), std::move(callback) });
+}
+
+std::future<response> service::fetch(std::string const &url, body_sink sink)
+{
+    auto p = std::make_shared<std::promise<response>>();
+    auto f = p->get_future();
+    impl->submit(request { url, std::move(sink), [p](response res) { p->set_value(std::move(res)); } });
+    return f;
+}
+
+std::future<response> service::fetch(std::string const &url, void *buf, size_t capacity)
+{
+    size_t written = 0;
+    return fetch(url, [buf, capacity, written](char const *data, size_t size) mutable
+    {
+        if (size > capacity - written)
+            return false;
+        std::memcpy(static_cast<char *>(buf) + written, data, size);
+        written += size;
+        return true;
+    });
+}
+
+//
+// The polling client
+//
+
+class client_impl
+{
+public:
+    std::atomic<status> m_status = status::ready;
     std::string m_url;
     std::string m_result;
 };
 
 client::client()
-  : impl(std::make_unique<client_impl>())
+  : impl(std::make_shared<client_impl>())
 {
 }
 
@@ -156,16 +363,21 @@ client::~client()
 
 void client::get(std::string const &url)
 {
+    // A new state, so that a query still in flight cannot touch this one
+    impl = std::make_shared<client_impl>();
     impl->m_status = status::pending;
     impl->m_url = url;
-    impl->get(url);
+
+    service::get().fetch(url, [state = impl](response res)
+    {
+        state->m_result = std::move(res.body);
+        state->m_status = res.ok() ? status::success : status::error;
+    });
 }
 
 void client::reset()
 {
-    impl->m_status = status::ready;
-    impl->m_url.assign("");
-    impl->m_result.assign("");
+    impl = std::make_shared<client_impl>();
 }
 
 status client::status() const
@@ -0,0 +1,233 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010–2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine/sys> // lol::sys::thread_pool
+
+#include <algorithm> // std::max, std::min
+#include <atomic> // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <cstdint> // uint64_t
+#include <mutex> // std::mutex
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+namespace lol::sys
+{
+
+// Set while a thread is running a parallel_for() chunk, so that nested
+// calls do not wait on workers that are busy waiting for them.
+static thread_local bool g_in_pool = false;
+
+class thread_pool_impl
+{
+public:
+    thread_pool_impl(int workers)
+      : m_slots(workers + 1)
+    {
+        for (int i = 0; i < workers; ++i)
+            m_threads.emplace_back([this, i]() { worker_main(i + 1); });
+    }
+
+    ~thread_pool_impl()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+
+        for (auto &t : m_threads)
+            t.join();
+    }
+
+    void run(size_t count, size_t grain,
+             std::function<void(size_t, size_t)> const &fn)
+    {
+        std::unique_lock<std::mutex> submit(m_submit);
+
+        // Give each thread an equal, contiguous slice of the range
+        size_t const n = m_slots.size();
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::unique_lock<std::mutex> lock(m_slots[i].lock);
+            m_slots[i].begin = count * i / n;
+            m_slots[i].end = count * (i + 1) / n;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_fn = &fn;
+            m_grain = grain;
+            m_pending = count;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+
+        work(0, fn);
+
+        // Wait until the last chunk is done and every worker has left the
+        // slots alone, so that the next call can safely reset them.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_pending == 0 && m_active == 0; });
+        m_fn = nullptr;
+    }
+
+    int concurrency() const { return (int)m_slots.size(); }
+
+private:
+    void worker_main(size_t index)
+    {
+        uint64_t seen = 0;
+
+        for (;;)
+        {
+            std::function<void(size_t, size_t)> const *fn;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&]() { return m_quit || (m_fn && m_generation != seen); });
+                if (m_quit)
+                    return;
+                seen = m_generation;
+                fn = m_fn;
+                ++m_active;
+            }
+
+            work(index, *fn);
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                --m_active;
+            }
+            m_done.notify_all();
+        }
+    }
+
+    void work(size_t index, std::function<void(size_t, size_t)> const &fn)
+    {
+        g_in_pool = true;
+
+        size_t begin, end;
+        while (pop(index, begin, end) || steal(index, begin, end))
+        {
+            fn(begin, end);
+
+            // Wake the caller if this was the last chunk
+            if (m_pending.fetch_sub(end - begin) == end - begin)
+            {
+                { std::unique_lock<std::mutex> lock(m_mutex); }
+                m_done.notify_all();
+            }
+        }
+
+        g_in_pool = false;
+    }
+
+    // Take one chunk from the front of our own slice
+    bool pop(size_t index, size_t &begin, size_t &end)
+    {
+        auto &s = m_slots[index];
+        std::unique_lock<std::mutex> lock(s.lock);
+        if (s.begin == s.end)
+            return false;
+        begin = s.begin;
+        end = s.begin = std::min(s.end, s.begin + m_grain);
+        return true;
+    }
+
+    // Take the back half of another thread’s slice and make it ours
+    bool steal(size_t index, size_t &begin, size_t &end)
+    {
+        size_t const n = m_slots.size();
+        for (size_t k = 1; k < n; ++k)
+        {
+            auto &victim = m_slots[(index + k) % n];
+            size_t from, to;
+            {
+                std::unique_lock<std::mutex> lock(victim.lock);
+                size_t const left = victim.end - victim.begin;
+                if (left == 0)
+                    continue;
+                to = victim.end;
+                from = victim.end -= (left + 1) / 2;
+            }
+
+            auto &s = m_slots[index];
+            {
+                std::unique_lock<std::mutex> lock(s.lock);
+                s.begin = from;
+                s.end = to;
+            }
+            return pop(index, begin, end);
+        }
+
+        return false;
+    }
+
+    // One work slice per thread; slot 0 belongs to the caller
+    struct alignas(64) slot
+    {
+        std::mutex lock;
+        size_t begin = 0, end = 0;
+    };
+
+    std::vector<slot> m_slots;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_submit, m_mutex;
+    std::condition_variable m_wake, m_done;
+    std::function<void(size_t, size_t)> const *m_fn = nullptr;
+    std::atomic<size_t> m_pending = 0;
+    size_t m_grain = 1;
+    uint64_t m_generation = 0;
+    int m_active = 0;
+    bool m_quit = false;
+};
+
+thread_pool::thread_pool(int workers)
+{
+    if (workers < 0)
+        workers = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+    impl = std::make_unique<thread_pool_impl>(workers);
+}
+
+thread_pool::~thread_pool()
+{
+}
+
+thread_pool &thread_pool::get()
+{
+    static thread_pool ret;
+    return ret;
+}
+
+int thread_pool::concurrency() const
+{
+    return impl->concurrency();
+}
+
+void thread_pool::parallel_for(size_t count, size_t grain,
+                               std::function<void(size_t, size_t)> const &fn)
+{
+    grain = std::max(grain, size_t(1));
+
+    // Not worth waking anyone up, or we are already inside a pool
+    if (count <= grain || impl->concurrency() == 1 || g_in_pool)
+    {
+        for (size_t i = 0; i < count; i += grain)
+            fn(i, std::min(count, i + grain));
+        return;
+    }
+
+    impl->run(count, grain, fn);
+}
+
+} // namespace lol::sys
@@ -0,0 +1,261 @@
+//
+//  Lol Engine — Unit tests for audio signal processing
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine/audio>
+#include <lol/unit_test>
+
+#include <algorithm> // std::min, std::max
+#include <cmath>     // std::sin, std::fabs
+#include <memory>    // std::shared_ptr
+#include <utility>   // std::pair
+#include <vector>    // std::vector
+
+namespace lol
+{
+
+// A seekable sine wave around a constant level, with the second channel
+// upside down
+class wave : public audio::stream<float>
+{
+public:
+    wave(size_t channels, int frequency, size_t size, float dc, float amplitude)
+      : audio::stream<float>(channels, frequency),
+        m_size(size), m_dc(dc), m_amplitude(amplitude)
+    {}
+
+    virtual size_t get(float *buf, size_t frames) override
+    {
+        size_t n = std::min(frames, m_size - m_pos);
+        for (size_t i = 0; i < n; ++i, ++m_pos)
+        {
+            float x = m_amplitude * std::sin(0.05f * float(m_pos));
+            for (size_t ch = 0; ch < m_channels; ++ch)
+                buf[i * m_channels + ch] = m_dc + (ch & 1 ? -x : x);
+        }
+        return n;
+    }
+
+    virtual std::optional<size_t> size() const override { return m_size; }
+    virtual std::optional<size_t> pos() const override { return m_pos; }
+
+    virtual bool seek(size_t pos) override
+    {
+        m_pos = std::min(pos, m_size);
+        return true;
+    }
+
+private:
+    size_t m_size, m_pos = 0;
+    float m_dc, m_amplitude;
+};
+
+// The kernels use SSE2 or NEON on blocks of 4 or 8 samples and plain code
+// for the rest; every length up to a few blocks must give what the plain
+// loops give.
+lolunit_declare_fixture(dsp_test)
+{
+    static size_t const MAX = 37;
+
+    static std::vector<float> random_floats(size_t count)
+    {
+        std::vector<float> ret(count);
+        for (auto &x : ret)
+            x = lol::rand(-1.f, 1.f);
+        return ret;
+    }
+
+    // Read a stream to its end
+    static std::vector<float> read_all(audio::stream<float> &s, size_t block = 1000)
+    {
+        std::vector<float> ret;
+        std::vector<float> buf(block * s.channels());
+        while (size_t n = s.get(buf.data(), block))
+            ret.insert(ret.end(), buf.begin(), buf.begin() + n * s.channels());
+        return ret;
+    }
+
+    lolunit_declare_test(convert)
+    {
+        for (size_t count = 0; count <= MAX; ++count)
+        {
+            std::vector<int16_t> src(count);
+            for (size_t n = 0; n < count; ++n)
+                src[n] = int16_t(lol::rand(65536) - 32768);
+            if (count)
+                src[0] = -32768;
+
+            std::vector<float> dst(count + 1, 42.f);
+            audio::dsp::convert(src.data(), dst.data(), count);
+            for (size_t n = 0; n < count; ++n)
+                lolunit_assert_equal(dst[n], src[n] * (1.f / 32768.f));
+            lolunit_assert_equal(dst[count], 42.f);
+        }
+    }
+
+    lolunit_declare_test(mix)
+    {
+        for (size_t count = 0; count <= MAX; ++count)
+        {
+            auto src = random_floats(count), dst = random_floats(count + 1);
+            auto expected = dst;
+            for (size_t n = 0; n < count; ++n)
+                expected[n] += src[n];
+
+            audio::dsp::mix(dst.data(), src.data(), count);
+            for (size_t n = 0; n <= count; ++n)
+                lolunit_assert_equal(dst[n], expected[n]);
+        }
+    }
+
+    lolunit_declare_test(remix)
+    {
+        for (size_t frames = 0; frames <= MAX; ++frames)
+        for (size_t in = 1; in <= 3; ++in)
+        for (size_t out = 1; out <= 3; ++out)
+        {
+            auto src = random_floats(frames * in);
+            std::vector<float> dst(frames * out + 1, 42.f);
+            audio::dsp::remix(src.data(), in, dst.data(), out, frames);
+
+            for (size_t n = 0; n < frames; ++n)
+            {
+                float sum = 0.f;
+                for (size_t ch = 0; ch < in; ++ch)
+                    sum += src[n * in + ch];
+
+                for (size_t ch = 0; ch < out; ++ch)
+                {
+                    float expected = in == out ? src[n * in + ch]
+                                   : in == 1 ? src[n]
+                                   : out == 1 ? (in == 2 ? 0.5f * sum : sum * (1.f / in))
+                                   : ch < in ? src[n * in + ch] : 0.f;
+                    lolunit_assert_equal(dst[n * out + ch], expected);
+                }
+            }
+            lolunit_assert_equal(dst[frames * out], 42.f);
+        }
+    }
+
+    lolunit_declare_test(deinterleave)
+    {
+        for (size_t frames = 0; frames <= MAX; ++frames)
+        for (size_t channels = 1; channels <= 3; ++channels)
+        {
+            auto src = random_floats(frames * channels);
+            std::vector<std::vector<float>> dst(channels, std::vector<float>(frames + 1, 42.f));
+            std::vector<float *> rows;
+            for (auto &d : dst)
+                rows.push_back(d.data());
+
+            audio::dsp::deinterleave(src.data(), channels, rows.data(), frames);
+            for (size_t ch = 0; ch < channels; ++ch)
+            {
+                for (size_t n = 0; n < frames; ++n)
+                    lolunit_assert_equal(dst[ch][n], src[n * channels + ch]);
+                lolunit_assert_equal(dst[ch][frames], 42.f);
+            }
+        }
+    }
+
+    // The curve must be the one of sample::softclip(), stay within
+    // [-1, 1], and never go down
+    lolunit_declare_test(softclip)
+    {
+        std::vector<float> buf;
+        for (int i = -4000; i <= 4000; ++i)
+            buf.push_back(i / 1000.f);
+        auto src = buf;
+        audio::dsp::softclip(buf.data(), buf.size());
+
+        for (size_t n = 0; n < buf.size(); ++n)
+        {
+            lolunit_set_context(src[n]);
+            lolunit_assert_equal(buf[n], audio::sample::softclip(src[n]));
+            lolunit_assert_lequal(std::fabs(buf[n]), 1.f);
+            if (n)
+                lolunit_assert_lequal(buf[n - 1], buf[n]);
+        }
+        lolunit_assert_equal(buf[4000], 0.f);
+    }
+
+    // A constant comes out unchanged, apart from the ramps at both ends
+    // where the filter sees the silence around the stream
+    lolunit_declare_test(resampler_dc)
+    {
+        for (auto [in, out] : { std::pair(44100, 48000), std::pair(48000, 44100),
+                                std::pair(22050, 48000), std::pair(48000, 8000) })
+        {
+            lolunit_set_context(in);
+            auto src = std::make_shared<wave>(2, in, 5000, 0.5f, 0.f);
+            audio::dsp::resampler r(src, out);
+            lolunit_assert_equal(r.channels(), 2u);
+            lolunit_assert_equal(r.frequency(), out);
+
+            auto data = read_all(r);
+            size_t const frames = data.size() / 2;
+            size_t const edge = 32 * std::max(out, in) / in;
+            lolunit_assert_greater(frames, 2 * edge);
+            for (size_t n = 2 * edge; n < 2 * (frames - edge); ++n)
+                lolunit_assert_doubles_equal(data[n], 0.5f, 1e-4f);
+        }
+    }
+
+    // As many frames as size() announces, whatever the read sizes
+    lolunit_declare_test(resampler_length)
+    {
+        for (auto [in, out] : { std::pair(44100, 48000), std::pair(48000, 44100),
+                                std::pair(44100, 44101), std::pair(48000, 8000) })
+        for (size_t size : { 1, 7, 1000, 4321 })
+        for (size_t block : { 1, 100, 4096 })
+        {
+            lolunit_set_context(size);
+            audio::dsp::resampler r(std::make_shared<wave>(1, in, size, 0.f, 0.5f), out);
+            lolunit_assert(r.size().has_value());
+            size_t frames = read_all(r, block).size();
+            lolunit_assert_equal(frames, *r.size());
+            lolunit_assert_equal(*r.pos(), frames);
+        }
+    }
+
+    // Once the filter window is past the seek point, the output is the
+    // same as when reading from the start
+    lolunit_declare_test(resampler_seek)
+    {
+        for (auto [in, out] : { std::pair(44100, 48000), std::pair(48000, 44100) })
+        {
+            lolunit_set_context(in);
+            auto src = std::make_shared<wave>(2, in, 6000, 0.f, 0.5f);
+            audio::dsp::resampler r(src, out);
+            auto ref = read_all(r);
+
+            for (size_t pos : { 0, 1, 1234, 3000 })
+            {
+                lolunit_set_context(pos);
+                lolunit_assert(r.seek(pos));
+                lolunit_assert_equal(*r.pos(), pos);
+                lolunit_assert_equal(*src->pos(), pos * in / out);
+
+                auto data = read_all(r);
+                lolunit_assert_equal(data.size(), ref.size() - 2 * pos);
+                size_t const skip = pos ? 32 : 0;
+                for (size_t n = 2 * skip; n < data.size(); ++n)
+                    lolunit_assert_equal(data[n], ref[2 * pos + n]);
+            }
+        }
+    }
+};
+
+} // namespace lol
@@ -0,0 +1,139 @@
+//
+//  Lol Engine — Unit tests for the QOA decoder
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine/audio>
+#include <lol/unit_test>
+
+#include <algorithm> // std::fill_n
+#include <cmath>     // std::sin
+#include <cstdlib>   // std::free
+#include <memory>    // std::shared_ptr
+#include <vector>    // std::vector
+
+#include "../../3rdparty/qoa/qoa.h"
+
+namespace lol
+{
+
+// The decoder must give exactly what the reference qoa_decode() gives for
+// the whole file, however it is read.
+lolunit_declare_fixture(qoa_test)
+{
+    static size_t const CHANNELS = 2;
+    static size_t const FRAMES = 3 * QOA_FRAME_LEN + 1234;
+
+    std::vector<uint8_t> file;
+    std::vector<int16_t> reference;
+
+    void setup()
+    {
+        // Two tones and some noise, so that every slice has work to do
+        std::vector<int16_t> signal(FRAMES * CHANNELS);
+        uint32_t seed = 1;
+        for (size_t n = 0; n < FRAMES; ++n)
+        {
+            seed = seed * 1664525 + 1013904223;
+            float noise = float(seed >> 20) / 4096.f - 0.5f;
+            signal[n * CHANNELS] = int16_t(8000.f * std::sin(float(n) * 0.031f) + 500.f * noise);
+            signal[n * CHANNELS + 1] = int16_t(6000.f * std::sin(float(n) * 0.0047f) - 700.f * noise);
+        }
+
+        qoa_desc desc {};
+        desc.channels = CHANNELS;
+        desc.samplerate = 44100;
+        desc.samples = FRAMES;
+        unsigned int len = 0;
+        auto *bytes = static_cast<uint8_t *>(qoa_encode(signal.data(), &desc, &len));
+        lolunit_assert(bytes);
+        file.assign(bytes, bytes + len);
+        std::free(bytes);
+
+        qoa_desc out {};
+        short *pcm = qoa_decode(file.data(), (int)file.size(), &out);
+        lolunit_assert(pcm);
+        lolunit_assert_equal(out.samples, FRAMES);
+        reference.assign(pcm, pcm + FRAMES * CHANNELS);
+        std::free(pcm);
+    }
+
+    // Read count frames and check them against the reference at pos
+    void check(audio::stream<int16_t> &s, size_t pos, size_t count)
+    {
+        std::vector<int16_t> buf(count * CHANNELS);
+        lolunit_assert_equal(s.get(buf.data(), count), count);
+        for (size_t n = 0; n < count * CHANNELS; ++n)
+        {
+            lolunit_set_context(pos * CHANNELS + n);
+            lolunit_assert_equal(buf[n], reference[pos * CHANNELS + n]);
+        }
+        lolunit_assert_equal(*s.pos(), pos + count);
+    }
+
+    lolunit_declare_test(whole_file)
+    {
+        auto s = audio::make_qoa_decoder(file.data(), file.size());
+        lolunit_assert_equal(s->channels(), CHANNELS);
+        lolunit_assert_equal(s->frequency(), 44100);
+        lolunit_assert(s->size().has_value());
+        lolunit_assert_equal(*s->size(), FRAMES);
+
+        // Reads that do not line up with frames
+        size_t pos = 0;
+        for (size_t count = 1; pos + count <= FRAMES; pos += count, count = count * 3 + 1)
+            check(*s, pos, count);
+        check(*s, pos, FRAMES - pos);
+
+        int16_t buf[CHANNELS];
+        lolunit_assert_equal(s->get(buf, 1), 0u);
+    }
+
+    lolunit_declare_test(seek)
+    {
+        auto s = audio::make_qoa_decoder(file.data(), file.size());
+
+        // Into the middle of a frame, then across the next frame boundary
+        size_t const mid = QOA_FRAME_LEN + QOA_FRAME_LEN / 2 + 7;
+        lolunit_assert(s->seek(mid));
+        check(*s, mid, QOA_FRAME_LEN);
+
+        // Back into the frame that was just left, and into the last one
+        lolunit_assert(s->seek(mid - 3));
+        check(*s, mid - 3, 10);
+        lolunit_assert(s->seek(FRAMES - 5));
+        check(*s, FRAMES - 5, 5);
+    }
+
+    lolunit_declare_test(streamed_file)
+    {
+        // A streamed file has a sample count of zero in its header
+        std::vector<uint8_t> streamed = file;
+        std::fill_n(streamed.begin() + 4, 4, 0);
+
+        auto s = audio::make_qoa_decoder(streamed.data(), streamed.size());
+        lolunit_assert_equal(s->channels(), CHANNELS);
+        lolunit_assert_equal(s->frequency(), 44100);
+        lolunit_assert(!s->size().has_value());
+
+        check(*s, 0, FRAMES);
+        int16_t buf[CHANNELS];
+        lolunit_assert_equal(s->get(buf, 1), 0u);
+
+        lolunit_assert(s->seek(2 * QOA_FRAME_LEN + 11));
+        check(*s, 2 * QOA_FRAME_LEN + 11, 100);
+    }
+};
+
+} // namespace lol
@@ -0,0 +1,281 @@
+//
+//  Lol Engine — Unit tests for the voice pool
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine/audio>
+#include <lol/unit_test>
+
+#include <algorithm>  // std::fill_n, std::min
+#include <functional> // std::function
+#include <memory>     // std::shared_ptr
+#include <optional>   // std::optional
+#include <vector>     // std::vector
+
+namespace lol
+{
+
+// A 48 kHz stereo source of ones that remembers where it was asked to
+// seek. A size of zero means it never ends.
+class counter : public audio::stream<float>
+{
+public:
+    counter(size_t size = 0)
+      : audio::stream<float>(2, 48000),
+        m_size(size)
+    {}
+
+    virtual size_t get(float *buf, size_t frames) override
+    {
+        if (on_get)
+            on_get();
+        size_t n = m_size ? std::min(frames, m_size - m_pos) : frames;
+        std::fill_n(buf, n * m_channels, 1.f);
+        m_pos += n;
+        return n;
+    }
+
+    virtual std::optional<size_t> size() const override
+    {
+        if (!m_size)
+            return std::nullopt;
+        return m_size;
+    }
+
+    virtual std::optional<size_t> pos() const override
+    {
+        return m_pos;
+    }
+
+    virtual bool seek(size_t pos) override
+    {
+        seeks.push_back(pos);
+        m_pos = pos;
+        return true;
+    }
+
+    std::vector<size_t> seeks;
+    std::function<void()> on_get;
+
+private:
+    size_t m_size, m_pos = 0;
+};
+
+// There is no audio device: the test renders by hand, which also applies
+// the commands the pool sent to the mixer.
+lolunit_declare_fixture(voice_test)
+{
+    std::vector<float> buf;
+
+    void render(size_t frames = 256)
+    {
+        buf.resize(frames * 2);
+        audio::render(buf.data(), frames);
+    }
+
+    static audio::voice_params params(int category, int priority, float volume = 1.f,
+                                      bool loop = false)
+    {
+        return audio::voice_params { category, priority, volume, loop };
+    }
+
+    lolunit_declare_test(steal_priority)
+    {
+        audio::voice_pool pool(2);
+        uint64_t a = pool.play(std::make_shared<counter>(), params(0, 0));
+        uint64_t b = pool.play(std::make_shared<counter>(), params(0, 0));
+        lolunit_assert(!pool.is_virtual(a));
+        lolunit_assert(!pool.is_virtual(b));
+
+        // Same priority and volume: the oldest sound is the weakest
+        uint64_t c = pool.play(std::make_shared<counter>(), params(0, 1));
+        lolunit_assert(pool.is_virtual(a));
+        lolunit_assert(!pool.is_virtual(b));
+        lolunit_assert(!pool.is_virtual(c));
+
+        // A lower priority cannot steal, however loud
+        uint64_t d = pool.play(std::make_shared<counter>(), params(0, -1, 10.f));
+        lolunit_assert(pool.is_virtual(d));
+
+        auto stats = pool.get_stats();
+        lolunit_assert_equal(stats.sounds, 4u);
+        lolunit_assert_equal(stats.mixed, 2u);
+        lolunit_assert_equal(stats.stolen, 1u);
+
+        // Raising a priority takes effect at the next update
+        pool.set_priority(a, 2);
+        pool.update(0.f);
+        lolunit_assert(!pool.is_virtual(a));
+        lolunit_assert(pool.is_virtual(b));
+        lolunit_assert(!pool.is_virtual(c));
+        lolunit_assert_equal(pool.get_stats().stolen, 2u);
+        render();
+    }
+
+    lolunit_declare_test(steal_volume)
+    {
+        audio::voice_pool pool(2);
+        uint64_t a = pool.play(std::make_shared<counter>(), params(0, 0, 1.f));
+        uint64_t b = pool.play(std::make_shared<counter>(), params(0, 0, 0.5f));
+
+        uint64_t c = pool.play(std::make_shared<counter>(), params(0, 0, 0.75f));
+        lolunit_assert(!pool.is_virtual(a));
+        lolunit_assert(pool.is_virtual(b));
+        lolunit_assert(!pool.is_virtual(c));
+
+        uint64_t d = pool.play(std::make_shared<counter>(), params(0, 0, 0.25f));
+        lolunit_assert(pool.is_virtual(d));
+        lolunit_assert_equal(pool.get_stats().stolen, 1u);
+        render();
+    }
+
+    lolunit_declare_test(category_limit)
+    {
+        audio::voice_pool pool(8);
+        pool.set_category_limit(1, 2);
+
+        // The weakest sound of the category makes room for the new one
+        uint64_t a = pool.play(std::make_shared<counter>(), params(1, 0));
+        uint64_t b = pool.play(std::make_shared<counter>(), params(1, 0));
+        uint64_t c = pool.play(std::make_shared<counter>(), params(1, 0));
+        lolunit_assert(!pool.is_playing(a));
+        lolunit_assert(pool.is_playing(b));
+        lolunit_assert(pool.is_playing(c));
+        lolunit_assert_equal(pool.get_stats().dropped, 0u);
+        lolunit_assert_equal(pool.get_stats().evicted, 1u);
+
+        // Unless the new sound is the weakest
+        lolunit_assert_equal(pool.play(std::make_shared<counter>(), params(1, -1)), 0u);
+        lolunit_assert_equal(pool.get_stats().dropped, 1u);
+        lolunit_assert_equal(pool.get_stats().evicted, 1u);
+
+        // Other categories are not affected
+        lolunit_assert(pool.play(std::make_shared<counter>(), params(0, -1)) != 0u);
+
+        // A limit of zero mutes the category
+        pool.set_category_limit(2, 0);
+        lolunit_assert_equal(pool.play(std::make_shared<counter>(), params(2, 10)), 0u);
+        lolunit_assert_equal(pool.get_stats().dropped, 2u);
+        lolunit_assert_equal(pool.get_stats().evicted, 1u);
+        lolunit_assert_equal(pool.get_stats().sounds, 3u);
+        render();
+    }
+
+    lolunit_declare_test(threshold)
+    {
+        audio::voice_pool pool(8);
+        pool.set_threshold(0.5f);
+
+        uint64_t quiet = pool.play(std::make_shared<counter>(), params(0, 0, 0.25f));
+        uint64_t loud = pool.play(std::make_shared<counter>(), params(0, 0, 1.f));
+        lolunit_assert(pool.is_virtual(quiet));
+        lolunit_assert(!pool.is_virtual(loud));
+
+        // Even with voices to spare
+        pool.set_volume(loud, 0.25f);
+        pool.update(0.f);
+        lolunit_assert(pool.is_virtual(loud));
+        lolunit_assert_equal(pool.get_stats().mixed, 0u);
+
+        pool.set_volume(quiet, 0.75f);
+        pool.update(0.f);
+        lolunit_assert(!pool.is_virtual(quiet));
+        lolunit_assert_equal(pool.get_stats().mixed, 1u);
+        render();
+    }
+
+    lolunit_declare_test(virtual_advance)
+    {
+        audio::voice_pool pool(8);
+        pool.set_threshold(0.5f);
+
+        // One second long, and kept virtual
+        uint64_t a = pool.play(std::make_shared<counter>(48000), params(0, 0, 0.25f));
+        pool.update(0.5f);
+        lolunit_assert(pool.is_playing(a));
+        pool.update(0.5f);
+        lolunit_assert(!pool.is_playing(a));
+    }
+
+    lolunit_declare_test(virtual_loop)
+    {
+        audio::voice_pool pool(8);
+        pool.set_threshold(0.5f);
+
+        auto s = std::make_shared<counter>(48000);
+        uint64_t a = pool.play(s, params(0, 0, 0.25f, true));
+        pool.update(0.75f);
+        pool.update(0.75f);
+        lolunit_assert(pool.is_playing(a));
+
+        // 1.5 seconds into a one second loop
+        pool.set_volume(a, 1.f);
+        pool.update(0.f);
+        lolunit_assert(!pool.is_virtual(a));
+        render();
+        lolunit_assert_equal(s->seeks.size(), 1u);
+        lolunit_assert_equal(s->seeks[0], 24000u);
+    }
+
+    lolunit_declare_test(resume_seek)
+    {
+        audio::voice_pool pool(1);
+        auto s = std::make_shared<counter>();
+        uint64_t a = pool.play(s, params(0, 0));
+        for (int i = 0; i < 3; ++i)
+            render();
+
+        uint64_t b = pool.play(std::make_shared<counter>(), params(0, 1));
+        lolunit_assert(pool.is_virtual(a));
+        render();
+
+        // Virtual for 1/16 second, or 3000 frames
+        pool.stop(b);
+        pool.update(0.0625f);
+        lolunit_assert(!pool.is_virtual(a));
+        render();
+        lolunit_assert_equal(s->seeks.size(), 1u);
+        lolunit_assert_equal(s->seeks[0], 768u + 3000u);
+    }
+
+    lolunit_declare_test(stolen_mid_block)
+    {
+        audio::voice_pool pool(1);
+        auto s = std::make_shared<counter>();
+        uint64_t a = pool.play(s, params(0, 0));
+        render();
+
+        // Lose the voice while the mixer is rendering the sound: that block
+        // must not be heard, since the sound resumes from before it
+        uint64_t b = 0;
+        s->on_get = [&]()
+        {
+            if (!b)
+                b = pool.play(std::make_shared<counter>(), params(0, 1));
+        };
+        render();
+        s->on_get = nullptr;
+        lolunit_assert(pool.is_virtual(a));
+        for (float x : buf)
+            lolunit_assert_equal(x, 0.f);
+
+        pool.stop(b);
+        pool.update(0.f);
+        render();
+        lolunit_assert_equal(s->seeks.size(), 1u);
+        lolunit_assert_equal(s->seeks[0], 256u);
+    }
+};
+
+} // namespace lol
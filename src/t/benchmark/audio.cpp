@@ -0,0 +1,216 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine/audio>
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace lol
+{
+
+static size_t const PERIOD = 256;        // frames per callback
+static double const DURATION = 3.0;      // seconds
+static int const CHURN_THREADS = 4;
+
+// A quiet sine wave, cheap enough that the benchmark measures the mixer
+// rather than the streams
+class tone : public audio::stream<float>
+{
+public:
+    tone(float freq)
+      : audio::stream<float>(2, 48000),
+        m_step(freq * 6.2831853f / 48000.f)
+    {}
+
+    virtual size_t get(float *buf, size_t frames) override
+    {
+        for (size_t n = 0; n < frames; ++n)
+        {
+            buf[2 * n] = buf[2 * n + 1] = 0.01f * std::sin(m_phase);
+            m_phase = std::fmod(m_phase + m_step, 6.2831853f);
+        }
+        return frames;
+    }
+
+private:
+    float m_step, m_phase = 0.f;
+};
+
+// Precomputed 16-bit sound that loops forever, so that only conversion,
+// channel mapping and resampling show up in the timings
+class pcm_loop : public audio::stream<int16_t>
+{
+public:
+    pcm_loop(size_t channels, int frequency)
+      : audio::stream<int16_t>(channels, frequency),
+        m_data(size_t(frequency) * channels)
+    {
+        for (size_t n = 0; n < m_data.size(); ++n)
+            m_data[n] = int16_t(2000.f * std::sin(float(n / channels) * 0.05f));
+    }
+
+    virtual size_t get(int16_t *buf, size_t frames) override
+    {
+        for (size_t done = 0; done < frames; )
+        {
+            size_t todo = std::min(frames - done, m_data.size() / m_channels - m_pos);
+            std::copy_n(m_data.data() + m_pos * m_channels, todo * m_channels, buf + done * m_channels);
+            done += todo;
+            m_pos = (m_pos + todo) % (m_data.size() / m_channels);
+        }
+        return frames;
+    }
+
+private:
+    std::vector<int16_t> m_data;
+    size_t m_pos = 0;
+};
+
+// Headless stress test: a thread renders audio on a fixed schedule, like a
+// device callback would, while other threads start and stop streams as fast
+// as they can. A callback that takes longer than its period is a miss.
+// There is no audio::init(): a device callback would render concurrently.
+void bench_audio()
+{
+    std::atomic<bool> done = false;
+    std::atomic<int> started = 0, stopped = 0;
+
+    std::vector<std::thread> churn;
+    for (int t = 0; t < CHURN_THREADS; ++t)
+    {
+        churn.emplace_back([&, t]()
+        {
+            // lol::rand() is shared between threads, so use our own
+            std::minstd_rand rng(t + 1);
+            std::vector<int> ids;
+            while (!done)
+            {
+                if (ids.size() < 32 && (ids.empty() || rng() % 2))
+                {
+                    std::shared_ptr<audio::stream<float>> s = std::make_shared<tone>(100.f + float(rng() % 1900));
+                    ids.push_back(audio::start_stream(s));
+                    ++started;
+                }
+                else
+                {
+                    size_t i = rng() % ids.size();
+                    audio::stop_stream(ids[i]);
+                    ids[i] = ids.back();
+                    ids.pop_back();
+                    ++stopped;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            for (int id : ids)
+                audio::stop_stream(id);
+        });
+    }
+
+    double const period = double(PERIOD) / 48000.0;
+    std::vector<float> buf(PERIOD * 2);
+    int callbacks = 0, misses = 0;
+    double total = 0.0, worst = 0.0;
+
+    auto next = std::chrono::steady_clock::now();
+    for (timer run; run.poll() < DURATION; ++callbacks)
+    {
+        timer t;
+        audio::render(buf.data(), PERIOD);
+        double time = t.get();
+
+        total += time;
+        worst = std::max(worst, time);
+        misses += time > period;
+
+        next += std::chrono::microseconds(int64_t(period * 1e6));
+        std::this_thread::sleep_until(next);
+    }
+
+    done = true;
+    for (auto &t : churn)
+        t.join();
+    audio::render(buf.data(), PERIOD); // apply the last stops
+
+    msg::info("callbacks  misses   avg µs   max µs   budget µs   starts   stops\n");
+    msg::info("%9d  %6d  %7.1f  %7.1f  %10.1f  %7d  %6d\n",
+              callbacks, misses, total / callbacks * 1e6, worst * 1e6,
+              period * 1e6, (int)started, (int)stopped);
+}
+
+// Cost of mixing one 1024-frame block with 64 voices, for several kinds
+// of sources, then of the output kernels. Like bench_audio(), this renders
+// by hand without opening the device.
+void bench_audio_mixer()
+{
+    size_t const FRAMES = 1024, VOICES = 64, BLOCKS = 200;
+    double const budget = FRAMES / 48000.0;
+
+    msg::info("                          µs/block   %% of budget\n");
+
+    struct source { char const *name; size_t channels; int frequency; };
+    for (auto const &src : { source { "s16 stereo 48 kHz", 2, 48000 },
+                             source { "s16 mono 48 kHz", 1, 48000 },
+                             source { "s16 stereo 44.1 kHz", 2, 44100 },
+                             source { "s16 mono 22.05 kHz", 1, 22050 } })
+    {
+        std::vector<int> ids;
+        for (size_t i = 0; i < VOICES; ++i)
+        {
+            auto s = std::make_shared<pcm_loop>(src.channels, src.frequency);
+            ids.push_back(audio::start_stream(audio::dsp::make_output_adapter(s, 2, 48000)));
+        }
+
+        std::vector<float> buf(FRAMES * 2);
+        audio::render(buf.data(), FRAMES); // apply the pending commands
+
+        timer t;
+        for (size_t n = 0; n < BLOCKS; ++n)
+            audio::render(buf.data(), FRAMES);
+        double time = t.get() / BLOCKS;
+
+        msg::info("%-22s  %10.1f  %12.1f\n", src.name, time * 1e6, 100.0 * time / budget);
+
+        for (int id : ids)
+            audio::stop_stream(id);
+        audio::render(buf.data(), FRAMES); // apply the stops
+    }
+
+    // The device side: soft-clip and split the mixed block into channels
+    std::vector<float> mixed(FRAMES * 2), left(FRAMES), right(FRAMES);
+    for (size_t n = 0; n < mixed.size(); ++n)
+        mixed[n] = std::sin(float(n) * 0.01f) * 1.5f;
+    float *planes[] = { left.data(), right.data() };
+
+    timer t;
+    for (size_t n = 0; n < BLOCKS * 10; ++n)
+    {
+        audio::dsp::softclip(mixed.data(), mixed.size());
+        audio::dsp::deinterleave(mixed.data(), 2, planes, FRAMES);
+    }
+    double time = t.get() / (BLOCKS * 10);
+    msg::info("%-22s  %10.2f  %12.2f\n", "softclip + split", time * 1e6, 100.0 * time / budget);
+}
+
+} // namespace lol
@@ -0,0 +1,137 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/../engine/entity.h>
+#include <lol/../engine/ticker.h>
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+#include <atomic>
+#include <deque>
+
+namespace lol
+{
+
+static int const FRAMES = 600;
+static int const LIFETIME = 60; // in frames
+
+// Short-lived entity, like a particle or a bullet
+class churn_particle : public entity
+{
+public:
+    virtual std::string GetName() const override { return "<churn_particle>"; }
+
+protected:
+    virtual void tick_game(float seconds) override
+    {
+        entity::tick_game(seconds);
+        m_pos += m_speed * seconds;
+    }
+
+    vec3 m_pos = vec3(0.f), m_speed = vec3(1.f);
+};
+
+// Spawns a given number of particles per frame and kills the ones that
+// are older than LIFETIME frames. Everything, including releasing the
+// spawner itself, happens in its game tick.
+class churn_spawner : public entity
+{
+public:
+    churn_spawner()
+    {
+        m_gamegroup = tickable::group::game::app;
+    }
+
+    virtual std::string GetName() const override { return "<churn_spawner>"; }
+
+    // Zero stops spawning and kills all live particles
+    std::atomic<int> m_per_frame = 0;
+    std::atomic<bool> m_release = false;
+
+protected:
+    virtual void tick_game(float seconds) override
+    {
+        entity::tick_game(seconds);
+
+        ++m_frame;
+
+        int const per_frame = m_release ? 0 : (int)m_per_frame;
+        while (m_live.size() && (!per_frame || m_live.front().first + LIFETIME <= m_frame))
+        {
+            Ticker::Unref(m_live.front().second);
+            m_live.pop_front();
+        }
+
+        for (int i = 0; i < per_frame; ++i)
+        {
+            auto *p = new churn_particle();
+            Ticker::Ref(p);
+            m_live.push_back(std::make_pair(m_frame, p));
+        }
+
+        if (m_release && !m_released)
+        {
+            m_released = true;
+            Ticker::Unref(this);
+        }
+    }
+
+    int m_frame = 0;
+    bool m_released = false;
+    std::deque<std::pair<int, entity *>> m_live;
+};
+
+void bench_entity_churn()
+{
+    msg::info("              spawn/frame  spawn/s @60fps   ms/frame   wall spawn/s\n");
+
+    ticker::setup(0.f);
+
+    // Created before the first frame is drawn, so the game thread is idle
+    auto *spawner = new churn_spawner();
+    Ticker::Ref(spawner);
+
+    for (int per_frame : { 200, 833, 3000 })
+    {
+        spawner->m_per_frame = per_frame;
+
+        timer t;
+        for (int frame = 0; frame < FRAMES; ++frame)
+            ticker::tick_draw();
+        double time = t.get();
+
+        msg::info("entity churn  %11d  %14d  %9.3f  %13.0f\n",
+                  per_frame, per_frame * 60, time * 1000.0 / FRAMES,
+                  per_frame * FRAMES / time);
+
+        // Kill the particles and let the ticker collect them
+        spawner->m_per_frame = 0;
+        for (int frame = 0; frame < 4; ++frame)
+            ticker::tick_draw();
+    }
+
+    spawner->m_release = true;
+    for (int frame = 0; frame < 4; ++frame)
+        ticker::tick_draw();
+
+    Ticker::Shutdown();
+    while (!Ticker::Finished())
+        ticker::tick_draw();
+    ticker::teardown();
+}
+
+} // namespace lol
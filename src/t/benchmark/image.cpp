@@ -0,0 +1,223 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace lol
+{
+
+// A 4K texture, as processed by the asset pipeline
+static ivec2 const SIZE(3840, 2160);
+
+// The median filter is much slower; use a smaller picture
+static ivec2 const MEDIAN_SIZE(1024, 1024);
+
+// Print resolution for error diffusion
+static ivec2 const DITHER_SIZE(7680, 4320);
+
+// Direct binary search is iterative; use a smaller picture and few passes
+static ivec2 const DBS_SIZE(1024, 1024);
+static int const DBS_PASSES = 4;
+
+void bench_image_filters()
+{
+    old_image rgba, rgba8, grey;
+    rgba.RenderRandom(SIZE);
+    rgba8.Copy(rgba);
+    rgba8.set_format(PixelFormat::RGBA_8);
+    grey.RenderRandom(MEDIAN_SIZE);
+    grey.set_format(PixelFormat::Y_F32);
+
+    auto gaussian = old_image::kernel::gaussian(vec2(2.f));
+    auto bayer = old_image::kernel::bayer(ivec2(8));
+
+    struct
+    {
+        char const *name;
+        std::function<void()> fn;
+    }
+    const filters[] =
+    {
+        { "convolution", [&]() { rgba.Convolution(gaussian); } },
+        { "median", [&]() { grey.Median(ivec2(1)); } },
+        { "dilate", [&]() { rgba.Dilate(); } },
+        { "erode", [&]() { rgba.Erode(); } },
+        { "brightness", [&]() { rgba.Brightness(0.1f); } },
+        { "contrast", [&]() { rgba.Contrast(0.1f); } },
+        { "yuv to rgb", [&]() { rgba.YUVToRGB(); } },
+        { "ordered", [&]() { rgba.dither_ordered(bayer); } },
+        { "halftone", [&]() { rgba.dither_halftone(4.f, 0.3f); } },
+        { "bicubic", [&]() { rgba.Resize(SIZE / 2, ResampleAlgorithm::Bicubic); } },
+        { "bresenham", [&]() { rgba.Resize(SIZE / 3, ResampleAlgorithm::Bresenham); } },
+        { "lanczos3", [&]() { rgba.Resize(SIZE / 3, ResampleAlgorithm::Lanczos3); } },
+        { "mitchell", [&]() { rgba.Resize(SIZE / 3, ResampleAlgorithm::Mitchell); } },
+        { "lanczos3 u8", [&]() { rgba8.Resize(SIZE / 3, ResampleAlgorithm::Lanczos3); } },
+    };
+
+    int const threads[] = { 1, 2, 4, 8 };
+
+    msg::info("                 1 thread   2 threads  4 threads  8 threads  speedup\n");
+
+    for (auto const &f : filters)
+    {
+        double times[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            old_image::set_threads(threads[i]);
+            timer t;
+            f.fn();
+            times[i] = t.get();
+        }
+
+        msg::info("%-14s  %8.1fms  %8.1fms  %8.1fms  %8.1fms  %6.2fx\n", f.name,
+                  times[0] * 1e3, times[1] * 1e3, times[2] * 1e3, times[3] * 1e3,
+                  times[0] / times[3]);
+    }
+
+    old_image::set_threads(0);
+}
+
+void bench_image_ops()
+{
+    old_image rgba, other;
+    rgba.RenderRandom(SIZE);
+    other.RenderRandom(SIZE);
+    rgba.set_format(PixelFormat::RGBA_8);
+
+    // The same five adjustments, one method call each, then fused
+    timer t;
+    old_image a = old_image::Mean(rgba, other);
+    a = a.Brightness(0.1f);
+    a = a.Contrast(0.2f);
+    a = a.Invert();
+    a = a.AutoContrast();
+    double separate = t.get();
+
+    auto b = rgba.ops().mix(other, 0.5f).brightness(0.1f).contrast(0.2f)
+                       .invert().auto_contrast().eval();
+    double fused = t.get();
+
+    msg::info("separate calls  %8.1fms\n", separate * 1e3);
+    msg::info("pixel_ops       %8.1fms  %6.2fx\n", fused * 1e3, separate / fused);
+}
+
+void bench_image_median()
+{
+    // Colour medians iterate per pixel; give each format a size that
+    // keeps the larger radii within a few seconds.
+    struct
+    {
+        char const *name;
+        PixelFormat format;
+        ivec2 size;
+    }
+    const inputs[] =
+    {
+        { "Y_8", PixelFormat::Y_8, ivec2(1024, 1024) },
+        { "Y_F32", PixelFormat::Y_F32, ivec2(1024, 1024) },
+        { "RGBA_F32", PixelFormat::RGBA_F32, ivec2(256, 256) },
+    };
+
+    int const radii[] = { 1, 2, 4, 8, 16 };
+
+    msg::info("            size       r=1       r=2       r=4       r=8      r=16  (Mpixel/s)\n");
+
+    for (auto const &in : inputs)
+    {
+        old_image im;
+        im.RenderRandom(in.size);
+        im.set_format(in.format);
+
+        msg::info("%-9s %4dx%-4d", in.name, in.size.x, in.size.y);
+        for (int r : radii)
+        {
+            timer t;
+            auto tmp = im.Median(ivec2(r));
+            double time = t.get();
+            msg::info("  %8.2f", in.size.x * in.size.y / time * 1e-6);
+        }
+        msg::info("\n");
+    }
+}
+
+void bench_image_dither()
+{
+    old_image grey;
+    grey.RenderRandom(DITHER_SIZE);
+    grey.set_format(PixelFormat::Y_F32);
+
+    old_image grey8 = grey;
+    grey8.set_format(PixelFormat::Y_8);
+
+    old_image small;
+    small.RenderRandom(DBS_SIZE);
+    small.set_format(PixelFormat::Y_F32);
+
+    auto fs = old_image::kernel::ediff(EdiffAlgorithm::FloydSteinberg);
+    auto jajuni = old_image::kernel::ediff(EdiffAlgorithm::JaJuNi);
+
+    struct
+    {
+        char const *name;
+        std::function<old_image()> fn;
+    }
+    const algorithms[] =
+    {
+        { "floyd-steinberg", [&]() { return grey.dither_ediff(fs); } },
+        { "jajuni", [&]() { return grey.dither_ediff(jajuni); } },
+        { "ostromoukhov", [&]() { return grey.dither_ostromoukhov(); } },
+        { "floyd-st. u8", [&]() { return grey8.dither_ediff_u8(fs); } },
+        { "jajuni u8", [&]() { return grey8.dither_ediff_u8(jajuni); } },
+        { "ostromoukhov u8", [&]() { return grey8.dither_ostromoukhov_u8(); } },
+        { "dbs", [&]() { return small.dither_dbs(DBS_PASSES); } },
+    };
+
+    msg::info("                    serial  wavefront  speedup  identical\n");
+
+    for (auto const &a : algorithms)
+    {
+        // Switch threads outside the timed sections, since resizing the
+        // pool joins or spawns worker threads
+        old_image::set_threads(1);
+        timer t1;
+        old_image serial = a.fn();
+        double time_serial = t1.get();
+
+        old_image::set_threads(0);
+        timer t2;
+        old_image wavefront = a.fn();
+        double time_wavefront = t2.get();
+
+        // Bytes are enough to compare, since all outputs are 0 or 1
+        uint8_t const *p = serial.lock<PixelFormat::Y_8>();
+        uint8_t const *q = wavefront.lock<PixelFormat::Y_8>();
+        bool same = !memcmp(p, q, size_t(serial.size().x) * serial.size().y);
+        serial.unlock(p);
+        wavefront.unlock(q);
+
+        msg::info("%-16s  %8.1fms  %8.1fms  %6.2fx  %s\n", a.name,
+                  time_serial * 1e3, time_wavefront * 1e3,
+                  time_serial / time_wavefront, same ? "yes" : "NO");
+    }
+}
+
+} // namespace lol
@@ -0,0 +1,79 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/msg>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace lol
+{
+
+void bench_audio();
+void bench_audio_mixer();
+void bench_ticker();
+void bench_entity_churn();
+void bench_image_dither();
+void bench_image_filters();
+void bench_image_median();
+void bench_image_ops();
+void bench_messageservice();
+void bench_pixel_formats();
+void bench_stream();
+void bench_tileset();
+
+} // namespace lol
+
+static struct
+{
+    char const *name;
+    void (*fn)();
+}
+const benchmarks[] =
+{
+    { "ticker", lol::bench_ticker },
+    { "audio", lol::bench_audio },
+    { "mixer", lol::bench_audio_mixer },
+    { "entity", lol::bench_entity_churn },
+    { "image", lol::bench_image_filters },
+    { "dither", lol::bench_image_dither },
+    { "median", lol::bench_image_median },
+    { "ops", lol::bench_image_ops },
+    { "messageservice", lol::bench_messageservice },
+    { "pixel", lol::bench_pixel_formats },
+    { "stream", lol::bench_stream },
+    { "tileset", lol::bench_tileset },
+};
+
+int main(int argc, char **argv)
+{
+    for (auto const &b : benchmarks)
+    {
+        // Run everything unless some benchmark names were given
+        bool run = argc < 2;
+        for (int i = 1; i < argc; ++i)
+            run |= !strcmp(argv[i], b.name);
+        if (!run)
+            continue;
+
+        lol::msg::info("----------------------------------------\n");
+        lol::msg::info(" %s\n", b.name);
+        lol::msg::info("----------------------------------------\n");
+        b.fn();
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/../messageservice.h>
+#include <lol/format> // std::format
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+#include <thread>
+#include <vector>
+
+namespace lol
+{
+
+static int const MESSAGES = 200000; // per producer
+
+void bench_messageservice()
+{
+    MessageService::Setup();
+
+    msg::info("                 producers     messages   Mmsg/s\n");
+
+    for (int producers : { 1, 2, 4, 8 })
+    {
+        std::vector<std::thread> threads;
+        std::vector<MessageList> received;
+        received.reserve(producers * MESSAGES);
+
+        timer t;
+
+        for (int n = 0; n < producers; ++n)
+            threads.emplace_back([n]()
+            {
+                for (int i = 0; i < MESSAGES; ++i)
+                    MessageService::Send(MessageBucket::Bckt0,
+                                         std::format("{{\"thread\":{},\"seq\":{}}}", n, i));
+            });
+
+        // Drain in batches while the producers are running
+        size_t expected = (size_t)producers * MESSAGES;
+        while (received.size() < expected)
+        {
+            if (!MessageService::FetchAll(MessageBucket::Bckt0, received))
+                std::this_thread::yield();
+        }
+
+        double time = t.get();
+
+        for (auto &th : threads)
+            th.join();
+
+        msg::info("message service  %9d  %11d  %7.2f\n",
+                  producers, (int)expected, expected / time * 1e-6);
+    }
+
+    MessageService::Destroy();
+}
+
+} // namespace lol
@@ -0,0 +1,86 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+namespace lol
+{
+
+// A 4K texture, as processed by the asset pipeline
+static ivec2 const SIZE(3840, 2160);
+
+static int const ITERATIONS = 10;
+
+void bench_pixel_formats()
+{
+    static struct { PixelFormat fmt; char const *name; } const formats[] =
+    {
+        { PixelFormat::Y_8, "Y_8" },
+        { PixelFormat::RGB_8, "RGB_8" },
+        { PixelFormat::RGBA_8, "RGBA_8" },
+        { PixelFormat::Y_F32, "Y_F32" },
+        { PixelFormat::RGB_F32, "RGB_F32" },
+        { PixelFormat::RGBA_F32, "RGBA_F32" },
+    };
+
+    old_image im;
+    im.RenderRandom(SIZE);
+
+    // Single-threaded first, to measure the kernels themselves
+    for (int threads : { 1, 0 })
+    {
+        old_image::set_threads(threads);
+        msg::info("%s\n", threads ? "1 thread:" : "all threads:");
+        msg::info("from \\ to  ");
+        for (auto const &dst : formats)
+            msg::info(" %9s", dst.name);
+        msg::info("   (GB/s)\n");
+
+        for (auto const &src : formats)
+        {
+            msg::info("%-10s ", src.name);
+            for (auto const &dst : formats)
+            {
+                if (src.fmt == dst.fmt)
+                {
+                    msg::info(" %9s", "-");
+                    continue;
+                }
+
+                // Only time the src → dst conversion; going back to the
+                // source format is not part of the measure.
+                double time = 0.0;
+                for (int i = 0; i < ITERATIONS; ++i)
+                {
+                    im.set_format(src.fmt);
+                    timer t;
+                    im.set_format(dst.fmt);
+                    time += t.get();
+                }
+
+                // Count bytes read and written
+                double bytes = double(SIZE.x) * SIZE.y * ITERATIONS
+                             * (BytesPerPixel(src.fmt) + BytesPerPixel(dst.fmt));
+                msg::info(" %9.2f", bytes / time * 1e-9);
+            }
+            msg::info("\n");
+        }
+    }
+}
+
+} // namespace lol
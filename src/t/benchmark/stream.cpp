@@ -0,0 +1,71 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+namespace lol
+{
+
+static int const TILES = 100000;
+static int const FRAMES = 200;
+
+// Simulate the vertex traffic of Scene::render_tiles() without a GPU: each
+// tileset run reserves 4 vertices per tile, drawn through the shared quad
+// index buffer. The old code created two new vertex buffers per run and
+// per frame; count what the ring does instead.
+void bench_stream()
+{
+    msg::info("                   runs   tiles   alloc/frame   steady   µs/frame\n");
+
+    for (int runs : { 1, 16, 256, 4096 })
+    {
+        stream_ring ring;
+
+        timer t;
+        uint64_t steady = 0;
+
+        for (int f = 0; f < FRAMES; ++f)
+        {
+            // The last quarter of the frames tells what happens in the
+            // steady state, once every arena was grown.
+            if (f == FRAMES * 3 / 4)
+                steady = ring.get_stats().allocations;
+
+            ring.begin_frame();
+
+            // Tile counts jitter a bit between frames, like a real scene
+            int tiles = TILES - lol::rand(TILES / 100);
+            for (int r = 0; r < runs; ++r)
+            {
+                int n = tiles * (r + 1) / runs - tiles * r / runs;
+                ring.allocate(4 * n);
+            }
+        }
+
+        double time = t.get();
+        auto const &stats = ring.get_stats();
+        steady = stats.allocations - steady;
+
+        msg::info("stream ring  %10d  %6d  %12.3f  %7.3f  %9.3f\n",
+                  runs, TILES, double(stats.allocations) / FRAMES,
+                  double(steady) / (FRAMES / 4), time / FRAMES * 1e6);
+        msg::info("  (previously %d vertex buffers per frame)\n", 2 * runs);
+    }
+}
+
+} // namespace lol
@@ -0,0 +1,162 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/../engine/entity.h>
+#include <lol/../engine/ticker.h>
+#include <lol/math>       // lol::rand
+#include <lol/msg>
+#include <lol/thread>     // lol::timer
+#include <lol/vector>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace lol
+{
+
+static int const TICKS = 20;
+
+// A game entity with a bit of maths in its tick, flagged so that the
+// ticker may run it on the parallel game tick pool
+class synthetic_entity : public entity
+{
+public:
+    synthetic_entity()
+    {
+        add_flags(entity::flags::parallel_game);
+    }
+
+    virtual std::string GetName() const override { return "<synthetic_entity>"; }
+
+protected:
+    virtual void tick_game(float seconds) override
+    {
+        entity::tick_game(seconds);
+
+        for (int k = 0; k < 16; ++k)
+        {
+            vec3 accel = vec3(-pos.y, pos.x, std::sin(phase + k));
+            speed += accel * seconds;
+            pos += speed * seconds;
+        }
+        phase += seconds;
+    }
+
+    vec3 pos = vec3(rand(-1.f, 1.f), rand(-1.f, 1.f), rand(-1.f, 1.f));
+    vec3 speed = vec3(0.f);
+    float phase = rand(6.28f);
+};
+
+// Creates and releases synthetic entities from the game thread until
+// there are as many as requested
+class synthetic_population : public entity
+{
+public:
+    synthetic_population()
+    {
+        m_gamegroup = tickable::group::game::app;
+    }
+
+    virtual std::string GetName() const override { return "<synthetic_population>"; }
+
+    std::atomic<size_t> m_target = 0;
+    std::atomic<bool> m_release = false;
+
+protected:
+    virtual void tick_game(float seconds) override
+    {
+        entity::tick_game(seconds);
+
+        size_t const target = m_release ? 0 : (size_t)m_target;
+        for (; m_entities.size() > target; m_entities.pop_back())
+            Ticker::Unref(m_entities.back());
+        while (m_entities.size() < target)
+        {
+            m_entities.push_back(new synthetic_entity());
+            Ticker::Ref(m_entities.back());
+        }
+
+        if (m_release && !m_released)
+        {
+            m_released = true;
+            Ticker::Unref(this);
+        }
+    }
+
+    std::vector<entity *> m_entities;
+    bool m_released = false;
+};
+
+void bench_ticker()
+{
+    int const max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    std::vector<int> thread_counts;
+    for (int n = 1; n < max_threads; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(max_threads);
+
+    msg::info("                 entities   threads   ms/tick   speedup\n");
+
+    ticker::setup(0.f);
+
+    // Created before the first frame is drawn, so the game thread is idle
+    auto *population = new synthetic_population();
+    Ticker::Ref(population);
+
+    for (size_t count : { 10000, 30000, 100000 })
+    {
+        population->m_target = count;
+        double serial_time = 0.0;
+
+        for (int threads : thread_counts)
+        {
+            ticker::set_game_threads(threads);
+
+            // Let the population and the thread count settle, then time
+            // a few frames
+            for (int n = 0; n < 4; ++n)
+                ticker::tick_draw();
+
+            timer t;
+            for (int n = 0; n < TICKS; ++n)
+                ticker::tick_draw();
+            double time = t.get() * 1000.0 / TICKS;
+
+            if (threads == 1)
+                serial_time = time;
+
+            msg::info("parallel tick  %10d  %8d  %8.3f  %7.2fx\n",
+                      (int)count, threads, time, serial_time / time);
+        }
+    }
+
+    // Let the game thread release everything before shutting down
+    population->m_release = true;
+    ticker::set_game_threads(0);
+    for (int n = 0; n < 4; ++n)
+        ticker::tick_draw();
+
+    Ticker::Shutdown();
+    while (!Ticker::Finished())
+        ticker::tick_draw();
+    ticker::teardown();
+}
+
+} // namespace lol
@@ -0,0 +1,70 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/msg>
+#include <lol/thread> // lol::timer
+
+#include "../test-tiles.h"
+
+#include <algorithm> // std::min
+#include <cstring>
+#include <vector>
+
+namespace lol
+{
+
+static int const TILES = 1000000;
+static int const DEFS = 256;
+static int const RUNS = 10;
+
+// Compare the scalar and SIMD quad generation used by Scene::render_tiles(),
+// without a GPU, and check that they produce the exact same bits.
+void bench_tileset()
+{
+    auto defs = random_tile_defs(DEFS);
+    auto tiles = random_tiles(TILES, DEFS);
+
+    std::vector<vec3> pos[2] = { std::vector<vec3>(4 * TILES),
+                                 std::vector<vec3>(4 * TILES) };
+    std::vector<vec2> uv[2] = { std::vector<vec2>(4 * TILES),
+                                std::vector<vec2>(4 * TILES) };
+
+    msg::info("                   tiles    Mtiles/s   speedup\n");
+
+    double times[2] = { 1e9, 1e9 };
+    for (int k = 0; k < 2; ++k)
+    {
+        for (int run = 0; run < RUNS; ++run)
+        {
+            timer t;
+            if (k == 0)
+                blit_quads_scalar(tiles, defs.data(), pos[k].data(), uv[k].data());
+            else
+                blit_quads(tiles, defs.data(), pos[k].data(), uv[k].data());
+            times[k] = std::min(times[k], t.get());
+        }
+
+        msg::info("%-14s  %8d  %10.2f  %8.2fx\n", k ? "quads (simd)" : "quads (scalar)",
+                  TILES, TILES / times[k] * 1e-6, times[0] / times[k]);
+    }
+
+    bool exact = !memcmp(pos[0].data(), pos[1].data(), pos[0].size() * sizeof(vec3))
+              && !memcmp(uv[0].data(), uv[1].data(), uv[0].size() * sizeof(vec2));
+    msg::info("bit-exact: %s\n", exact ? "yes" : "NO");
+}
+
+} // namespace lol
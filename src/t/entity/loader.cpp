@@ -0,0 +1,184 @@
+//
+//  Lol Engine — Unit tests for the resource loader
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <functional> // std::function
+#include <memory>     // std::shared_ptr
+#include <string>     // std::string
+#include <vector>     // std::vector
+
+namespace lol
+{
+
+// The queue is driven by hand, on the test thread: serve() plays the disk
+// thread and deliver() the start of a game tick.
+lolunit_declare_fixture(loader_test)
+{
+    std::vector<std::string> loads, delivered;
+    std::function<void(std::string const &)> on_load;
+
+    loader_queue make_queue()
+    {
+        loads.clear();
+        delivered.clear();
+        on_load = nullptr;
+        return loader_queue([this](std::string const &path) -> ResourceCodecData *
+        {
+            loads.push_back(path);
+            if (on_load)
+                on_load(path);
+            return new ResourceCodecData();
+        });
+    }
+
+    loader::callback record(std::string const &name)
+    {
+        return [this, name](std::shared_ptr<ResourceCodecData> data)
+        {
+            lolunit_assert(data != nullptr);
+            delivered.push_back(name);
+        };
+    }
+
+    lolunit_declare_test(priority_order)
+    {
+        auto q = make_queue();
+        q.load("a", 0, record("a"));
+        q.load("b", 5, record("b"));
+        q.load("c", 5, record("c"));
+        uint64_t d = q.load("d", -1, record("d"));
+        q.set_priority(d, 10);
+
+        while (q.get_stats().queued)
+            q.serve(false);
+        q.deliver();
+
+        // Highest priority first, then in the order they came
+        std::vector<std::string> const expected = { "d", "b", "c", "a" };
+        lolunit_assert(loads == expected);
+        lolunit_assert(delivered == expected);
+    }
+
+    lolunit_declare_test(shared_path)
+    {
+        auto q = make_queue();
+        std::shared_ptr<ResourceCodecData> first, second;
+        q.load("x", 0, [&](std::shared_ptr<ResourceCodecData> data) { first = data; });
+        q.load("x", 0, [&](std::shared_ptr<ResourceCodecData> data) { second = data; });
+
+        q.serve(false);
+        q.deliver();
+
+        // One load, whose data both requests share
+        lolunit_assert_equal(int(loads.size()), 1);
+        lolunit_assert(first != nullptr);
+        lolunit_assert(first == second);
+        lolunit_assert_equal(q.get_stats().shared, 1);
+        lolunit_assert_equal(q.get_stats().loaded, 1);
+    }
+
+    lolunit_declare_test(shared_path_priority)
+    {
+        auto q = make_queue();
+        q.load("a", 1, record("a"));
+        q.load("b", 0, record("b1"));
+        // Joining a pending load with a higher priority moves it forward
+        q.load("b", 2, record("b2"));
+
+        q.serve(false);
+        lolunit_assert_equal(loads[0], std::string("b"));
+    }
+
+    lolunit_declare_test(cancel_queued)
+    {
+        auto q = make_queue();
+        uint64_t a = q.load("a", 0, record("a"));
+        q.load("b", 0, record("b"));
+
+        lolunit_assert(q.cancel(a));
+        lolunit_assert_equal(q.get_stats().queued, 1);
+
+        while (q.get_stats().queued)
+            q.serve(false);
+        q.deliver();
+
+        // The cancelled path was never loaded
+        lolunit_assert(loads == std::vector<std::string>({ "b" }));
+        lolunit_assert(delivered == std::vector<std::string>({ "b" }));
+        lolunit_assert(!q.cancel(a));
+    }
+
+    lolunit_declare_test(cancel_shared)
+    {
+        auto q = make_queue();
+        uint64_t a = q.load("x", 0, record("a"));
+        q.load("x", 0, record("b"));
+
+        // The other request still wants the file
+        lolunit_assert(q.cancel(a));
+        q.serve(false);
+        q.deliver();
+
+        lolunit_assert_equal(int(loads.size()), 1);
+        lolunit_assert(delivered == std::vector<std::string>({ "b" }));
+    }
+
+    lolunit_declare_test(cancel_loading)
+    {
+        auto q = make_queue();
+        uint64_t a = q.load("a", 0, record("a"));
+
+        // Cancel while the disk thread is busy with the file
+        bool cancelled = false;
+        on_load = [&](std::string const &) { cancelled = q.cancel(a); };
+        q.serve(false);
+        q.deliver();
+
+        lolunit_assert(cancelled);
+        lolunit_assert_equal(int(loads.size()), 1);
+        lolunit_assert(delivered.empty());
+        lolunit_assert_equal(q.get_stats().loaded, 1);
+
+        // The same path can be requested again
+        q.load("a", 0, record("a"));
+        q.serve(false);
+        q.deliver();
+        lolunit_assert(delivered == std::vector<std::string>({ "a" }));
+    }
+
+    lolunit_declare_test(cancel_done)
+    {
+        auto q = make_queue();
+        uint64_t a = q.load("a", 0, record("a"));
+        uint64_t b = q.load("b", 0, record("b"));
+
+        // Loaded but not handed over yet
+        q.serve(false);
+        q.serve(false);
+        lolunit_assert(q.cancel(a));
+        q.deliver();
+
+        lolunit_assert(delivered == std::vector<std::string>({ "b" }));
+
+        // Too late once the callback ran
+        lolunit_assert(!q.cancel(b));
+        lolunit_assert_equal(q.get_stats().cancelled, 1);
+    }
+};
+
+} // namespace lol
@@ -0,0 +1,141 @@
+//
+//  Lol Engine — Unit tests for tile quad generation
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include "../test-tiles.h"
+
+#include <algorithm> // std::stable_sort
+#include <cstring>   // std::memcmp
+#include <map>       // std::map
+#include <vector>    // std::vector
+
+namespace lol
+{
+
+lolunit_declare_fixture(tileset_test)
+{
+    std::vector<tile_def> defs;
+
+    void setup()
+    {
+        defs = random_tile_defs(16);
+    }
+
+    // The batched path must give the same bits as the scalar one, including
+    // for the tiles left over after the last full vector
+    lolunit_declare_test(quads_bit_exact)
+    {
+        for (size_t count : { 1, 2, 3, 4, 5, 7, 8, 9, 31, 100 })
+        {
+            auto tiles = random_tiles(count, (int)defs.size());
+
+            std::vector<vec3> pos[2] = { std::vector<vec3>(4 * count),
+                                         std::vector<vec3>(4 * count) };
+            std::vector<vec2> uv[2] = { std::vector<vec2>(4 * count),
+                                        std::vector<vec2>(4 * count) };
+
+            blit_quads_scalar(tiles, defs.data(), pos[0].data(), uv[0].data());
+            blit_quads(tiles, defs.data(), pos[1].data(), uv[1].data());
+
+            lolunit_set_context(count);
+            lolunit_assert(!std::memcmp(pos[0].data(), pos[1].data(), pos[0].size() * sizeof(vec3)));
+            lolunit_assert(!std::memcmp(uv[0].data(), uv[1].data(), uv[0].size() * sizeof(vec2)));
+        }
+    }
+
+    // The corners follow the 0 1 2 2 1 3 index pattern
+    lolunit_declare_test(quad_corners)
+    {
+        std::vector<Tile> tiles(1);
+        tiles[0].m_model = mat4::translate(10.f, 20.f, 0.f);
+        tiles[0].m_tileset = nullptr;
+        tiles[0].m_id = 0;
+
+        defs[0].pixel_coords = ibox2(ivec2(0, 0), ivec2(4, 2));
+        defs[0].tex_coords = box2(vec2(0.25f, 0.5f), vec2(0.5f, 0.75f));
+
+        vec3 pos[4];
+        vec2 uv[4];
+        blit_quads(tiles, defs.data(), pos, uv);
+
+        vec3 const expected_pos[] = { vec3(12.f, 21.f, 0.f), vec3(8.f, 21.f, 0.f),
+                                      vec3(12.f, 19.f, 0.f), vec3(8.f, 19.f, 0.f) };
+        vec2 const expected_uv[] = { vec2(0.5f, 0.5f), vec2(0.25f, 0.5f),
+                                     vec2(0.5f, 0.75f), vec2(0.25f, 0.75f) };
+        for (int i = 0; i < 4; ++i)
+        {
+            lolunit_set_context(i);
+            lolunit_assert_equal(pos[i].x, expected_pos[i].x);
+            lolunit_assert_equal(pos[i].y, expected_pos[i].y);
+            lolunit_assert_equal(pos[i].z, expected_pos[i].z);
+            lolunit_assert_equal(uv[i].x, expected_uv[i].x);
+            lolunit_assert_equal(uv[i].y, expected_uv[i].y);
+        }
+    }
+
+    // Tiles go back to front, and within a depth layer they are grouped
+    // by tileset, in the order the tilesets first appear in the list. This
+    // may reorder tiles at the same depth from different tilesets; tiles
+    // at the same depth from the same tileset keep their order.
+    lolunit_declare_test(sort_order)
+    {
+        // Fake tilesets: only their addresses are used
+        char sets[4];
+        float const depths[] = { 3.f, -1.5f, 0.f, 0.25f, -0.f };
+
+        tile_sorter sorter;
+        for (size_t count : { 1, 2, 10, 1000 })
+        {
+            lolunit_set_context(count);
+            std::vector<Tile> tiles(count);
+            int runs = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                tiles[i].m_model = mat4::translate(0.f, 0.f, depths[lol::rand(5)]);
+                tiles[i].m_tileset = reinterpret_cast<TileSet *>(&sets[lol::rand(4)]);
+                tiles[i].m_id = int(i);
+                runs += !i || tiles[i].m_tileset != tiles[i - 1].m_tileset;
+            }
+
+            std::map<TileSet const *, int> rank;
+            for (auto const &t : tiles)
+                rank.emplace(t.m_tileset, int(rank.size()));
+
+            auto expected = tiles;
+            std::stable_sort(expected.begin(), expected.end(),
+                             [&](Tile const &a, Tile const &b)
+            {
+                float za = a.m_model[3].z, zb = b.m_model[3].z;
+                return za != zb ? za < zb : rank[a.m_tileset] < rank[b.m_tileset];
+            });
+
+            lolunit_assert_equal(sorter.sort(tiles), runs);
+            lolunit_assert_equal(tiles.size(), count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                lolunit_set_context(i);
+                lolunit_assert_equal(tiles[i].m_id, expected[i].m_id);
+            }
+        }
+
+        std::vector<Tile> empty;
+        lolunit_assert_equal(sorter.sort(empty), 0);
+    }
+};
+
+} // namespace lol
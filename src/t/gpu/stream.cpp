@@ -0,0 +1,105 @@
+//
+//  Lol Engine — Unit tests for the streaming vertex buffer allocator
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+namespace lol
+{
+
+lolunit_declare_fixture(stream_ring_test)
+{
+    lolunit_declare_test(bump_allocation)
+    {
+        stream_ring ring(3, 100);
+        ring.begin_frame();
+
+        lolunit_assert_equal(ring.allocate(10), 0u);
+        lolunit_assert_equal(ring.allocate(20), 10u);
+        lolunit_assert_equal(ring.allocate(70), 30u);
+        lolunit_assert_equal(ring.get_stats().allocations, 0u);
+    }
+
+    lolunit_declare_test(round_robin)
+    {
+        stream_ring ring(3, 100);
+
+        for (int i = 0; i < 7; ++i)
+        {
+            ring.begin_frame();
+            lolunit_assert_equal(ring.arena(), (i + 1) % 3);
+            // Every frame starts from an empty arena
+            lolunit_assert_equal(ring.allocate(50), 0u);
+        }
+
+        lolunit_assert_equal(ring.get_stats().frames, 7u);
+    }
+
+    lolunit_declare_test(grow_in_frame)
+    {
+        stream_ring ring(2, 16);
+        ring.begin_frame();
+
+        uint64_t gen = ring.generation();
+        lolunit_assert_equal(ring.allocate(10), 0u);
+        // Does not fit: the arena grows and restarts at zero
+        lolunit_assert_equal(ring.allocate(10), 0u);
+        lolunit_assert(ring.generation() != gen);
+        lolunit_assert(ring.capacity() >= 20u);
+        lolunit_assert_equal(ring.get_stats().allocations, 1u);
+    }
+
+    lolunit_declare_test(steady_state)
+    {
+        stream_ring ring(3, 16);
+
+        // After a few frames of the same size, nothing is allocated anymore
+        for (int i = 0; i < 10; ++i)
+        {
+            ring.begin_frame();
+            for (int j = 0; j < 100; ++j)
+                ring.allocate(6);
+        }
+
+        auto allocations = ring.get_stats().allocations;
+        for (int i = 0; i < 10; ++i)
+        {
+            ring.begin_frame();
+            for (int j = 0; j < 100; ++j)
+                ring.allocate(6);
+        }
+
+        lolunit_assert_equal(ring.get_stats().allocations, allocations);
+        lolunit_assert_equal(ring.get_stats().high_water, 600u);
+    }
+
+    lolunit_declare_test(grow_at_frame_start)
+    {
+        stream_ring ring(2, 16);
+
+        ring.begin_frame();
+        ring.allocate(100);
+        ring.begin_frame();
+
+        // The other arena was grown before being used
+        lolunit_assert(ring.capacity() >= 100u);
+        uint64_t gen = ring.generation();
+        ring.allocate(100);
+        lolunit_assert_equal(ring.generation(), gen);
+    }
+};
+
+} /* namespace lol */
@@ -0,0 +1,291 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <algorithm> // std::copy
+#include <cmath>     // std::exp
+#include <cstring>   // std::memcmp
+#include <vector>    // std::vector
+
+namespace lol
+{
+
+lolunit_declare_fixture(dither_test)
+{
+    // Random 8-bit pixels, one row after another
+    static std::vector<uint8_t> random_pixels(ivec2 size)
+    {
+        std::vector<uint8_t> ret(size_t(size.x) * size.y);
+        for (auto &p : ret)
+            p = (uint8_t)lol::rand(256);
+        return ret;
+    }
+
+    // The packed output must hold the same decisions as the bytewise one,
+    // at widths around the 32-pixel SIMD blocks and the 8-pixel bytes
+    lolunit_declare_test(threshold_map_1bit)
+    {
+        old_array2d<float> ker(ivec2(5, 3));
+        for (int j = 0; j < 3; ++j)
+            for (int i = 0; i < 5; ++i)
+                ker[i][j] = lol::rand(1.f);
+
+        for (int width : { 1, 7, 31, 32, 33, 100 })
+        {
+            ivec2 const size(width, 9);
+            int const pitch = (width + 7) / 8;
+            auto src = random_pixels(size);
+
+            for (float angle : { 0.f, 0.3f })
+            {
+                old_image::threshold_map map(ker, size, 1.f, angle);
+
+                std::vector<uint8_t> bytes(size_t(size.x) * size.y);
+                std::vector<uint8_t> bits(size_t(pitch) * size.y, 0xaa);
+                map.dither_u8(src.data(), bytes.data());
+                map.dither_1bit(src.data(), bits.data());
+
+                for (int y = 0; y < size.y; ++y)
+                    for (int x = 0; x < pitch * 8; ++x)
+                    {
+                        lolunit_set_context(x);
+                        int bit = (bits[y * pitch + x / 8] >> (7 - x % 8)) & 1;
+                        // Padding bits at the end of a row are cleared
+                        int expected = x < width ? bytes[y * width + x] != 0 : 0;
+                        lolunit_assert_equal(bit, expected);
+                    }
+            }
+        }
+    }
+
+    // 8-bit thresholds give the same result as comparing p / 255 with the
+    // kernel value, which is how ordered dithering is defined
+    lolunit_declare_test(threshold_map_exact)
+    {
+        auto ker = old_image::kernel::bayer(ivec2(8));
+        ivec2 const size(45, 13);
+        auto src = random_pixels(size);
+
+        old_image::threshold_map map(ker, size);
+        std::vector<uint8_t> dst(src.size());
+        map.dither_u8(src.data(), dst.data());
+
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+            {
+                float p = src[y * size.x + x] / 255.f;
+                int expected = p > ker[x % 8][y % 8] ? 255 : 0;
+                lolunit_assert_equal((int)dst[y * size.x + x], expected);
+            }
+    }
+
+    // Float images are quantised to 8 bits before thresholding, so they
+    // dither exactly like their Y_8 conversion
+    lolunit_declare_test(threshold_map_float)
+    {
+        ivec2 const size(37, 11);
+        old_image src(size);
+        float *p = src.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            p[n] = lol::rand(1.f);
+        src.unlock(p);
+
+        old_image src8 = src;
+        src8.set_format(PixelFormat::Y_8);
+
+        old_image::threshold_map map(old_image::kernel::bayer(ivec2(4)), size);
+        old_image a = map.dither(src);
+        old_image b = map.dither(src8);
+
+        uint8_t const *pa = a.lock<PixelFormat::Y_8>();
+        uint8_t const *pb = b.lock<PixelFormat::Y_8>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            lolunit_assert_equal((int)pa[n], (int)pb[n]);
+        a.unlock(pa);
+        b.unlock(pb);
+    }
+
+    // Mean perceived squared error |p ∗ (g − f)|² / count, computed from
+    // scratch with the same HVS model as the DBS implementation
+    static double dbs_error(float const *g, float const *f, ivec2 size)
+    {
+        int const N = 7, NN = 2 * N + 1;
+        double ker[NN][NN], t = 0.0;
+        for (int j = 0; j < NN; ++j)
+            for (int i = 0; i < NN; ++i)
+            {
+                vec2 v = vec2((float)(i - N), (float)(j - N));
+                ker[j][i] = std::exp(-sqlength(v / 1.6f) / 2.f)
+                          + std::exp(-sqlength(v / 0.6f) / 2.f);
+                t += ker[j][i];
+            }
+
+        double ret = 0.0;
+        for (int y = -N; y < size.y + N; ++y)
+            for (int x = -N; x < size.x + N; ++x)
+            {
+                double e = 0.0;
+                for (int j = 0; j < NN; ++j)
+                    for (int i = 0; i < NN; ++i)
+                    {
+                        int x2 = x + i - N, y2 = y + j - N;
+                        if (x2 >= 0 && y2 >= 0 && x2 < size.x && y2 < size.y)
+                            e += ker[j][i] / t * (g[y2 * size.x + x2] - f[y2 * size.x + x2]);
+                    }
+                ret += e * e;
+            }
+        return ret / (size.x * size.y);
+    }
+
+    // Run fn on a single thread, then on several: the wavefront must give
+    // the very same pixels as the serial scan
+    template<PixelFormat T, typename F>
+    static void check_wavefront(F const &fn)
+    {
+        old_image::set_threads(1);
+        old_image serial = fn();
+        old_image::set_threads(4);
+        old_image parallel = fn();
+        old_image::set_threads(0);
+
+        lolunit_assert(serial.format() == T);
+        lolunit_assert(parallel.format() == T);
+
+        ivec2 const size = serial.size();
+        auto const *p = serial.lock<T>();
+        auto const *q = parallel.lock<T>();
+        bool same = !memcmp(p, q, sizeof(*p) * size.x * size.y);
+        serial.unlock(p);
+        parallel.unlock(q);
+        lolunit_assert(same);
+    }
+
+    lolunit_declare_test(ediff_wavefront_exact)
+    {
+        // Not a multiple of the 64-pixel progress blocks
+        ivec2 const size(301, 47);
+        auto src = random_pixels(size);
+
+        old_image grey8(size);
+        uint8_t *p = grey8.lock<PixelFormat::Y_8>();
+        std::copy(src.begin(), src.end(), p);
+        grey8.unlock(p);
+
+        old_image grey = grey8;
+        grey.set_format(PixelFormat::Y_F32);
+
+        for (auto scan : { ScanMode::Raster, ScanMode::Serpentine })
+        {
+            for (int a = 0; a <= (int)EdiffAlgorithm::Lite; ++a)
+            {
+                lolunit_set_context(a);
+                auto ker = old_image::kernel::ediff(EdiffAlgorithm(a));
+                check_wavefront<PixelFormat::Y_F32>([&]() { return grey.dither_ediff(ker, scan); });
+                check_wavefront<PixelFormat::Y_F32>([&]() { return grey8.dither_ediff(ker, scan); });
+                check_wavefront<PixelFormat::Y_8>([&]() { return grey8.dither_ediff_u8(ker, scan); });
+            }
+
+            check_wavefront<PixelFormat::Y_F32>([&]() { return grey.dither_ostromoukhov(scan); });
+            check_wavefront<PixelFormat::Y_F32>([&]() { return grey8.dither_ostromoukhov(scan); });
+            check_wavefront<PixelFormat::Y_8>([&]() { return grey8.dither_ostromoukhov_u8(scan); });
+        }
+    }
+
+    // The fixed-point path gives 0 and 255 and keeps the mean grey level,
+    // while Y_8 images given to the float path are dithered as floats
+    lolunit_declare_test(ediff_u8)
+    {
+        ivec2 const size(128, 64);
+        old_image grey8(size);
+        uint8_t *p = grey8.lock<PixelFormat::Y_8>();
+        double mean = 0.0;
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+            {
+                p[y * size.x + x] = uint8_t(x * 2 + y % 2);
+                mean += p[y * size.x + x] / 255.0;
+            }
+        mean /= size.x * size.y;
+        grey8.unlock(p);
+
+        old_image grey = grey8;
+        grey.set_format(PixelFormat::Y_F32);
+
+        auto fs = old_image::kernel::ediff(EdiffAlgorithm::FloydSteinberg);
+        auto jajuni = old_image::kernel::ediff(EdiffAlgorithm::JaJuNi);
+
+        struct { old_image fixed, from_u8, from_float; } const results[] =
+        {
+            { grey8.dither_ediff_u8(fs), grey8.dither_ediff(fs), grey.dither_ediff(fs) },
+            { grey8.dither_ediff_u8(jajuni), grey8.dither_ediff(jajuni), grey.dither_ediff(jajuni) },
+            { grey8.dither_ostromoukhov_u8(), grey8.dither_ostromoukhov(), grey.dither_ostromoukhov() },
+        };
+
+        for (auto r : results)
+        {
+            lolunit_assert(r.fixed.format() == PixelFormat::Y_8);
+            uint8_t const *q = r.fixed.lock<PixelFormat::Y_8>();
+            double fixed_mean = 0.0;
+            for (int n = 0; n < size.x * size.y; ++n)
+            {
+                lolunit_assert(q[n] == 0 || q[n] == 255);
+                fixed_mean += q[n] / 255.0;
+            }
+            r.fixed.unlock(q);
+            lolunit_assert_doubles_equal(fixed_mean / (size.x * size.y), mean, 0.02);
+
+            lolunit_assert(r.from_u8.format() == PixelFormat::Y_F32);
+            float const *f = r.from_u8.lock<PixelFormat::Y_F32>();
+            float const *g = r.from_float.lock<PixelFormat::Y_F32>();
+            bool same = !memcmp(f, g, sizeof(float) * size.x * size.y);
+            r.from_u8.unlock(f);
+            r.from_float.unlock(g);
+            lolunit_assert(same);
+        }
+    }
+
+    // The error reported after each pass is maintained incrementally from
+    // c_ep = c_pp ∗ (g − f), so it only matches a full recompute if every
+    // accepted toggle and swap updated c_ep everywhere it should have.
+    lolunit_declare_test(dbs_incremental_error)
+    {
+        for (ivec2 size : { ivec2(97, 61), ivec2(130, 70) })
+        {
+            old_image src(size);
+            float *p = src.lock<PixelFormat::Y_F32>();
+            for (int y = 0; y < size.y; ++y)
+                for (int x = 0; x < size.x; ++x)
+                    p[y * size.x + x] = float(x + y) / float(size.x + size.y);
+            src.unlock(p);
+
+            std::vector<old_image::dbs_pass> stats;
+            old_image dst = src.dither_dbs(4, 0.f, &stats);
+            lolunit_assert(!stats.empty());
+
+            float const *f = src.lock<PixelFormat::Y_F32>();
+            float const *g = dst.lock<PixelFormat::Y_F32>();
+            double const expected = dbs_error(g, f, size);
+            src.unlock(f);
+            dst.unlock(g);
+
+            lolunit_assert_doubles_equal(stats.back().error, expected, expected * 2e-5);
+        }
+    }
+};
+
+} // namespace lol
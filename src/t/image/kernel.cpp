@@ -0,0 +1,146 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <algorithm> // std::sort
+#include <cstdio>    // fopen
+#include <cstring>   // std::memcpy
+#if !defined _LIBCPP_HAS_NO_FILESYSTEM_LIBRARY && !defined _LIBCPP_AVAILABILITY_HAS_NO_FILESYSTEM_LIBRARY
+#   include <filesystem> // std::filesystem
+#   define LOL_KERNEL_CACHE 1
+#endif
+#include <random>    // std::random_device
+#include <string>    // std::to_string
+#include <vector>    // std::vector
+
+namespace lol
+{
+
+lolunit_declare_fixture(kernel_test)
+{
+    static std::vector<float> values(old_array2d<float> const &kernel)
+    {
+        std::vector<float> ret;
+        for (int y = 0; y < kernel.sizes().y; ++y)
+            for (int x = 0; x < kernel.sizes().x; ++x)
+                ret.push_back(kernel[x][y]);
+        return ret;
+    }
+
+    lolunit_declare_test(blue_noise_ranks)
+    {
+        old_image::kernel::set_cache_dir("");
+        auto kernel = old_image::kernel::blue_noise(ivec2(32, 24));
+
+        // Every pixel gets a distinct threshold
+        auto v = values(kernel);
+        std::sort(v.begin(), v.end());
+        for (int n = 0; n < 32 * 24; ++n)
+            lolunit_assert_doubles_equal(v[n], (n + 1.f) / (32 * 24 + 1), 1e-6);
+    }
+
+    lolunit_declare_test(blue_noise_seed)
+    {
+        old_image::kernel::set_cache_dir("");
+        auto a = values(old_image::kernel::blue_noise(ivec2(16, 16), ivec2(7, 7), 1));
+        auto b = values(old_image::kernel::blue_noise(ivec2(16, 16), ivec2(7, 7), 1));
+        auto c = values(old_image::kernel::blue_noise(ivec2(16, 16), ivec2(7, 7), 2));
+
+        lolunit_assert(a == b);
+        lolunit_assert(a != c);
+    }
+
+#if LOL_KERNEL_CACHE
+    static std::vector<uint8_t> read_file(std::filesystem::path const &path)
+    {
+        std::vector<uint8_t> ret(std::filesystem::file_size(path));
+        FILE *fp = fopen(path.string().c_str(), "rb");
+        lolunit_assert(fp);
+        lolunit_assert_equal(fread(ret.data(), 1, ret.size(), fp), ret.size());
+        fclose(fp);
+        return ret;
+    }
+
+    static void write_file(std::filesystem::path const &path, std::vector<uint8_t> const &data)
+    {
+        FILE *fp = fopen(path.string().c_str(), "wb");
+        lolunit_assert(fp);
+        if (!data.empty())
+            lolunit_assert_equal(fwrite(data.data(), 1, data.size(), fp), data.size());
+        fclose(fp);
+    }
+
+    lolunit_declare_test(blue_noise_cache)
+    {
+        namespace fs = std::filesystem;
+
+        auto dir = fs::temp_directory_path() / ("lol-kernel-test-" + std::to_string(std::random_device()()));
+        fs::remove_all(dir);
+        old_image::kernel::set_cache_dir(dir.string());
+
+        ivec2 const size(16, 12), gsize(7, 7);
+        auto const path = dir / "blue-noise-16x12-7x7-3.bin";
+        auto const fresh = values(old_image::kernel::blue_noise(size, gsize, 3));
+
+        // Magic, five parameters, then the values; the temporary file was
+        // renamed, not left behind
+        size_t const header = 8 + 5 * sizeof(int32_t);
+        lolunit_assert(fs::exists(path));
+        lolunit_assert_equal(size_t(fs::file_size(path)), header + fresh.size() * sizeof(float));
+        lolunit_assert_equal(std::distance(fs::directory_iterator(dir), fs::directory_iterator()), 1);
+        auto const data = read_file(path);
+
+        // The next call reads the file instead of generating the kernel
+        auto marked = data;
+        for (size_t n = header; n < marked.size(); n += sizeof(float))
+        {
+            float const mark = 0.25f;
+            std::memcpy(&marked[n], &mark, sizeof(float));
+        }
+        write_file(path, marked);
+        for (float x : values(old_image::kernel::blue_noise(size, gsize, 3)))
+            lolunit_assert_equal(x, 0.25f);
+
+        // Empty, short, corrupt or mismatched files are replaced
+        auto bad_magic = data, bad_seed = data;
+        bad_magic[7] ^= 1;
+        bad_seed[8 + 4 * sizeof(int32_t)] ^= 1;
+        std::vector<uint8_t> const bad_files[] =
+        {
+            {},
+            std::vector<uint8_t>(data.begin(), data.begin() + header),
+            std::vector<uint8_t>(data.begin(), data.end() - 1),
+            bad_magic,
+            bad_seed,
+        };
+
+        for (auto const &bad : bad_files)
+        {
+            lolunit_set_context(bad.size());
+            write_file(path, bad);
+            lolunit_assert(values(old_image::kernel::blue_noise(size, gsize, 3)) == fresh);
+            lolunit_assert(read_file(path) == data);
+        }
+
+        fs::remove_all(dir);
+        old_image::kernel::set_cache_dir("");
+    }
+#endif
+};
+
+} // namespace lol
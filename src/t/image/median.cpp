@@ -0,0 +1,148 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <algorithm>
+#include <vector>
+
+namespace lol
+{
+
+lolunit_declare_fixture(median_test)
+{
+    // Reference median with wrap-around, sorting the whole neighbourhood
+    template<typename T>
+    static T reference(T const *p, ivec2 size, ivec2 k, int x, int y)
+    {
+        std::vector<T> list;
+        for (int j = -k.y; j <= k.y; ++j)
+            for (int i = -k.x; i <= k.x; ++i)
+            {
+                int x2 = ((x + i) % size.x + size.x) % size.x;
+                int y2 = ((y + j) % size.y + size.y) % size.y;
+                list.push_back(p[y2 * size.x + x2]);
+            }
+        std::sort(list.begin(), list.end());
+        return list[list.size() / 2];
+    }
+
+    template<PixelFormat F>
+    static void check(ivec2 size, ivec2 k)
+    {
+        old_image src(size);
+        auto *p = src.lock<F>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            p[n] = (typename PixelType<F>::type)(lol::rand(256) / (F == PixelFormat::Y_8 ? 1.f : 255.f));
+        src.unlock(p);
+
+        old_image dst = src.Median(k);
+
+        auto const *s = src.lock<F>();
+        auto const *d = dst.lock<F>();
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+                lolunit_assert_equal(d[y * size.x + x], reference(s, size, k, x, y));
+        src.unlock(s);
+        dst.unlock(d);
+    }
+
+    // Reference geometric median of the neighbourhood, using the same
+    // Weiszfeld iteration as the library but with plain scalar sums
+    static vec3 reference_rgb(vec4 const *p, ivec2 size, ivec2 k, int x, int y)
+    {
+        std::vector<vec3> list;
+        for (int j = -k.y; j <= k.y; ++j)
+            for (int i = -k.x; i <= k.x; ++i)
+            {
+                int x2 = ((x + i) % size.x + size.x) % size.x;
+                int y2 = ((y + j) % size.y + size.y) % size.y;
+                list.push_back(p[y2 * size.x + x2].xyz);
+            }
+
+        vec3 oldmed(0.f), median(0.f);
+        for (int iter = 0; ; ++iter)
+        {
+            oldmed = median;
+            vec3 s1(0.f);
+            float s2 = 0.f;
+            for (vec3 const &c : list)
+            {
+                float d = 1.f / (1e-10f + distance(median, c));
+                s1 += c * d;
+                s2 += d;
+            }
+            median = s1 / s2;
+            if (iter > 1 && iter < 5)
+                median += 1.5f * (median - oldmed);
+            if (iter > 3 && distance(oldmed, median) < 1.e-5f)
+                break;
+        }
+        return median;
+    }
+
+    static void check_rgba(ivec2 size, ivec2 k)
+    {
+        old_image src(size);
+        auto *p = src.lock<PixelFormat::RGBA_8>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            p[n] = u8vec4(lol::rand(256), lol::rand(256), lol::rand(256), lol::rand(256));
+        src.unlock(p);
+
+        old_image dst = src.Median(k);
+
+        // Colour images are filtered as floats
+        auto const *s = src.lock<PixelFormat::RGBA_F32>();
+        auto const *d = dst.lock<PixelFormat::RGBA_F32>();
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+            {
+                vec4 const &c = d[y * size.x + x];
+                vec3 ref = reference_rgb(s, size, k, x, y);
+                lolunit_assert_doubles_equal(c.r, ref.r, 1e-3f);
+                lolunit_assert_doubles_equal(c.g, ref.g, 1e-3f);
+                lolunit_assert_doubles_equal(c.b, ref.b, 1e-3f);
+                // Alpha is not filtered
+                lolunit_assert_equal(c.a, s[y * size.x + x].a);
+            }
+        src.unlock(s);
+        dst.unlock(d);
+    }
+
+    lolunit_declare_test(median_y8)
+    {
+        check<PixelFormat::Y_8>(ivec2(37, 23), ivec2(1));
+        check<PixelFormat::Y_8>(ivec2(37, 23), ivec2(3, 1));
+        check<PixelFormat::Y_8>(ivec2(5, 4), ivec2(4));
+    }
+
+    lolunit_declare_test(median_f32)
+    {
+        check<PixelFormat::Y_F32>(ivec2(37, 23), ivec2(1));
+        check<PixelFormat::Y_F32>(ivec2(37, 23), ivec2(2, 1));
+        check<PixelFormat::Y_F32>(ivec2(5, 4), ivec2(4));
+    }
+
+    lolunit_declare_test(median_rgba8)
+    {
+        check_rgba(ivec2(19, 11), ivec2(1));
+        check_rgba(ivec2(19, 11), ivec2(2, 1));
+        check_rgba(ivec2(5, 4), ivec2(3));
+    }
+};
+
+} // namespace lol
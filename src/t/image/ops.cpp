@@ -0,0 +1,282 @@
+//
+//  Lol Engine — Unit tests for lazy point operations
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <algorithm>  // std::min, std::max
+#include <cmath>      // std::fabs
+#include <functional> // std::function
+#include <vector>     // std::vector
+
+namespace lol
+{
+
+// Every operation is checked against a plain loop over RGBA float pixels,
+// written the way the old one-pass-per-operation code did it.
+lolunit_declare_fixture(pixel_ops_test)
+{
+    // 1000 pixels, which is not a multiple of the 256-pixel chunks
+    ivec2 size = ivec2(40, 25);
+
+    typedef std::function<float(float, float)> binary_fn;
+
+    old_image random_image(bool colour)
+    {
+        old_image ret(size);
+        if (colour)
+        {
+            u8vec4 *p = ret.lock<PixelFormat::RGBA_8>();
+            for (int n = 0; n < size.x * size.y; ++n)
+                p[n] = u8vec4(uint8_t(lol::rand(256)), uint8_t(lol::rand(256)),
+                              uint8_t(lol::rand(256)), uint8_t(lol::rand(256)));
+            ret.unlock(p);
+        }
+        else
+        {
+            uint8_t *p = ret.lock<PixelFormat::Y_8>();
+            for (int n = 0; n < size.x * size.y; ++n)
+                p[n] = uint8_t(lol::rand(256));
+            ret.unlock(p);
+        }
+        return ret;
+    }
+
+    // Pixels as RGBA floats; grey pixels have r = g = b and an alpha of 1
+    std::vector<vec4> pixels(old_image const &im)
+    {
+        old_image tmp = im;
+        vec4 const *p = tmp.lock<PixelFormat::RGBA_F32>();
+        std::vector<vec4> ret(p, p + size.x * size.y);
+        tmp.unlock(p);
+        return ret;
+    }
+
+    // Apply f to the colour channels, and keep alpha
+    template<typename F>
+    static std::vector<vec4> unary(std::vector<vec4> v, F const &f)
+    {
+        for (auto &p : v)
+            p = vec4(f(p.r), f(p.g), f(p.b), p.a);
+        return v;
+    }
+
+    // Apply f to all channels; a greyscale result has no alpha
+    static std::vector<vec4> binary(std::vector<vec4> v, std::vector<vec4> const &w,
+                                    bool grey, binary_fn const &f)
+    {
+        for (size_t n = 0; n < v.size(); ++n)
+            v[n] = vec4(f(v[n].r, w[n].r), f(v[n].g, w[n].g), f(v[n].b, w[n].b),
+                        grey ? 1.f : f(v[n].a, w[n].a));
+        return v;
+    }
+
+    void check(old_image const &out, bool grey, std::vector<vec4> const &expected)
+    {
+        lolunit_assert(out.size() == size);
+        lolunit_assert(out.format() == (grey ? PixelFormat::Y_F32 : PixelFormat::RGBA_F32));
+
+        auto got = pixels(out);
+        for (size_t n = 0; n < expected.size(); ++n)
+        {
+            lolunit_set_context(n);
+            lolunit_assert_doubles_equal(got[n].r, expected[n].r, 1e-5f);
+            lolunit_assert_doubles_equal(got[n].g, expected[n].g, 1e-5f);
+            lolunit_assert_doubles_equal(got[n].b, expected[n].b, 1e-5f);
+            lolunit_assert_doubles_equal(got[n].a, expected[n].a, 1e-5f);
+        }
+    }
+
+    static float contrast_scale(float val)
+    {
+        return val >= 0.f ? 1.f / (1.f - std::min(val, 0.99999f))
+                          : lol::clamp(1.f + val, 0.f, 1.f);
+    }
+
+    static std::vector<vec4> auto_contrast(std::vector<vec4> const &v)
+    {
+        float lo = 1.f, hi = 0.f;
+        for (auto const &p : v)
+        {
+            lo = std::min({ lo, p.r, p.g, p.b });
+            hi = std::max({ hi, p.r, p.g, p.b });
+        }
+        float t = hi > lo ? 1.f / (hi - lo) : 1.f;
+        return unary(v, [=](float x) { return (x - lo) * t; });
+    }
+
+    lolunit_declare_test(colour_filters)
+    {
+        for (bool colour : { false, true })
+        {
+            old_image src = random_image(colour);
+            auto in = pixels(src);
+            bool grey = !colour;
+
+            check(src.Brightness(0.2f), grey,
+                  unary(in, [](float x) { return lol::clamp(x + 0.2f, 0.f, 1.f); }));
+            check(src.Brightness(-0.3f), grey,
+                  unary(in, [](float x) { return lol::clamp(x - 0.3f, 0.f, 1.f); }));
+
+            for (float val : { 0.4f, -0.4f, 1.f })
+            {
+                float s = contrast_scale(val);
+                check(src.Contrast(val), grey, unary(in, [=](float x)
+                {
+                    return lol::clamp(x * s + (-0.5f * s + 0.5f), 0.f, 1.f);
+                }));
+            }
+
+            check(src.Invert(), grey, unary(in, [](float x) { return 1.f - x; }));
+            check(src.AutoContrast(), grey, auto_contrast(in));
+
+            vec3 const t(0.3f, 0.5f, 0.7f);
+            auto expected = in;
+            for (auto &p : expected)
+                p = vec4(p.r > t.r ? 1.f : 0.f, p.g > t.g ? 1.f : 0.f,
+                         p.b > t.b ? 1.f : 0.f, p.a);
+            check(src.Threshold(t), false, expected);
+        }
+    }
+
+    // Colour images are thresholded on their luma
+    lolunit_declare_test(threshold)
+    {
+        for (bool colour : { false, true })
+        {
+            old_image src = random_image(colour);
+            old_image out = src.Threshold(0.5f);
+            lolunit_assert(out.format() == PixelFormat::Y_F32);
+
+            auto in = pixels(src), got = pixels(out);
+            for (size_t n = 0; n < in.size(); ++n)
+            {
+                lolunit_set_context(n);
+                float y = 0.299f * in[n].r + 0.587f * in[n].g + 0.114f * in[n].b;
+                // Rounding may go either way this close to the threshold
+                if (std::fabs(y - 0.5f) < 1e-5f)
+                    continue;
+                lolunit_assert_equal(got[n].r, y > 0.5f ? 1.f : 0.f);
+            }
+        }
+    }
+
+    lolunit_declare_test(auto_contrast_constant)
+    {
+        for (bool colour : { false, true })
+        {
+            old_image src(size);
+            vec4 *p = src.lock<PixelFormat::RGBA_F32>();
+            for (int n = 0; n < size.x * size.y; ++n)
+                p[n] = vec4(0.4f, 0.4f, 0.4f, 0.8f);
+            src.unlock(p);
+            if (!colour)
+                src.set_format(PixelFormat::Y_F32);
+
+            // No range to stretch: the minimum goes to zero, and nothing
+            // gets divided by zero
+            auto expected = pixels(src);
+            for (auto &q : expected)
+                q = vec4(0.f, 0.f, 0.f, q.a);
+            check(src.AutoContrast(), !colour, expected);
+        }
+    }
+
+    // Grey and colour operands in every combination
+    lolunit_declare_test(combine)
+    {
+        using std::min, std::max;
+
+        struct
+        {
+            old_image (*op)(old_image &, old_image &);
+            binary_fn ref;
+        }
+        const ops[] =
+        {
+            { old_image::Mean, [](float x, float y) { return x + (y - x) * 0.5f; } },
+            { old_image::Min, [](float x, float y) { return min(x, y); } },
+            { old_image::Max, [](float x, float y) { return max(x, y); } },
+            { old_image::Overlay, [](float x, float y) { return x * (x + 2.f * y * (1.f - x)); } },
+            { old_image::Screen, [](float x, float y) { return x + y - x * y; } },
+            { old_image::Multiply, [](float x, float y) { return x * y; } },
+            { old_image::Divide, [](float x, float y) { return x / (max(x, y) + 1e-8f); } },
+            { old_image::Add, [](float x, float y) { return min(x + y, 1.f); } },
+            { old_image::Sub, [](float x, float y) { return max(x - y, 0.f); } },
+            { old_image::Difference, [](float x, float y) { return std::fabs(x - y); } },
+        };
+
+        for (bool colour1 : { false, true })
+        for (bool colour2 : { false, true })
+        {
+            old_image a = random_image(colour1), b = random_image(colour2);
+            auto pa = pixels(a), pb = pixels(b);
+            bool grey = !colour1 && !colour2;
+
+            for (size_t k = 0; k < sizeof(ops) / sizeof(*ops); ++k)
+            {
+                lolunit_set_context(k);
+                check(ops[k].op(a, b), grey, binary(pa, pb, grey, ops[k].ref));
+            }
+
+            check(old_image::Merge(a, b, 0.3f), grey,
+                  binary(pa, pb, grey, [](float x, float y) { return x + (y - x) * 0.3f; }));
+        }
+    }
+
+    lolunit_declare_test(chains)
+    {
+        old_image grey = random_image(false), grey2 = random_image(false);
+        old_image colour = random_image(true);
+        auto pg = pixels(grey), pg2 = pixels(grey2), pc = pixels(colour);
+
+        // All greyscale
+        {
+            float s = contrast_scale(0.2f);
+            auto expected = unary(pg, [=](float x)
+            {
+                x = lol::clamp(x + 0.1f, 0.f, 1.f);
+                x = lol::clamp(x * s + (-0.5f * s + 0.5f), 0.f, 1.f);
+                return 1.f - x;
+            });
+            check(grey.ops().brightness(0.1f).contrast(0.2f).invert().eval(), true, expected);
+        }
+
+        // Grey becomes colour halfway through, then auto contrast must
+        // see the values the previous steps produce
+        {
+            auto expected = binary(pg, pc, false, [](float x, float y) { return x * y; });
+            expected = unary(expected, [](float x) { return lol::clamp(x - 0.1f, 0.f, 1.f); });
+            expected = auto_contrast(expected);
+            expected = unary(expected, [](float x) { return 1.f - x; });
+            check(grey.ops().multiply(colour).brightness(-0.1f).auto_contrast().invert().eval(),
+                  false, expected);
+        }
+
+        // Threshold to grey, then combine with grey and colour images
+        {
+            auto expected = unary(pg, [](float x) { return x > 0.5f ? 1.f : 0.f; });
+            expected = binary(expected, pg2, true, [](float x, float y) { return std::fabs(x - y); });
+            check(grey.ops().threshold(0.5f).difference(grey2).eval(), true, expected);
+
+            expected = binary(expected, pc, false, [](float x, float y) { return x + (y - x) * 0.25f; });
+            check(grey.ops().threshold(0.5f).difference(grey2).mix(colour, 0.25f).eval(),
+                  false, expected);
+        }
+    }
+};
+
+} // namespace lol
@@ -0,0 +1,134 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <algorithm> // std::min, std::max
+#include <vector>
+
+namespace lol
+{
+
+lolunit_declare_fixture(pixel_test)
+{
+    static int channel_count(PixelFormat f)
+    {
+        switch (f)
+        {
+            case PixelFormat::Y_8: case PixelFormat::Y_F32: return 1;
+            case PixelFormat::RGB_8: case PixelFormat::RGB_F32: return 3;
+            default: return 4;
+        }
+    }
+
+    static bool is_float(PixelFormat f)
+    {
+        return f == PixelFormat::Y_F32 || f == PixelFormat::RGB_F32
+            || f == PixelFormat::RGBA_F32;
+    }
+
+    // Convert an image from SRC to DST and compare every channel with a
+    // straightforward per-pixel reference. Float sources go slightly out
+    // of range to check clamping.
+    template<PixelFormat SRC, PixelFormat DST>
+    static void check(ivec2 size)
+    {
+        int const count = size.x * size.y;
+        int const sc = channel_count(SRC), dc = channel_count(DST);
+
+        std::vector<vec4> ref(count);
+        old_image img(size);
+        auto *p = img.lock<SRC>();
+        for (int n = 0; n < count; ++n)
+        {
+            for (int c = 0; c < sc; ++c)
+            {
+                if (is_float(SRC))
+                {
+                    float x = lol::rand(-0.1f, 1.1f);
+                    ((float *)p)[n * sc + c] = x;
+                    ref[n][c] = x;
+                }
+                else
+                {
+                    uint8_t x = (uint8_t)lol::rand(256);
+                    ((uint8_t *)p)[n * sc + c] = x;
+                    ref[n][c] = x / 255.f;
+                }
+            }
+            if (sc == 1)
+                ref[n].g = ref[n].b = ref[n].r;
+            if (sc < 4)
+                ref[n].a = 1.f;
+        }
+        img.unlock(p);
+
+        auto const *q = img.lock<DST>();
+        for (int n = 0; n < count; ++n)
+        {
+            lolunit_set_context(n);
+
+            // Same luma weights and order of operations as the library
+            vec4 v = ref[n];
+            if (sc > 1 && dc == 1)
+                v.r = 0.299f * v.r + 0.587f * v.g + 0.114f * v.b;
+
+            for (int c = 0; c < dc; ++c)
+            {
+                if (is_float(DST))
+                {
+                    lolunit_assert_equal(((float const *)q)[n * dc + c], v[c]);
+                }
+                else
+                {
+                    int expected = (int)(uint8_t)std::min(std::max(v[c] * 255.99f, 0.f), 255.f);
+                    lolunit_assert_equal((int)((uint8_t const *)q)[n * dc + c], expected);
+                }
+            }
+        }
+        img.unlock(q);
+    }
+
+    template<PixelFormat SRC>
+    static void check_all(ivec2 size)
+    {
+        check<SRC, PixelFormat::Y_8>(size);
+        check<SRC, PixelFormat::RGB_8>(size);
+        check<SRC, PixelFormat::RGBA_8>(size);
+        check<SRC, PixelFormat::Y_F32>(size);
+        check<SRC, PixelFormat::RGB_F32>(size);
+        check<SRC, PixelFormat::RGBA_F32>(size);
+    }
+
+    // Sizes that are not a multiple of the 8-pixel SIMD blocks exercise
+    // the tail code; the largest one is split into several bands.
+    lolunit_declare_test(convert_formats)
+    {
+        for (ivec2 size : { ivec2(1, 1), ivec2(7, 1), ivec2(8, 1), ivec2(9, 1),
+                            ivec2(17, 3), ivec2(251, 37) })
+        {
+            check_all<PixelFormat::Y_8>(size);
+            check_all<PixelFormat::RGB_8>(size);
+            check_all<PixelFormat::RGBA_8>(size);
+            check_all<PixelFormat::Y_F32>(size);
+            check_all<PixelFormat::RGB_F32>(size);
+            check_all<PixelFormat::RGBA_F32>(size);
+        }
+    }
+};
+
+} // namespace lol
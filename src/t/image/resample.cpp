@@ -0,0 +1,221 @@
+//
+//  Lol Engine — Unit tests for image resampling
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+#include <utility> // std::pair
+#include <vector>  // std::vector
+
+namespace lol
+{
+
+// 8-bit images go through fixed-point code, everything else through the
+// float code; both must give the same pictures.
+lolunit_declare_fixture(resample_test)
+{
+    static constexpr ResampleAlgorithm algorithms[] =
+    {
+        ResampleAlgorithm::Bicubic,
+        ResampleAlgorithm::Lanczos3,
+        ResampleAlgorithm::Mitchell,
+    };
+
+    // Random colours; with alpha, opaque blocks alternate with blocks of
+    // random alpha that have fully transparent columns
+    static old_image random_image(ivec2 size, bool alpha)
+    {
+        old_image ret(size);
+        u8vec4 *p = ret.lock<PixelFormat::RGBA_8>();
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+            {
+                uint8_t a = 255;
+                if (alpha && (x / 5 + y / 3) % 2 == 0)
+                    a = x % 7 ? uint8_t(lol::rand(256)) : 0;
+                p[y * size.x + x] = u8vec4(uint8_t(lol::rand(256)), uint8_t(lol::rand(256)),
+                                           uint8_t(lol::rand(256)), a);
+            }
+        ret.unlock(p);
+        return ret;
+    }
+
+    static std::vector<vec4> pixels(old_image const &im)
+    {
+        old_image tmp = im;
+        ivec2 const size = tmp.size();
+        vec4 const *p = tmp.lock<PixelFormat::RGBA_F32>();
+        std::vector<vec4> ret(p, p + size.x * size.y);
+        tmp.unlock(p);
+        return ret;
+    }
+
+    static std::vector<u8vec4> bytes(old_image const &im)
+    {
+        old_image tmp = im;
+        ivec2 const size = tmp.size();
+        u8vec4 const *p = tmp.lock<PixelFormat::RGBA_8>();
+        std::vector<u8vec4> ret(p, p + size.x * size.y);
+        tmp.unlock(p);
+        return ret;
+    }
+
+    // Colours are only compared where there is enough alpha for them to
+    // be accurate, since they are divided by it
+    lolunit_declare_test(u8_matches_float)
+    {
+        std::pair<ivec2, ivec2> const sizes[] =
+        {
+            { ivec2(37, 23), ivec2(100, 61) },
+            { ivec2(100, 61), ivec2(37, 23) },
+            { ivec2(50, 30), ivec2(33, 47) },
+            { ivec2(17, 9), ivec2(1, 1) },
+            { ivec2(1, 40), ivec2(1, 7) },
+        };
+
+        for (auto [from, to] : sizes)
+        for (bool grey : { false, true })
+        for (bool alpha : { false, true })
+        for (auto algorithm : algorithms)
+        {
+            if (grey && alpha)
+                continue;
+
+            lolunit_set_context(to.x);
+            old_image src = random_image(from, alpha);
+            if (grey)
+                src.set_format(PixelFormat::Y_8);
+            old_image srcf = src;
+            srcf.set_format(grey ? PixelFormat::Y_F32 : PixelFormat::RGBA_F32);
+
+            old_image a = src.Resize(to, algorithm);
+            old_image b = srcf.Resize(to, algorithm);
+            lolunit_assert(a.format() == src.format());
+            lolunit_assert(a.size() == to);
+            lolunit_assert(b.size() == to);
+
+            auto pa = pixels(a), pb = pixels(b);
+            for (size_t n = 0; n < pa.size(); ++n)
+            {
+                lolunit_set_context(n);
+                lolunit_assert_doubles_equal(pa[n].a, pb[n].a, 1.f / 255);
+                if (pb[n].a < 1.f / 16)
+                    continue;
+                lolunit_assert_doubles_equal(pa[n].r, pb[n].r, 1.f / 255);
+                lolunit_assert_doubles_equal(pa[n].g, pb[n].g, 1.f / 255);
+                lolunit_assert_doubles_equal(pa[n].b, pb[n].b, 1.f / 255);
+            }
+        }
+    }
+
+    // Transparent pixels must not give their colour to their neighbours,
+    // whatever it is
+    lolunit_declare_test(alpha_edges)
+    {
+        ivec2 const size(16, 4);
+        old_image src(size);
+        u8vec4 *p = src.lock<PixelFormat::RGBA_8>();
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+                p[y * size.x + x] = x < 8 ? u8vec4(255, 0, 0, 255) : u8vec4(0, 255, 0, 0);
+        src.unlock(p);
+
+        old_image srcf = src;
+        srcf.set_format(PixelFormat::RGBA_F32);
+
+        for (auto to : { ivec2(50, 10), ivec2(7, 3) })
+        for (auto algorithm : algorithms)
+        {
+            int seen = 0;
+            for (auto q : bytes(src.Resize(to, algorithm)))
+                if (q.a)
+                {
+                    lolunit_assert_equal((int)q.r, 255);
+                    lolunit_assert_equal((int)q.g, 0);
+                    lolunit_assert_equal((int)q.b, 0);
+                    ++seen;
+                }
+            lolunit_assert_greater(seen, 0);
+
+            for (auto q : pixels(srcf.Resize(to, algorithm)))
+                if (q.a > 0.f)
+                {
+                    lolunit_assert_doubles_equal(q.r, 1.f, 1e-5f);
+                    lolunit_assert_equal(q.g, 0.f);
+                    lolunit_assert_equal(q.b, 0.f);
+                }
+        }
+    }
+
+    // Bicubic and Lanczos3 interpolate, so resizing to the same size gives
+    // the same image; Mitchell blurs on purpose
+    lolunit_declare_test(identity)
+    {
+        ivec2 const size(29, 17);
+        old_image src(size);
+        u8vec4 *p = src.lock<PixelFormat::RGBA_8>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            p[n] = u8vec4(uint8_t(lol::rand(256)), uint8_t(lol::rand(256)),
+                          uint8_t(lol::rand(256)), uint8_t(1 + lol::rand(255)));
+        src.unlock(p);
+
+        old_image srcf = src;
+        srcf.set_format(PixelFormat::RGBA_F32);
+        auto in = pixels(src);
+
+        for (auto algorithm : { ResampleAlgorithm::Bicubic, ResampleAlgorithm::Lanczos3 })
+        {
+            auto a = bytes(src.Resize(size, algorithm));
+            auto b = pixels(srcf.Resize(size, algorithm));
+            auto expected = bytes(src);
+            for (size_t n = 0; n < in.size(); ++n)
+            {
+                lolunit_set_context(n);
+                lolunit_assert(a[n] == expected[n]);
+                lolunit_assert_doubles_equal(b[n].r, in[n].r, 1e-5f);
+                lolunit_assert_doubles_equal(b[n].g, in[n].g, 1e-5f);
+                lolunit_assert_doubles_equal(b[n].b, in[n].b, 1e-5f);
+                lolunit_assert_doubles_equal(b[n].a, in[n].a, 1e-5f);
+            }
+        }
+    }
+
+    // Flat areas stay exactly flat at any ratio, down to a single pixel,
+    // and a single pixel gives a flat image
+    lolunit_declare_test(flat)
+    {
+        u8vec4 const colour(200, 17, 99, 130);
+
+        for (auto [from, to] : { std::pair(ivec2(37, 23), ivec2(100, 61)),
+                                 std::pair(ivec2(37, 23), ivec2(13, 7)),
+                                 std::pair(ivec2(37, 23), ivec2(1, 1)),
+                                 std::pair(ivec2(1, 1), ivec2(17, 9)) })
+        for (auto algorithm : algorithms)
+        {
+            lolunit_set_context(to.x);
+            old_image src(from);
+            u8vec4 *p = src.lock<PixelFormat::RGBA_8>();
+            for (int n = 0; n < from.x * from.y; ++n)
+                p[n] = colour;
+            src.unlock(p);
+
+            for (auto q : bytes(src.Resize(to, algorithm)))
+                lolunit_assert(q == colour);
+        }
+    }
+};
+
+} // namespace lol
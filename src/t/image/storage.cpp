@@ -0,0 +1,65 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/unit_test>
+
+namespace lol
+{
+
+lolunit_declare_fixture(storage_test)
+{
+    lolunit_declare_test(copy_on_write)
+    {
+        old_image a(ivec2(64, 64));
+        uint8_t *p = a.lock<PixelFormat::Y_8>();
+        for (int n = 0; n < 64 * 64; ++n)
+            p[n] = uint8_t(n);
+        a.unlock(p);
+
+        auto before = old_image::get_memory_stats();
+
+        // Copies share their pixels
+        old_image b = a;
+        lolunit_assert_equal(old_image::get_memory_stats().bytes, before.bytes);
+
+        // Writing to the copy does not change the original
+        uint8_t *q = b.lock<PixelFormat::Y_8>();
+        q[0] = 42;
+        b.unlock(q);
+        lolunit_assert_equal(old_image::get_memory_stats().copies, before.copies + 1);
+
+        uint8_t const *r = a.lock<PixelFormat::Y_8>();
+        lolunit_assert_equal((int)r[0], 0);
+        a.unlock(r);
+    }
+
+    lolunit_declare_test(trim)
+    {
+        old_image a(ivec2(64, 64));
+        a.set_format(PixelFormat::Y_8);
+        float *p = a.lock<PixelFormat::Y_F32>();
+        a.unlock(p);
+
+        // The Y_8 buffer is kept for reuse until trimmed
+        lolunit_assert_equal(a.memory_usage(), size_t(64 * 64 * (1 + 4)));
+        a.trim();
+        lolunit_assert_equal(a.memory_usage(), size_t(64 * 64 * 4));
+        lolunit_assert_equal((int)a.format(), (int)PixelFormat::Y_F32);
+    }
+};
+
+} // namespace lol
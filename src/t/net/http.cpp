@@ -0,0 +1,149 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/unit_test>
+#include <lol/engine/net> // lol::net::http::service
+
+#include <httplib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lol
+{
+
+// A server on the loopback interface that remembers how many requests it
+// ran at once and which client sockets they came from
+struct local_server
+{
+    local_server()
+    {
+        m_server.Get("/hello", [](httplib::Request const &, httplib::Response &res)
+        {
+            res.set_content("hello world", "text/plain");
+        });
+
+        m_server.Get("/slow", [this](httplib::Request const &req, httplib::Response &res)
+        {
+            int n = ++m_running;
+            for (int max = m_max_running; n > max && !m_max_running.compare_exchange_weak(max, n); )
+                ;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ports.insert(req.remote_port);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            --m_running;
+            res.set_content(req.get_param_value("id"), "text/plain");
+        });
+
+        // Let a connection serve every request of a test, so that the
+        // number of client sockets only depends on the service, not on
+        // the httplib default
+        m_server.set_keep_alive_max_count(100);
+
+        m_port = m_server.bind_to_any_port("127.0.0.1");
+        m_thread = std::thread([this]() { m_server.listen_after_bind(); });
+        while (!m_server.is_running())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    ~local_server()
+    {
+        m_server.stop();
+        m_thread.join();
+    }
+
+    std::string url(std::string const &path) const
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+
+    httplib::Server m_server;
+    std::thread m_thread;
+    int m_port = 0;
+
+    std::atomic<int> m_running = 0, m_max_running = 0;
+    std::mutex m_mutex;
+    std::set<int> m_ports;
+};
+
+lolunit_declare_fixture(http_test)
+{
+    lolunit_declare_test(http_fetch)
+    {
+        local_server server;
+        net::http::service service(2, 2);
+
+        auto res = service.fetch(server.url("/hello")).get();
+        lolunit_assert_equal(200, res.code);
+        lolunit_assert_equal(std::string("hello world"), res.body);
+        lolunit_assert_equal(size_t(11), res.size);
+
+        res = service.fetch(server.url("/missing")).get();
+        lolunit_assert_equal(404, res.code);
+        lolunit_assert(!res.ok());
+
+        std::promise<int> code;
+        service.fetch(server.url("/hello"), [&](net::http::response r) { code.set_value(r.code); });
+        lolunit_assert_equal(200, code.get_future().get());
+    }
+
+    lolunit_declare_test(http_parallel_keep_alive)
+    {
+        local_server server;
+        net::http::service service(8, 4);
+
+        std::vector<std::future<net::http::response>> results;
+        for (int i = 0; i < 32; ++i)
+            results.push_back(service.fetch(server.url("/slow?id=" + std::to_string(i))));
+        for (int i = 0; i < 32; ++i)
+            lolunit_assert_equal(std::to_string(i), results[i].get().body);
+
+        // Requests ran side by side, but never on more than four
+        // connections, which were reused from one request to the next
+        lolunit_assert_greater((int)server.m_max_running, 1);
+        lolunit_assert_lequal((int)server.m_max_running, 4);
+        lolunit_assert_lequal(server.m_ports.size(), size_t(4));
+    }
+
+    lolunit_declare_test(http_fetch_to_buffer)
+    {
+        local_server server;
+        net::http::service service(2, 2);
+
+        char buf[32];
+        auto res = service.fetch(server.url("/hello"), buf, sizeof(buf)).get();
+        lolunit_assert_equal(200, res.code);
+        lolunit_assert_equal(size_t(11), res.size);
+        lolunit_assert_equal(std::string("hello world"), std::string(buf, res.size));
+        lolunit_assert(res.body.empty());
+
+        char small[4];
+        res = service.fetch(server.url("/hello"), small, sizeof(small)).get();
+        lolunit_assert(!res.ok());
+        lolunit_assert_lequal(res.size, sizeof(small));
+    }
+};
+
+} // namespace lol
@@ -0,0 +1,213 @@
+//
+//  Lol Engine — Unit tests for profiler zones
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <lol/engine.h>
+#include <lol/file> // lol::file::read
+#include <lol/unit_test>
+
+#include <filesystem> // std::filesystem
+#include <regex>      // std::regex
+#include <string>     // std::string
+#include <thread>     // std::thread
+#include <vector>     // std::vector
+
+namespace lol
+{
+
+// Every test uses its own frame numbers, since zones from the previous
+// tests are still in the buffers.
+lolunit_declare_fixture(profiler_test)
+{
+    struct zone
+    {
+        int tid;
+        double ts, dur;
+    };
+
+    std::string path;
+
+    void setup()
+    {
+        path = (std::filesystem::temp_directory_path() / "lol-profiler-test.json").string();
+        Profiler::EnableZones(true);
+    }
+
+    void teardown()
+    {
+        Profiler::EnableZones(false);
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    std::string trace(int first_frame, int last_frame)
+    {
+        lolunit_assert(Profiler::SaveTrace(path, first_frame, last_frame));
+        std::string ret;
+        file::read(path, ret);
+        lolunit_assert(ret.rfind("{\"traceEvents\":[\n", 0) == 0);
+        lolunit_assert(ret.size() >= 4 && ret.compare(ret.size() - 4, 4, "\n]}\n") == 0);
+        return ret;
+    }
+
+    // The complete events with the given name
+    static std::vector<zone> find_zones(std::string const &json, std::string const &name)
+    {
+        std::regex const re("\\{\"name\":\"" + name + "\",\"ph\":\"X\",\"pid\":1,"
+                            "\"tid\":([0-9]+),\"ts\":([0-9.]+),\"dur\":([0-9.]+)\\}");
+        std::vector<zone> ret;
+        for (std::sregex_iterator it(json.begin(), json.end(), re), end; it != end; ++it)
+            ret.push_back(zone { std::stoi((*it)[1]), std::stod((*it)[2]), std::stod((*it)[3]) });
+        return ret;
+    }
+
+    lolunit_declare_test(nesting)
+    {
+        Profiler::MarkFrame(1000);
+        {
+            ProfilerZone outer("outer");
+            for (int i = 0; i < 3; ++i)
+                ProfilerZone inner("inner");
+        }
+        Profiler::MarkFrame(1001);
+
+        auto json = trace(1000, 1000);
+        auto outer = find_zones(json, "outer");
+        auto inner = find_zones(json, "inner");
+        lolunit_assert_equal(outer.size(), 1u);
+        lolunit_assert_equal(inner.size(), 3u);
+
+        // Inner zones are within the outer one, one after the other; the
+        // times are printed with 1 ns precision
+        for (size_t i = 0; i < inner.size(); ++i)
+        {
+            lolunit_assert_equal(inner[i].tid, outer[0].tid);
+            lolunit_assert(inner[i].ts >= outer[0].ts);
+            lolunit_assert(inner[i].ts + inner[i].dur <= outer[0].ts + outer[0].dur + 0.002);
+            if (i)
+                lolunit_assert(inner[i].ts >= inner[i - 1].ts + inner[i - 1].dur - 0.002);
+        }
+    }
+
+    // An end is recorded if and only if its beginning was, whatever
+    // happened to the setting in between
+    lolunit_declare_test(balancing)
+    {
+        Profiler::MarkFrame(2000);
+
+        Profiler::EnableZones(false);
+        Profiler::BeginZone("hidden");
+        Profiler::EnableZones(true);
+        Profiler::BeginZone("shown");
+        Profiler::EndZone();
+        Profiler::EndZone();
+
+        Profiler::BeginZone("toggled");
+        Profiler::EnableZones(false);
+        Profiler::EndZone();
+        Profiler::EnableZones(true);
+
+        // Ends without a beginning are ignored
+        Profiler::EndZone();
+        Profiler::BeginZone(std::string("after"));
+        Profiler::EndZone();
+
+        Profiler::MarkFrame(2001);
+
+        auto json = trace(2000, 2000);
+        lolunit_assert_equal(find_zones(json, "hidden").size(), 0u);
+        lolunit_assert_equal(find_zones(json, "shown").size(), 1u);
+        lolunit_assert_equal(find_zones(json, "toggled").size(), 1u);
+
+        // Would have been matched with the end of "toggled" otherwise
+        auto after = find_zones(json, "after");
+        lolunit_assert_equal(after.size(), 1u);
+        lolunit_assert(after[0].ts >= find_zones(json, "toggled")[0].ts);
+    }
+
+    lolunit_declare_test(frame_range)
+    {
+        Profiler::MarkFrame(3000);
+        Profiler::BeginZone("frame 3000");
+        Profiler::EndZone();
+        Profiler::MarkFrame(3001);
+        Profiler::BeginZone("frame 3001");
+        Profiler::EndZone();
+        Profiler::MarkFrame(3002);
+        Profiler::BeginZone("frame 3002");
+        Profiler::EndZone();
+        Profiler::MarkFrame(3003);
+
+        auto json = trace(3001, 3001);
+        lolunit_assert_equal(find_zones(json, "frame 3000").size(), 0u);
+        lolunit_assert_equal(find_zones(json, "frame 3001").size(), 1u);
+        lolunit_assert_equal(find_zones(json, "frame 3002").size(), 0u);
+        lolunit_assert(json.find("\"name\":\"frame 3001\",\"ph\":\"i\"") != std::string::npos);
+
+        json = trace(3000, 3002);
+        for (auto name : { "frame 3000", "frame 3001", "frame 3002" })
+            lolunit_assert_equal(find_zones(json, name).size(), 1u);
+
+        // Frames that were never marked
+        lolunit_assert(!Profiler::SaveTrace(path, 2999, 3000));
+    }
+
+    lolunit_declare_test(escaping)
+    {
+        Profiler::MarkFrame(4000);
+        Profiler::BeginZone("a \"quoted\" \\ name\n");
+        Profiler::EndZone();
+        Profiler::MarkFrame(4001);
+
+        auto json = trace(4000, 4000);
+        lolunit_assert(json.find("\"name\":\"a \\\"quoted\\\" \\\\ name\\u000a\"") != std::string::npos);
+    }
+
+    // Each thread gets its own track, and its buffer is freed when it
+    // exits, together with the zones it recorded
+    lolunit_declare_test(threads)
+    {
+        Profiler::MarkFrame(5000);
+        {
+            ProfilerZone z("main");
+        }
+
+        bool saved = false;
+        std::string json;
+        std::thread t([&]()
+        {
+            {
+                ProfilerZone z("worker");
+            }
+            saved = Profiler::SaveTrace(path, 5000, 5000);
+            file::read(path, json);
+        });
+        t.join();
+        Profiler::MarkFrame(5001);
+
+        lolunit_assert(saved);
+        auto worker = find_zones(json, "worker");
+        auto main = find_zones(json, "main");
+        lolunit_assert_equal(worker.size(), 1u);
+        lolunit_assert_equal(main.size(), 1u);
+        lolunit_assert(worker[0].tid != main[0].tid);
+
+        json = trace(5000, 5000);
+        lolunit_assert_equal(find_zones(json, "worker").size(), 0u);
+        lolunit_assert_equal(find_zones(json, "main").size(), 1u);
+    }
+};
+
+} // namespace lol
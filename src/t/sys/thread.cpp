@@ -16,8 +16,12 @@
 #endif
 
 #include <lol/unit_test>
+#include <lol/engine/sys> // lol::sys::thread_pool
 #include <lol/thread>
 
+#include <atomic>
+#include <vector>
+
 namespace lol
 {
 
@@ -49,6 +53,32 @@ lolunit_declare_fixture(thread_test)
         lolunit_assert_equal(false, b2);
         lolunit_assert_equal(42, tmp);
     }
+
+    lolunit_declare_test(thread_pool_parallel_for)
+    {
+        sys::thread_pool pool(3);
+        std::vector<std::atomic<int>> hits(10000);
+
+        for (size_t grain : { 1, 7, 64, 20000 })
+        {
+            std::atomic<bool> oversized = false;
+            for (auto &h : hits)
+                h = 0;
+
+            pool.parallel_for(hits.size(), grain, [&](size_t begin, size_t end)
+            {
+                if (end - begin > grain)
+                    oversized = true;
+                for (size_t i = begin; i < end; ++i)
+                    ++hits[i];
+            });
+
+            // Every index must have been visited exactly once
+            lolunit_assert(!oversized);
+            for (auto &h : hits)
+                lolunit_assert_equal(1, (int)h);
+        }
+    }
 };
 
 } /* namespace lol */
@@ -0,0 +1,54 @@
+//
+//  Lol Engine — Random tiles for the tileset tests and benchmarks
+//
+//  Copyright © 2010—2025 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+#include <lol/engine.h>
+
+#include <vector> // std::vector
+
+namespace lol
+{
+
+// Tile definitions of random sizes within a 512×512 texture
+static inline std::vector<tile_def> random_tile_defs(size_t count)
+{
+    std::vector<tile_def> defs(count);
+    for (auto &d : defs)
+    {
+        ivec2 aa(lol::rand(256), lol::rand(256));
+        d.pixel_coords = ibox2(aa, aa + ivec2(1 + lol::rand(64), 1 + lol::rand(64)));
+        d.tex_coords = box2(vec2(d.pixel_coords.aa) / 512.f,
+                            vec2(d.pixel_coords.bb) / 512.f);
+    }
+    return defs;
+}
+
+// Randomly placed, rotated and scaled tiles without a tileset, using
+// tile ids below defs
+static inline std::vector<Tile> random_tiles(size_t count, int defs)
+{
+    std::vector<Tile> tiles(count);
+    for (auto &t : tiles)
+    {
+        t.m_model = mat4::translate(lol::rand(-1000.f, 1000.f),
+                                    lol::rand(-1000.f, 1000.f),
+                                    lol::rand(-10.f, 10.f))
+                  * mat4::rotate(lol::rand(-180.f, 180.f), vec3::axis_z)
+                  * mat4::scale(lol::rand(0.5f, 2.f), lol::rand(0.5f, 2.f), 1.f);
+        t.m_tileset = nullptr;
+        t.m_id = lol::rand(defs);
+    }
+    return tiles;
+}
+
+} // namespace lol